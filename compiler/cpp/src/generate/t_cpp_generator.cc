@@ -25,6 +25,8 @@
 
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <set>
 #include <sstream>
 #include <string>
 #include <vector>
@@ -56,6 +58,18 @@ class t_cpp_generator : public t_oop_generator {
     iter = parsed_options.find("include_prefix");
     use_include_prefix_ = (iter != parsed_options.end());
 
+    iter = parsed_options.find("templates");
+    gen_templates_ = (iter != parsed_options.end());
+
+    iter = parsed_options.find("arena");
+    gen_arena_ = (iter != parsed_options.end());
+
+    iter = parsed_options.find("async");
+    gen_async_ = (iter != parsed_options.end());
+
+    iter = parsed_options.find("table");
+    gen_table_ = (iter != parsed_options.end());
+
     out_dir_base_ = "gen-cpp";
   }
 
@@ -92,6 +106,9 @@ class t_cpp_generator : public t_oop_generator {
   void generate_struct_reader        (std::ofstream& out, t_struct* tstruct, bool pointers=false);
   void generate_struct_writer        (std::ofstream& out, t_struct* tstruct, bool pointers=false);
   void generate_struct_result_writer (std::ofstream& out, t_struct* tstruct, bool pointers=false);
+  void generate_struct_table         (std::ofstream& out, t_struct* tstruct);
+  void generate_struct_table_reader  (std::ofstream& out, t_struct* tstruct);
+  void generate_struct_table_writer  (std::ofstream& out, t_struct* tstruct);
 
   /**
    * Service-level generation functions
@@ -102,9 +119,13 @@ class t_cpp_generator : public t_oop_generator {
   void generate_service_multiface (t_service* tservice);
   void generate_service_helpers   (t_service* tservice);
   void generate_service_client    (t_service* tservice);
+  void generate_service_async_client (t_service* tservice);
+  void generate_client_send_body  (t_service* tservice, t_function* tfunction);
+  void generate_client_recv_body  (t_service* tservice, t_function* tfunction);
   void generate_service_processor (t_service* tservice);
   void generate_service_skeleton  (t_service* tservice);
   void generate_process_function  (t_service* tservice, t_function* tfunction);
+  void generate_process_dispatch  (const std::vector<std::string>& names);
   void generate_function_helpers  (t_service* tservice, t_function* tfunction);
 
   /**
@@ -176,9 +197,12 @@ class t_cpp_generator : public t_oop_generator {
   std::string function_signature(t_function* tfunction, std::string prefix="", bool name_params=true);
   std::string argument_list(t_struct* tstruct, bool name_params=true);
   std::string type_to_enum(t_type* ttype);
+  std::string arena_args(t_type* ttype, std::string arena);
+  std::string array_function_type(t_type* ttype);
+  std::string table_codec(t_type* ttype);
   std::string local_reflection_name(const char*, t_type* ttype, bool external=false);
 
-  // These handles checking gen_dense_ and checking for duplicates.
+  // These handles checking gen_local_reflection_ and checking for duplicates.
   void generate_local_reflection(std::ofstream& out, t_type* ttype, bool is_definition);
   void generate_local_reflection_pointer(std::ofstream& out, t_type* ttype);
 
@@ -196,6 +220,13 @@ class t_cpp_generator : public t_oop_generator {
     use_include_prefix_ = use_include_prefix;
   }
 
+  bool use_table_serializer(t_struct* tstruct) {
+    return table_structs_.find(tstruct) != table_structs_.end();
+  }
+
+  bool is_table_serializable(t_struct* tstruct);
+  bool is_table_serializable(t_type* ttype);
+
  private:
   /**
    * Returns the include prefix to use for a file generated by program, or the
@@ -214,6 +245,38 @@ class t_cpp_generator : public t_oop_generator {
    */
   bool use_include_prefix_;
 
+  /**
+   * True iff we should generate templatized reader/writer methods.
+   */
+  bool gen_templates_;
+
+  /**
+   * True iff strings and containers should use TArenaAllocator.
+   */
+  bool gen_arena_;
+
+  /**
+   * True iff we should generate pipelined asynchronous clients.
+   */
+  bool gen_async_;
+
+  /**
+   * True iff structs should be read and written by the table-driven
+   * serializer unless they are annotated otherwise.
+   */
+  bool gen_table_;
+
+  /**
+   * True iff we should generate local reflection TypeSpecs, which both
+   * TDenseProtocol and the table-driven serializer need.
+   */
+  bool gen_local_reflection_;
+
+  /**
+   * The structs that use the table-driven serializer.
+   */
+  std::set<t_struct*> table_structs_;
+
   /**
    * Strings for namespace, computed once up front then used directly
    */
@@ -228,6 +291,7 @@ class t_cpp_generator : public t_oop_generator {
 
   std::ofstream f_types_;
   std::ofstream f_types_impl_;
+  std::ofstream f_types_tcc_;
   std::ofstream f_header_;
   std::ofstream f_service_;
 
@@ -248,6 +312,37 @@ void t_cpp_generator::init_generator() {
   // Make output directory
   MKDIR(get_out_dir().c_str());
 
+  // Pick the structs that use the table-driven serializer.  The "table"
+  // option is the default, and the cpp.serializer annotation overrides it.
+  vector<t_struct*> structs = program_->get_structs();
+  const vector<t_struct*>& xceptions = program_->get_xceptions();
+  structs.insert(structs.end(), xceptions.begin(), xceptions.end());
+  for (vector<t_struct*>::iterator s_iter = structs.begin(); s_iter != structs.end(); ++s_iter) {
+    bool table = gen_table_;
+    std::map<string, string>::iterator it = (*s_iter)->annotations_.find("cpp.serializer");
+    if (it != (*s_iter)->annotations_.end()) {
+      if (it->second == "table") {
+        table = true;
+      } else if (it->second == "generated") {
+        table = false;
+      } else {
+        pwarning(1, "Unknown cpp.serializer \"%s\" for %s\n",
+                 it->second.c_str(), (*s_iter)->get_name().c_str());
+      }
+    }
+    if (table && !is_table_serializable(*s_iter)) {
+      if (it != (*s_iter)->annotations_.end()) {
+        pwarning(1, "%s cannot use the table serializer, generating code for it\n",
+                 (*s_iter)->get_name().c_str());
+      }
+      table = false;
+    }
+    if (table) {
+      table_structs_.insert(*s_iter);
+    }
+  }
+  gen_local_reflection_ = gen_dense_ || !table_structs_.empty();
+
   // Make output file
   string f_types_name = get_out_dir()+program_name_+"_types.h";
   f_types_.open(f_types_name.c_str());
@@ -255,17 +350,30 @@ void t_cpp_generator::init_generator() {
   string f_types_impl_name = get_out_dir()+program_name_+"_types.cpp";
   f_types_impl_.open(f_types_impl_name.c_str());
 
+  if (gen_templates_) {
+    // When templates are off the tcc stream is never opened, and anything
+    // written to it is simply discarded.
+    string f_types_tcc_name = get_out_dir()+program_name_+"_types.tcc";
+    f_types_tcc_.open(f_types_tcc_name.c_str());
+  }
+
   // Print header
   f_types_ <<
     autogen_comment();
   f_types_impl_ <<
     autogen_comment();
+  f_types_tcc_ <<
+    autogen_comment();
 
   // Start ifndef
   f_types_ <<
     "#ifndef " << program_name_ << "_TYPES_H" << endl <<
     "#define " << program_name_ << "_TYPES_H" << endl <<
     endl;
+  f_types_tcc_ <<
+    "#ifndef " << program_name_ << "_TYPES_TCC" << endl <<
+    "#define " << program_name_ << "_TYPES_TCC" << endl <<
+    endl;
 
   // Include base types
   f_types_ <<
@@ -275,6 +383,18 @@ void t_cpp_generator::init_generator() {
     "#include <transport/TTransport.h>" << endl <<
     endl;
 
+  if (gen_arena_) {
+    f_types_ <<
+      "#include <TArena.h>" << endl <<
+      endl;
+  }
+
+  if (!table_structs_.empty()) {
+    f_types_ <<
+      "#include <protocol/TTableSerializer.h>" << endl <<
+      endl;
+  }
+
   // Include other Thrift includes
   const vector<t_program*>& includes = program_->get_includes();
   for (size_t i = 0; i < includes.size(); ++i) {
@@ -303,10 +423,14 @@ void t_cpp_generator::init_generator() {
     "#include \"" << get_include_prefix(*get_program()) << program_name_ <<
     "_types.h\"" << endl <<
     endl;
+  f_types_tcc_ <<
+    "#include \"" << get_include_prefix(*get_program()) << program_name_ <<
+    "_types.h\"" << endl <<
+    endl;
 
   // If we are generating local reflection metadata, we need to include
   // the definition of TypeSpec.
-  if (gen_dense_) {
+  if (gen_local_reflection_) {
     f_types_impl_ <<
       "#include <TReflectionLocal.h>" << endl <<
       endl;
@@ -323,6 +447,10 @@ void t_cpp_generator::init_generator() {
   f_types_impl_ <<
     ns_open_ << endl <<
     endl;
+
+  f_types_tcc_ <<
+    ns_open_ << endl <<
+    endl;
 }
 
 /**
@@ -335,14 +463,29 @@ void t_cpp_generator::close_generator() {
     endl;
   f_types_impl_ <<
     ns_close_ << endl;
+  f_types_tcc_ <<
+    ns_close_ << endl <<
+    endl;
+
+  // Include the types.tcc file from the types header file,
+  // so clients don't have to explicitly include the tcc file.
+  if (gen_templates_) {
+    f_types_ <<
+      "#include \"" << get_include_prefix(*get_program()) << program_name_ <<
+      "_types.tcc\"" << endl <<
+      endl;
+  }
 
   // Close ifndef
   f_types_ <<
     "#endif" << endl;
+  f_types_tcc_ <<
+    "#endif" << endl;
 
   // Close output file
   f_types_.close();
   f_types_impl_.close();
+  f_types_tcc_.close();
 }
 
 /**
@@ -604,8 +747,16 @@ void t_cpp_generator::generate_cpp_struct(t_struct* tstruct, bool is_exception)
   generate_local_reflection(f_types_, tstruct, false);
   generate_local_reflection(f_types_impl_, tstruct, true);
   generate_local_reflection_pointer(f_types_impl_, tstruct);
-  generate_struct_reader(f_types_impl_, tstruct);
-  generate_struct_writer(f_types_impl_, tstruct);
+
+  std::ofstream& out = (gen_templates_ ? f_types_tcc_ : f_types_impl_);
+  if (use_table_serializer(tstruct)) {
+    generate_struct_table(f_types_impl_, tstruct);
+    generate_struct_table_reader(out, tstruct);
+    generate_struct_table_writer(out, tstruct);
+  } else {
+    generate_struct_reader(out, tstruct);
+    generate_struct_writer(out, tstruct);
+  }
 }
 
 /**
@@ -640,14 +791,13 @@ void t_cpp_generator::generate_struct_definition(ofstream& out,
   const vector<t_field*>& members = tstruct->get_members();
 
   if (!pointers) {
-    // Default constructor
-    indent(out) <<
-      tstruct->get_name() << "()";
-
-    bool init_ctor = false;
-
+    // Default constructor.  With arenas it takes the arena that the
+    // strings, containers and nested structs should be allocated from.
+    string inits;
+    bool uses_arena = false;
     for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
       t_type* t = get_true_type((*m_iter)->get_type());
+      string init;
       if (t->is_base_type()) {
         string dval;
         if (t->is_enum()) {
@@ -658,16 +808,30 @@ void t_cpp_generator::generate_struct_definition(ofstream& out,
         if (cv != NULL) {
           dval = render_const_value(out, (*m_iter)->get_name(), t, cv);
         }
-        if (!init_ctor) {
-          init_ctor = true;
-          out << " : ";
-          out << (*m_iter)->get_name() << "(" << dval << ")";
+        if (gen_arena_ && t->is_string()) {
+          init = "(" + dval + ", arena)";
+          uses_arena = true;
         } else {
-          out << ", " << (*m_iter)->get_name() << "(" << dval << ")";
+          init = "(" + dval + ")";
         }
+      } else {
+        init = arena_args((*m_iter)->get_type(), "arena");
+        uses_arena = uses_arena || !init.empty();
       }
+      if (!init.empty()) {
+        inits += (inits.empty() ? " : " : ", ") + (*m_iter)->get_name() + init;
+      }
+    }
+
+    if (gen_arena_) {
+      indent(out) <<
+        "explicit " << tstruct->get_name() << "(::apache::thrift::TArena* " <<
+        (uses_arena ? "arena" : "/* arena */") << " = NULL)";
+    } else {
+      indent(out) <<
+        tstruct->get_name() << "()";
     }
-    out << " {" << endl;
+    out << inits << " {" << endl;
     indent_up();
     // TODO(dreiss): When everything else in Thrift is perfect,
     // do more of these in the initializer list.
@@ -697,6 +861,13 @@ void t_cpp_generator::generate_struct_definition(ofstream& out,
       endl << endl;
   }
 
+  // What read() and write() interpret instead of generated code.
+  if (use_table_serializer(tstruct)) {
+    indent(out) <<
+      "static const ::apache::thrift::protocol::table::StructTable serializer_table;" <<
+      endl << endl;
+  }
+
   // Declare all fields
   for (m_iter = members.begin(); m_iter != members.end(); ++m_iter) {
     indent(out) <<
@@ -789,12 +960,24 @@ void t_cpp_generator::generate_struct_definition(ofstream& out,
                << tstruct->get_name() << " & ) const;" << endl << endl;
   }
   if (read) {
-    out <<
-      indent() << "uint32_t read(::apache::thrift::protocol::TProtocol* iprot);" << endl;
+    if (gen_templates_) {
+      out <<
+        indent() << "template <class Protocol_>" << endl <<
+        indent() << "uint32_t read(Protocol_* iprot);" << endl;
+    } else {
+      out <<
+        indent() << "uint32_t read(::apache::thrift::protocol::TProtocol* iprot);" << endl;
+    }
   }
   if (write) {
-    out <<
-      indent() << "uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;" << endl;
+    if (gen_templates_) {
+      out <<
+        indent() << "template <class Protocol_>" << endl <<
+        indent() << "uint32_t write(Protocol_* oprot) const;" << endl;
+    } else {
+      out <<
+        indent() << "uint32_t write(::apache::thrift::protocol::TProtocol* oprot) const;" << endl;
+    }
   }
   out << endl;
 
@@ -846,7 +1029,7 @@ void t_cpp_generator::generate_struct_fingerprint(ofstream& out,
 void t_cpp_generator::generate_local_reflection(std::ofstream& out,
                                                 t_type* ttype,
                                                 bool is_definition) {
-  if (!gen_dense_) {
+  if (!gen_local_reflection_) {
     return;
   }
   ttype = get_true_type(ttype);
@@ -981,8 +1164,16 @@ void t_cpp_generator::generate_local_reflection_pointer(std::ofstream& out,
 void t_cpp_generator::generate_struct_reader(ofstream& out,
                                              t_struct* tstruct,
                                              bool pointers) {
-  indent(out) <<
-    "uint32_t " << tstruct->get_name() << "::read(::apache::thrift::protocol::TProtocol* iprot) {" << endl;
+  if (gen_templates_) {
+    out <<
+      indent() << "template <class Protocol_>" << endl <<
+      indent() << "uint32_t " << tstruct->get_name() <<
+      "::read(Protocol_* iprot) {" << endl;
+  } else {
+    indent(out) <<
+      "uint32_t " << tstruct->get_name() <<
+      "::read(::apache::thrift::protocol::TProtocol* iprot) {" << endl;
+  }
   indent_up();
 
   const vector<t_field*>& fields = tstruct->get_members();
@@ -992,11 +1183,10 @@ void t_cpp_generator::generate_struct_reader(ofstream& out,
   out <<
     endl <<
     indent() << "uint32_t xfer = 0;" << endl <<
-    indent() << "std::string fname;" << endl <<
     indent() << "::apache::thrift::protocol::TType ftype;" << endl <<
     indent() << "int16_t fid;" << endl <<
     endl <<
-    indent() << "xfer += iprot->readStructBegin(fname);" << endl <<
+    indent() << "xfer += iprot->readStructBegin();" << endl <<
     endl <<
     indent() << "using ::apache::thrift::protocol::TProtocolException;" << endl <<
     endl;
@@ -1016,7 +1206,7 @@ void t_cpp_generator::generate_struct_reader(ofstream& out,
 
     // Read beginning field marker
     indent(out) <<
-      "xfer += iprot->readFieldBegin(fname, ftype, fid);" << endl;
+      "xfer += iprot->readFieldBegin(ftype, fid);" << endl;
 
     // Check for field STOP marker
     out <<
@@ -1120,8 +1310,16 @@ void t_cpp_generator::generate_struct_writer(ofstream& out,
   const vector<t_field*>& fields = tstruct->get_sorted_members();
   vector<t_field*>::const_iterator f_iter;
 
-  indent(out) <<
-    "uint32_t " << tstruct->get_name() << "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
+  if (gen_templates_) {
+    out <<
+      indent() << "template <class Protocol_>" << endl <<
+      indent() << "uint32_t " << tstruct->get_name() <<
+      "::write(Protocol_* oprot) const {" << endl;
+  } else {
+    indent(out) <<
+      "uint32_t " << tstruct->get_name() <<
+      "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
+  }
   indent_up();
 
   out <<
@@ -1182,8 +1380,16 @@ void t_cpp_generator::generate_struct_result_writer(ofstream& out,
   const vector<t_field*>& fields = tstruct->get_sorted_members();
   vector<t_field*>::const_iterator f_iter;
 
-  indent(out) <<
-    "uint32_t " << tstruct->get_name() << "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
+  if (gen_templates_) {
+    out <<
+      indent() << "template <class Protocol_>" << endl <<
+      indent() << "uint32_t " << tstruct->get_name() <<
+      "::write(Protocol_* oprot) const {" << endl;
+  } else {
+    indent(out) <<
+      "uint32_t " << tstruct->get_name() <<
+      "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
+  }
   indent_up();
 
   out <<
@@ -1242,6 +1448,117 @@ void t_cpp_generator::generate_struct_result_writer(ofstream& out,
     endl;
 }
 
+/**
+ * Writes the table that the table-driven serializer reads and writes a
+ * struct by: a FieldTable for each field, in the order of the struct's
+ * local reflection TypeSpec, and the StructTable that holds them.
+ *
+ * @param out Output stream
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_table(ofstream& out,
+                                            t_struct* tstruct) {
+  string name = tstruct->get_name();
+  const vector<t_field*>& fields = tstruct->get_sorted_members();
+  vector<t_field*>::const_iterator f_iter;
+  string fields_name = "NULL";
+  uint64_t required_fields = 0;
+
+  if (!fields.empty()) {
+    fields_name = name + "_table_fields";
+    indent(out) <<
+      "static const ::apache::thrift::protocol::table::FieldTable " <<
+      fields_name << "[] = {" << endl;
+    indent_up();
+    for (f_iter = fields.begin(); f_iter != fields.end(); ++f_iter) {
+      string fname = (*f_iter)->get_name();
+      string isset = "-1";
+      if ((*f_iter)->get_req() == t_field::T_REQUIRED) {
+        required_fields |= (uint64_t)1 << (f_iter - fields.begin());
+      } else {
+        isset = "THRIFT_FIELD_OFFSET(" + name + ", __isset." + fname + ")";
+      }
+      // Bools, numbers and strings are handled by the serializer itself
+      t_type* type = get_true_type((*f_iter)->get_type());
+      string reader = "NULL";
+      string writer = "NULL";
+      if (!type->is_base_type() || ((t_base_type*)type)->is_binary()) {
+        string codec = table_codec(type);
+        reader = "&::apache::thrift::protocol::table::readField< " + codec + " >";
+        writer = "&::apache::thrift::protocol::table::writeField< " + codec + " >";
+      }
+      indent(out) << "{ \"" << fname << "\", THRIFT_FIELD_OFFSET(" << name <<
+        ", " << fname << "), " << isset << "," << endl;
+      indent(out) << "  " << reader << "," << endl;
+      indent(out) << "  " << writer << " }," << endl;
+    }
+    indent_down();
+    indent(out) << "};" << endl << endl;
+  }
+
+  indent(out) <<
+    "const ::apache::thrift::protocol::table::StructTable " << name <<
+    "::serializer_table = {" << endl;
+  indent_up();
+  indent(out) << "\"" << name << "\"," << endl;
+  indent(out) << "&" << local_reflection_name("typespec", tstruct) << "," << endl;
+  indent(out) << fields_name << "," << endl;
+  indent(out) << fields.size() << "," << endl;
+  indent(out) << "0x" << std::hex << required_fields << std::dec << "ULL" << endl;
+  indent_down();
+  indent(out) << "};" << endl << endl;
+}
+
+/**
+ * Generates a read function that hands the struct's table to the
+ * table-driven serializer.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_table_reader(ofstream& out,
+                                                   t_struct* tstruct) {
+  if (gen_templates_) {
+    out <<
+      indent() << "template <class Protocol_>" << endl <<
+      indent() << "uint32_t " << tstruct->get_name() <<
+      "::read(Protocol_* iprot) {" << endl;
+  } else {
+    indent(out) <<
+      "uint32_t " << tstruct->get_name() <<
+      "::read(::apache::thrift::protocol::TProtocol* iprot) {" << endl;
+  }
+  indent(out) <<
+    "  return ::apache::thrift::protocol::table::read(iprot, this, serializer_table);" << endl;
+  indent(out) <<
+    "}" << endl << endl;
+}
+
+/**
+ * Generates a write function that hands the struct's table to the
+ * table-driven serializer.
+ *
+ * @param out Stream to write to
+ * @param tstruct The struct
+ */
+void t_cpp_generator::generate_struct_table_writer(ofstream& out,
+                                                   t_struct* tstruct) {
+  if (gen_templates_) {
+    out <<
+      indent() << "template <class Protocol_>" << endl <<
+      indent() << "uint32_t " << tstruct->get_name() <<
+      "::write(Protocol_* oprot) const {" << endl;
+  } else {
+    indent(out) <<
+      "uint32_t " << tstruct->get_name() <<
+      "::write(::apache::thrift::protocol::TProtocol* oprot) const {" << endl;
+  }
+  indent(out) <<
+    "  return ::apache::thrift::protocol::table::write(oprot, this, serializer_table);" << endl;
+  indent(out) <<
+    "}" << endl << endl;
+}
+
 /**
  * Generates a thrift service. In C++, this comprises an entirely separate
  * header and source file. The header file defines the methods and includes
@@ -1275,6 +1592,11 @@ void t_cpp_generator::generate_service(t_service* tservice) {
       extends_service->get_name() << ".h\"" << endl;
   }
 
+  if (gen_async_) {
+    f_header_ <<
+      "#include <async/TAsyncClient.h>" << endl;
+  }
+
   f_header_ <<
     endl <<
     ns_open_ << endl <<
@@ -1288,6 +1610,7 @@ void t_cpp_generator::generate_service(t_service* tservice) {
   f_service_ <<
     "#include \"" << get_include_prefix(*get_program()) << svcname << ".h\"" <<
     endl <<
+    "#include <cstring>" << endl <<
     endl <<
     ns_open_ << endl <<
     endl;
@@ -1297,6 +1620,9 @@ void t_cpp_generator::generate_service(t_service* tservice) {
   generate_service_null(tservice);
   generate_service_helpers(tservice);
   generate_service_client(tservice);
+  if (gen_async_) {
+    generate_service_async_client(tservice);
+  }
   generate_service_processor(tservice);
   generate_service_multiface(tservice);
   generate_service_skeleton(tservice);
@@ -1690,28 +2016,9 @@ void t_cpp_generator::generate_service_client(t_service* tservice) {
       function_signature(&send_function, scope) << endl;
     scope_up(f_service_);
 
-    // Function arguments and results
-    string argsname = tservice->get_name() + "_" + (*f_iter)->get_name() + "_pargs";
-    string resultname = tservice->get_name() + "_" + (*f_iter)->get_name() + "_presult";
-
-    // Serialize the request
     f_service_ <<
-      indent() << "int32_t cseqid = 0;" << endl <<
-      indent() << "oprot_->writeMessageBegin(\"" << (*f_iter)->get_name() << "\", ::apache::thrift::protocol::T_CALL, cseqid);" << endl <<
-      endl <<
-      indent() << argsname << " args;" << endl;
-
-    for (fld_iter = fields.begin(); fld_iter != fields.end(); ++fld_iter) {
-      f_service_ <<
-        indent() << "args." << (*fld_iter)->get_name() << " = &" << (*fld_iter)->get_name() << ";" << endl;
-    }
-
-    f_service_ <<
-      indent() << "args.write(oprot_);" << endl <<
-      endl <<
-      indent() << "oprot_->writeMessageEnd();" << endl <<
-      indent() << "oprot_->getTransport()->flush();" << endl <<
-      indent() << "oprot_->getTransport()->writeEnd();" << endl;
+      indent() << "int32_t cseqid = 0;" << endl;
+    generate_client_send_body(tservice, *f_iter);
 
     scope_down(f_service_);
     f_service_ << endl;
@@ -1727,96 +2034,233 @@ void t_cpp_generator::generate_service_client(t_service* tservice) {
         function_signature(&recv_function, scope) << endl;
       scope_up(f_service_);
 
-      f_service_ <<
-        endl <<
-        indent() << "int32_t rseqid = 0;" << endl <<
-        indent() << "std::string fname;" << endl <<
-        indent() << "::apache::thrift::protocol::TMessageType mtype;" << endl <<
-        endl <<
-        indent() << "iprot_->readMessageBegin(fname, mtype, rseqid);" << endl <<
-        indent() << "if (mtype == ::apache::thrift::protocol::T_EXCEPTION) {" << endl <<
-        indent() << "  ::apache::thrift::TApplicationException x;" << endl <<
-        indent() << "  x.read(iprot_);" << endl <<
-        indent() << "  iprot_->readMessageEnd();" << endl <<
-        indent() << "  iprot_->getTransport()->readEnd();" << endl <<
-        indent() << "  throw x;" << endl <<
-        indent() << "}" << endl <<
-        indent() << "if (mtype != ::apache::thrift::protocol::T_REPLY) {" << endl <<
-        indent() << "  iprot_->skip(::apache::thrift::protocol::T_STRUCT);" << endl <<
-        indent() << "  iprot_->readMessageEnd();" << endl <<
-        indent() << "  iprot_->getTransport()->readEnd();" << endl <<
-        indent() << "  throw ::apache::thrift::TApplicationException(::apache::thrift::TApplicationException::INVALID_MESSAGE_TYPE);" << endl <<
-        indent() << "}" << endl <<
-        indent() << "if (fname.compare(\"" << (*f_iter)->get_name() << "\") != 0) {" << endl <<
-        indent() << "  iprot_->skip(::apache::thrift::protocol::T_STRUCT);" << endl <<
-        indent() << "  iprot_->readMessageEnd();" << endl <<
-        indent() << "  iprot_->getTransport()->readEnd();" << endl <<
-        indent() << "  throw ::apache::thrift::TApplicationException(::apache::thrift::TApplicationException::WRONG_METHOD_NAME);" << endl <<
-        indent() << "}" << endl;
+      generate_client_recv_body(tservice, *f_iter);
 
-      if (!(*f_iter)->get_returntype()->is_void() &&
-          !is_complex_type((*f_iter)->get_returntype())) {
-        t_field returnfield((*f_iter)->get_returntype(), "_return");
-        f_service_ <<
-          indent() << declare_field(&returnfield) << endl;
-      }
+      // Close function
+      scope_down(f_service_);
+      f_service_ << endl;
+    }
+  }
+}
 
-      f_service_ <<
-        indent() << resultname << " result;" << endl;
+/**
+ * Generates a pipelined asynchronous client for a service.  Each call
+ * takes a callback that is run with the client once the response has
+ * arrived, from which the callback reads it with recv_.
+ *
+ * @param tservice The service to generate a client for
+ */
+void t_cpp_generator::generate_service_async_client(t_service* tservice) {
+  string extends_client = " ::apache::thrift::async::TAsyncClient";
+  if (tservice->get_extends() != NULL) {
+    extends_client = " " + type_name(tservice->get_extends()) + "AsyncClient";
+  }
+  string client = service_name_ + "AsyncClient";
 
-      if (!(*f_iter)->get_returntype()->is_void()) {
-        f_service_ <<
-          indent() << "result.success = &_return;" << endl;
-      }
+  // Generate the header portion
+  f_header_ <<
+    "class " << client << " : public" << extends_client << " {" << endl <<
+    " public:" << endl;
 
-      f_service_ <<
-        indent() << "result.read(iprot_);" << endl <<
-        indent() << "iprot_->readMessageEnd();" << endl <<
-        indent() << "iprot_->getTransport()->readEnd();" << endl <<
-        endl;
+  indent_up();
+  f_header_ <<
+    indent() << "typedef std::tr1::function<void (" << client << "* client)> Callback;" << endl <<
+    endl <<
+    indent() << client << "(boost::shared_ptr< ::apache::thrift::async::TAsyncChannel> channel, boost::shared_ptr< ::apache::thrift::protocol::TProtocolFactory> protocolFactory) :" << endl <<
+    indent() << " " << extends_client << "(channel, protocolFactory) {}" << endl;
 
-      // Careful, only look for _result if not a void function
-      if (!(*f_iter)->get_returntype()->is_void()) {
-        if (is_complex_type((*f_iter)->get_returntype())) {
-          f_service_ <<
-            indent() << "if (result.__isset.success) {" << endl <<
-            indent() << "  // _return pointer has now been filled" << endl <<
-            indent() << "  return;" << endl <<
-            indent() << "}" << endl;
-        } else {
-          f_service_ <<
-            indent() << "if (result.__isset.success) {" << endl <<
-            indent() << "  return _return;" << endl <<
-            indent() << "}" << endl;
-        }
-      }
+  vector<t_function*> functions = tservice->get_functions();
+  vector<t_function*>::const_iterator f_iter;
+  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
+    t_struct* arglist = (*f_iter)->get_arglist();
+    string args = argument_list(arglist);
+    if (!(*f_iter)->is_oneway()) {
+      args = "Callback cob" + (args.empty() ? "" : ", " + args);
+    }
+    indent(f_header_) << "void " << (*f_iter)->get_name() << "(" << args << ");" << endl;
+    if (!(*f_iter)->is_oneway()) {
+      t_struct noargs(program_);
+      t_function recv_function((*f_iter)->get_returntype(),
+                               string("recv_") + (*f_iter)->get_name(),
+                               &noargs);
+      indent(f_header_) << function_signature(&recv_function) << ";" << endl;
+    }
+  }
+  indent_down();
 
-      t_struct* xs = (*f_iter)->get_xceptions();
-      const std::vector<t_field*>& xceptions = xs->get_members();
-      vector<t_field*>::const_iterator x_iter;
-      for (x_iter = xceptions.begin(); x_iter != xceptions.end(); ++x_iter) {
-        f_service_ <<
-          indent() << "if (result.__isset." << (*x_iter)->get_name() << ") {" << endl <<
-          indent() << "  throw result." << (*x_iter)->get_name() << ";" << endl <<
-          indent() << "}" << endl;
-      }
+  f_header_ <<
+    "};" << endl <<
+    endl;
 
-      // We only get here if we are a void function
-      if ((*f_iter)->get_returntype()->is_void()) {
-        indent(f_service_) <<
-          "return;" << endl;
-      } else {
-        f_service_ <<
-          indent() << "throw ::apache::thrift::TApplicationException(::apache::thrift::TApplicationException::MISSING_RESULT, \"" << (*f_iter)->get_name() << " failed: unknown result\");" << endl;
-      }
+  string scope = client + "::";
 
-      // Close function
+  // Generate client method implementations
+  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
+    t_struct* arglist = (*f_iter)->get_arglist();
+    string args = argument_list(arglist);
+    if (!(*f_iter)->is_oneway()) {
+      args = "Callback cob" + (args.empty() ? "" : ", " + args);
+    }
+    indent(f_service_) << "void " << scope << (*f_iter)->get_name() << "(" << args << ")" << endl;
+    scope_up(f_service_);
+    f_service_ <<
+      indent() << "int32_t cseqid = beginCall();" << endl;
+    generate_client_send_body(tservice, *f_iter);
+    f_service_ << endl;
+    if ((*f_iter)->is_oneway()) {
+      indent(f_service_) << "endCall(cseqid, Completion());" << endl;
+    } else {
+      indent(f_service_) << "endCall(cseqid, std::tr1::bind(cob, this));" << endl;
+    }
+    scope_down(f_service_);
+    f_service_ << endl;
+
+    if (!(*f_iter)->is_oneway()) {
+      t_struct noargs(program_);
+      t_function recv_function((*f_iter)->get_returntype(),
+                               string("recv_") + (*f_iter)->get_name(),
+                               &noargs);
+      indent(f_service_) <<
+        function_signature(&recv_function, scope) << endl;
+      scope_up(f_service_);
+      f_service_ <<
+        indent() << "checkResponse();" << endl;
+      generate_client_recv_body(tservice, *f_iter);
       scope_down(f_service_);
       f_service_ << endl;
     }
   }
 }
 
+/**
+ * Generates the statements of a client's send function that write a call,
+ * with the sequence id in cseqid.
+ *
+ * @param tservice  The service the function belongs to
+ * @param tfunction The function to write a call to
+ */
+void t_cpp_generator::generate_client_send_body(t_service* tservice,
+                                                t_function* tfunction) {
+  string argsname = tservice->get_name() + "_" + tfunction->get_name() + "_pargs";
+
+  // Serialize the request
+  f_service_ <<
+    indent() << "oprot_->writeMessageBegin(\"" << tfunction->get_name() << "\", ::apache::thrift::protocol::T_CALL, cseqid);" << endl <<
+    endl <<
+    indent() << argsname << " args;" << endl;
+
+  const vector<t_field*>& fields = tfunction->get_arglist()->get_members();
+  vector<t_field*>::const_iterator fld_iter;
+  for (fld_iter = fields.begin(); fld_iter != fields.end(); ++fld_iter) {
+    f_service_ <<
+      indent() << "args." << (*fld_iter)->get_name() << " = &" << (*fld_iter)->get_name() << ";" << endl;
+  }
+
+  f_service_ <<
+    indent() << "args.write(oprot_);" << endl <<
+    endl <<
+    indent() << "oprot_->writeMessageEnd();" << endl <<
+    indent() << "oprot_->getTransport()->flush();" << endl <<
+    indent() << "oprot_->getTransport()->writeEnd();" << endl;
+}
+
+/**
+ * Generates the statements of a client's recv function, which read the
+ * response from iprot_ and return or throw what it holds.
+ *
+ * @param tservice  The service the function belongs to
+ * @param tfunction The function to read the response of
+ */
+void t_cpp_generator::generate_client_recv_body(t_service* tservice,
+                                                t_function* tfunction) {
+  string resultname = tservice->get_name() + "_" + tfunction->get_name() + "_presult";
+
+  f_service_ <<
+    endl <<
+    indent() << "int32_t rseqid = 0;" << endl <<
+    indent() << "const char* fname;" << endl <<
+    indent() << "uint32_t fnameLen;" << endl <<
+    indent() << "::apache::thrift::protocol::TMessageType mtype;" << endl <<
+    endl <<
+    indent() << "iprot_->readMessageBegin(fname, fnameLen, mtype, rseqid);" << endl <<
+    indent() << "if (mtype == ::apache::thrift::protocol::T_EXCEPTION) {" << endl <<
+    indent() << "  ::apache::thrift::TApplicationException x;" << endl <<
+    indent() << "  x.read(iprot_);" << endl <<
+    indent() << "  iprot_->readMessageEnd();" << endl <<
+    indent() << "  iprot_->getTransport()->readEnd();" << endl <<
+    indent() << "  throw x;" << endl <<
+    indent() << "}" << endl <<
+    indent() << "if (mtype != ::apache::thrift::protocol::T_REPLY) {" << endl <<
+    indent() << "  iprot_->skip(::apache::thrift::protocol::T_STRUCT);" << endl <<
+    indent() << "  iprot_->readMessageEnd();" << endl <<
+    indent() << "  iprot_->getTransport()->readEnd();" << endl <<
+    indent() << "  throw ::apache::thrift::TApplicationException(::apache::thrift::TApplicationException::INVALID_MESSAGE_TYPE);" << endl <<
+    indent() << "}" << endl <<
+    indent() << "if (fnameLen != " << tfunction->get_name().size() <<
+                " || std::memcmp(fname, \"" << tfunction->get_name() << "\", fnameLen) != 0) {" << endl <<
+    indent() << "  iprot_->skip(::apache::thrift::protocol::T_STRUCT);" << endl <<
+    indent() << "  iprot_->readMessageEnd();" << endl <<
+    indent() << "  iprot_->getTransport()->readEnd();" << endl <<
+    indent() << "  throw ::apache::thrift::TApplicationException(::apache::thrift::TApplicationException::WRONG_METHOD_NAME);" << endl <<
+    indent() << "}" << endl;
+
+  if (!tfunction->get_returntype()->is_void() &&
+      !is_complex_type(tfunction->get_returntype())) {
+    t_field returnfield(tfunction->get_returntype(), "_return");
+    f_service_ <<
+      indent() << declare_field(&returnfield) << endl;
+  }
+
+  f_service_ <<
+    indent() << resultname << " result;" << endl;
+
+  if (!tfunction->get_returntype()->is_void()) {
+    f_service_ <<
+      indent() << "result.success = &_return;" << endl;
+  }
+
+  f_service_ <<
+    indent() << "result.read(iprot_);" << endl <<
+    indent() << "iprot_->readMessageEnd();" << endl <<
+    indent() << "iprot_->getTransport()->readEnd();" << endl <<
+    endl;
+
+  // Careful, only look for _result if not a void function
+  if (!tfunction->get_returntype()->is_void()) {
+    if (is_complex_type(tfunction->get_returntype())) {
+      f_service_ <<
+        indent() << "if (result.__isset.success) {" << endl <<
+        indent() << "  // _return pointer has now been filled" << endl <<
+        indent() << "  return;" << endl <<
+        indent() << "}" << endl;
+    } else {
+      f_service_ <<
+        indent() << "if (result.__isset.success) {" << endl <<
+        indent() << "  return _return;" << endl <<
+        indent() << "}" << endl;
+    }
+  }
+
+  t_struct* xs = tfunction->get_xceptions();
+  const std::vector<t_field*>& xceptions = xs->get_members();
+  vector<t_field*>::const_iterator x_iter;
+  for (x_iter = xceptions.begin(); x_iter != xceptions.end(); ++x_iter) {
+    f_service_ <<
+      indent() << "if (result.__isset." << (*x_iter)->get_name() << ") {" << endl <<
+      indent() << "  throw result." << (*x_iter)->get_name() << ";" << endl <<
+      indent() << "}" << endl;
+  }
+
+  // We only get here if we are a void function
+  if (tfunction->get_returntype()->is_void()) {
+    indent(f_service_) <<
+      "return;" << endl;
+  } else {
+    f_service_ <<
+      indent() << "throw ::apache::thrift::TApplicationException(::apache::thrift::TApplicationException::MISSING_RESULT, \"" << tfunction->get_name() << " failed: unknown result\");" << endl;
+  }
+}
+
 /**
  * Generates a service server definition.
  *
@@ -1834,6 +2278,10 @@ void t_cpp_generator::generate_service_processor(t_service* tservice) {
     extends_processor = ", public " + extends + "Processor";
   }
 
+  // With arenas every request is processed against the caller's arena
+  string arena_param = gen_arena_ ? ", ::apache::thrift::TArena* arena" : "";
+  string arena_arg = gen_arena_ ? ", arena" : "";
+
   // Generate the header portion
   f_header_ <<
     "class " << service_name_ << "Processor : " <<
@@ -1847,79 +2295,76 @@ void t_cpp_generator::generate_service_processor(t_service* tservice) {
   f_header_ <<
     indent() << "boost::shared_ptr<" << service_name_ << "If> iface_;" << endl;
   f_header_ <<
-    indent() << "virtual bool process_fn(::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, std::string& fname, int32_t seqid);" << endl;
-  indent_down();
+    indent() << "virtual bool process_fn(::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, const char* fname, uint32_t fnameLen, int32_t seqid" << arena_param << ");" << endl;
 
-  // Process function declarations
-  f_header_ <<
-    " private:" << endl;
-  indent_up();
+  // Hand-written code may still call process_fn with the name as a string.
+  // Overrides have to take the (name, length) form, which process() calls.
   f_header_ <<
-    indent() << "std::map<std::string, void (" << service_name_ << "Processor::*)(int32_t, ::apache::thrift::protocol::TProtocol*, ::apache::thrift::protocol::TProtocol*)> processMap_;" << endl;
-  for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
-    indent(f_header_) <<
-      "void process_" << (*f_iter)->get_name() << "(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot);" << endl;
-  }
-  indent_down();
-
-  indent_up();
-  string declare_map = "";
-  indent_up();
+    indent() << "bool process_fn(::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, std::string& fname, int32_t seqid" << arena_param << ") {" << endl <<
+    indent() << "  return process_fn(iprot, oprot, fname.data(), fname.size(), seqid" << arena_arg << ");" << endl <<
+    indent() << "}" << endl;
 
+  // Process function declarations.  These are protected so that the
+  // processors of extending services can dispatch to them directly.
   for (f_iter = functions.begin(); f_iter != functions.end(); ++f_iter) {
-    declare_map += indent();
-    declare_map += "processMap_[\"";
-    declare_map += (*f_iter)->get_name();
-    declare_map += "\"] = &";
-    declare_map += service_name_;
-    declare_map += "Processor::process_";
-    declare_map += (*f_iter)->get_name();
-    declare_map += ";\n";
+    indent(f_header_) <<
+      "void process_" << (*f_iter)->get_name() << "(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot" << arena_param << ");" << endl;
   }
-  indent_down();
 
   f_header_ <<
     " public:" << endl <<
     indent() << service_name_ << "Processor(boost::shared_ptr<" << service_name_ << "If> iface) :" << endl;
   if (extends.empty()) {
     f_header_ <<
-      indent() << "  iface_(iface) {" << endl;
+      indent() << "  iface_(iface) {}" << endl;
   } else {
     f_header_ <<
       indent() << "  " << extends << "Processor(iface)," << endl <<
-      indent() << "  iface_(iface) {" << endl;
+      indent() << "  iface_(iface) {}" << endl;
   }
   f_header_ <<
-    declare_map <<
-    indent() << "}" << endl <<
     endl <<
-    indent() << "virtual bool process(boost::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot, boost::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot);" << endl <<
+    indent() << "virtual bool process(boost::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot, boost::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot);" << endl;
+  if (gen_arena_) {
+    f_header_ <<
+      indent() << "virtual bool process(boost::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot, boost::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot, ::apache::thrift::TArena* arena);" << endl;
+  }
+  f_header_ <<
     indent() << "virtual ~" << service_name_ << "Processor() {}" << endl;
   indent_down();
   f_header_ <<
     "};" << endl << endl;
 
   // Generate the server implementation
+  if (gen_arena_) {
+    f_service_ <<
+      "bool " << service_name_ << "Processor::process(boost::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot, boost::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot) {" << endl <<
+      "  return process(piprot, poprot, NULL);" << endl <<
+      "}" << endl <<
+      endl;
+  }
   f_service_ <<
-    "bool " << service_name_ << "Processor::process(boost::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot, boost::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot) {" << endl;
+    "bool " << service_name_ << "Processor::process(boost::shared_ptr< ::apache::thrift::protocol::TProtocol> piprot, boost::shared_ptr< ::apache::thrift::protocol::TProtocol> poprot" << arena_param << ") {" << endl;
   indent_up();
 
   f_service_ <<
     endl <<
     indent() << "::apache::thrift::protocol::TProtocol* iprot = piprot.get();" << endl <<
     indent() << "::apache::thrift::protocol::TProtocol* oprot = poprot.get();" << endl <<
-    indent() << "std::string fname;" << endl <<
+    indent() << "const char* fname;" << endl <<
+    indent() << "uint32_t fnameLen;" << endl <<
     indent() << "::apache::thrift::protocol::TMessageType mtype;" << endl <<
     indent() << "int32_t seqid;" << endl <<
     endl <<
-    indent() << "iprot->readMessageBegin(fname, mtype, seqid);" << endl <<
+    indent() << "iprot->readMessageBegin(fname, fnameLen, mtype, seqid);" << endl <<
     endl <<
     indent() << "if (mtype != ::apache::thrift::protocol::T_CALL && mtype != ::apache::thrift::protocol::T_ONEWAY) {" << endl <<
+    indent() << "  std::string name(fname, fnameLen);" << endl <<
     indent() << "  iprot->skip(::apache::thrift::protocol::T_STRUCT);" << endl <<
     indent() << "  iprot->readMessageEnd();" << endl <<
     indent() << "  iprot->getTransport()->readEnd();" << endl <<
     indent() << "  ::apache::thrift::TApplicationException x(::apache::thrift::TApplicationException::INVALID_MESSAGE_TYPE);" << endl <<
-    indent() << "  oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);" << endl <<
+    indent() << "  oprot->writeMessageBegin(name, ::apache::thrift::protocol::T_EXCEPTION, seqid);" << endl <<
     indent() << "  x.write(oprot);" << endl <<
     indent() << "  oprot->writeMessageEnd();" << endl <<
     indent() << "  oprot->getTransport()->flush();" << endl <<
@@ -1927,7 +2372,7 @@ void t_cpp_generator::generate_service_processor(t_service* tservice) {
     indent() << "  return true;" << endl <<
     indent() << "}" << endl <<
     endl <<
-    indent() << "return process_fn(iprot, oprot, fname, seqid);" <<
+    indent() << "return process_fn(iprot, oprot, fname, fnameLen, seqid" << arena_arg << ");" <<
     endl;
 
   indent_down();
@@ -1936,33 +2381,56 @@ void t_cpp_generator::generate_service_processor(t_service* tservice) {
     endl;
 
   f_service_ <<
-    "bool " << service_name_ << "Processor::process_fn(::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, std::string& fname, int32_t seqid) {" << endl;
+    "bool " << service_name_ << "Processor::process_fn(::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot, const char* fname, uint32_t fnameLen, int32_t seqid" << arena_param << ") {" << endl;
   indent_up();
 
-  // HOT: member function pointer map
-  f_service_ <<
-    indent() << "std::map<std::string, void (" << service_name_ << "Processor::*)(int32_t, ::apache::thrift::protocol::TProtocol*, ::apache::thrift::protocol::TProtocol*)>::iterator pfn;" << endl <<
-    indent() << "pfn = processMap_.find(fname);" << endl <<
-    indent() << "if (pfn == processMap_.end()) {" << endl;
-  if (extends.empty()) {
-    f_service_ <<
-      indent() << "  iprot->skip(::apache::thrift::protocol::T_STRUCT);" << endl <<
-      indent() << "  iprot->readMessageEnd();" << endl <<
-      indent() << "  iprot->getTransport()->readEnd();" << endl <<
-      indent() << "  ::apache::thrift::TApplicationException x(::apache::thrift::TApplicationException::UNKNOWN_METHOD, \"Invalid method name: '\"+fname+\"'\");" << endl <<
-      indent() << "  oprot->writeMessageBegin(fname, ::apache::thrift::protocol::T_EXCEPTION, seqid);" << endl <<
-      indent() << "  x.write(oprot);" << endl <<
-      indent() << "  oprot->writeMessageEnd();" << endl <<
-      indent() << "  oprot->getTransport()->flush();" << endl <<
-      indent() << "  oprot->getTransport()->writeEnd();" << endl <<
-      indent() << "  return true;" << endl;
-  } else {
-    f_service_ <<
-      indent() << "  return " << extends << "Processor::process_fn(iprot, oprot, fname, seqid);" << endl;
+  // The table covers the functions of every service up the extends chain,
+  // so an inherited method is found without going through the parent's
+  // process_fn.  A function redefined lower down hides the inherited one.
+  map<size_t, vector<string> > names_by_length;
+  set<string> seen;
+  for (t_service* tsvc = tservice; tsvc != NULL; tsvc = tsvc->get_extends()) {
+    const vector<t_function*>& svc_functions = tsvc->get_functions();
+    vector<t_function*>::const_iterator s_iter;
+    for (s_iter = svc_functions.begin(); s_iter != svc_functions.end(); ++s_iter) {
+      const string& name = (*s_iter)->get_name();
+      if (seen.insert(name).second) {
+        names_by_length[name.size()].push_back(name);
+      }
+    }
+  }
+
+  // HOT: switch on the name length, then on the bytes that tell the
+  // candidates apart
+  if (!names_by_length.empty()) {
+    indent(f_service_) <<
+      "switch (fnameLen)" << endl;
+    scope_up(f_service_);
+    map<size_t, vector<string> >::const_iterator l_iter;
+    for (l_iter = names_by_length.begin(); l_iter != names_by_length.end(); ++l_iter) {
+      indent(f_service_) <<
+        "case " << l_iter->first << ":" << endl;
+      indent_up();
+      generate_process_dispatch(l_iter->second);
+      indent(f_service_) <<
+        "break;" << endl;
+      indent_down();
+    }
+    scope_down(f_service_);
+    f_service_ << endl;
   }
+
   f_service_ <<
-    indent() << "}" << endl <<
-    indent() << "(this->*(pfn->second))(seqid, iprot, oprot);" << endl <<
+    indent() << "std::string name(fname, fnameLen);" << endl <<
+    indent() << "iprot->skip(::apache::thrift::protocol::T_STRUCT);" << endl <<
+    indent() << "iprot->readMessageEnd();" << endl <<
+    indent() << "iprot->getTransport()->readEnd();" << endl <<
+    indent() << "::apache::thrift::TApplicationException x(::apache::thrift::TApplicationException::UNKNOWN_METHOD, \"Invalid method name: '\"+name+\"'\");" << endl <<
+    indent() << "oprot->writeMessageBegin(name, ::apache::thrift::protocol::T_EXCEPTION, seqid);" << endl <<
+    indent() << "x.write(oprot);" << endl <<
+    indent() << "oprot->writeMessageEnd();" << endl <<
+    indent() << "oprot->getTransport()->flush();" << endl <<
+    indent() << "oprot->getTransport()->writeEnd();" << endl <<
     indent() << "return true;" << endl;
 
   indent_down();
@@ -1976,6 +2444,58 @@ void t_cpp_generator::generate_service_processor(t_service* tservice) {
   }
 }
 
+/**
+ * Generates the dispatch for a group of method names of the same length.
+ * While more than one candidate is left it switches on the byte that takes
+ * the most distinct values among them.  A single candidate is confirmed
+ * with a memcmp and dispatched to.
+ *
+ * @param names The method names, all of the same length
+ */
+void t_cpp_generator::generate_process_dispatch(const vector<string>& names) {
+  if (names.size() == 1) {
+    f_service_ <<
+      indent() << "if (std::memcmp(fname, \"" << names[0] << "\", " << names[0].size() << ") == 0) {" << endl <<
+      indent() << "  process_" << names[0] << "(seqid, iprot, oprot" << (gen_arena_ ? ", arena" : "") << ");" << endl <<
+      indent() << "  return true;" << endl <<
+      indent() << "}" << endl;
+    return;
+  }
+
+  size_t best_pos = 0;
+  size_t best_count = 0;
+  for (size_t pos = 0; pos < names[0].size(); ++pos) {
+    set<char> values;
+    for (size_t i = 0; i < names.size(); ++i) {
+      values.insert(names[i][pos]);
+    }
+    if (values.size() > best_count) {
+      best_pos = pos;
+      best_count = values.size();
+    }
+  }
+
+  map<char, vector<string> > groups;
+  for (size_t i = 0; i < names.size(); ++i) {
+    groups[names[i][best_pos]].push_back(names[i]);
+  }
+
+  indent(f_service_) <<
+    "switch (fname[" << best_pos << "])" << endl;
+  scope_up(f_service_);
+  map<char, vector<string> >::const_iterator g_iter;
+  for (g_iter = groups.begin(); g_iter != groups.end(); ++g_iter) {
+    indent(f_service_) <<
+      "case '" << g_iter->first << "':" << endl;
+    indent_up();
+    generate_process_dispatch(g_iter->second);
+    indent(f_service_) <<
+      "break;" << endl;
+    indent_down();
+  }
+  scope_down(f_service_);
+}
+
 /**
  * Generates a struct and helpers for a function.
  *
@@ -2021,14 +2541,15 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
   f_service_ <<
     "void " << tservice->get_name() << "Processor::" <<
     "process_" << tfunction->get_name() <<
-    "(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot)" << endl;
+    "(int32_t seqid, ::apache::thrift::protocol::TProtocol* iprot, ::apache::thrift::protocol::TProtocol* oprot" <<
+    (gen_arena_ ? ", ::apache::thrift::TArena* arena" : "") << ")" << endl;
   scope_up(f_service_);
 
   string argsname = tservice->get_name() + "_" + tfunction->get_name() + "_args";
   string resultname = tservice->get_name() + "_" + tfunction->get_name() + "_result";
 
   f_service_ <<
-    indent() << argsname << " args;" << endl <<
+    indent() << argsname << (gen_arena_ ? " args(arena);" : " args;") << endl <<
     indent() << "args.read(iprot);" << endl <<
     indent() << "iprot->readMessageEnd();" << endl <<
     indent() << "iprot->getTransport()->readEnd();" << endl <<
@@ -2041,7 +2562,7 @@ void t_cpp_generator::generate_process_function(t_service* tservice,
   // Declare result
   if (!tfunction->is_oneway()) {
     f_service_ <<
-      indent() << resultname << " result;" << endl;
+      indent() << resultname << (gen_arena_ ? " result(arena);" : " result;") << endl;
   }
 
   // Try block for functions with exceptions
@@ -2250,6 +2771,17 @@ void t_cpp_generator::generate_deserialize_field(ofstream& out,
     generate_deserialize_struct(out, (t_struct*)type, name);
   } else if (type->is_container()) {
     generate_deserialize_container(out, type, name);
+  } else if (gen_arena_ && type->is_string()) {
+    // Arena strings are filled from a view of the protocol's buffer
+    string str = tmp("_str");
+    string len = tmp("_len");
+    out <<
+      indent() << "const char* " << str << ";" << endl <<
+      indent() << "uint32_t " << len << ";" << endl <<
+      indent() << "xfer += iprot->" <<
+      (((t_base_type*)type)->is_binary() ? "readBinary(" : "readString(") <<
+      str << ", " << len << ");" << endl <<
+      indent() << name << ".assign(" << str << ", " << len << ");" << endl;
   } else if (type->is_base_type()) {
     indent(out) <<
       "xfer += iprot->";
@@ -2349,28 +2881,58 @@ void t_cpp_generator::generate_deserialize_container(ofstream& out,
       indent() << "iprot->readListBegin(" <<
       etype << ", " << size << ");" << endl;
     if (!use_push) {
-      indent(out) << prefix << ".resize(" << size << ");" << endl;
+      t_type* elem_type = ((t_list*)ttype)->get_elem_type();
+      string args = arena_args(elem_type, prefix + ".get_allocator().arena()");
+      if (args.empty()) {
+        indent(out) << prefix << ".resize(" << size << ");" << endl;
+      } else {
+        // Every element copies the allocator of the prototype
+        indent(out) << prefix << ".resize(" << size << ", " <<
+          type_name(elem_type) << args << ");" << endl;
+      }
     }
   }
 
 
-  // For loop iterates over elements
-  string i = tmp("_i");
-  out <<
-    indent() << "uint32_t " << i << ";" << endl <<
-    indent() << "for (" << i << " = 0; " << i << " < " << size << "; ++" << i << ")" << endl;
+  string array_type = ttype->is_map() ? "" : array_function_type(ttype);
+  if (!array_type.empty()) {
+    // Lists are read in place, sets by way of a vector
+    string values = prefix;
+    if (ttype->is_set()) {
+      values = tmp("_values");
+      indent(out) << "std::vector<" <<
+        type_name(((t_set*)ttype)->get_elem_type()) << "> " << values <<
+        "(" << size << ");" << endl;
+    }
+    indent(out) << "if (" << size << " > 0) {" << endl;
+    indent_up();
+    indent(out) << "xfer += iprot->read" << array_type << "Array(&" <<
+      values << "[0], " << size << ");" << endl;
+    indent_down();
+    indent(out) << "}" << endl;
+    if (ttype->is_set()) {
+      indent(out) << prefix << ".insert(" << values << ".begin(), " <<
+        values << ".end());" << endl;
+    }
+  } else {
+    // For loop iterates over elements
+    string i = tmp("_i");
+    out <<
+      indent() << "uint32_t " << i << ";" << endl <<
+      indent() << "for (" << i << " = 0; " << i << " < " << size << "; ++" << i << ")" << endl;
 
-    scope_up(out);
+      scope_up(out);
 
-    if (ttype->is_map()) {
-      generate_deserialize_map_element(out, (t_map*)ttype, prefix);
-    } else if (ttype->is_set()) {
-      generate_deserialize_set_element(out, (t_set*)ttype, prefix);
-    } else if (ttype->is_list()) {
-      generate_deserialize_list_element(out, (t_list*)ttype, prefix, use_push, i);
-    }
+      if (ttype->is_map()) {
+        generate_deserialize_map_element(out, (t_map*)ttype, prefix);
+      } else if (ttype->is_set()) {
+        generate_deserialize_set_element(out, (t_set*)ttype, prefix);
+      } else if (ttype->is_list()) {
+        generate_deserialize_list_element(out, (t_list*)ttype, prefix, use_push, i);
+      }
 
-    scope_down(out);
+      scope_down(out);
+  }
 
   // Read container end
   if (ttype->is_map()) {
@@ -2395,14 +2957,30 @@ void t_cpp_generator::generate_deserialize_map_element(ofstream& out,
   string val = tmp("_val");
   t_field fkey(tmap->get_key_type(), key);
   t_field fval(tmap->get_val_type(), val);
+  string arena = prefix + ".get_allocator().arena()";
+  string key_args = arena_args(tmap->get_key_type(), arena);
+  string val_args = arena_args(tmap->get_val_type(), arena);
 
-  out <<
-    indent() << declare_field(&fkey) << endl;
+  if (key_args.empty()) {
+    out <<
+      indent() << declare_field(&fkey) << endl;
+  } else {
+    out <<
+      indent() << type_name(tmap->get_key_type()) << " " << key << key_args << ";" << endl;
+  }
 
   generate_deserialize_field(out, &fkey);
-  indent(out) <<
-    declare_field(&fval, false, false, false, true) << " = " <<
-    prefix << "[" << key << "];" << endl;
+  if (val_args.empty()) {
+    indent(out) <<
+      declare_field(&fval, false, false, false, true) << " = " <<
+      prefix << "[" << key << "];" << endl;
+  } else {
+    // operator[] would default construct the value outside the arena
+    indent(out) <<
+      declare_field(&fval, false, false, false, true) << " = " <<
+      prefix << ".insert(std::make_pair(" << key << ", " <<
+      type_name(tmap->get_val_type()) << val_args << ")).first->second;" << endl;
+  }
 
   generate_deserialize_field(out, &fval);
 }
@@ -2412,9 +2990,15 @@ void t_cpp_generator::generate_deserialize_set_element(ofstream& out,
                                                        string prefix) {
   string elem = tmp("_elem");
   t_field felem(tset->get_elem_type(), elem);
+  string args = arena_args(tset->get_elem_type(), prefix + ".get_allocator().arena()");
 
-  indent(out) <<
-    declare_field(&felem) << endl;
+  if (args.empty()) {
+    indent(out) <<
+      declare_field(&felem) << endl;
+  } else {
+    indent(out) <<
+      type_name(tset->get_elem_type()) << " " << elem << args << ";" << endl;
+  }
 
   generate_deserialize_field(out, &felem);
 
@@ -2481,10 +3065,15 @@ void t_cpp_generator::generate_serialize_field(ofstream& out,
         break;
       case t_base_type::TYPE_STRING:
         if (((t_base_type*)type)->is_binary()) {
-          out << "writeBinary(" << name << ");";
+          out << "writeBinary(";
         }
         else {
-          out << "writeString(" << name << ");";
+          out << "writeString(";
+        }
+        if (gen_arena_) {
+          out << name << ".data(), " << name << ".size());";
+        } else {
+          out << name << ");";
         }
         break;
       case t_base_type::TYPE_BOOL:
@@ -2555,19 +3144,37 @@ void t_cpp_generator::generate_serialize_container(ofstream& out,
       prefix << ".size());" << endl;
   }
 
-  string iter = tmp("_iter");
-  out <<
-    indent() << type_name(ttype) << "::const_iterator " << iter << ";" << endl <<
-    indent() << "for (" << iter << " = " << prefix  << ".begin(); " << iter << " != " << prefix << ".end(); ++" << iter << ")" << endl;
-  scope_up(out);
-    if (ttype->is_map()) {
-      generate_serialize_map_element(out, (t_map*)ttype, iter);
-    } else if (ttype->is_set()) {
-      generate_serialize_set_element(out, (t_set*)ttype, iter);
-    } else if (ttype->is_list()) {
-      generate_serialize_list_element(out, (t_list*)ttype, iter);
+  string array_type = ttype->is_map() ? "" : array_function_type(ttype);
+  if (!array_type.empty()) {
+    // Lists are written in place, sets by way of a vector
+    string values = prefix;
+    if (ttype->is_set()) {
+      values = tmp("_values");
+      indent(out) << "std::vector<" <<
+        type_name(((t_set*)ttype)->get_elem_type()) << "> " << values <<
+        "(" << prefix << ".begin(), " << prefix << ".end());" << endl;
     }
-  scope_down(out);
+    indent(out) << "if (!" << values << ".empty()) {" << endl;
+    indent_up();
+    indent(out) << "xfer += oprot->write" << array_type << "Array(&" <<
+      values << "[0], " << values << ".size());" << endl;
+    indent_down();
+    indent(out) << "}" << endl;
+  } else {
+    string iter = tmp("_iter");
+    out <<
+      indent() << type_name(ttype) << "::const_iterator " << iter << ";" << endl <<
+      indent() << "for (" << iter << " = " << prefix  << ".begin(); " << iter << " != " << prefix << ".end(); ++" << iter << ")" << endl;
+    scope_up(out);
+      if (ttype->is_map()) {
+        generate_serialize_map_element(out, (t_map*)ttype, iter);
+      } else if (ttype->is_set()) {
+        generate_serialize_set_element(out, (t_set*)ttype, iter);
+      } else if (ttype->is_list()) {
+        generate_serialize_list_element(out, (t_list*)ttype, iter);
+      }
+    scope_down(out);
+  }
 
   if (ttype->is_map()) {
     indent(out) <<
@@ -2716,15 +3323,33 @@ string t_cpp_generator::type_name(t_type* ttype, bool in_typedef, bool arg) {
       cname = tcontainer->get_cpp_name();
     } else if (ttype->is_map()) {
       t_map* tmap = (t_map*) ttype;
-      cname = "std::map<" +
-        type_name(tmap->get_key_type(), in_typedef) + ", " +
-        type_name(tmap->get_val_type(), in_typedef) + "> ";
+      string kname = type_name(tmap->get_key_type(), in_typedef);
+      string vname = type_name(tmap->get_val_type(), in_typedef);
+      if (gen_arena_) {
+        cname = "std::map< " + kname + ", " + vname + ", std::less< " + kname +
+          " >, ::apache::thrift::TArenaAllocator<std::pair<const " + kname +
+          ", " + vname + " > > > ";
+      } else {
+        cname = "std::map<" + kname + ", " + vname + "> ";
+      }
     } else if (ttype->is_set()) {
       t_set* tset = (t_set*) ttype;
-      cname = "std::set<" + type_name(tset->get_elem_type(), in_typedef) + "> ";
+      string ename = type_name(tset->get_elem_type(), in_typedef);
+      if (gen_arena_) {
+        cname = "std::set< " + ename + ", std::less< " + ename +
+          " >, ::apache::thrift::TArenaAllocator< " + ename + " > > ";
+      } else {
+        cname = "std::set<" + ename + "> ";
+      }
     } else if (ttype->is_list()) {
       t_list* tlist = (t_list*) ttype;
-      cname = "std::vector<" + type_name(tlist->get_elem_type(), in_typedef) + "> ";
+      string ename = type_name(tlist->get_elem_type(), in_typedef);
+      if (gen_arena_) {
+        cname = "std::vector< " + ename +
+          ", ::apache::thrift::TArenaAllocator< " + ename + " > > ";
+      } else {
+        cname = "std::vector<" + ename + "> ";
+      }
     }
 
     if (arg) {
@@ -2773,7 +3398,7 @@ string t_cpp_generator::base_type_name(t_base_type::t_base tbase) {
   case t_base_type::TYPE_VOID:
     return "void";
   case t_base_type::TYPE_STRING:
-    return "std::string";
+    return gen_arena_ ? "::apache::thrift::TArenaString" : "std::string";
   case t_base_type::TYPE_BOOL:
     return "bool";
   case t_base_type::TYPE_BYTE:
@@ -2942,6 +3567,154 @@ string t_cpp_generator::type_to_enum(t_type* type) {
   throw "INVALID TYPE IN type_to_enum: " + type->get_name();
 }
 
+/**
+ * Returns the constructor arguments that place an object of the given type
+ * in an arena, or the empty string if the type takes none.
+ *
+ * @param ttype The type
+ * @param arena Expression for the TArena* to use
+ */
+string t_cpp_generator::arena_args(t_type* ttype, string arena) {
+  if (!gen_arena_) {
+    return "";
+  }
+
+  t_type* type = get_true_type(ttype);
+  if (type->is_string() || type->is_struct() || type->is_xception()) {
+    return "(" + arena + ")";
+  }
+  if (type->is_container() && !((t_container*)type)->has_cpp_name()) {
+    if (type->is_list()) {
+      return "(" + arena + ")";
+    }
+    t_type* ktype = type->is_map() ?
+      ((t_map*)type)->get_key_type() : ((t_set*)type)->get_elem_type();
+    return "(std::less< " + type_name(ktype) + " >(), " + arena + ")";
+  }
+  return "";
+}
+
+/**
+ * Returns the type part of the bulk protocol functions that can move all
+ * the elements of a list or set at once (like "I32" for readI32Array()),
+ * or the empty string if the elements have to go one by one.
+ *
+ * @param ttype The list or set type
+ */
+string t_cpp_generator::array_function_type(t_type* ttype) {
+  if (((t_container*)ttype)->has_cpp_name()) {
+    return "";
+  }
+
+  t_type* elem_type = get_true_type(ttype->is_list() ?
+    ((t_list*)ttype)->get_elem_type() : ((t_set*)ttype)->get_elem_type());
+  if (!elem_type->is_base_type()) {
+    return "";
+  }
+  switch (((t_base_type*)elem_type)->get_base()) {
+  case t_base_type::TYPE_BYTE:
+    return "Byte";
+  case t_base_type::TYPE_I16:
+    return "I16";
+  case t_base_type::TYPE_I32:
+    return "I32";
+  case t_base_type::TYPE_I64:
+    return "I64";
+  case t_base_type::TYPE_DOUBLE:
+    return "Double";
+  default:
+    return "";
+  }
+}
+
+/**
+ * Returns the codec of the table-driven serializer for a type, like
+ * "::apache::thrift::protocol::table::List<std::vector<int32_t> , ...I32>".
+ *
+ * @param ttype The type
+ */
+string t_cpp_generator::table_codec(t_type* ttype) {
+  string ns = "::apache::thrift::protocol::table::";
+  ttype = get_true_type(ttype);
+
+  if (ttype->is_base_type()) {
+    t_base_type::t_base tbase = ((t_base_type*)ttype)->get_base();
+    switch (tbase) {
+    case t_base_type::TYPE_STRING:
+      return ns + (((t_base_type*)ttype)->is_binary() ? "Binary" : "String");
+    case t_base_type::TYPE_BOOL:
+      return ns + "Bool";
+    case t_base_type::TYPE_BYTE:
+      return ns + "Byte";
+    case t_base_type::TYPE_I16:
+      return ns + "I16";
+    case t_base_type::TYPE_I32:
+      return ns + "I32";
+    case t_base_type::TYPE_I64:
+      return ns + "I64";
+    case t_base_type::TYPE_DOUBLE:
+      return ns + "Double";
+    default:
+      throw "compiler error: no table codec for base type " + t_base_type::t_base_name(tbase);
+    }
+  } else if (ttype->is_enum()) {
+    return ns + "Enum< " + type_name(ttype) + " >";
+  } else if (ttype->is_struct() || ttype->is_xception()) {
+    return ns + "Struct< " + type_name(ttype) + " >";
+  } else if (ttype->is_list()) {
+    return ns + "List< " + type_name(ttype) + ", " +
+      table_codec(((t_list*)ttype)->get_elem_type()) + " >";
+  } else if (ttype->is_set()) {
+    return ns + "Set< " + type_name(ttype) + ", " +
+      table_codec(((t_set*)ttype)->get_elem_type()) + " >";
+  } else if (ttype->is_map()) {
+    return ns + "Map< " + type_name(ttype) + ", " +
+      table_codec(((t_map*)ttype)->get_key_type()) + ", " +
+      table_codec(((t_map*)ttype)->get_val_type()) + " >";
+  }
+  throw "compiler error: no table codec for type " + ttype->get_name();
+}
+
+/**
+ * Returns true iff the table-driven serializer can read and write a struct.
+ * It does not handle arena strings, containers with a cpp.template, or
+ * required fields past the 64th.
+ *
+ * @param tstruct The struct
+ */
+bool t_cpp_generator::is_table_serializable(t_struct* tstruct) {
+  if (gen_arena_) {
+    return false;
+  }
+  const vector<t_field*>& fields = tstruct->get_sorted_members();
+  for (size_t i = 0; i < fields.size(); ++i) {
+    if (fields[i]->get_req() == t_field::T_REQUIRED && i >= 64) {
+      return false;
+    }
+    if (!is_table_serializable(fields[i]->get_type())) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool t_cpp_generator::is_table_serializable(t_type* ttype) {
+  ttype = get_true_type(ttype);
+  if (!ttype->is_container()) {
+    return true;
+  }
+  if (((t_container*)ttype)->has_cpp_name()) {
+    return false;
+  }
+  if (ttype->is_list()) {
+    return is_table_serializable(((t_list*)ttype)->get_elem_type());
+  } else if (ttype->is_set()) {
+    return is_table_serializable(((t_set*)ttype)->get_elem_type());
+  }
+  return is_table_serializable(((t_map*)ttype)->get_key_type()) &&
+    is_table_serializable(((t_map*)ttype)->get_val_type());
+}
+
 /**
  * Returns the symbol name of the local reflection of a type.
  */
@@ -3005,4 +3778,9 @@ string t_cpp_generator::get_include_prefix(const t_program& program) const {
 THRIFT_REGISTER_GENERATOR(cpp, "C++",
 "    dense:           Generate type specifications for the dense protocol.\n"
 "    include_prefix:  Use full include paths in generated files.\n"
+"    templates:       Generate templatized reader/writer methods.\n"
+"    arena:           Allocate strings and containers from a TArena.\n"
+"    async:           Generate pipelined asynchronous clients.\n"
+"    table:           Read and write structs with the table-driven serializer,\n"
+"                     unless annotated cpp.serializer = \"generated\".\n"
 );
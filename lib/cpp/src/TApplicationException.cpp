@@ -24,14 +24,13 @@ namespace apache { namespace thrift {
 
 uint32_t TApplicationException::read(apache::thrift::protocol::TProtocol* iprot) {
   uint32_t xfer = 0;
-  std::string fname;
   apache::thrift::protocol::TType ftype;
   int16_t fid;
 
-  xfer += iprot->readStructBegin(fname);
+  xfer += iprot->readStructBegin();
 
   while (true) {
-    xfer += iprot->readFieldBegin(fname, ftype, fid);
+    xfer += iprot->readFieldBegin(ftype, fid);
     if (ftype == apache::thrift::protocol::T_STOP) {
       break;
     }
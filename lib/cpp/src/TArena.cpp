@@ -0,0 +1,82 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <TArena.h>
+#include <cstdlib>
+
+namespace apache { namespace thrift {
+
+TArena::~TArena() {
+  Block* block = head_;
+  while (block != NULL) {
+    Block* next = block->next;
+    std::free(block);
+    block = next;
+  }
+}
+
+void* TArena::allocateSlow(size_t size) {
+  size_t blockSize = blockSize_;
+  if (current_ != NULL) {
+    blockSize = current_->size * 2;
+  }
+  if (blockSize < size) {
+    blockSize = size;
+  }
+
+  Block* block = (Block*)std::malloc(HEADER_SIZE + blockSize);
+  if (block == NULL) {
+    throw std::bad_alloc();
+  }
+  block->next = NULL;
+  block->size = blockSize;
+  if (current_ == NULL) {
+    head_ = block;
+  } else {
+    current_->next = block;
+  }
+  current_ = block;
+
+  char* data = blockData(block);
+  pos_ = data + size;
+  end_ = data + blockSize;
+  allocated_ += size;
+  return data;
+}
+
+void TArena::reset() {
+  if (head_ == NULL) {
+    return;
+  }
+
+  Block* block = head_->next;
+  while (block != NULL) {
+    Block* next = block->next;
+    std::free(block);
+    block = next;
+  }
+  head_->next = NULL;
+
+  current_ = head_;
+  pos_ = blockData(head_);
+  end_ = pos_ + head_->size;
+  allocated_ = 0;
+}
+
+}} // apache::thrift
@@ -0,0 +1,200 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TARENA_H_
+#define _THRIFT_TARENA_H_ 1
+
+#include <Thrift.h>
+#include <cstddef>
+#include <new>
+#include <boost/noncopyable.hpp>
+
+namespace apache { namespace thrift {
+
+/**
+ * A region allocator.  Memory is carved out of large blocks by bumping a
+ * pointer, individual allocations are never freed, and reset() releases
+ * everything at once.
+ *
+ * The first block is kept across reset() so an arena that is reused for
+ * similar sized requests stops calling malloc altogether.  Blocks after the
+ * first double in size, and are freed by reset().
+ *
+ * Everything allocated from the arena must have been destroyed (or be
+ * abandoned for good) before reset() is called.  The arena is not
+ * thread-safe.
+ */
+class TArena : boost::noncopyable {
+ public:
+  static const uint32_t DEFAULT_BLOCK_SIZE = 8192;
+
+  explicit TArena(uint32_t blockSize = DEFAULT_BLOCK_SIZE) :
+    blockSize_(blockSize),
+    head_(NULL),
+    current_(NULL),
+    pos_(NULL),
+    end_(NULL),
+    allocated_(0) {}
+
+  ~TArena();
+
+  void* allocate(size_t size) {
+    size = (size + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+    if (size <= (size_t)(end_ - pos_)) {
+      void* p = pos_;
+      pos_ += size;
+      allocated_ += size;
+      return p;
+    }
+    return allocateSlow(size);
+  }
+
+  /**
+   * Frees every block but the first and makes all of the first block
+   * available again.
+   */
+  void reset();
+
+  /**
+   * Returns the number of bytes handed out since the last reset().
+   */
+  size_t getAllocated() const {
+    return allocated_;
+  }
+
+ private:
+  static const size_t ALIGNMENT = 8;
+
+  struct Block {
+    Block* next;
+    size_t size;
+  };
+
+  static const size_t HEADER_SIZE =
+    (sizeof(Block) + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+
+  void* allocateSlow(size_t size);
+
+  static char* blockData(Block* block) {
+    return reinterpret_cast<char*>(block) + HEADER_SIZE;
+  }
+
+  uint32_t blockSize_;
+  Block* head_;
+  Block* current_;
+  char* pos_;
+  char* end_;
+  size_t allocated_;
+};
+
+/**
+ * A standard allocator that places objects in a TArena.  deallocate() is a
+ * no-op; the memory comes back when the arena is reset.
+ *
+ * An allocator without an arena (the default constructed one) uses the
+ * heap, so containers built with it behave exactly like their std::allocator
+ * counterparts.  Every container keeps the allocator it was constructed
+ * with, so arena and heap backed objects can be copied and assigned into
+ * each other, but must not be swapped.
+ */
+template <class T>
+class TArenaAllocator {
+ public:
+  typedef T value_type;
+  typedef T* pointer;
+  typedef const T* const_pointer;
+  typedef T& reference;
+  typedef const T& const_reference;
+  typedef size_t size_type;
+  typedef ptrdiff_t difference_type;
+
+  template <class U>
+  struct rebind {
+    typedef TArenaAllocator<U> other;
+  };
+
+  TArenaAllocator() : arena_(NULL) {}
+
+  TArenaAllocator(TArena* arena) : arena_(arena) {}
+
+  template <class U>
+  TArenaAllocator(const TArenaAllocator<U>& other) : arena_(other.arena()) {}
+
+  TArena* arena() const {
+    return arena_;
+  }
+
+  pointer address(reference x) const {
+    return &x;
+  }
+
+  const_pointer address(const_reference x) const {
+    return &x;
+  }
+
+  pointer allocate(size_type n, const void* /* hint */ = 0) {
+    if (n > max_size()) {
+      throw std::bad_alloc();
+    }
+    if (arena_ == NULL) {
+      return static_cast<pointer>(::operator new(n * sizeof(T)));
+    }
+    return static_cast<pointer>(arena_->allocate(n * sizeof(T)));
+  }
+
+  void deallocate(pointer p, size_type /* n */) {
+    if (arena_ == NULL) {
+      ::operator delete(p);
+    }
+  }
+
+  size_type max_size() const {
+    return (((size_type)-1) >> 1) / sizeof(T);
+  }
+
+  void construct(pointer p, const T& value) {
+    new(p) T(value);
+  }
+
+  void destroy(pointer p) {
+    p->~T();
+  }
+
+ private:
+  TArena* arena_;
+};
+
+template <class T, class U>
+inline bool operator==(const TArenaAllocator<T>& a, const TArenaAllocator<U>& b) {
+  return a.arena() == b.arena();
+}
+
+template <class T, class U>
+inline bool operator!=(const TArenaAllocator<T>& a, const TArenaAllocator<U>& b) {
+  return a.arena() != b.arena();
+}
+
+/**
+ * The string type of code generated with the "arena" option.
+ */
+typedef std::basic_string<char, std::char_traits<char>, TArenaAllocator<char> > TArenaString;
+
+}} // apache::thrift
+
+#endif // #ifndef _THRIFT_TARENA_H_
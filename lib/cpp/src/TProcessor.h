@@ -26,6 +26,8 @@
 
 namespace apache { namespace thrift {
 
+class TArena;
+
 /**
  * A processor is a generic object that acts upon two streams of data, one
  * an input and the other an output. The definition of this object is loose,
@@ -44,6 +46,18 @@ class TProcessor {
     return process(io, io);
   }
 
+  /**
+   * Processes a request whose arguments and result may be allocated from
+   * arena, which the caller resets once the response has been written.
+   * Processors generated with the "arena" option use it; the default just
+   * ignores the arena.
+   */
+  virtual bool process(boost::shared_ptr<protocol::TProtocol> in,
+                       boost::shared_ptr<protocol::TProtocol> out,
+                       TArena* /* arena */) {
+    return process(in, out);
+  }
+
  protected:
   TProcessor() {}
 };
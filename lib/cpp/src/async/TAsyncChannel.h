@@ -0,0 +1,78 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_ASYNC_TASYNCCHANNEL_H_
+#define _THRIFT_ASYNC_TASYNCCHANNEL_H_ 1
+
+#include <Thrift.h>
+#include <transport/TTransportException.h>
+
+namespace apache { namespace thrift { namespace async {
+
+/**
+ * A connection that carries whole messages both ways without blocking the
+ * caller.  Messages can be sent while earlier ones are still outstanding,
+ * and received messages are handed to a receiver as they complete.
+ */
+class TAsyncChannel {
+ public:
+
+  /**
+   * Gets the messages a channel receives.
+   */
+  class Receiver {
+   public:
+    virtual ~Receiver() {}
+
+    /**
+     * Called with each complete message.  The data is only valid until
+     * the call returns.
+     */
+    virtual void messageReceived(const uint8_t* data, uint32_t len) = 0;
+
+    /**
+     * Called once if the connection fails or is closed by the peer.
+     */
+    virtual void channelFailed(const transport::TTransportException& x) = 0;
+  };
+
+  virtual ~TAsyncChannel() {}
+
+  /**
+   * Sets the receiver, which the channel doesn't own.  NULL drops
+   * received messages.
+   */
+  virtual void setReceiver(Receiver* receiver) = 0;
+
+  /**
+   * Whether the channel can still send and receive messages.
+   */
+  virtual bool good() const = 0;
+
+  /**
+   * Queues a message to send.  The data is copied.
+   *
+   * @throws TTransportException NOT_OPEN if the channel has failed.
+   */
+  virtual void sendMessage(const uint8_t* data, uint32_t len) = 0;
+};
+
+}}} // apache::thrift::async
+
+#endif // #ifndef _THRIFT_ASYNC_TASYNCCHANNEL_H_
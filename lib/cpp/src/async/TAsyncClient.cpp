@@ -0,0 +1,130 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <async/TAsyncClient.h>
+
+namespace apache { namespace thrift { namespace async {
+
+using boost::shared_ptr;
+using apache::thrift::protocol::TProtocolFactory;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+
+TAsyncClient::TAsyncClient(shared_ptr<TAsyncChannel> channel,
+                           shared_ptr<TProtocolFactory> protocolFactory) :
+  channel_(channel),
+  ibuf_(new TMemoryBuffer(NULL, 0)),
+  obuf_(new TMemoryBuffer()),
+  piprot_(protocolFactory->getProtocol(ibuf_)),
+  poprot_(protocolFactory->getProtocol(obuf_)),
+  nextSeqId_(0),
+  failure_(NULL) {
+  iprot_ = piprot_.get();
+  oprot_ = poprot_.get();
+  channel_->setReceiver(this);
+}
+
+TAsyncClient::~TAsyncClient() {
+  channel_->setReceiver(NULL);
+}
+
+int32_t TAsyncClient::beginCall() {
+  if (!channel_->good()) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "TAsyncClient: channel has failed");
+  }
+  obuf_->resetBuffer();
+
+  // Skip ids still waiting for a response after a wraparound
+  do {
+    nextSeqId_ = (nextSeqId_ + 1) & 0x7fffffff;
+  } while (pending_.find(nextSeqId_) != pending_.end());
+  return nextSeqId_;
+}
+
+void TAsyncClient::endCall(int32_t seqid, const Completion& completion) {
+  uint8_t* data;
+  uint32_t len;
+  obuf_->getBuffer(&data, &len);
+
+  // Wait for the response before sending, as a channel that fails while
+  // sending fails the outstanding calls, this one included
+  if (!completion) {
+    channel_->sendMessage(data, len);
+    return;
+  }
+  pending_[seqid] = completion;
+  try {
+    channel_->sendMessage(data, len);
+  } catch (...) {
+    pending_.erase(seqid);
+    throw;
+  }
+}
+
+void TAsyncClient::checkResponse() {
+  if (failure_ != NULL) {
+    throw *failure_;
+  }
+}
+
+void TAsyncClient::messageReceived(const uint8_t* data, uint32_t len) {
+  std::string fname;
+  TMessageType mtype;
+  int32_t seqid;
+
+  // Find the call from the message header, then rewind for recv_.
+  ibuf_->resetBuffer(const_cast<uint8_t*>(data), len);
+  try {
+    iprot_->readMessageBegin(fname, mtype, seqid);
+  } catch (TException& x) {
+    GlobalOutput.printf("TAsyncClient: unreadable response: %s", x.what());
+    return;
+  }
+  std::map<int32_t, Completion>::iterator it = pending_.find(seqid);
+  if (it == pending_.end()) {
+    GlobalOutput.printf("TAsyncClient: response to unknown call %d", seqid);
+    return;
+  }
+  Completion completion = it->second;
+  pending_.erase(it);
+
+  ibuf_->resetBuffer(const_cast<uint8_t*>(data), len);
+  completion();
+}
+
+void TAsyncClient::channelFailed(const TTransportException& x) {
+  std::map<int32_t, Completion> failed;
+  failed.swap(pending_);
+
+  TTransportException failure(x);
+  failure_ = &failure;
+  try {
+    for (std::map<int32_t, Completion>::iterator it = failed.begin(); it != failed.end(); ++it) {
+      it->second();
+    }
+  } catch (...) {
+    failure_ = NULL;
+    throw;
+  }
+  failure_ = NULL;
+}
+
+}}} // apache::thrift::async
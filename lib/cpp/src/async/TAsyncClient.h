@@ -0,0 +1,110 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_ASYNC_TASYNCCLIENT_H_
+#define _THRIFT_ASYNC_TASYNCCLIENT_H_ 1
+
+#include <map>
+#include <tr1/functional>
+#include <boost/shared_ptr.hpp>
+
+#include <async/TAsyncChannel.h>
+#include <protocol/TProtocol.h>
+#include <transport/TBufferTransports.h>
+
+namespace apache { namespace thrift { namespace async {
+
+/**
+ * Base class for generated asynchronous clients.
+ *
+ * Calls go out on the channel as soon as they are made, each with its own
+ * sequence id, and wait in a table for the response with that id, in
+ * whatever order the responses come.  The callback of a call is run with
+ * its response ready to read, which the generated recv_ method does.  If
+ * the channel fails, the callbacks of all outstanding calls run and their
+ * recv_ methods throw the failure.
+ *
+ * Clients aren't thread safe; make calls from the thread that drives the
+ * channel, which is also the one callbacks run on.
+ */
+class TAsyncClient : public TAsyncChannel::Receiver {
+ public:
+  typedef std::tr1::function<void ()> Completion;
+
+  virtual ~TAsyncClient();
+
+  boost::shared_ptr<TAsyncChannel> getChannel() {
+    return channel_;
+  }
+
+  /**
+   * The number of calls waiting for a response.
+   */
+  size_t getPendingCount() const {
+    return pending_.size();
+  }
+
+  void messageReceived(const uint8_t* data, uint32_t len);
+
+  void channelFailed(const transport::TTransportException& x);
+
+ protected:
+  TAsyncClient(boost::shared_ptr<TAsyncChannel> channel,
+               boost::shared_ptr<protocol::TProtocolFactory> protocolFactory);
+
+  /**
+   * Starts a call in oprot_.
+   *
+   * @return The call's sequence id
+   */
+  int32_t beginCall();
+
+  /**
+   * Sends the call written to oprot_.  completion is run when the response
+   * arrives, or when the channel fails, even during this call; leave it
+   * empty for oneway calls.  If sending throws, completion is dropped and
+   * never run.
+   */
+  void endCall(int32_t seqid, const Completion& completion);
+
+  /**
+   * Throws the channel failure if that is what a callback is being run
+   * for, instead of a response.
+   */
+  void checkResponse();
+
+  boost::shared_ptr<TAsyncChannel> channel_;
+  boost::shared_ptr<transport::TMemoryBuffer> ibuf_;
+  boost::shared_ptr<transport::TMemoryBuffer> obuf_;
+  boost::shared_ptr<protocol::TProtocol> piprot_;
+  boost::shared_ptr<protocol::TProtocol> poprot_;
+  protocol::TProtocol* iprot_;
+  protocol::TProtocol* oprot_;
+
+ private:
+  int32_t nextSeqId_;
+  std::map<int32_t, Completion> pending_;
+
+  // Set while callbacks run for a failed channel
+  transport::TTransportException* failure_;
+};
+
+}}} // apache::thrift::async
+
+#endif // #ifndef _THRIFT_ASYNC_TASYNCCLIENT_H_
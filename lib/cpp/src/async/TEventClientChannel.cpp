@@ -0,0 +1,233 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <async/TEventClientChannel.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <arpa/inet.h>
+
+namespace apache { namespace thrift { namespace async {
+
+using boost::shared_ptr;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransportException;
+
+static const uint32_t INITIAL_READ_SIZE = 4096;
+
+TEventClientChannel::TEventClientChannel(shared_ptr<TSocket> socket,
+                                         struct event_base* base) :
+  socket_(socket),
+  fd_(socket->getSocketFD()),
+  base_(base),
+  eventFlags_(0),
+  receiver_(NULL),
+  failed_(false),
+  wPos_(0),
+  rBuf_(INITIAL_READ_SIZE),
+  rLen_(0) {
+  if (!socket_->isOpen()) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "TEventClientChannel: socket not open");
+  }
+
+  int flags;
+  if ((flags = fcntl(fd_, F_GETFL, 0)) < 0 ||
+      fcntl(fd_, F_SETFL, flags | O_NONBLOCK) < 0) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TEventClientChannel: set O_NONBLOCK (fcntl) ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN,
+                              "TEventClientChannel: O_NONBLOCK", errno_copy);
+  }
+
+  setFlags(EV_READ | EV_PERSIST);
+}
+
+TEventClientChannel::~TEventClientChannel() {
+  setFlags(0);
+}
+
+void TEventClientChannel::sendMessage(const uint8_t* data, uint32_t len) {
+  if (failed_) {
+    throw TTransportException(TTransportException::NOT_OPEN,
+                              "TEventClientChannel: channel has failed");
+  }
+
+  // Drop what has been written already before growing the buffer
+  if (wPos_ == wBuf_.size()) {
+    wBuf_.clear();
+    wPos_ = 0;
+  }
+
+  uint32_t sz = htonl(len);
+  wBuf_.insert(wBuf_.end(), (const uint8_t*)&sz, (const uint8_t*)&sz + sizeof(sz));
+  wBuf_.insert(wBuf_.end(), data, data + len);
+
+  // Only try now if nothing is already waiting for the socket
+  if (!(eventFlags_ & EV_WRITE)) {
+    writePending();
+  }
+}
+
+void TEventClientChannel::handleEvent(short which) {
+  if (which & EV_WRITE) {
+    writePending();
+  }
+  if ((which & EV_READ) && !failed_) {
+    readFrames();
+  }
+}
+
+void TEventClientChannel::writePending() {
+  int flags = 0;
+#ifdef MSG_NOSIGNAL
+  flags |= MSG_NOSIGNAL;
+#endif // ifdef MSG_NOSIGNAL
+
+  while (wPos_ < wBuf_.size()) {
+    ssize_t n = ::send(fd_, &wBuf_[wPos_], wBuf_.size() - wPos_, flags);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        setFlags(EV_READ | EV_WRITE | EV_PERSIST);
+        return;
+      }
+      int errno_copy = errno;
+      GlobalOutput.perror("TEventClientChannel: send() ", errno_copy);
+      fail(TTransportException(TTransportException::UNKNOWN,
+                               "TEventClientChannel: send()", errno_copy));
+      return;
+    }
+    wPos_ += n;
+  }
+
+  wBuf_.clear();
+  wPos_ = 0;
+  setFlags(EV_READ | EV_PERSIST);
+}
+
+void TEventClientChannel::readFrames() {
+  for (;;) {
+    if (rLen_ == rBuf_.size()) {
+      rBuf_.resize(rBuf_.size() * 2);
+    }
+    ssize_t n = ::recv(fd_, &rBuf_[rLen_], rBuf_.size() - rLen_, 0);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        return;
+      }
+      int errno_copy = errno;
+      GlobalOutput.perror("TEventClientChannel: recv() ", errno_copy);
+      fail(TTransportException(TTransportException::UNKNOWN,
+                               "TEventClientChannel: recv()", errno_copy));
+      return;
+    }
+    if (n == 0) {
+      fail(TTransportException(TTransportException::END_OF_FILE,
+                               "TEventClientChannel: connection closed"));
+      return;
+    }
+    rLen_ += n;
+
+    // Hand over every complete frame, then move a partial one to the front
+    uint32_t pos = 0;
+    while (rLen_ - pos >= sizeof(uint32_t)) {
+      uint32_t sz;
+      memcpy(&sz, &rBuf_[pos], sizeof(sz));
+      sz = ntohl(sz);
+      if ((int32_t)sz < 0) {
+        fail(TTransportException(TTransportException::CORRUPTED_DATA,
+                                 "TEventClientChannel: negative frame size"));
+        return;
+      }
+      if (rLen_ - pos - sizeof(uint32_t) < sz) {
+        // Make room for the whole frame up front
+        if (sizeof(uint32_t) + sz > rBuf_.size()) {
+          rBuf_.resize(sizeof(uint32_t) + sz);
+        }
+        break;
+      }
+      pos += sizeof(uint32_t);
+      if (receiver_ != NULL) {
+        try {
+          receiver_->messageReceived(&rBuf_[pos], sz);
+        } catch (TException& x) {
+          GlobalOutput.printf("TEventClientChannel: receiver threw: %s", x.what());
+        }
+      }
+      pos += sz;
+      if (failed_) {
+        return;
+      }
+    }
+    if (pos > 0) {
+      memmove(&rBuf_[0], &rBuf_[pos], rLen_ - pos);
+      rLen_ -= pos;
+    }
+  }
+}
+
+void TEventClientChannel::setFlags(short eventFlags) {
+  if (eventFlags_ == eventFlags) {
+    return;
+  }
+
+  if (eventFlags_ != 0) {
+    if (event_del(&event_) == -1) {
+      GlobalOutput("TEventClientChannel::setFlags event_del");
+      return;
+    }
+  }
+
+  eventFlags_ = eventFlags;
+  if (!eventFlags_) {
+    return;
+  }
+
+  event_set(&event_, fd_, eventFlags_, TEventClientChannel::eventHandler, this);
+  event_base_set(base_, &event_);
+  if (event_add(&event_, 0) == -1) {
+    GlobalOutput("TEventClientChannel::setFlags(): could not event_add");
+  }
+}
+
+/**
+ * Stops watching the socket and tells the receiver, once.
+ */
+void TEventClientChannel::fail(const TTransportException& x) {
+  if (failed_) {
+    return;
+  }
+  failed_ = true;
+  setFlags(0);
+  socket_->close();
+  if (receiver_ != NULL) {
+    receiver_->channelFailed(x);
+  }
+}
+
+}}} // apache::thrift::async
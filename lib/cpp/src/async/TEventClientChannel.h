@@ -0,0 +1,112 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_ASYNC_TEVENTCLIENTCHANNEL_H_
+#define _THRIFT_ASYNC_TEVENTCLIENTCHANNEL_H_ 1
+
+#include <vector>
+#include <event.h>
+#include <boost/shared_ptr.hpp>
+
+#include <async/TAsyncChannel.h>
+#include <transport/TSocket.h>
+
+namespace apache { namespace thrift { namespace async {
+
+/**
+ * A client channel driven by a libevent loop.  Messages travel in frames
+ * with a four byte size in front, as TFramedTransport writes them, so the
+ * channel talks to TNonblockingServer and to servers using framed
+ * transports.
+ *
+ * Sends are written straight away as far as the socket takes them; the
+ * rest waits for the socket to drain.  Everything else, including the
+ * receiver's callbacks, happens in the thread running the event base.
+ * The channel must outlive its registration with the event base, which
+ * lasts until it is destroyed or fails.
+ */
+class TEventClientChannel : public TAsyncChannel {
+ public:
+  /**
+   * @param socket An open socket, which is switched to nonblocking mode
+   * @param base   The event base to register the socket with
+   */
+  TEventClientChannel(boost::shared_ptr<transport::TSocket> socket,
+                      struct event_base* base);
+
+  virtual ~TEventClientChannel();
+
+  void setReceiver(Receiver* receiver) {
+    receiver_ = receiver;
+  }
+
+  bool good() const {
+    return !failed_;
+  }
+
+  void sendMessage(const uint8_t* data, uint32_t len);
+
+  /**
+   * Bytes accepted by sendMessage() that the socket hasn't taken yet.
+   */
+  uint32_t getPendingWriteSize() const {
+    return wBuf_.size() - wPos_;
+  }
+
+  /// libevent callback
+  static void eventHandler(int fd, short which, void* v) {
+    (void)fd;
+    static_cast<TEventClientChannel*>(v)->handleEvent(which);
+  }
+
+ private:
+  void handleEvent(short which);
+
+  /**
+   * Writes as much of wBuf_ as the socket takes.
+   */
+  void writePending();
+
+  /**
+   * Reads what the socket has and hands over complete frames.
+   */
+  void readFrames();
+
+  void setFlags(short eventFlags);
+
+  void fail(const transport::TTransportException& x);
+
+  boost::shared_ptr<transport::TSocket> socket_;
+  int fd_;
+  struct event_base* base_;
+  struct event event_;
+  short eventFlags_;
+  Receiver* receiver_;
+  bool failed_;
+
+  std::vector<uint8_t> wBuf_;
+  uint32_t wPos_;
+
+  std::vector<uint8_t> rBuf_;
+  uint32_t rLen_;
+};
+
+}}} // apache::thrift::async
+
+#endif // #ifndef _THRIFT_ASYNC_TEVENTCLIENTCHANNEL_H_
@@ -58,7 +58,8 @@ class ThreadManager::Impl : public ThreadManager  {
     expiredCount_(0),
     state_(ThreadManager::UNINITIALIZED),
     monitor_(&mutex_),
-    maxMonitor_(&mutex_) {}
+    maxMonitor_(&mutex_),
+    workerMonitor_(&mutex_) {}
 
   ~Impl() { stop(); }
 
@@ -233,30 +234,28 @@ class ThreadManager::Worker: public Runnable {
    */
   void run() {
     bool active = false;
-    bool notifyManager = false;
 
     /**
      * Increment worker semaphore and notify manager if worker count reached
      * desired max
      *
-     * Note: We have to release the monitor and acquire the workerMonitor
-     * since that is what the manager blocks on for worker add/remove
+     * Note: workerMonitor shares the manager mutex, so the manager blocked
+     * on it for worker add/remove sees the count change atomically
      */
     {
       Synchronized s(manager_->monitor_);
       active = manager_->workerCount_ < manager_->workerMaxCount_;
       if (active) {
         manager_->workerCount_++;
-        notifyManager = manager_->workerCount_ == manager_->workerMaxCount_;
+        if (manager_->workerCount_ == manager_->workerMaxCount_) {
+          manager_->workerMonitor_.notify();
+        }
+      } else {
+        manager_->deadWorkers_.insert(this->thread());
+        return;
       }
     }
 
-    if (notifyManager) {
-      Synchronized s(manager_->workerMonitor_);
-      manager_->workerMonitor_.notify();
-      notifyManager = false;
-    }
-
     while (active) {
       shared_ptr<ThreadManager::Task> task;
 
@@ -300,9 +299,15 @@ class ThreadManager::Worker: public Runnable {
             }
           }
         } else {
+          /* Count ourselves out, hand our thread to removeWorker and wake it
+             in one critical section; the manager may be gone once we
+             release the mutex. */
           idle_ = true;
           manager_->workerCount_--;
-          notifyManager = (manager_->workerCount_ == manager_->workerMaxCount_);
+          manager_->deadWorkers_.insert(this->thread());
+          if (manager_->workerCount_ == manager_->workerMaxCount_) {
+            manager_->workerMonitor_.notify();
+          }
         }
       }
 
@@ -317,14 +322,6 @@ class ThreadManager::Worker: public Runnable {
       }
     }
 
-    {
-      Synchronized s(manager_->workerMonitor_);
-      manager_->deadWorkers_.insert(this->thread());
-      if (notifyManager) {
-        manager_->workerMonitor_.notify();
-      }
-    }
-
     return;
   }
 
@@ -449,7 +446,15 @@ void ThreadManager::Impl::removeWorker(size_t value) {
       idMap_.erase((*ix)->getId());
     }
 
-    deadWorkers_.clear();
+    removedThreads.swap(deadWorkers_);
+  }
+
+  // Wait for the threads themselves to finish, where the factory made them
+  // joinable
+  for (std::set<shared_ptr<Thread> >::iterator ix = removedThreads.begin(); ix != removedThreads.end(); ix++) {
+    if ((*ix)->getId() != threadFactory_->getCurrentThreadId()) {
+      (*ix)->join();
+    }
   }
 }
 
@@ -190,6 +190,14 @@ class ThreadManager {
    */
   static boost::shared_ptr<ThreadManager> newSimpleThreadManager(size_t count=4, size_t pendingTaskCountMax=0);
 
+  /**
+   * Creates a thread manager like newSimpleThreadManager, but instead of one
+   * task queue behind one lock, each of the count workers gets a bounded
+   * lock-free queue and idle workers steal from the others.  Tasks are run
+   * in FIFO order per queue rather than overall.
+   */
+  static boost::shared_ptr<ThreadManager> newWorkStealingThreadManager(size_t count=4, size_t pendingTaskCountMax=0);
+
   class Task;
 
   class Worker;
@@ -0,0 +1,420 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "TimerWheel.h"
+#include "Exception.h"
+#include "Util.h"
+
+#include <assert.h>
+
+namespace apache { namespace thrift { namespace concurrency {
+
+using boost::shared_ptr;
+
+// Level 0 has a slot per tick, the four levels above it a slot per 2^8,
+// 2^14, 2^20 and 2^26 ticks.
+static const int ROOT_BITS = 8;
+static const int LEVEL_BITS = 6;
+static const int LEVELS = 4;
+static const uint32_t ROOT_SLOTS = 1 << ROOT_BITS;
+static const uint32_t LEVEL_SLOTS = 1 << LEVEL_BITS;
+static const uint64_t MAX_DELTA = (1ULL << (ROOT_BITS + LEVELS * LEVEL_BITS)) - 1;
+static const uint64_t NEVER = ~0ULL;
+
+const uint32_t TimerWheel::NIL;
+
+class TimerWheel::Dispatcher: public Runnable {
+
+ public:
+  Dispatcher(TimerWheel* manager) :
+    manager_(manager) {}
+
+  /**
+   * Dispatcher entry point
+   *
+   * Advance the wheel to the current time, run whatever fell due, and sleep
+   * until the next occupied tick.
+   */
+  void run() {
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimerManager::STARTING) {
+        manager_->state_ = TimerManager::STARTED;
+        manager_->monitor_.notifyAll();
+      }
+    }
+
+    std::vector<shared_ptr<Runnable> > expired;
+
+    do {
+      {
+        Synchronized s(manager_->monitor_);
+        while (manager_->state_ == TimerManager::STARTED) {
+          int64_t now = Util::currentTime();
+          uint64_t nowTick = (now - manager_->startTime_) / manager_->tickMillis_;
+
+          if (manager_->taskCount_ == 0) {
+            // Nothing to cascade, so there's no need to walk the ticks
+            manager_->currentTick_ = nowTick + 1;
+            manager_->wakeTick_ = NEVER;
+            manager_->monitor_.wait();
+            continue;
+          }
+
+          while (manager_->currentTick_ <= nowTick) {
+            manager_->advance(expired);
+          }
+          if (!expired.empty()) {
+            break;
+          }
+
+          manager_->wakeTick_ = manager_->nextTick();
+          int64_t timeout = manager_->startTime_ +
+            (int64_t)manager_->wakeTick_ * manager_->tickMillis_ - now;
+          if (timeout > 0) {
+            try {
+              manager_->monitor_.wait(timeout);
+            } catch (TimedOutException &e) {}
+          }
+        }
+      }
+
+      for (std::vector<shared_ptr<Runnable> >::iterator ix = expired.begin(); ix != expired.end(); ix++) {
+        (*ix)->run();
+      }
+      expired.clear();
+
+    } while (manager_->state_ == TimerManager::STARTED);
+
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->state_ == TimerManager::STOPPING) {
+        manager_->state_ = TimerManager::STOPPED;
+        manager_->monitor_.notify();
+      }
+    }
+  }
+
+ private:
+  TimerWheel* manager_;
+  friend class TimerWheel;
+};
+
+TimerWheel::TimerWheel(int64_t tickMillis) :
+  tickMillis_(tickMillis > 0 ? tickMillis : 1),
+  startTime_(0),
+  currentTick_(0),
+  wakeTick_(NEVER),
+  freeList_(NIL),
+  slots_(ROOT_SLOTS + LEVELS * LEVEL_SLOTS, NIL),
+  taskCount_(0),
+  state_(TimerManager::UNINITIALIZED),
+  dispatcher_(shared_ptr<Dispatcher>(new Dispatcher(this))) {
+}
+
+TimerWheel::~TimerWheel() {
+  if (state_ != STOPPED) {
+    stop();
+  }
+}
+
+void TimerWheel::start() {
+  bool doStart = false;
+  {
+    Synchronized s(monitor_);
+    if (threadFactory() == NULL) {
+      throw InvalidArgumentException();
+    }
+    if (state_ == TimerManager::UNINITIALIZED) {
+      state_ = TimerManager::STARTING;
+      startTime_ = Util::currentTime();
+      doStart = true;
+    }
+  }
+
+  if (doStart) {
+    dispatcherThread_ = threadFactory()->newThread(dispatcher_);
+    dispatcherThread_->start();
+  }
+
+  {
+    Synchronized s(monitor_);
+    while (state_ == TimerManager::STARTING) {
+      monitor_.wait();
+    }
+    assert(state_ != TimerManager::STARTING);
+  }
+}
+
+void TimerWheel::stop() {
+  bool doStop = false;
+  {
+    Synchronized s(monitor_);
+    if (state_ == TimerManager::UNINITIALIZED) {
+      state_ = TimerManager::STOPPED;
+    } else if (state_ != STOPPING &&  state_ != STOPPED) {
+      doStop = true;
+      state_ = STOPPING;
+      monitor_.notifyAll();
+    }
+    while (state_ != STOPPED) {
+      monitor_.wait();
+    }
+  }
+
+  if (doStop) {
+    // Clean up any outstanding tasks
+    nodes_.clear();
+    freeList_ = NIL;
+    slots_.assign(slots_.size(), NIL);
+    taskCount_ = 0;
+
+    // Remove dispatcher's reference to us.
+    dispatcher_->manager_ = NULL;
+  }
+}
+
+size_t TimerWheel::taskCount() const {
+  return taskCount_;
+}
+
+void TimerWheel::add(shared_ptr<Runnable> task, int64_t timeout) {
+  schedule(task, timeout);
+}
+
+void TimerWheel::add(shared_ptr<Runnable> task, const struct timespec& value) {
+  int64_t expiration;
+  Util::toMilliseconds(expiration, value);
+
+  int64_t now = Util::currentTime();
+
+  if (expiration < now) {
+    throw  InvalidArgumentException();
+  }
+
+  schedule(task, expiration - now);
+}
+
+TimerWheel::Handle TimerWheel::schedule(shared_ptr<Runnable> task, int64_t timeout) {
+  int64_t due = Util::currentTime() + timeout;
+
+  Synchronized s(monitor_);
+  if (state_ != TimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  uint32_t index = freeList_;
+  if (index != NIL) {
+    freeList_ = nodes_[index].next;
+  } else {
+    index = nodes_.size();
+    nodes_.push_back(Node());
+    nodes_[index].generation = 1;
+  }
+
+  // Round up, so the task never runs early
+  Node& node = nodes_[index];
+  node.task = task;
+  node.expireTick = due > startTime_ ?
+    (due - startTime_ + tickMillis_ - 1) / tickMillis_ : 0;
+  place(index);
+  taskCount_++;
+
+  // Kick the dispatcher if it's going to sleep past this task
+  if (node.expireTick < wakeTick_) {
+    wakeTick_ = node.expireTick;
+    monitor_.notify();
+  }
+
+  return ((Handle)node.generation << 32) | index;
+}
+
+bool TimerWheel::cancel(Handle handle) {
+  uint32_t index = (uint32_t)(handle & 0xffffffff);
+  uint32_t generation = (uint32_t)(handle >> 32);
+
+  Synchronized s(monitor_);
+  if (index >= nodes_.size() ||
+      nodes_[index].generation != generation ||
+      nodes_[index].slot == NIL) {
+    return false;
+  }
+
+  unlink(index);
+  release(index);
+  taskCount_--;
+  return true;
+}
+
+void TimerWheel::remove(shared_ptr<Runnable> task) {
+  Synchronized s(monitor_);
+  if (state_ != TimerManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  bool found = false;
+  for (uint32_t index = 0; index < nodes_.size(); ++index) {
+    if (nodes_[index].slot != NIL && nodes_[index].task == task) {
+      unlink(index);
+      release(index);
+      taskCount_--;
+      found = true;
+    }
+  }
+  if (!found) {
+    throw NoSuchTaskException();
+  }
+}
+
+const TimerManager::STATE TimerWheel::state() const { return state_; }
+
+/**
+ * Links a node into the slot for its expiration time, relative to
+ * currentTick_.
+ */
+void TimerWheel::place(uint32_t index) {
+  Node& node = nodes_[index];
+  uint64_t expire = node.expireTick;
+  if (expire < currentTick_) {
+    expire = currentTick_;
+  }
+  uint64_t delta = expire - currentTick_;
+
+  uint32_t slot;
+  if (delta < ROOT_SLOTS) {
+    slot = expire & (ROOT_SLOTS - 1);
+  } else {
+    // Beyond the wheel's range, park the node in the last slot it has and
+    // place it again when it cascades down from there.
+    if (delta > MAX_DELTA) {
+      expire = currentTick_ + MAX_DELTA;
+      delta = MAX_DELTA;
+    }
+    int level = 0;
+    int shift = ROOT_BITS;
+    while (level < LEVELS - 1 && delta >= (1ULL << (shift + LEVEL_BITS))) {
+      level++;
+      shift += LEVEL_BITS;
+    }
+    slot = ROOT_SLOTS + level * LEVEL_SLOTS +
+      ((expire >> shift) & (LEVEL_SLOTS - 1));
+  }
+
+  node.slot = slot;
+  node.prev = NIL;
+  node.next = slots_[slot];
+  if (node.next != NIL) {
+    nodes_[node.next].prev = index;
+  }
+  slots_[slot] = index;
+}
+
+void TimerWheel::unlink(uint32_t index) {
+  Node& node = nodes_[index];
+  if (node.prev != NIL) {
+    nodes_[node.prev].next = node.next;
+  } else {
+    slots_[node.slot] = node.next;
+  }
+  if (node.next != NIL) {
+    nodes_[node.next].prev = node.prev;
+  }
+}
+
+/**
+ * Returns an unlinked node to the free list.  Bumping the generation
+ * invalidates any handle to it.
+ */
+void TimerWheel::release(uint32_t index) {
+  Node& node = nodes_[index];
+  node.task.reset();
+  node.slot = NIL;
+  if (++node.generation == 0) {
+    node.generation = 1;
+  }
+  node.next = freeList_;
+  freeList_ = index;
+}
+
+/**
+ * Places every node of an upper level slot again, which moves it down at
+ * least one level.
+ */
+void TimerWheel::cascade(uint32_t slot) {
+  uint32_t index = slots_[slot];
+  slots_[slot] = NIL;
+  while (index != NIL) {
+    uint32_t next = nodes_[index].next;
+    place(index);
+    index = next;
+  }
+}
+
+/**
+ * Processes currentTick_, collecting the tasks that fell due.
+ */
+void TimerWheel::advance(std::vector<shared_ptr<Runnable> >& expired) {
+  uint32_t root = currentTick_ & (ROOT_SLOTS - 1);
+
+  // When the root level wraps around, bring the next slot of the level above
+  // down, and so on up while those wrap too.
+  if (root == 0) {
+    int shift = ROOT_BITS;
+    for (int level = 0; level < LEVELS; level++, shift += LEVEL_BITS) {
+      uint32_t slot = (currentTick_ >> shift) & (LEVEL_SLOTS - 1);
+      cascade(ROOT_SLOTS + level * LEVEL_SLOTS + slot);
+      if (slot != 0) {
+        break;
+      }
+    }
+  }
+
+  uint32_t index = slots_[root];
+  slots_[root] = NIL;
+  while (index != NIL) {
+    uint32_t next = nodes_[index].next;
+    expired.push_back(nodes_[index].task);
+    release(index);
+    taskCount_--;
+    index = next;
+  }
+
+  currentTick_++;
+}
+
+/**
+ * The first tick from currentTick_ on with something to do: either an
+ * occupied root slot or the next cascade.
+ */
+uint64_t TimerWheel::nextTick() const {
+  uint64_t tick = currentTick_;
+  if ((tick & (ROOT_SLOTS - 1)) == 0) {
+    // The root level hasn't been refilled from above yet
+    return tick;
+  }
+  while (slots_[tick & (ROOT_SLOTS - 1)] == NIL) {
+    if ((tick & (ROOT_SLOTS - 1)) == ROOT_SLOTS - 1) {
+      return tick + 1;
+    }
+    tick++;
+  }
+  return tick;
+}
+
+}}} // apache::thrift::concurrency
@@ -0,0 +1,146 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_CONCURRENCY_TIMERWHEEL_H_
+#define _THRIFT_CONCURRENCY_TIMERWHEEL_H_ 1
+
+#include "TimerManager.h"
+
+#include <boost/shared_ptr.hpp>
+#include <vector>
+#include <stdint.h>
+
+namespace apache { namespace thrift { namespace concurrency {
+
+/**
+ * Timer manager backed by a hierarchical timer wheel
+ *
+ * Time is divided into ticks of a configurable number of milliseconds.
+ * Timers due within the next 256 ticks sit in a slot per tick.  Four
+ * coarser levels of 64 slots each cover the rest of a 2^32 tick range, and
+ * their timers are moved ("cascaded") down a level each time the level
+ * below wraps around.  Adding and cancelling a timer are constant time and
+ * don't allocate once the manager has seen its peak number of timers.
+ * Tasks run on the dispatcher thread, as with TimerManager.
+ */
+class TimerWheel : public TimerManager {
+
+ public:
+
+  /**
+   * Identifies a task added with schedule(), for cancel().  Never 0.
+   */
+  typedef int64_t Handle;
+
+  /**
+   * @param tickMillis The wheel's resolution in milliseconds.  Tasks run at
+   *                   the end of the tick they fall due in.
+   */
+  TimerWheel(int64_t tickMillis=1LL);
+
+  virtual ~TimerWheel();
+
+  virtual void start();
+
+  virtual void stop();
+
+  virtual size_t taskCount() const;
+
+  virtual void add(boost::shared_ptr<Runnable> task, int64_t timeout);
+
+  virtual void add(boost::shared_ptr<Runnable> task, const struct timespec& timeout);
+
+  /**
+   * Removes every pending timer for task.  This has to search the whole
+   * wheel; use schedule() and cancel() to remove timers cheaply.
+   *
+   * @throws NoSuchTaskException No timer for task is pending.
+   */
+  virtual void remove(boost::shared_ptr<Runnable> task);
+
+  virtual const STATE state() const;
+
+  /**
+   * Adds a task like add() and returns a handle to cancel it with.
+   *
+   * @param task The task to execute
+   * @param timeout Time in milliseconds to delay before executing task
+   */
+  Handle schedule(boost::shared_ptr<Runnable> task, int64_t timeout);
+
+  /**
+   * Cancels a task added with schedule().
+   *
+   * @return Whether the task was still pending.  It isn't if it has already
+   *         been dispatched or cancelled.
+   */
+  bool cancel(Handle handle);
+
+  int64_t tickMillis() const {
+    return tickMillis_;
+  }
+
+ private:
+  class Dispatcher;
+  friend class Dispatcher;
+
+  struct Node {
+    boost::shared_ptr<Runnable> task;
+    uint64_t expireTick;
+    uint32_t slot;
+    uint32_t prev;
+    uint32_t next;
+    uint32_t generation;
+  };
+
+  static const uint32_t NIL = 0xffffffff;
+
+  void place(uint32_t index);
+  void unlink(uint32_t index);
+  void release(uint32_t index);
+  void cascade(uint32_t slot);
+  void advance(std::vector<boost::shared_ptr<Runnable> >& expired);
+  uint64_t nextTick() const;
+
+  const int64_t tickMillis_;
+  int64_t startTime_;
+
+  // The next tick to process; everything before it has been dispatched
+  uint64_t currentTick_;
+
+  // The tick the dispatcher will wake up at if nothing is added before
+  uint64_t wakeTick_;
+
+  // Timer nodes, and a free list through Node::next
+  std::vector<Node> nodes_;
+  uint32_t freeList_;
+
+  // List heads for every slot of every level
+  std::vector<uint32_t> slots_;
+
+  size_t taskCount_;
+  Monitor monitor_;
+  STATE state_;
+  boost::shared_ptr<Dispatcher> dispatcher_;
+  boost::shared_ptr<Thread> dispatcherThread_;
+};
+
+}}} // apache::thrift::concurrency
+
+#endif // #ifndef _THRIFT_CONCURRENCY_TIMERWHEEL_H_
@@ -0,0 +1,719 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "ThreadManager.h"
+#include "Exception.h"
+#include "Monitor.h"
+#include "Util.h"
+
+#include <boost/shared_ptr.hpp>
+
+#include <deque>
+#include <map>
+#include <set>
+#include <vector>
+#include <stdint.h>
+
+namespace apache { namespace thrift { namespace concurrency {
+
+using boost::shared_ptr;
+using boost::dynamic_pointer_cast;
+
+/**
+ * A pending task.  Stored by value in the queues, so adding a task doesn't
+ * allocate anything beyond the caller's Runnable.
+ */
+struct PendingTask {
+  PendingTask() : expireTime(0LL) {}
+
+  PendingTask(shared_ptr<Runnable> runnable, int64_t expiration) :
+    runnable(runnable),
+    expireTime(expiration != 0LL ? Util::currentTime() + expiration : 0LL) {}
+
+  shared_ptr<Runnable> runnable;
+  int64_t expireTime;
+};
+
+/**
+ * Bounded lock-free multi-producer, multi-consumer FIFO ring (Dmitry
+ * Vyukov's design).  Every cell carries a sequence number which says
+ * whether it is ready to be written or read at a given position, so
+ * producers and consumers only contend on their own position counter.
+ */
+class TaskRing {
+
+ public:
+  // Must be a power of two
+  static const size_t CAPACITY = 1024;
+
+  TaskRing() :
+    enqueuePos_(0),
+    dequeuePos_(0) {
+    for (size_t i = 0; i < CAPACITY; ++i) {
+      cells_[i].sequence = i;
+    }
+  }
+
+  bool push(const PendingTask& task) {
+    Cell* cell;
+    size_t pos = enqueuePos_;
+    while (true) {
+      cell = &cells_[pos & (CAPACITY - 1)];
+      intptr_t dif = (intptr_t)cell->sequence - (intptr_t)pos;
+      if (dif == 0) {
+        if (__sync_bool_compare_and_swap(&enqueuePos_, pos, pos + 1)) {
+          break;
+        }
+        pos = enqueuePos_;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = enqueuePos_;
+      }
+    }
+    cell->task = task;
+    __sync_synchronize();
+    cell->sequence = pos + 1;
+    return true;
+  }
+
+  /**
+   * Pops the task at the front.  If expiredBefore is nonzero, only pops it
+   * if it expires at or before that time.
+   */
+  bool pop(PendingTask& task, int64_t expiredBefore=0LL) {
+    Cell* cell;
+    size_t pos = dequeuePos_;
+    while (true) {
+      cell = &cells_[pos & (CAPACITY - 1)];
+      intptr_t dif = (intptr_t)cell->sequence - (intptr_t)(pos + 1);
+      if (dif == 0) {
+        if (expiredBefore != 0LL) {
+          __sync_synchronize();
+          int64_t expireTime = cell->task.expireTime;
+          if (expireTime == 0LL || expireTime > expiredBefore) {
+            return false;
+          }
+        }
+        if (__sync_bool_compare_and_swap(&dequeuePos_, pos, pos + 1)) {
+          break;
+        }
+        pos = dequeuePos_;
+      } else if (dif < 0) {
+        return false;
+      } else {
+        pos = dequeuePos_;
+      }
+    }
+    task = cell->task;
+    cell->task = PendingTask();
+    __sync_synchronize();
+    cell->sequence = pos + CAPACITY;
+    return true;
+  }
+
+ private:
+  struct Cell {
+    volatile size_t sequence;
+    PendingTask task;
+  };
+
+  // Keep the two positions, and the cells, on separate cache lines
+  char pad0_[64];
+  volatile size_t enqueuePos_;
+  char pad1_[64];
+  volatile size_t dequeuePos_;
+  char pad2_[64];
+  Cell cells_[CAPACITY];
+};
+
+/**
+ * ThreadManager with a task ring per initial worker rather than a single
+ * queue behind one mutex.
+ *
+ * add() spreads tasks round robin over the rings, spilling into a locked
+ * overflow queue only when they are all full.  A worker serves its own ring
+ * first and then steals from the others.  Wakeups are batched: add() only
+ * wakes a sleeping worker when no worker is already awake looking for
+ * work, and a worker that finds a task while more are pending wakes the
+ * next one.
+ *
+ * Ordering is FIFO per ring, not across the whole manager, so
+ * removeNextPending() and removeExpiredTasks() look at the front of every
+ * ring in turn.
+ */
+class WorkStealingThreadManager : public ThreadManager {
+
+ public:
+  class Worker;
+
+  WorkStealingThreadManager(size_t workerCount, size_t pendingTaskCountMax) :
+    initialWorkerCount_(workerCount),
+    rings_(workerCount > 0 ? workerCount : 1),
+    nextRing_(0),
+    pendingCount_(0),
+    overflowCount_(0),
+    searching_(0),
+    sleeping_(0),
+    blockedAdders_(0),
+    running_(0),
+    workerCount_(0),
+    workerMaxCount_(0),
+    idleCount_(0),
+    pendingTaskCountMax_(pendingTaskCountMax),
+    expiredCount_(0),
+    state_(ThreadManager::UNINITIALIZED),
+    workerMonitor_(&monitor_) {
+    for (size_t i = 0; i < rings_.size(); ++i) {
+      rings_[i] = new TaskRing();
+    }
+  }
+
+  ~WorkStealingThreadManager() {
+    stop();
+    for (size_t i = 0; i < rings_.size(); ++i) {
+      delete rings_[i];
+    }
+  }
+
+  void start();
+
+  void stop() { stopImpl(false); }
+
+  void join() { stopImpl(true); }
+
+  const ThreadManager::STATE state() const {
+    return state_;
+  }
+
+  shared_ptr<ThreadFactory> threadFactory() const {
+    Synchronized s(monitor_);
+    return threadFactory_;
+  }
+
+  void threadFactory(shared_ptr<ThreadFactory> value) {
+    Synchronized s(monitor_);
+    threadFactory_ = value;
+  }
+
+  void addWorker(size_t value);
+
+  void removeWorker(size_t value);
+
+  size_t idleWorkerCount() const {
+    return idleCount_;
+  }
+
+  size_t workerCount() const {
+    Synchronized s(monitor_);
+    return workerCount_;
+  }
+
+  size_t pendingTaskCount() const {
+    return pendingCount_;
+  }
+
+  size_t totalTaskCount() const {
+    return pendingCount_ + running_;
+  }
+
+  size_t pendingTaskCountMax() const {
+    return pendingTaskCountMax_;
+  }
+
+  size_t expiredTaskCount() {
+    return __sync_fetch_and_and(&expiredCount_, 0);
+  }
+
+  void add(shared_ptr<Runnable> value, int64_t timeout, int64_t expiration);
+
+  void remove(shared_ptr<Runnable> task);
+
+  shared_ptr<Runnable> removeNextPending();
+
+  void removeExpiredTasks();
+
+  void setExpireCallback(ExpireCallback expireCallback) {
+    expireCallback_ = expireCallback;
+  }
+
+ private:
+  void stopImpl(bool join);
+
+  bool canSleep();
+
+  void reserve(int64_t timeout);
+
+  void push(const PendingTask& task);
+
+  bool take(size_t home, PendingTask& task, bool run);
+
+  bool expire(PendingTask& task);
+
+  void taken(bool run);
+
+  void wakeWorker();
+
+  bool isActive() const {
+    return
+      (workerCount_ <= workerMaxCount_) ||
+      (state_ == JOINING && pendingCount_ > 0);
+  }
+
+  const size_t initialWorkerCount_;
+
+  std::vector<TaskRing*> rings_;
+  volatile size_t nextRing_;
+
+  // Tasks that didn't fit in any ring, guarded by overflowMutex_
+  std::deque<PendingTask> overflow_;
+  Mutex overflowMutex_;
+
+  // Tasks reserved by add() and not yet taken by a worker
+  volatile size_t pendingCount_;
+  volatile size_t overflowCount_;
+
+  // Workers awake and looking for a task, and workers asleep waiting for one
+  volatile size_t searching_;
+  volatile size_t sleeping_;
+
+  // Threads in add() waiting for pendingCount_ to drop below the maximum
+  volatile size_t blockedAdders_;
+
+  // Tasks being run by workers
+  volatile size_t running_;
+
+  size_t workerCount_;
+  size_t workerMaxCount_;
+  volatile size_t idleCount_;
+  const size_t pendingTaskCountMax_;
+  volatile size_t expiredCount_;
+  ExpireCallback expireCallback_;
+
+  volatile ThreadManager::STATE state_;
+  shared_ptr<ThreadFactory> threadFactory_;
+
+  Monitor monitor_;
+  Monitor maxMonitor_;
+  // Shares monitor_'s mutex, so a worker counts itself out, joins
+  // deadWorkers_ and wakes removeWorker() in one critical section
+  Monitor workerMonitor_;
+
+  friend class WorkStealingThreadManager::Worker;
+  std::set<shared_ptr<Thread> > workers_;
+  std::set<shared_ptr<Thread> > deadWorkers_;
+  std::map<const Thread::id_t, shared_ptr<Thread> > idMap_;
+};
+
+class WorkStealingThreadManager::Worker : public Runnable {
+
+ public:
+  Worker(WorkStealingThreadManager* manager, size_t home) :
+    manager_(manager),
+    home_(home) {}
+
+  /**
+   * Worker entry point
+   *
+   * Take tasks from our own ring, or steal them from the others, and run
+   * them.  Sleep when there is nothing pending anywhere.
+   */
+  void run() {
+    {
+      Synchronized s(manager_->monitor_);
+      if (manager_->workerCount_ >= manager_->workerMaxCount_) {
+        retire();
+        return;
+      }
+      manager_->workerCount_++;
+      if (manager_->workerCount_ == manager_->workerMaxCount_) {
+        manager_->workerMonitor_.notifyAll();
+      }
+      __sync_fetch_and_add(&manager_->searching_, 1);
+    }
+
+    while (true) {
+      PendingTask task;
+
+      if (manager_->take(home_, task, true)) {
+        // Someone else has to look for the rest of the pending tasks
+        if (__sync_sub_and_fetch(&manager_->searching_, 1) == 0 &&
+            manager_->pendingCount_ > 0) {
+          manager_->wakeWorker();
+        }
+
+        if (!manager_->expire(task)) {
+          try {
+            task.runnable->run();
+          } catch(...) {
+            // XXX need to log this
+          }
+        }
+        task = PendingTask();
+        __sync_fetch_and_sub(&manager_->running_, 1);
+
+        __sync_fetch_and_add(&manager_->searching_, 1);
+        if (manager_->workerCount_ <= manager_->workerMaxCount_) {
+          continue;
+        }
+      }
+
+      /**
+       * Nothing to do, or we may have been asked to stop.  Under the manager
+       * monitor, announce that we are going to sleep and then check for
+       * pending tasks one last time.  add() bumps pendingCount_ before it
+       * looks at sleeping_, so one of us always sees the other.
+       */
+      Synchronized s(manager_->monitor_);
+      __sync_fetch_and_sub(&manager_->searching_, 1);
+      while (true) {
+        if (!manager_->isActive()) {
+          manager_->workerCount_--;
+          retire();
+          // The manager may be gone once the monitor is released
+          return;
+        }
+        __sync_fetch_and_add(&manager_->sleeping_, 1);
+        if (manager_->pendingCount_ > 0) {
+          __sync_fetch_and_sub(&manager_->sleeping_, 1);
+          break;
+        }
+        manager_->idleCount_++;
+        manager_->monitor_.wait();
+        manager_->idleCount_--;
+        __sync_fetch_and_sub(&manager_->sleeping_, 1);
+      }
+      __sync_fetch_and_add(&manager_->searching_, 1);
+    }
+  }
+
+ private:
+  /**
+   * Hands this worker's thread to removeWorker().  Called with the manager
+   * monitor held, as the worker's last use of the manager.
+   */
+  void retire() {
+    manager_->deadWorkers_.insert(this->thread());
+    if (manager_->workerCount_ == manager_->workerMaxCount_) {
+      manager_->workerMonitor_.notifyAll();
+    }
+  }
+
+  WorkStealingThreadManager* manager_;
+  const size_t home_;
+};
+
+void WorkStealingThreadManager::addWorker(size_t value) {
+  std::set<shared_ptr<Thread> > newThreads;
+  for (size_t ix = 0; ix < value; ix++) {
+    shared_ptr<Worker> worker(new Worker(this, (workers_.size() + ix) % rings_.size()));
+    newThreads.insert(threadFactory_->newThread(worker));
+  }
+
+  {
+    Synchronized s(monitor_);
+    workerMaxCount_ += value;
+    workers_.insert(newThreads.begin(), newThreads.end());
+  }
+
+  for (std::set<shared_ptr<Thread> >::iterator ix = newThreads.begin(); ix != newThreads.end(); ix++) {
+    (*ix)->start();
+    Synchronized s(monitor_);
+    idMap_.insert(std::pair<const Thread::id_t, shared_ptr<Thread> >((*ix)->getId(), *ix));
+  }
+
+  {
+    Synchronized s(monitor_);
+    while (workerCount_ != workerMaxCount_) {
+      workerMonitor_.wait();
+    }
+  }
+}
+
+void WorkStealingThreadManager::start() {
+  if (state_ == ThreadManager::STOPPED) {
+    return;
+  }
+
+  {
+    Synchronized s(monitor_);
+    if (state_ == ThreadManager::UNINITIALIZED) {
+      if (threadFactory_ == NULL) {
+        throw InvalidArgumentException();
+      }
+      state_ = ThreadManager::STARTED;
+      monitor_.notifyAll();
+    }
+
+    while (state_ == STARTING) {
+      monitor_.wait();
+    }
+  }
+
+  if (workers_.empty()) {
+    addWorker(initialWorkerCount_);
+  }
+}
+
+void WorkStealingThreadManager::stopImpl(bool join) {
+  bool doStop = false;
+  if (state_ == ThreadManager::STOPPED) {
+    return;
+  }
+
+  {
+    Synchronized s(monitor_);
+    if (state_ != ThreadManager::STOPPING &&
+        state_ != ThreadManager::JOINING &&
+        state_ != ThreadManager::STOPPED) {
+      doStop = true;
+      state_ = join ? ThreadManager::JOINING : ThreadManager::STOPPING;
+    }
+  }
+
+  if (doStop) {
+    removeWorker(workerCount_);
+  }
+
+  {
+    Synchronized s(monitor_);
+    state_ = ThreadManager::STOPPED;
+  }
+}
+
+void WorkStealingThreadManager::removeWorker(size_t value) {
+  std::set<shared_ptr<Thread> > dead;
+  {
+    Synchronized s(monitor_);
+    if (value > workerMaxCount_) {
+      throw InvalidArgumentException();
+    }
+
+    workerMaxCount_ -= value;
+    monitor_.notifyAll();
+
+    // A worker leaves workerCount_ and joins deadWorkers_ in one critical
+    // section, so once the count is down every departing worker is done
+    // with the manager
+    while (workerCount_ != workerMaxCount_) {
+      workerMonitor_.wait();
+    }
+
+    for (std::set<shared_ptr<Thread> >::iterator ix = deadWorkers_.begin(); ix != deadWorkers_.end(); ix++) {
+      workers_.erase(*ix);
+      idMap_.erase((*ix)->getId());
+    }
+    dead.swap(deadWorkers_);
+  }
+
+  // Wait for the threads themselves to finish, where the factory made them
+  // joinable
+  for (std::set<shared_ptr<Thread> >::iterator ix = dead.begin(); ix != dead.end(); ix++) {
+    if ((*ix)->getId() != threadFactory_->getCurrentThreadId()) {
+      (*ix)->join();
+    }
+  }
+}
+
+bool WorkStealingThreadManager::canSleep() {
+  const Thread::id_t id = threadFactory_->getCurrentThreadId();
+  Synchronized s(monitor_);
+  return idMap_.find(id) == idMap_.end();
+}
+
+/**
+ * Counts a task as pending, blocking or throwing as add() documents if
+ * that would exceed pendingTaskCountMax.
+ */
+void WorkStealingThreadManager::reserve(int64_t timeout) {
+  if (pendingTaskCountMax_ == 0) {
+    __sync_fetch_and_add(&pendingCount_, 1);
+    return;
+  }
+
+  while (true) {
+    size_t count = pendingCount_;
+    if (count < pendingTaskCountMax_) {
+      if (__sync_bool_compare_and_swap(&pendingCount_, count, count + 1)) {
+        return;
+      }
+      continue;
+    }
+
+    removeExpiredTasks();
+    if (pendingCount_ < pendingTaskCountMax_) {
+      continue;
+    }
+    if (!canSleep() || timeout < 0) {
+      throw TooManyPendingTasksException();
+    }
+
+    Synchronized s(maxMonitor_);
+    __sync_fetch_and_add(&blockedAdders_, 1);
+    try {
+      if (pendingCount_ >= pendingTaskCountMax_) {
+        maxMonitor_.wait(timeout);
+      }
+    } catch (...) {
+      __sync_fetch_and_sub(&blockedAdders_, 1);
+      throw;
+    }
+    __sync_fetch_and_sub(&blockedAdders_, 1);
+  }
+}
+
+void WorkStealingThreadManager::push(const PendingTask& task) {
+  size_t first = __sync_fetch_and_add(&nextRing_, 1);
+  for (size_t i = 0; i < rings_.size(); ++i) {
+    if (rings_[(first + i) % rings_.size()]->push(task)) {
+      return;
+    }
+  }
+
+  Guard g(overflowMutex_);
+  overflow_.push_back(task);
+  __sync_fetch_and_add(&overflowCount_, 1);
+}
+
+bool WorkStealingThreadManager::take(size_t home, PendingTask& task, bool run) {
+  for (size_t i = 0; i < rings_.size(); ++i) {
+    if (rings_[(home + i) % rings_.size()]->pop(task)) {
+      taken(run);
+      return true;
+    }
+  }
+
+  if (overflowCount_ > 0) {
+    Guard g(overflowMutex_);
+    if (!overflow_.empty()) {
+      task = overflow_.front();
+      overflow_.pop_front();
+      __sync_fetch_and_sub(&overflowCount_, 1);
+      taken(run);
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+ * Bookkeeping for a task that just left the queues, to be run by the
+ * calling worker if run is set.
+ */
+void WorkStealingThreadManager::taken(bool run) {
+  if (run) {
+    __sync_fetch_and_add(&running_, 1);
+  }
+  __sync_fetch_and_sub(&pendingCount_, 1);
+
+  // If we have a pending task max and adders are waiting on it, we just
+  // made room for one.
+  if (pendingTaskCountMax_ != 0 && blockedAdders_ > 0) {
+    Synchronized s(maxMonitor_);
+    maxMonitor_.notify();
+  }
+}
+
+/**
+ * Drops a task that was taken after its expiration time.  Returns whether
+ * it did.
+ */
+bool WorkStealingThreadManager::expire(PendingTask& task) {
+  if (task.expireTime == 0LL || task.expireTime > Util::currentTime()) {
+    return false;
+  }
+  if (expireCallback_) {
+    expireCallback_(task.runnable);
+  }
+  __sync_fetch_and_add(&expiredCount_, 1);
+  return true;
+}
+
+void WorkStealingThreadManager::wakeWorker() {
+  Synchronized s(monitor_);
+  if (idleCount_ > 0) {
+    monitor_.notify();
+  }
+}
+
+void WorkStealingThreadManager::add(shared_ptr<Runnable> value,
+                                    int64_t timeout,
+                                    int64_t expiration) {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  reserve(timeout);
+  push(PendingTask(value, expiration));
+
+  // Only wake a worker if none is already awake to find this task
+  if (searching_ == 0 && sleeping_ > 0) {
+    wakeWorker();
+  }
+}
+
+void WorkStealingThreadManager::remove(shared_ptr<Runnable> task) {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException();
+  }
+}
+
+shared_ptr<Runnable> WorkStealingThreadManager::removeNextPending() {
+  if (state_ != ThreadManager::STARTED) {
+    throw IllegalStateException();
+  }
+
+  PendingTask task;
+  if (!take(0, task, false)) {
+    return shared_ptr<Runnable>();
+  }
+  return task.runnable;
+}
+
+void WorkStealingThreadManager::removeExpiredTasks() {
+  int64_t now = Util::currentTime();
+
+  // Like the single queue, stop at the first task on each ring that hasn't
+  // expired
+  for (size_t i = 0; i < rings_.size(); ++i) {
+    PendingTask task;
+    while (rings_[i]->pop(task, now)) {
+      taken(false);
+      expire(task);
+    }
+  }
+
+  if (overflowCount_ > 0) {
+    Guard g(overflowMutex_);
+    while (!overflow_.empty() && overflow_.front().expireTime != 0LL &&
+           overflow_.front().expireTime <= now) {
+      PendingTask task = overflow_.front();
+      overflow_.pop_front();
+      __sync_fetch_and_sub(&overflowCount_, 1);
+      taken(false);
+      expire(task);
+    }
+  }
+}
+
+shared_ptr<ThreadManager> ThreadManager::newWorkStealingThreadManager(size_t count, size_t pendingTaskCountMax) {
+  return shared_ptr<ThreadManager>(new WorkStealingThreadManager(count, pendingTaskCountMax));
+}
+
+}}} // apache::thrift::concurrency
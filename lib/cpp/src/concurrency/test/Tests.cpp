@@ -98,14 +98,40 @@ int main(int argc, char** argv) {
 
     TimerManagerTests timerManagerTests;
 
-    assert(timerManagerTests.test00());
+    assert(timerManagerTests.test00<TimerManager>());
+
+    std::cout << "\t\tTimerWheel test00" << std::endl;
+
+    assert(timerManagerTests.test00<TimerWheel>());
+
+    std::cout << "\t\tTimerWheel cancel test" << std::endl;
+
+    assert(timerManagerTests.cancelTest());
+  }
+
+  if (runAll || args[0].compare("timer-manager-benchmark") == 0) {
+
+    std::cout << "TimerManager benchmark..." << std::endl;
+
+    for (size_t count = 1000; count <= 1000000; count*= 10) {
+
+      TimerManagerTests timerManagerTests;
+
+      double multimap = timerManagerTests.addBenchmark<TimerManager>(count);
+
+      double wheel = timerManagerTests.addBenchmark<TimerWheel>(count);
+
+      double cancel = timerManagerTests.cancelBenchmark(count, count);
+
+      std::cout << "\t\ttimers: " << count << " adds/ms multimap: " << multimap << " wheel: " << wheel << " wheel schedule+cancel/ms: " << cancel << std::endl;
+    }
   }
 
   if (runAll || args[0].compare("thread-manager") == 0) {
 
     std::cout << "ThreadManager tests..." << std::endl;
 
-    {
+    for (int workStealing = 0; workStealing < 2; workStealing++) {
 
       size_t workerCount = 100;
 
@@ -113,16 +139,22 @@ int main(int argc, char** argv) {
 
       int64_t delay = 10LL;
 
-      std::cout << "\t\tThreadManager load test: worker count: " << workerCount << " task count: " << taskCount << " delay: " << delay << std::endl;
+      const char* name = workStealing ? "WorkStealing" : "Simple";
+
+      std::cout << "\t\t" << name << " ThreadManager load test: worker count: " << workerCount << " task count: " << taskCount << " delay: " << delay << std::endl;
 
-      ThreadManagerTests threadManagerTests;
+      ThreadManagerTests threadManagerTests(workStealing);
 
       assert(threadManagerTests.loadTest(taskCount, delay, workerCount));
 
-      std::cout << "\t\tThreadManager block test: worker count: " << workerCount << " delay: " << delay << std::endl;
+      std::cout << "\t\t" << name << " ThreadManager block test: worker count: " << workerCount << " delay: " << delay << std::endl;
 
       assert(threadManagerTests.blockTest(delay, workerCount));
 
+      std::cout << "\t\t" << name << " ThreadManager expire test: delay: " << delay << std::endl;
+
+      assert(threadManagerTests.expireTest(delay));
+
     }
   }
 
@@ -152,4 +184,27 @@ int main(int argc, char** argv) {
       }
     }
   }
+
+  if (runAll || args[0].compare("thread-manager-throughput") == 0) {
+
+    std::cout << "ThreadManager throughput benchmark..." << std::endl;
+
+    {
+
+      size_t tasksPerThread = 20000;
+
+      for (size_t threadCount = 1; threadCount <= 64; threadCount*= 2) {
+
+        ThreadManagerTests simpleTests(false);
+
+        ThreadManagerTests workStealingTests(true);
+
+        double simple = simpleTests.throughputTest(threadCount, tasksPerThread);
+
+        double workStealing = workStealingTests.throughputTest(threadCount, tasksPerThread);
+
+        std::cout << "\t\tthreads: " << threadCount << " tasks/ms simple: " << simple << " work stealing: " << workStealing << std::endl;
+      }
+    }
+  }
 }
@@ -27,7 +27,9 @@
 #include <set>
 #include <iostream>
 #include <set>
+#include <vector>
 #include <stdint.h>
+#include <unistd.h>
 
 namespace apache { namespace thrift { namespace concurrency { namespace test {
 
@@ -44,6 +46,19 @@ public:
 
   static const double ERROR;
 
+  ThreadManagerTests(bool workStealing=false) :
+    _workStealing(workStealing) {}
+
+  /**
+   * Creates the kind of thread manager under test
+   */
+  shared_ptr<ThreadManager> newThreadManager(size_t workerCount, size_t pendingTaskCountMax=0) {
+    if (_workStealing) {
+      return ThreadManager::newWorkStealingThreadManager(workerCount, pendingTaskCountMax);
+    }
+    return ThreadManager::newSimpleThreadManager(workerCount, pendingTaskCountMax);
+  }
+
   class Task: public Runnable {
 
   public:
@@ -108,7 +123,7 @@ public:
 
     size_t activeCount = count;
 
-    shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(workerCount);
+    shared_ptr<ThreadManager> threadManager = newThreadManager(workerCount);
 
     shared_ptr<PosixThreadFactory> threadFactory = shared_ptr<PosixThreadFactory>(new PosixThreadFactory());
 
@@ -200,10 +215,11 @@ public:
 
   public:
 
-    BlockTask(Monitor& monitor, Monitor& bmonitor, size_t& count) :
+    BlockTask(Monitor& monitor, Monitor& bmonitor, size_t& count, bool notifyEach=false) :
       _monitor(monitor),
       _bmonitor(bmonitor),
-      _count(count) {}
+      _count(count),
+      _notifyEach(notifyEach) {}
 
     void run() {
       {
@@ -218,7 +234,7 @@ public:
 
         _count--;
 
-        if (_count == 0) {
+        if (_count == 0 || _notifyEach) {
 
           _monitor.notify();
         }
@@ -228,6 +244,7 @@ public:
     Monitor& _monitor;
     Monitor& _bmonitor;
     size_t& _count;
+    bool _notifyEach;
   };
 
   /**
@@ -247,7 +264,7 @@ public:
 
       size_t activeCounts[] = {workerCount, pendingTaskMaxCount, 1};
 
-      shared_ptr<ThreadManager> threadManager = ThreadManager::newSimpleThreadManager(workerCount, pendingTaskMaxCount);
+      shared_ptr<ThreadManager> threadManager = newThreadManager(workerCount, pendingTaskMaxCount);
 
       shared_ptr<PosixThreadFactory> threadFactory = shared_ptr<PosixThreadFactory>(new PosixThreadFactory());
 
@@ -257,19 +274,21 @@ public:
 
       threadManager->start();
 
-      std::set<shared_ptr<ThreadManagerTests::BlockTask> > tasks;
+      // Added in the order they are made, so that with a FIFO manager the
+      // first workerCount are the ones that run
+      std::vector<shared_ptr<ThreadManagerTests::BlockTask> > tasks;
 
       for (size_t ix = 0; ix < workerCount; ix++) {
 
-        tasks.insert(shared_ptr<ThreadManagerTests::BlockTask>(new ThreadManagerTests::BlockTask(monitor, bmonitor,activeCounts[0])));
+        tasks.push_back(shared_ptr<ThreadManagerTests::BlockTask>(new ThreadManagerTests::BlockTask(monitor, bmonitor,activeCounts[0], _workStealing)));
       }
 
       for (size_t ix = 0; ix < pendingTaskMaxCount; ix++) {
 
-        tasks.insert(shared_ptr<ThreadManagerTests::BlockTask>(new ThreadManagerTests::BlockTask(monitor, bmonitor,activeCounts[1])));
+        tasks.push_back(shared_ptr<ThreadManagerTests::BlockTask>(new ThreadManagerTests::BlockTask(monitor, bmonitor,activeCounts[1], _workStealing)));
       }
 
-      for (std::set<shared_ptr<ThreadManagerTests::BlockTask> >::iterator ix = tasks.begin(); ix != tasks.end(); ix++) {
+      for (std::vector<shared_ptr<ThreadManagerTests::BlockTask> >::iterator ix = tasks.begin(); ix != tasks.end(); ix++) {
         threadManager->add(*ix);
       }
 
@@ -308,8 +327,18 @@ public:
       {
         Synchronized s(monitor);
 
-        while(activeCounts[0] != 0) {
-          monitor.wait();
+        if (_workStealing) {
+
+          // A work stealing manager doesn't start tasks in FIFO order, so
+          // any workerCount of the blocked tasks may have been running
+          while(activeCounts[0] + activeCounts[1] != pendingTaskMaxCount) {
+            monitor.wait();
+          }
+        } else {
+
+          while(activeCounts[0] != 0) {
+            monitor.wait();
+          }
         }
       }
 
@@ -337,8 +366,16 @@ public:
       {
         Synchronized s(monitor);
 
-        while(activeCounts[1] != 0) {
-          monitor.wait();
+        if (_workStealing) {
+
+          while(activeCounts[0] + activeCounts[1] != 0) {
+            monitor.wait();
+          }
+        } else {
+
+          while(activeCounts[1] != 0) {
+            monitor.wait();
+          }
         }
       }
 
@@ -369,6 +406,238 @@ public:
     std::cout << "\t\t\t" << (success ? "Success" : "Failure") << std::endl;
     return success;
  }
+
+  class CountTask: public Runnable {
+
+  public:
+
+    CountTask(Monitor& monitor, size_t& count) :
+      _monitor(monitor),
+      _count(count) {}
+
+    void run() {
+      Synchronized s(_monitor);
+
+      _count--;
+
+      if (_count == 0) {
+        _monitor.notify();
+      }
+    }
+
+    Monitor& _monitor;
+    size_t& _count;
+  };
+
+  class ExpireCounter {
+
+  public:
+
+    ExpireCounter(size_t& count) :
+      _count(count) {}
+
+    void operator()(shared_ptr<Runnable> runnable) {
+      assert(runnable != NULL);
+      _count++;
+    }
+
+    size_t& _count;
+  };
+
+  /**
+   * Expire test.  With the only worker blocked, queue tasks that expire
+   * after timeout milliseconds followed by tasks that don't.  Verify that
+   * removeExpiredTasks drops just the expiring tasks, that a task which
+   * expires while queued is dropped rather than run, and that the rest
+   * run. */
+
+  bool expireTest(int64_t timeout=10LL, size_t count=10) {
+
+    bool success = false;
+
+    try {
+
+      Monitor bmonitor;
+      Monitor monitor;
+
+      size_t blockCount = 1;
+      size_t runCount = count;
+      size_t expiredCount = 0;
+      size_t neverRunCount = 1;
+
+      shared_ptr<ThreadManager> threadManager = newThreadManager(1);
+
+      threadManager->threadFactory(shared_ptr<PosixThreadFactory>(new PosixThreadFactory()));
+
+      threadManager->setExpireCallback(ExpireCounter(expiredCount));
+
+      threadManager->start();
+
+      threadManager->add(shared_ptr<Runnable>(new BlockTask(monitor, bmonitor, blockCount)));
+
+      // Let the worker pick up the blocking task
+      while (threadManager->pendingTaskCount() != 0) {
+        usleep(1000);
+      }
+
+      for (size_t ix = 0; ix < count; ix++) {
+        threadManager->add(shared_ptr<Runnable>(new CountTask(monitor, neverRunCount)), 0, timeout);
+      }
+
+      for (size_t ix = 0; ix < count; ix++) {
+        threadManager->add(shared_ptr<Runnable>(new CountTask(monitor, runCount)));
+      }
+
+      usleep((timeout + 10) * 1000);
+
+      threadManager->removeExpiredTasks();
+
+      if (!(success = (expiredCount == count &&
+                       threadManager->expiredTaskCount() == count &&
+                       threadManager->pendingTaskCount() == count))) {
+        throw TException("Unexpected expired task count");
+      }
+
+      // This one expires in the queue, behind the tasks that don't
+      threadManager->add(shared_ptr<Runnable>(new CountTask(monitor, neverRunCount)), 0, timeout);
+
+      usleep((timeout + 10) * 1000);
+
+      {
+        Synchronized s(bmonitor);
+
+        bmonitor.notifyAll();
+      }
+
+      {
+        Synchronized s(monitor);
+
+        while (runCount != 0) {
+          monitor.wait();
+        }
+      }
+
+      threadManager->join();
+
+      if (!(success = (expiredCount == count + 1 &&
+                       threadManager->expiredTaskCount() == 1 &&
+                       neverRunCount == 1))) {
+        throw TException("Expired task was run");
+      }
+
+    } catch(TException& e) {
+      std::cout << "ERROR: " << e.what() << std::endl;
+    }
+
+    std::cout << "\t\t\t" << (success ? "Success" : "Failure") << std::endl;
+    return success;
+  }
+
+  class NoopTask: public Runnable {
+
+  public:
+
+    NoopTask(Monitor& monitor, size_t& count, size_t runCount) :
+      _monitor(monitor),
+      _count(count),
+      _runCount(runCount) {}
+
+    void run() {
+      if (__sync_sub_and_fetch(&_runCount, 1) == 0) {
+        Synchronized s(_monitor);
+
+        _count--;
+
+        if (_count == 0) {
+          _monitor.notify();
+        }
+      }
+    }
+
+    Monitor& _monitor;
+    size_t& _count;
+    volatile size_t _runCount;
+  };
+
+  class Producer: public Runnable {
+
+  public:
+
+    Producer(shared_ptr<ThreadManager> threadManager,
+             shared_ptr<Runnable> task,
+             size_t count) :
+      _threadManager(threadManager),
+      _task(task),
+      _count(count) {}
+
+    void run() {
+      for (size_t ix = 0; ix < _count; ix++) {
+        _threadManager->add(_task);
+      }
+    }
+
+    shared_ptr<ThreadManager> _threadManager;
+    shared_ptr<Runnable> _task;
+    size_t _count;
+  };
+
+  /**
+   * Throughput benchmark.  threadCount producer threads each add their own
+   * empty task count times to a thread manager with threadCount workers.
+   * Returns the number of tasks added and run per millisecond.
+   */
+  double throughputTest(size_t threadCount, size_t count) {
+
+    Monitor monitor;
+
+    size_t activeCount = threadCount;
+
+    shared_ptr<ThreadManager> threadManager = newThreadManager(threadCount);
+
+    shared_ptr<PosixThreadFactory> threadFactory = shared_ptr<PosixThreadFactory>(new PosixThreadFactory());
+
+    threadManager->threadFactory(threadFactory);
+
+    threadManager->start();
+
+    PosixThreadFactory producerFactory(PosixThreadFactory::ROUND_ROBIN, PosixThreadFactory::NORMAL, 1, false);
+
+    std::vector<shared_ptr<Thread> > producers;
+
+    for (size_t ix = 0; ix < threadCount; ix++) {
+      shared_ptr<Runnable> task(new NoopTask(monitor, activeCount, count));
+
+      producers.push_back(producerFactory.newThread(shared_ptr<Runnable>(new Producer(threadManager, task, count))));
+    }
+
+    int64_t time00 = Util::currentTime();
+
+    {
+      Synchronized s(monitor);
+
+      for (size_t ix = 0; ix < threadCount; ix++) {
+        producers[ix]->start();
+      }
+
+      while (activeCount != 0) {
+        monitor.wait();
+      }
+    }
+
+    int64_t time01 = Util::currentTime();
+
+    for (size_t ix = 0; ix < threadCount; ix++) {
+      producers[ix]->join();
+    }
+
+    threadManager->join();
+
+    return (double)(threadCount * count) / (time01 > time00 ? time01 - time00 : 1);
+  }
+
+ private:
+
+  bool _workStealing;
 };
 
 const double ThreadManagerTests::ERROR = .20;
@@ -18,6 +18,7 @@
  */
 
 #include <concurrency/TimerManager.h>
+#include <concurrency/TimerWheel.h>
 #include <concurrency/PosixThreadFactory.h>
 #include <concurrency/Monitor.h>
 #include <concurrency/Util.h>
@@ -92,13 +93,14 @@ class TimerManagerTests {
    * properly clean up itself and the remaining orphaned timeout task when the
    * manager goes out of scope and its destructor is called.
    */
+  template <class Manager>
   bool test00(int64_t timeout=1000LL) {
 
     shared_ptr<TimerManagerTests::Task> orphanTask = shared_ptr<TimerManagerTests::Task>(new TimerManagerTests::Task(_monitor, 10 * timeout));
 
     {
 
-      TimerManager timerManager;
+      Manager timerManager;
 
       timerManager.threadFactory(shared_ptr<PosixThreadFactory>(new PosixThreadFactory()));
 
@@ -144,6 +146,143 @@ class TimerManagerTests {
     return true;
   }
 
+  class CountTask: public Runnable {
+   public:
+
+    CountTask(Monitor& monitor) :
+      _monitor(monitor),
+      _count(0) {}
+
+    void run() {
+      Synchronized s(_monitor);
+      _count++;
+      _monitor.notifyAll();
+    }
+
+    Monitor& _monitor;
+    size_t _count;
+  };
+
+  /**
+   * This test schedules timers on a TimerWheel far enough out to be
+   * cascaded down from the upper levels, cancels some of them by handle and
+   * verifies that only the others run, and only once.
+   */
+  bool cancelTest(int64_t timeout=600LL) {
+
+    TimerWheel timerWheel;
+
+    timerWheel.threadFactory(shared_ptr<PosixThreadFactory>(new PosixThreadFactory()));
+
+    timerWheel.start();
+
+    shared_ptr<CountTask> kept(new CountTask(_monitor));
+    shared_ptr<CountTask> cancelled(new CountTask(_monitor));
+
+    TimerWheel::Handle keptHandle = timerWheel.schedule(kept, timeout);
+    timerWheel.schedule(kept, timeout / 2);
+    TimerWheel::Handle nearHandle = timerWheel.schedule(cancelled, timeout / 2);
+    TimerWheel::Handle farHandle = timerWheel.schedule(cancelled, 30 * timeout);
+
+    assert(timerWheel.taskCount() == 4);
+    assert(timerWheel.cancel(nearHandle));
+    assert(timerWheel.cancel(farHandle));
+    assert(!timerWheel.cancel(farHandle));
+    assert(timerWheel.taskCount() == 2);
+
+    int64_t startTime = Util::currentTime();
+
+    {
+      Synchronized s(_monitor);
+      while (kept->_count < 2) {
+        _monitor.wait();
+      }
+    }
+
+    int64_t elapsed = Util::currentTime() - startTime;
+
+    std::cout << "\t\t\tkept timers ran after " << elapsed << "ms" << std::endl;
+
+    assert(elapsed >= timeout - timerWheel.tickMillis());
+    assert(!timerWheel.cancel(keptHandle));
+    assert(timerWheel.taskCount() == 0);
+
+    // A node reused for a new timer can't be cancelled with the old handle
+    TimerWheel::Handle reusedHandle = timerWheel.schedule(cancelled, timeout);
+    assert(reusedHandle != nearHandle && reusedHandle != farHandle);
+    assert(!timerWheel.cancel(nearHandle));
+
+    timerWheel.remove(cancelled);
+    assert(timerWheel.taskCount() == 0);
+
+    try {
+      timerWheel.remove(cancelled);
+      assert(0 == "ERROR: removing a task twice should fail");
+    } catch (NoSuchTaskException&) {
+    }
+
+    assert(cancelled->_count == 0);
+
+    return true;
+  }
+
+  /**
+   * Adds count timers spread over a minute and returns the rate at which
+   * they were added, in timers per millisecond.  None of them fire.
+   */
+  template <class Manager>
+  double addBenchmark(size_t count) {
+
+    Manager timerManager;
+
+    timerManager.threadFactory(shared_ptr<PosixThreadFactory>(new PosixThreadFactory()));
+
+    timerManager.start();
+
+    shared_ptr<CountTask> task(new CountTask(_monitor));
+
+    int64_t startTime = Util::currentTime();
+
+    for (size_t ix = 0; ix < count; ix++) {
+      timerManager.add(task, 60000LL + (int64_t)((ix * 7919) % 60000));
+    }
+
+    int64_t elapsed = Util::currentTime() - startTime;
+
+    return (double)count / (elapsed > 0 ? elapsed : 1);
+  }
+
+  /**
+   * Schedules and cancels count timers, like a request timeout that
+   * usually doesn't fire, with pending timers in the wheel.  Returns
+   * timers per millisecond.
+   */
+  double cancelBenchmark(size_t count, size_t pending) {
+
+    TimerWheel timerWheel;
+
+    timerWheel.threadFactory(shared_ptr<PosixThreadFactory>(new PosixThreadFactory()));
+
+    timerWheel.start();
+
+    shared_ptr<CountTask> task(new CountTask(_monitor));
+
+    for (size_t ix = 0; ix < pending; ix++) {
+      timerWheel.add(task, 60000LL + (int64_t)((ix * 7919) % 60000));
+    }
+
+    int64_t startTime = Util::currentTime();
+
+    for (size_t ix = 0; ix < count; ix++) {
+      TimerWheel::Handle handle = timerWheel.schedule(task, 5000LL + (int64_t)(ix % 1000));
+      timerWheel.cancel(handle);
+    }
+
+    int64_t elapsed = Util::currentTime() - startTime;
+
+    return (double)count / (elapsed > 0 ? elapsed : 1);
+  }
+
   friend class TestTask;
 
   Monitor _monitor;
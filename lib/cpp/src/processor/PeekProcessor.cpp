@@ -59,6 +59,12 @@ void PeekProcessor::setTargetTransport(boost::shared_ptr<TTransport> targetTrans
 
 bool PeekProcessor::process(boost::shared_ptr<TProtocol> in,
                             boost::shared_ptr<TProtocol> out) {
+  return process(in, out, NULL);
+}
+
+bool PeekProcessor::process(boost::shared_ptr<TProtocol> in,
+                            boost::shared_ptr<TProtocol> out,
+                            TArena* arena) {
 
   std::string fname;
   TMessageType mtype;
@@ -100,7 +106,7 @@ bool PeekProcessor::process(boost::shared_ptr<TProtocol> in,
   // Done peeking at variables
   peekEnd();
 
-  bool ret = actualProcessor_->process(pipedProtocol_, out);
+  bool ret = actualProcessor_->process(pipedProtocol_, out, arena);
   memoryBuffer_->resetBuffer();
   return ret;
 }
@@ -55,6 +55,12 @@ class PeekProcessor : public apache::thrift::TProcessor {
   virtual bool process(boost::shared_ptr<apache::thrift::protocol::TProtocol> in,
                        boost::shared_ptr<apache::thrift::protocol::TProtocol> out);
 
+  // Peeks at the request as above, then hands the arena on to the
+  // underlying processor
+  virtual bool process(boost::shared_ptr<apache::thrift::protocol::TProtocol> in,
+                       boost::shared_ptr<apache::thrift::protocol::TProtocol> out,
+                       apache::thrift::TArena* arena);
+
   // The following three functions can be overloaded by child classes to
   // achieve desired peeking behavior
   virtual void peekName(const std::string& fname);
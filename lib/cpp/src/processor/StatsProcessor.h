@@ -86,6 +86,13 @@ public:
     return true;
   }
 
+  // Nothing is allocated per request here, so the arena isn't needed
+  virtual bool process(boost::shared_ptr<apache::thrift::protocol::TProtocol> piprot,
+                       boost::shared_ptr<apache::thrift::protocol::TProtocol> poprot,
+                       apache::thrift::TArena* /* arena */) {
+    return process(piprot, poprot);
+  }
+
   const std::map<std::string, int64_t>& get_frequency_map() {
     return frequency_map_;
   }
@@ -20,6 +20,11 @@
 #include "TBase64Utils.h"
 
 #include <boost/static_assert.hpp>
+#include <string.h>
+
+#ifdef __SSSE3__
+#include <tmmintrin.h>
+#endif
 
 using std::string;
 
@@ -75,5 +80,134 @@ void base64_decode(uint8_t *buf, uint32_t len) {
   }
 }
 
+#ifdef __SSSE3__
+
+// Encodes 12 bytes of in into 16 characters at buf. Reads 16 bytes of in.
+static inline void base64_encode_12(const uint8_t *in, uint8_t *buf) {
+  __m128i v = _mm_loadu_si128((const __m128i *)in);
+  // Spread each 3 bytes over 4, as (b1, b0, b2, b1) for each 32 bit lane
+  v = _mm_shuffle_epi8(v, _mm_set_epi8(10, 11, 9, 10, 7, 8, 6, 7,
+                                       4, 5, 3, 4, 1, 2, 0, 1));
+  // Move each 6 bit group to the bottom of its own byte
+  __m128i t0 = _mm_and_si128(v, _mm_set1_epi32(0x0fc0fc00));
+  __m128i t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+  __m128i t2 = _mm_and_si128(v, _mm_set1_epi32(0x003f03f0));
+  __m128i t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+  __m128i indices = _mm_or_si128(t1, t3);
+
+  // Map 0-25, 26-51, 52-61, 62 and 63 to the offsets that turn them into
+  // characters: reduced is 13 for 0-25, 1 for 26-51, and 1-12 above that
+  __m128i reduced = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+  __m128i upper = _mm_cmpgt_epi8(_mm_set1_epi8(26), indices);
+  reduced = _mm_or_si128(reduced, _mm_and_si128(upper, _mm_set1_epi8(13)));
+  const __m128i offsets = _mm_setr_epi8(
+      'a' - 26, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52, '0' - 52,
+      '0' - 52, '0' - 52, '0' - 52, '0' - 52, '+' - 62, '/' - 63, 'A', 0, 0);
+  __m128i out = _mm_add_epi8(indices, _mm_shuffle_epi8(offsets, reduced));
+  _mm_storeu_si128((__m128i *)buf, out);
+}
+
+// Decodes 16 characters at in into 12 bytes at out, writing 16 bytes of out.
+// Returns false, writing nothing, if any character is not base64.
+static inline bool base64_decode_16(const uint8_t *in, uint8_t *out) {
+  __m128i v = _mm_loadu_si128((const __m128i *)in);
+  __m128i hiNibbles = _mm_and_si128(_mm_srli_epi32(v, 4), _mm_set1_epi8(0x0f));
+  __m128i loNibbles = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+
+  // A character is valid when the bits for its high and low nibbles don't
+  // overlap
+  const __m128i loBits = _mm_setr_epi8(
+      0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11,
+      0x11, 0x11, 0x13, 0x1a, 0x1b, 0x1b, 0x1b, 0x1a);
+  const __m128i hiBits = _mm_setr_epi8(
+      0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08,
+      0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10);
+  __m128i lo = _mm_shuffle_epi8(loBits, loNibbles);
+  __m128i hi = _mm_shuffle_epi8(hiBits, hiNibbles);
+  if (_mm_movemask_epi8(_mm_cmpgt_epi8(_mm_and_si128(lo, hi),
+                                       _mm_setzero_si128()))) {
+    return false;
+  }
+
+  // Characters sharing a high nibble share an offset, except for '/'
+  const __m128i offsets = _mm_setr_epi8(
+      0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0);
+  __m128i isSlash = _mm_cmpeq_epi8(v, _mm_set1_epi8('/'));
+  __m128i values = _mm_add_epi8(
+      v, _mm_shuffle_epi8(offsets, _mm_add_epi8(isSlash, hiNibbles)));
+
+  // Pack 4 6 bit values into 3 bytes in each 32 bit lane, then the lanes
+  // together
+  __m128i merged = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+  merged = _mm_madd_epi16(merged, _mm_set1_epi32(0x00011000));
+  merged = _mm_shuffle_epi8(merged, _mm_setr_epi8(
+      2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1));
+  _mm_storeu_si128((__m128i *)out, merged);
+  return true;
+}
+
+#endif // __SSSE3__
+
+uint32_t base64_encode_block(const uint8_t *in, uint32_t len, uint8_t *buf) {
+  uint8_t *out = buf;
+#ifdef __SSSE3__
+  // Each step reads 16 bytes but only encodes 12
+  while (len >= 16) {
+    base64_encode_12(in, out);
+    in += 12;
+    out += 16;
+    len -= 12;
+  }
+#endif
+  while (len >= 3) {
+    base64_encode(in, 3, out);
+    in += 3;
+    out += 4;
+    len -= 3;
+  }
+  if (len) { // Handle remainder
+    base64_encode(in, len, out);
+    out += len + 1;
+  }
+  return out - buf;
+}
+
+uint32_t base64_decode_block(uint8_t *buf, uint32_t len) {
+  // Output never overtakes input, so this can be done in place
+  uint8_t *in = buf;
+  uint8_t *out = buf;
+#ifdef __SSSE3__
+  while (len >= 16) {
+    if (!base64_decode_16(in, out)) {
+      // Decode these the slow way, for the same result on bad input
+      for (int i = 0; i < 4; i++) {
+        base64_decode(in, 4);
+        memmove(out, in, 3);
+        in += 4;
+        out += 3;
+      }
+    }
+    else {
+      in += 16;
+      out += 12;
+    }
+    len -= 16;
+  }
+#endif
+  while (len >= 4) {
+    base64_decode(in, 4);
+    memmove(out, in, 3);
+    in += 4;
+    out += 3;
+    len -= 4;
+  }
+  // Don't decode a single leftover character (invalid base64)
+  if (len > 1) {
+    base64_decode(in, len);
+    memmove(out, in, len - 1);
+    out += len - 1;
+  }
+  return out - buf;
+}
 
 }}} // apache::thrift::protocol
@@ -37,6 +37,19 @@ void base64_encode(const uint8_t *in, uint32_t len, uint8_t *buf);
 // no '=' padding should be included in the input
 void base64_decode(uint8_t *buf, uint32_t len);
 
+// Encodes all len bytes of in, unpadded, into buf, which must have room
+// for (4 * len + 2) / 3 bytes. Returns the number of bytes written.
+// Output is the same as base64_encode() on each 3 bytes and the remainder,
+// but is produced 12 bytes at a time when SSSE3 is available.
+uint32_t base64_encode_block(const uint8_t *in, uint32_t len, uint8_t *buf);
+
+// Decodes len unpadded base64 characters in buf, in place, and returns the
+// number of bytes decoded. Output is the same as base64_decode() on each 4
+// characters and the remainder, including for invalid characters; a single
+// leftover character is ignored. Produced 16 characters at a time when SSSE3
+// is available.
+uint32_t base64_decode_block(uint8_t *buf, uint32_t len);
+
 }}} // apache::thrift::protocol
 
 #endif // #define _THRIFT_PROTOCOL_TBASE64UTILS_H_
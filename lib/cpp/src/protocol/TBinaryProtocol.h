@@ -21,6 +21,8 @@
 #define _THRIFT_PROTOCOL_TBINARYPROTOCOL_H_ 1
 
 #include "TProtocol.h"
+#include "TVirtualProtocol.h"
+#include <transport/TBufferTransports.h>
 
 #include <boost/shared_ptr.hpp>
 
@@ -30,42 +32,45 @@ namespace apache { namespace thrift { namespace protocol {
  * The default binary protocol for thrift. Writes all data in a very basic
  * binary format, essentially just spitting out the raw bytes.
  *
+ * The Transport_ parameter lets code that knows its transport type (e.g.
+ * TBinaryProtocolT<TMemoryBuffer>) call the transport's non-virtual,
+ * inlinable methods directly.  TBinaryProtocol works with any TTransport,
+ * and still reads straight out of the buffer of buffered, framed and memory
+ * transports (anything derived from TBufferBase), which it detects once, at
+ * construction.
  */
-class TBinaryProtocol : public TProtocol {
+template <class Transport_>
+class TBinaryProtocolT
+  : public TVirtualProtocol< TBinaryProtocolT<Transport_> > {
  protected:
   static const int32_t VERSION_MASK = 0xffff0000;
   static const int32_t VERSION_1 = 0x80010000;
   // VERSION_2 (0x80020000)  is taken by TDenseProtocol.
 
  public:
-  TBinaryProtocol(boost::shared_ptr<TTransport> trans) :
-    TProtocol(trans),
+  TBinaryProtocolT(boost::shared_ptr<Transport_> trans) :
+    TVirtualProtocol< TBinaryProtocolT<Transport_> >(trans),
+    trans_(trans.get()),
+    buffer_(dynamic_cast<transport::TBufferBase*>(trans.get())),
     string_limit_(0),
     container_limit_(0),
     strict_read_(false),
-    strict_write_(true),
-    string_buf_(NULL),
-    string_buf_size_(0) {}
-
-  TBinaryProtocol(boost::shared_ptr<TTransport> trans,
-                  int32_t string_limit,
-                  int32_t container_limit,
-                  bool strict_read,
-                  bool strict_write) :
-    TProtocol(trans),
+    strict_write_(true) {}
+
+  TBinaryProtocolT(boost::shared_ptr<Transport_> trans,
+                   int32_t string_limit,
+                   int32_t container_limit,
+                   bool strict_read,
+                   bool strict_write) :
+    TVirtualProtocol< TBinaryProtocolT<Transport_> >(trans),
+    trans_(trans.get()),
+    buffer_(dynamic_cast<transport::TBufferBase*>(trans.get())),
     string_limit_(string_limit),
     container_limit_(container_limit),
     strict_read_(strict_read),
-    strict_write_(strict_write),
-    string_buf_(NULL),
-    string_buf_size_(0) {}
-
-  ~TBinaryProtocol() {
-    if (string_buf_ != NULL) {
-      std::free(string_buf_);
-      string_buf_size_ = 0;
-    }
-  }
+    strict_write_(strict_write) {}
+
+  ~TBinaryProtocolT() {}
 
   void setStringSizeLimit(int32_t string_limit) {
     string_limit_ = string_limit;
@@ -84,11 +89,11 @@ class TBinaryProtocol : public TProtocol {
    * Writing functions.
    */
 
-  virtual uint32_t writeMessageBegin(const std::string& name,
-                                     const TMessageType messageType,
-                                     const int32_t seqid);
+  uint32_t writeMessageBegin(const std::string& name,
+                             const TMessageType messageType,
+                             const int32_t seqid);
 
-  virtual uint32_t writeMessageEnd();
+  uint32_t writeMessageEnd();
 
 
   uint32_t writeStructBegin(const char* name);
@@ -135,6 +140,20 @@ class TBinaryProtocol : public TProtocol {
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeString(const char* str, uint32_t len);
+
+  uint32_t writeBinary(const char* str, uint32_t len);
+
+  uint32_t writeByteArray(const int8_t* values, uint32_t size);
+
+  uint32_t writeI16Array(const int16_t* values, uint32_t size);
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t size);
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t size);
+
+  uint32_t writeDoubleArray(const double* values, uint32_t size);
+
   /**
    * Reading functions
    */
@@ -144,16 +163,26 @@ class TBinaryProtocol : public TProtocol {
                             TMessageType& messageType,
                             int32_t& seqid);
 
+  uint32_t readMessageBegin(const char*& name,
+                            uint32_t& nameLen,
+                            TMessageType& messageType,
+                            int32_t& seqid);
+
   uint32_t readMessageEnd();
 
   uint32_t readStructBegin(std::string& name);
 
+  uint32_t readStructBegin();
+
   uint32_t readStructEnd();
 
   uint32_t readFieldBegin(std::string& name,
                           TType& fieldType,
                           int16_t& fieldId);
 
+  uint32_t readFieldBegin(TType& fieldType,
+                          int16_t& fieldId);
+
   uint32_t readFieldEnd();
 
   uint32_t readMapBegin(TType& keyType,
@@ -173,6 +202,8 @@ class TBinaryProtocol : public TProtocol {
   uint32_t readSetEnd();
 
   uint32_t readBool(bool& value);
+  // Provide the default readBool() implementation for std::vector<bool>
+  using TVirtualProtocol< TBinaryProtocolT<Transport_> >::readBool;
 
   uint32_t readByte(int8_t& byte);
 
@@ -188,9 +219,72 @@ class TBinaryProtocol : public TProtocol {
 
   uint32_t readBinary(std::string& str);
 
+  uint32_t readString(const char*& str, uint32_t& len);
+
+  uint32_t readBinary(const char*& str, uint32_t& len);
+
+  uint32_t readByteArray(int8_t* values, uint32_t size);
+
+  uint32_t readI16Array(int16_t* values, uint32_t size);
+
+  uint32_t readI32Array(int32_t* values, uint32_t size);
+
+  uint32_t readI64Array(int64_t* values, uint32_t size);
+
+  uint32_t readDoubleArray(double* values, uint32_t size);
+
  protected:
+  // Number of values the array writers byte swap at a time
+  static const uint32_t ARRAY_CHUNK_SIZE = 512;
+
+  void checkArraySize(uint32_t size, uint32_t elemSize);
+
+  uint32_t writeName(const std::string& name);
+
   uint32_t readStringBody(std::string& str, int32_t sz);
 
+  uint32_t readStringBody(const char*& str, uint32_t& len, int32_t sz,
+                          uint32_t trailer, std::string& backing);
+
+  /**
+   * Returns the next len bytes of input: straight out of the transport's
+   * buffer if it has that many, and read into buf otherwise.
+   */
+  const uint8_t* readFixed(uint8_t* buf, uint32_t len) {
+    if (buffer_ != NULL) {
+      const uint8_t* borrowed = buffer_->borrowAndConsume(len);
+      if (borrowed != NULL) {
+        return borrowed;
+      }
+    }
+    trans_->readAll(buf, len);
+    return buf;
+  }
+
+  /**
+   * borrow() and consume() on the transport, without virtual calls when it
+   * is a TBufferBase.
+   */
+  const uint8_t* borrowInput(uint8_t* buf, uint32_t* len) {
+    if (buffer_ != NULL) {
+      return buffer_->borrow(buf, len);
+    }
+    return trans_->borrow(buf, len);
+  }
+
+  void consumeInput(uint32_t len) {
+    if (buffer_ != NULL) {
+      buffer_->consume(len);
+    } else {
+      trans_->consume(len);
+    }
+  }
+
+  Transport_* trans_;
+
+  // trans_ as a TBufferBase, or NULL if it isn't one
+  transport::TBufferBase* buffer_;
+
   int32_t string_limit_;
   int32_t container_limit_;
 
@@ -198,31 +292,30 @@ class TBinaryProtocol : public TProtocol {
   bool strict_read_;
   bool strict_write_;
 
-  // Buffer for reading strings, save for the lifetime of the protocol to
-  // avoid memory churn allocating memory on every string read
-  uint8_t* string_buf_;
-  int32_t string_buf_size_;
-
 };
 
+typedef TBinaryProtocolT<TTransport> TBinaryProtocol;
+
 /**
- * Constructs binary protocol handlers
+ * Constructs binary protocol handlers.  When the transport handed to
+ * getProtocol() is a Transport_, the protocol is specialized on it.
  */
-class TBinaryProtocolFactory : public TProtocolFactory {
+template <class Transport_>
+class TBinaryProtocolFactoryT : public TProtocolFactory {
  public:
-  TBinaryProtocolFactory() :
+  TBinaryProtocolFactoryT() :
     string_limit_(0),
     container_limit_(0),
     strict_read_(false),
     strict_write_(true) {}
 
-  TBinaryProtocolFactory(int32_t string_limit, int32_t container_limit, bool strict_read, bool strict_write) :
+  TBinaryProtocolFactoryT(int32_t string_limit, int32_t container_limit, bool strict_read, bool strict_write) :
     string_limit_(string_limit),
     container_limit_(container_limit),
     strict_read_(strict_read),
     strict_write_(strict_write) {}
 
-  virtual ~TBinaryProtocolFactory() {}
+  virtual ~TBinaryProtocolFactoryT() {}
 
   void setStringSizeLimit(int32_t string_limit) {
     string_limit_ = string_limit;
@@ -238,7 +331,15 @@ class TBinaryProtocolFactory : public TProtocolFactory {
   }
 
   boost::shared_ptr<TProtocol> getProtocol(boost::shared_ptr<TTransport> trans) {
-    return boost::shared_ptr<TProtocol>(new TBinaryProtocol(trans, string_limit_, container_limit_, strict_read_, strict_write_));
+    boost::shared_ptr<Transport_> specific_trans =
+      boost::dynamic_pointer_cast<Transport_>(trans);
+    TProtocol* prot;
+    if (specific_trans) {
+      prot = new TBinaryProtocolT<Transport_>(specific_trans, string_limit_, container_limit_, strict_read_, strict_write_);
+    } else {
+      prot = new TBinaryProtocol(trans, string_limit_, container_limit_, strict_read_, strict_write_);
+    }
+    return boost::shared_ptr<TProtocol>(prot);
   }
 
  private:
@@ -249,6 +350,10 @@ class TBinaryProtocolFactory : public TProtocolFactory {
 
 };
 
+typedef TBinaryProtocolFactoryT<TTransport> TBinaryProtocolFactory;
+
 }}} // apache::thrift::protocol
 
+#include "TBinaryProtocol.tcc"
+
 #endif // #ifndef _THRIFT_PROTOCOL_TBINARYPROTOCOL_H_
@@ -0,0 +1,703 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TBINARYPROTOCOL_TCC_
+#define _THRIFT_PROTOCOL_TBINARYPROTOCOL_TCC_ 1
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+
+namespace apache { namespace thrift { namespace protocol {
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeMessageBegin(const std::string& name,
+                                                         const TMessageType messageType,
+                                                         const int32_t seqid) {
+  if (strict_write_) {
+    int32_t version = (VERSION_1) | ((int32_t)messageType);
+    uint32_t wsize = 0;
+    wsize += writeI32(version);
+    wsize += writeName(name);
+    wsize += writeI32(seqid);
+    return wsize;
+  } else {
+    uint32_t wsize = 0;
+    wsize += writeName(name);
+    wsize += writeByte((int8_t)messageType);
+    wsize += writeI32(seqid);
+    return wsize;
+  }
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeMessageEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeStructBegin(const char* name) {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeStructEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeFieldBegin(const char* name,
+                                                       const TType fieldType,
+                                                       const int16_t fieldId) {
+  uint32_t wsize = 0;
+  wsize += writeByte((int8_t)fieldType);
+  wsize += writeI16(fieldId);
+  return wsize;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeFieldEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeFieldStop() {
+  return
+    writeByte((int8_t)T_STOP);
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeMapBegin(const TType keyType,
+                                                     const TType valType,
+                                                     const uint32_t size) {
+  uint32_t wsize = 0;
+  wsize += writeByte((int8_t)keyType);
+  wsize += writeByte((int8_t)valType);
+  wsize += writeI32((int32_t)size);
+  return wsize;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeMapEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeListBegin(const TType elemType,
+                                                      const uint32_t size) {
+  uint32_t wsize = 0;
+  wsize += writeByte((int8_t) elemType);
+  wsize += writeI32((int32_t)size);
+  return wsize;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeListEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeSetBegin(const TType elemType,
+                                                     const uint32_t size) {
+  uint32_t wsize = 0;
+  wsize += writeByte((int8_t)elemType);
+  wsize += writeI32((int32_t)size);
+  return wsize;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeSetEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeBool(const bool value) {
+  uint8_t tmp =  value ? 1 : 0;
+  trans_->write(&tmp, 1);
+  return 1;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeByte(const int8_t byte) {
+  trans_->write((uint8_t*)&byte, 1);
+  return 1;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeI16(const int16_t i16) {
+  int16_t net = (int16_t)htons(i16);
+  trans_->write((uint8_t*)&net, 2);
+  return 2;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeI32(const int32_t i32) {
+  int32_t net = (int32_t)htonl(i32);
+  trans_->write((uint8_t*)&net, 4);
+  return 4;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeI64(const int64_t i64) {
+  int64_t net = (int64_t)htonll(i64);
+  trans_->write((uint8_t*)&net, 8);
+  return 8;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeDouble(const double dub) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint64_t bits = bitwise_cast<uint64_t>(dub);
+  bits = htonll(bits);
+  trans_->write((uint8_t*)&bits, 8);
+  return 8;
+}
+
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeString(const std::string& str) {
+  return TBinaryProtocolT<Transport_>::writeString(str.data(), str.size());
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeBinary(const std::string& str) {
+  return TBinaryProtocolT<Transport_>::writeString(str.data(), str.size());
+}
+
+/**
+ * String and binary values are borrowed, so a transport may send them
+ * straight from the caller's memory when the message is flushed.
+ */
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeString(const char* str,
+                                                   uint32_t len) {
+  uint32_t result = writeI32((int32_t)len);
+  if (len > 0) {
+    trans_->writeBorrowed((const uint8_t*)str, len);
+  }
+  return result + len;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeBinary(const char* str,
+                                                   uint32_t len) {
+  return TBinaryProtocolT<Transport_>::writeString(str, len);
+}
+
+/**
+ * Message names are often temporaries that are gone before the flush, so
+ * unlike string values they are always copied.
+ */
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeName(const std::string& name) {
+  uint32_t len = name.size();
+  uint32_t result = writeI32((int32_t)len);
+  if (len > 0) {
+    trans_->write((const uint8_t*)name.data(), len);
+  }
+  return result + len;
+}
+
+/**
+ * The array writers byte swap a chunk of values at a time into a buffer on
+ * the stack, so the transport sees one write per chunk instead of one per
+ * value.  The swap loops are simple enough for the compiler to vectorize.
+ * The buffer is reused, so it goes through write(), which copies, and never
+ * writeBorrowed().
+ */
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeByteArray(const int8_t* values,
+                                                      uint32_t size) {
+  trans_->write((const uint8_t*)values, size);
+  return size;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeI16Array(const int16_t* values,
+                                                     uint32_t size) {
+  int16_t buf[ARRAY_CHUNK_SIZE];
+  for (uint32_t i = 0; i < size; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = std::min(size - i, (uint32_t)ARRAY_CHUNK_SIZE);
+    for (uint32_t j = 0; j < n; ++j) {
+      buf[j] = (int16_t)htons(values[i + j]);
+    }
+    trans_->write((uint8_t*)buf, n * 2);
+  }
+  return size * 2;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeI32Array(const int32_t* values,
+                                                     uint32_t size) {
+  int32_t buf[ARRAY_CHUNK_SIZE];
+  for (uint32_t i = 0; i < size; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = std::min(size - i, (uint32_t)ARRAY_CHUNK_SIZE);
+    for (uint32_t j = 0; j < n; ++j) {
+      buf[j] = (int32_t)htonl(values[i + j]);
+    }
+    trans_->write((uint8_t*)buf, n * 4);
+  }
+  return size * 4;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeI64Array(const int64_t* values,
+                                                     uint32_t size) {
+  int64_t buf[ARRAY_CHUNK_SIZE];
+  for (uint32_t i = 0; i < size; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = std::min(size - i, (uint32_t)ARRAY_CHUNK_SIZE);
+    for (uint32_t j = 0; j < n; ++j) {
+      buf[j] = (int64_t)htonll(values[i + j]);
+    }
+    trans_->write((uint8_t*)buf, n * 8);
+  }
+  return size * 8;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::writeDoubleArray(const double* values,
+                                                        uint32_t size) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint64_t buf[ARRAY_CHUNK_SIZE];
+  for (uint32_t i = 0; i < size; i += ARRAY_CHUNK_SIZE) {
+    uint32_t n = std::min(size - i, (uint32_t)ARRAY_CHUNK_SIZE);
+    for (uint32_t j = 0; j < n; ++j) {
+      buf[j] = htonll(bitwise_cast<uint64_t>(values[i + j]));
+    }
+    trans_->write((uint8_t*)buf, n * 8);
+  }
+  return size * 8;
+}
+
+/**
+ * Reading functions
+ */
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readMessageBegin(std::string& name,
+                                                        TMessageType& messageType,
+                                                        int32_t& seqid) {
+  const char* nameBuf;
+  uint32_t nameLen;
+  uint32_t result = readMessageBegin(nameBuf, nameLen, messageType, seqid);
+  name.assign(nameBuf, nameLen);
+  return result;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readMessageBegin(const char*& name,
+                                                        uint32_t& nameLen,
+                                                        TMessageType& messageType,
+                                                        int32_t& seqid) {
+  uint32_t result = 0;
+  int32_t sz;
+  result += readI32(sz);
+
+  if (sz < 0) {
+    // Check for correct version number
+    int32_t version = sz & VERSION_MASK;
+    if (version != VERSION_1) {
+      throw TProtocolException(TProtocolException::BAD_VERSION, "Bad version identifier");
+    }
+    messageType = (TMessageType)(sz & 0x000000ff);
+    int32_t nameSize;
+    result += readI32(nameSize);
+    // The name is followed by the 4 byte seqid
+    result += readStringBody(name, nameLen, nameSize, 4, this->messageName_);
+    result += readI32(seqid);
+  } else {
+    if (strict_read_) {
+      throw TProtocolException(TProtocolException::BAD_VERSION, "No version identifier... old protocol client in strict mode?");
+    } else {
+      // Handle pre-versioned input.  The name is followed by the 1 byte
+      // type and the 4 byte seqid.
+      int8_t type;
+      result += readStringBody(name, nameLen, sz, 5, this->messageName_);
+      result += readByte(type);
+      messageType = (TMessageType)type;
+      result += readI32(seqid);
+    }
+  }
+  return result;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readMessageEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readStructBegin(std::string& name) {
+  name = "";
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readStructBegin() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readStructEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readFieldBegin(std::string& /* name */,
+                                                      TType& fieldType,
+                                                      int16_t& fieldId) {
+  return readFieldBegin(fieldType, fieldId);
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readFieldBegin(TType& fieldType,
+                                                      int16_t& fieldId) {
+  uint32_t result = 0;
+  int8_t type;
+  result += readByte(type);
+  fieldType = (TType)type;
+  if (fieldType == T_STOP) {
+    fieldId = 0;
+    return result;
+  }
+  result += readI16(fieldId);
+  return result;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readFieldEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readMapBegin(TType& keyType,
+                                                    TType& valType,
+                                                    uint32_t& size) {
+  int8_t k, v;
+  uint32_t result = 0;
+  int32_t sizei;
+  result += readByte(k);
+  keyType = (TType)k;
+  result += readByte(v);
+  valType = (TType)v;
+  result += readI32(sizei);
+  if (sizei < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  } else if (container_limit_ && sizei > container_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  size = (uint32_t)sizei;
+  return result;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readMapEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readListBegin(TType& elemType,
+                                                     uint32_t& size) {
+  int8_t e;
+  uint32_t result = 0;
+  int32_t sizei;
+  result += readByte(e);
+  elemType = (TType)e;
+  result += readI32(sizei);
+  if (sizei < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  } else if (container_limit_ && sizei > container_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  size = (uint32_t)sizei;
+  return result;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readListEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readSetBegin(TType& elemType,
+                                                    uint32_t& size) {
+  int8_t e;
+  uint32_t result = 0;
+  int32_t sizei;
+  result += readByte(e);
+  elemType = (TType)e;
+  result += readI32(sizei);
+  if (sizei < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  } else if (container_limit_ && sizei > container_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  size = (uint32_t)sizei;
+  return result;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readSetEnd() {
+  return 0;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readBool(bool& value) {
+  uint8_t buf[1];
+  const uint8_t* b = readFixed(buf, 1);
+  value = *(int8_t*)b != 0;
+  return 1;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readByte(int8_t& byte) {
+  uint8_t buf[1];
+  const uint8_t* b = readFixed(buf, 1);
+  byte = *(int8_t*)b;
+  return 1;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readI16(int16_t& i16) {
+  uint8_t buf[2];
+  const uint8_t* b = readFixed(buf, 2);
+  memcpy(&i16, b, 2);
+  i16 = (int16_t)ntohs(i16);
+  return 2;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readI32(int32_t& i32) {
+  uint8_t buf[4];
+  const uint8_t* b = readFixed(buf, 4);
+  memcpy(&i32, b, 4);
+  i32 = (int32_t)ntohl(i32);
+  return 4;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readI64(int64_t& i64) {
+  uint8_t buf[8];
+  const uint8_t* b = readFixed(buf, 8);
+  memcpy(&i64, b, 8);
+  i64 = (int64_t)ntohll(i64);
+  return 8;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readDouble(double& dub) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint64_t bits;
+  uint8_t buf[8];
+  const uint8_t* b = readFixed(buf, 8);
+  memcpy(&bits, b, 8);
+  bits = ntohll(bits);
+  dub = bitwise_cast<double>(bits);
+  return 8;
+}
+
+/**
+ * The array readers read the whole array straight into place with a single
+ * readAll() and then byte swap it in place.
+ */
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readByteArray(int8_t* values,
+                                                     uint32_t size) {
+  trans_->readAll((uint8_t*)values, size);
+  return size;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readI16Array(int16_t* values,
+                                                    uint32_t size) {
+  checkArraySize(size, 2);
+  trans_->readAll((uint8_t*)values, size * 2);
+  for (uint32_t i = 0; i < size; ++i) {
+    values[i] = (int16_t)ntohs(values[i]);
+  }
+  return size * 2;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readI32Array(int32_t* values,
+                                                    uint32_t size) {
+  checkArraySize(size, 4);
+  trans_->readAll((uint8_t*)values, size * 4);
+  for (uint32_t i = 0; i < size; ++i) {
+    values[i] = (int32_t)ntohl(values[i]);
+  }
+  return size * 4;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readI64Array(int64_t* values,
+                                                    uint32_t size) {
+  checkArraySize(size, 8);
+  trans_->readAll((uint8_t*)values, size * 8);
+  for (uint32_t i = 0; i < size; ++i) {
+    values[i] = (int64_t)ntohll(values[i]);
+  }
+  return size * 8;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readDoubleArray(double* values,
+                                                       uint32_t size) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  checkArraySize(size, 8);
+  trans_->readAll((uint8_t*)values, size * 8);
+  for (uint32_t i = 0; i < size; ++i) {
+    // Swap the bits without ever holding them in a double
+    uint64_t bits;
+    memcpy(&bits, &values[i], 8);
+    bits = ntohll(bits);
+    memcpy(&values[i], &bits, 8);
+  }
+  return size * 8;
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readString(std::string& str) {
+  uint32_t result;
+  int32_t size;
+  result = readI32(size);
+  return result + readStringBody(str, size);
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readBinary(std::string& str) {
+  return TBinaryProtocolT<Transport_>::readString(str);
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readString(const char*& str,
+                                                  uint32_t& len) {
+  uint32_t result;
+  int32_t size;
+  result = readI32(size);
+  return result + readStringBody(str, len, size, 0, this->stringBuf_);
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readBinary(const char*& str,
+                                                  uint32_t& len) {
+  return TBinaryProtocolT<Transport_>::readString(str, len);
+}
+
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readStringBody(std::string& str, int32_t size) {
+  uint32_t result = 0;
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  // Catch empty string case
+  if (size == 0) {
+    str = "";
+    return result;
+  }
+
+  // Try to borrow first.  Memory and buffered transports can hand out the
+  // bytes in place, so the string is built with a single copy.
+  uint32_t got = size;
+  const uint8_t* borrow_buf = borrowInput(NULL, &got);
+  if (borrow_buf) {
+    str.assign((const char*)borrow_buf, size);
+    consumeInput(size);
+    return (uint32_t)size;
+  }
+
+  // Otherwise read straight into the string's own storage.
+  str.resize(size);
+  trans_->readAll(reinterpret_cast<uint8_t*>(&str[0]), size);
+  return (uint32_t)size;
+}
+
+/**
+ * Reads a string of sz bytes and returns it as a view.  trailer is the
+ * number of bytes that are read after the string before the view is used
+ * (the rest of the header, for a message name); if the transport can lend
+ * out the string and the trailer together, reading the trailer can't
+ * disturb the buffer the view points into.  Otherwise the string is copied
+ * into backing.
+ */
+template <class Transport_>
+uint32_t TBinaryProtocolT<Transport_>::readStringBody(const char*& str,
+                                                      uint32_t& len,
+                                                      int32_t size,
+                                                      uint32_t trailer,
+                                                      std::string& backing) {
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  len = (uint32_t)size;
+  if (size == 0) {
+    str = "";
+    return 0;
+  }
+
+  uint32_t got = len + trailer;
+  const uint8_t* borrow_buf = borrowInput(NULL, &got);
+  if (borrow_buf) {
+    str = (const char*)borrow_buf;
+    consumeInput(len);
+    return len;
+  }
+
+  backing.resize(len);
+  trans_->readAll(reinterpret_cast<uint8_t*>(&backing[0]), len);
+  str = backing.data();
+  return len;
+}
+
+/**
+ * Makes sure an array of size elements of elemSize bytes each can be sized
+ * in a uint32_t.  Sizes come off the wire, so this can only fail for
+ * garbage input.
+ */
+template <class Transport_>
+void TBinaryProtocolT<Transport_>::checkArraySize(uint32_t size,
+                                                  uint32_t elemSize) {
+  if (size > std::numeric_limits<uint32_t>::max() / elemSize) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+}
+
+}}} // apache::thrift::protocol
+
+#endif // #ifndef _THRIFT_PROTOCOL_TBINARYPROTOCOL_TCC_
@@ -21,6 +21,8 @@
 #define _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_H_ 1
 
 #include "TProtocol.h"
+#include "TVirtualProtocol.h"
+#include <transport/TBufferTransports.h>
 
 #include <stack>
 #include <boost/shared_ptr.hpp>
@@ -29,8 +31,13 @@ namespace apache { namespace thrift { namespace protocol {
 
 /**
  * C++ Implementation of the Compact Protocol as described in THRIFT-110
+ *
+ * Like TBinaryProtocolT, it reads straight out of the buffer of transports
+ * derived from TBufferBase, even when it only knows them as a TTransport.
  */
-class TCompactProtocol : public TProtocol {
+template <class Transport_>
+class TCompactProtocolT
+  : public TVirtualProtocol< TCompactProtocolT<Transport_> > {
 
  protected:
   static const int8_t  PROTOCOL_ID = 0x82;
@@ -39,6 +46,11 @@ class TCompactProtocol : public TProtocol {
   static const int8_t  TYPE_MASK = 0xE0; // 1110 0000
   static const int32_t TYPE_SHIFT_AMOUNT = 5;
 
+  Transport_* trans_;
+
+  // trans_ as a TBufferBase, or NULL if it isn't one
+  transport::TBufferBase* buffer_;
+
   /**
    * (Writing) If we encounter a boolean field begin, save the TField here
    * so it can have the value incorporated.
@@ -85,42 +97,40 @@ class TCompactProtocol : public TProtocol {
   static const int8_t TTypeToCType[16];
 
  public:
-  TCompactProtocol(boost::shared_ptr<TTransport> trans) :
-    TProtocol(trans),
+  TCompactProtocolT(boost::shared_ptr<Transport_> trans) :
+    TVirtualProtocol< TCompactProtocolT<Transport_> >(trans),
+    trans_(trans.get()),
+    buffer_(dynamic_cast<transport::TBufferBase*>(trans.get())),
     lastFieldId_(0),
     string_limit_(0),
-    string_buf_(NULL),
-    string_buf_size_(0),
     container_limit_(0) {
     booleanField_.name = NULL;
     boolValue_.hasBoolValue = false;
   }
 
-  TCompactProtocol(boost::shared_ptr<TTransport> trans,
-                   int32_t string_limit,
-                   int32_t container_limit) :
-    TProtocol(trans),
+  TCompactProtocolT(boost::shared_ptr<Transport_> trans,
+                    int32_t string_limit,
+                    int32_t container_limit) :
+    TVirtualProtocol< TCompactProtocolT<Transport_> >(trans),
+    trans_(trans.get()),
+    buffer_(dynamic_cast<transport::TBufferBase*>(trans.get())),
     lastFieldId_(0),
     string_limit_(string_limit),
-    string_buf_(NULL),
-    string_buf_size_(0),
     container_limit_(container_limit) {
     booleanField_.name = NULL;
     boolValue_.hasBoolValue = false;
   }
 
-  ~TCompactProtocol() {
-    free(string_buf_);
-  }
+  ~TCompactProtocolT() {}
 
 
   /**
    * Writing functions
    */
 
-  virtual uint32_t writeMessageBegin(const std::string& name,
-                                     const TMessageType messageType,
-                                     const int32_t seqid);
+  uint32_t writeMessageBegin(const std::string& name,
+                             const TMessageType messageType,
+                             const int32_t seqid);
 
   uint32_t writeStructBegin(const char* name);
 
@@ -138,9 +148,9 @@ class TCompactProtocol : public TProtocol {
   uint32_t writeSetBegin(const TType elemType,
                          const uint32_t size);
 
-  virtual uint32_t writeMapBegin(const TType keyType,
-                                 const TType valType,
-                                 const uint32_t size);
+  uint32_t writeMapBegin(const TType keyType,
+                         const TType valType,
+                         const uint32_t size);
 
   uint32_t writeBool(const bool value);
 
@@ -158,11 +168,23 @@ class TCompactProtocol : public TProtocol {
 
   uint32_t writeBinary(const std::string& str);
 
+  uint32_t writeString(const char* str, uint32_t len);
+
+  uint32_t writeBinary(const char* str, uint32_t len);
+
+  uint32_t writeByteArray(const int8_t* values, uint32_t size);
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t size);
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t size);
+
+  uint32_t writeDoubleArray(const double* values, uint32_t size);
+
   /**
   * These methods are called by structs, but don't actually have any wired
   * output or purpose
   */
-  virtual uint32_t writeMessageEnd() { return 0; }
+  uint32_t writeMessageEnd() { return 0; }
   uint32_t writeMapEnd() { return 0; }
   uint32_t writeListEnd() { return 0; }
   uint32_t writeSetEnd() { return 0; }
@@ -174,8 +196,11 @@ class TCompactProtocol : public TProtocol {
                                   const int16_t fieldId,
                                   int8_t typeOverride);
   uint32_t writeCollectionBegin(int8_t elemType, int32_t size);
+  uint32_t writeName(const std::string& name);
   uint32_t writeVarint32(uint32_t n);
   uint32_t writeVarint64(uint64_t n);
+  static uint32_t encodeVarint32(uint32_t n, uint8_t* buf);
+  static uint32_t encodeVarint64(uint64_t n, uint8_t* buf);
   uint64_t i64ToZigzag(const int64_t l);
   uint32_t i32ToZigzag(const int32_t n);
   inline int8_t getCompactType(int8_t ttype);
@@ -185,14 +210,24 @@ class TCompactProtocol : public TProtocol {
                             TMessageType& messageType,
                             int32_t& seqid);
 
+  uint32_t readMessageBegin(const char*& name,
+                            uint32_t& nameLen,
+                            TMessageType& messageType,
+                            int32_t& seqid);
+
   uint32_t readStructBegin(std::string& name);
 
+  uint32_t readStructBegin();
+
   uint32_t readStructEnd();
 
   uint32_t readFieldBegin(std::string& name,
                           TType& fieldType,
                           int16_t& fieldId);
 
+  uint32_t readFieldBegin(TType& fieldType,
+                          int16_t& fieldId);
+
   uint32_t readMapBegin(TType& keyType,
                         TType& valType,
                         uint32_t& size);
@@ -204,6 +239,8 @@ class TCompactProtocol : public TProtocol {
                         uint32_t& size);
 
   uint32_t readBool(bool& value);
+  // Provide the default readBool() implementation for std::vector<bool>
+  using TVirtualProtocol< TCompactProtocolT<Transport_> >::readBool;
 
   uint32_t readByte(int8_t& byte);
 
@@ -219,6 +256,18 @@ class TCompactProtocol : public TProtocol {
 
   uint32_t readBinary(std::string& str);
 
+  uint32_t readString(const char*& str, uint32_t& len);
+
+  uint32_t readBinary(const char*& str, uint32_t& len);
+
+  uint32_t readByteArray(int8_t* values, uint32_t size);
+
+  uint32_t readI32Array(int32_t* values, uint32_t size);
+
+  uint32_t readI64Array(int64_t* values, uint32_t size);
+
+  uint32_t readDoubleArray(double* values, uint32_t size);
+
   /*
    *These methods are here for the struct to call, but don't have any wire
    * encoding.
@@ -232,32 +281,67 @@ class TCompactProtocol : public TProtocol {
  protected:
   uint32_t readVarint32(int32_t& i32);
   uint32_t readVarint64(int64_t& i64);
+  static uint32_t decodeVarint64(const uint8_t* buf, uint32_t len, uint64_t& val);
+
+  /**
+   * Returns the next len bytes of input: straight out of the transport's
+   * buffer if it has that many, and read into buf otherwise.
+   */
+  const uint8_t* readFixed(uint8_t* buf, uint32_t len) {
+    if (buffer_ != NULL) {
+      const uint8_t* borrowed = buffer_->borrowAndConsume(len);
+      if (borrowed != NULL) {
+        return borrowed;
+      }
+    }
+    trans_->readAll(buf, len);
+    return buf;
+  }
+
+  /**
+   * borrow() and consume() on the transport, without virtual calls when it
+   * is a TBufferBase.
+   */
+  const uint8_t* borrowInput(uint8_t* buf, uint32_t* len) {
+    if (buffer_ != NULL) {
+      return buffer_->borrow(buf, len);
+    }
+    return trans_->borrow(buf, len);
+  }
+
+  void consumeInput(uint32_t len) {
+    if (buffer_ != NULL) {
+      buffer_->consume(len);
+    } else {
+      trans_->consume(len);
+    }
+  }
   int32_t zigzagToI32(uint32_t n);
   int64_t zigzagToI64(uint64_t n);
   TType getTType(int8_t type);
 
-  // Buffer for reading strings, save for the lifetime of the protocol to
-  // avoid memory churn allocating memory on every string read
   int32_t string_limit_;
-  uint8_t* string_buf_;
-  int32_t string_buf_size_;
   int32_t container_limit_;
 };
 
+typedef TCompactProtocolT<TTransport> TCompactProtocol;
+
 /**
- * Constructs compact protocol handlers
+ * Constructs compact protocol handlers.  When the transport handed to
+ * getProtocol() is a Transport_, the protocol is specialized on it.
  */
-class TCompactProtocolFactory : public TProtocolFactory {
+template <class Transport_>
+class TCompactProtocolFactoryT : public TProtocolFactory {
  public:
-  TCompactProtocolFactory() :
+  TCompactProtocolFactoryT() :
     string_limit_(0),
     container_limit_(0) {}
 
-  TCompactProtocolFactory(int32_t string_limit, int32_t container_limit) :
+  TCompactProtocolFactoryT(int32_t string_limit, int32_t container_limit) :
     string_limit_(string_limit),
     container_limit_(container_limit) {}
 
-  virtual ~TCompactProtocolFactory() {}
+  virtual ~TCompactProtocolFactoryT() {}
 
   void setStringSizeLimit(int32_t string_limit) {
     string_limit_ = string_limit;
@@ -268,7 +352,15 @@ class TCompactProtocolFactory : public TProtocolFactory {
   }
 
   boost::shared_ptr<TProtocol> getProtocol(boost::shared_ptr<TTransport> trans) {
-    return boost::shared_ptr<TProtocol>(new TCompactProtocol(trans, string_limit_, container_limit_));
+    boost::shared_ptr<Transport_> specific_trans =
+      boost::dynamic_pointer_cast<Transport_>(trans);
+    TProtocol* prot;
+    if (specific_trans) {
+      prot = new TCompactProtocolT<Transport_>(specific_trans, string_limit_, container_limit_);
+    } else {
+      prot = new TCompactProtocol(trans, string_limit_, container_limit_);
+    }
+    return boost::shared_ptr<TProtocol>(prot);
   }
 
  private:
@@ -277,6 +369,10 @@ class TCompactProtocolFactory : public TProtocolFactory {
 
 };
 
+typedef TCompactProtocolFactoryT<TTransport> TCompactProtocolFactory;
+
 }}} // apache::thrift::protocol
 
+#include "TCompactProtocol.tcc"
+
 #endif
@@ -0,0 +1,1174 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_
+#define _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_ 1
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+
+#ifdef __GNUC__
+#define UNLIKELY(val) (__builtin_expect((val), 0))
+#else
+#define UNLIKELY(val) (val)
+#endif
+
+namespace apache { namespace thrift { namespace protocol {
+
+template <class Transport_>
+const int8_t TCompactProtocolT<Transport_>::TTypeToCType[16] = {
+    CT_STOP, // T_STOP
+    0, // unused
+    CT_BOOLEAN_TRUE, // T_BOOL
+    CT_BYTE, // T_BYTE
+    CT_DOUBLE, // T_DOUBLE
+    0, // unused
+    CT_I16, // T_I16
+    0, // unused
+    CT_I32, // T_I32
+    0, // unused
+    CT_I64, // T_I64
+    CT_BINARY, // T_STRING
+    CT_STRUCT, // T_STRUCT
+    CT_MAP, // T_MAP
+    CT_SET, // T_SET
+    CT_LIST, // T_LIST
+  };
+
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeMessageBegin(const std::string& name,
+                                                          const TMessageType messageType,
+                                                          const int32_t seqid) {
+  uint32_t wsize = 0;
+  wsize += writeByte(PROTOCOL_ID);
+  wsize += writeByte((VERSION_N & VERSION_MASK) | (((int32_t)messageType << TYPE_SHIFT_AMOUNT) & TYPE_MASK));
+  wsize += writeVarint32(seqid);
+  wsize += writeName(name);
+  return wsize;
+}
+
+/**
+ * Write a field header containing the field id and field type. If the
+ * difference between the current field id and the last one is small (< 15),
+ * then the field id will be encoded in the 4 MSB as a delta. Otherwise, the
+ * field id will follow the type header as a zigzag varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeFieldBegin(const char* name,
+                                                        const TType fieldType,
+                                                        const int16_t fieldId) {
+  if (fieldType == T_BOOL) {
+    booleanField_.name = name;
+    booleanField_.fieldType = fieldType;
+    booleanField_.fieldId = fieldId;
+  } else {
+    return writeFieldBeginInternal(name, fieldType, fieldId, -1);
+  }
+  return 0;
+}
+
+/**
+ * Write the STOP symbol so we know there are no more fields in this struct.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeFieldStop() {
+  return writeByte(T_STOP);
+}
+
+/**
+ * Write a struct begin. This doesn't actually put anything on the wire. We
+ * use it as an opportunity to put special placeholder markers on the field
+ * stack so we can get the field id deltas correct.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeStructBegin(const char* name) {
+  lastField_.push(lastFieldId_);
+  lastFieldId_ = 0;
+  return 0;
+}
+
+/**
+ * Write a struct end. This doesn't actually put anything on the wire. We use
+ * this as an opportunity to pop the last field from the current struct off
+ * of the field stack.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeStructEnd() {
+  lastFieldId_ = lastField_.top();
+  lastField_.pop();
+  return 0;
+}
+
+/**
+ * Write a List header.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeListBegin(const TType elemType,
+                                                       const uint32_t size) {
+  return writeCollectionBegin(elemType, size);
+}
+
+/**
+ * Write a set header.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeSetBegin(const TType elemType,
+                                                      const uint32_t size) {
+  return writeCollectionBegin(elemType, size);
+}
+
+/**
+ * Write a map header. If the map is empty, omit the key and value type
+ * headers, as we don't need any additional information to skip it.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeMapBegin(const TType keyType,
+                                                      const TType valType,
+                                                      const uint32_t size) {
+  uint32_t wsize = 0;
+
+  if (size == 0) {
+    wsize += writeByte(0);
+  } else {
+    wsize += writeVarint32(size);
+    wsize += writeByte(getCompactType(keyType) << 4 | getCompactType(valType));
+  }
+  return wsize;
+}
+
+/**
+ * Write a boolean value. Potentially, this could be a boolean field, in
+ * which case the field header info isn't written yet. If so, decide what the
+ * right type header is for the value and then write the field header.
+ * Otherwise, write a single byte.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBool(const bool value) {
+  uint32_t wsize = 0;
+
+  if (booleanField_.name != NULL) {
+    // we haven't written the field header yet
+    wsize += writeFieldBeginInternal(booleanField_.name,
+                                     booleanField_.fieldType,
+                                     booleanField_.fieldId,
+                                     value ? CT_BOOLEAN_TRUE : CT_BOOLEAN_FALSE);
+    booleanField_.name = NULL;
+  } else {
+    // we're not part of a field, so just write the value
+    wsize += writeByte(value ? CT_BOOLEAN_TRUE : CT_BOOLEAN_FALSE);
+  }
+  return wsize;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeByte(const int8_t byte) {
+  trans_->write((uint8_t*)&byte, 1);
+  return 1;
+}
+
+/**
+ * Write an i16 as a zigzag varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI16(const int16_t i16) {
+  return writeVarint32(i32ToZigzag(i16));
+}
+
+/**
+ * Write an i32 as a zigzag varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI32(const int32_t i32) {
+  return writeVarint32(i32ToZigzag(i32));
+}
+
+/**
+ * Write an i64 as a zigzag varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI64(const int64_t i64) {
+  return writeVarint64(i64ToZigzag(i64));
+}
+
+/**
+ * Write a double to the wire as 8 bytes.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeDouble(const double dub) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint64_t bits = bitwise_cast<uint64_t>(dub);
+  bits = htolell(bits);
+  trans_->write((uint8_t*)&bits, 8);
+  return 8;
+}
+
+/**
+ * Write a string to the wire with a varint size preceeding.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeString(const std::string& str) {
+  return writeBinary(str);
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinary(const std::string& str) {
+  return writeBinary(str.data(), str.size());
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeString(const char* str,
+                                                    uint32_t len) {
+  return writeBinary(str, len);
+}
+
+/**
+ * The bytes are borrowed, so a transport may send them straight from the
+ * caller's memory when the message is flushed.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeBinary(const char* str,
+                                                    uint32_t len) {
+  uint32_t wsize = writeVarint32(len) + len;
+  trans_->writeBorrowed((const uint8_t*)str, len);
+  return wsize;
+}
+
+/**
+ * Message names are often temporaries that are gone before the flush, so
+ * unlike string values they are always copied.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeName(const std::string& name) {
+  uint32_t wsize = writeVarint32(name.size()) + name.size();
+  trans_->write((const uint8_t*)name.data(), name.size());
+  return wsize;
+}
+
+/**
+ * Write a run of bytes, which go on the wire as they are.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeByteArray(const int8_t* values,
+                                                       uint32_t size) {
+  trans_->write((const uint8_t*)values, size);
+  return size;
+}
+
+/**
+ * Write a run of i32s as zigzag varints.  They are encoded into a buffer on
+ * the stack and handed to the transport a few hundred at a time, rather
+ * than with a transport write each.  The buffer is reused, so it goes
+ * through write(), which copies, and never writeBorrowed().
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI32Array(const int32_t* values,
+                                                      uint32_t size) {
+  uint8_t buf[512];
+  uint32_t wsize = 0;
+  uint32_t pos = 0;
+  for (uint32_t i = 0; i < size; ++i) {
+    if (pos > sizeof(buf) - 5) {
+      trans_->write(buf, pos);
+      wsize += pos;
+      pos = 0;
+    }
+    pos += encodeVarint32(i32ToZigzag(values[i]), buf + pos);
+  }
+  trans_->write(buf, pos);
+  return wsize + pos;
+}
+
+/**
+ * Write a run of i64s as zigzag varints, the same way as writeI32Array().
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeI64Array(const int64_t* values,
+                                                      uint32_t size) {
+  uint8_t buf[512];
+  uint32_t wsize = 0;
+  uint32_t pos = 0;
+  for (uint32_t i = 0; i < size; ++i) {
+    if (pos > sizeof(buf) - 10) {
+      trans_->write(buf, pos);
+      wsize += pos;
+      pos = 0;
+    }
+    pos += encodeVarint64(i64ToZigzag(values[i]), buf + pos);
+  }
+  trans_->write(buf, pos);
+  return wsize + pos;
+}
+
+/**
+ * Write a run of doubles as 8 little endian bytes each, a chunk at a time.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeDoubleArray(const double* values,
+                                                         uint32_t size) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint64_t buf[512];
+  const uint32_t chunk = sizeof(buf) / sizeof(buf[0]);
+  for (uint32_t i = 0; i < size; i += chunk) {
+    uint32_t n = std::min(size - i, chunk);
+    for (uint32_t j = 0; j < n; ++j) {
+      buf[j] = htolell(bitwise_cast<uint64_t>(values[i + j]));
+    }
+    trans_->write((uint8_t*)buf, n * 8);
+  }
+  return size * 8;
+}
+
+//
+// Internal Writing methods
+//
+
+/**
+ * The workhorse of writeFieldBegin. It has the option of doing a
+ * 'type override' of the type header. This is used specifically in the
+ * boolean field case.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::writeFieldBeginInternal(const char* name,
+                                                               const TType fieldType,
+                                                               const int16_t fieldId,
+                                                               int8_t typeOverride) {
+  uint32_t wsize = 0;
+
+  // if there's a type override, use that.
+  int8_t typeToWrite = (typeOverride == -1 ? getCompactType(fieldType) : typeOverride);
+
+  // check if we can use delta encoding for the field id
+  if (fieldId > lastFieldId_ && fieldId - lastFieldId_ <= 15) {
+    // write them together
+    wsize += writeByte((fieldId - lastFieldId_) << 4 | typeToWrite);
+  } else {
+    // write them separate
+    wsize += writeByte(typeToWrite);
+    wsize += writeI16(fieldId);
+  }
+
+  lastFieldId_ = fieldId;
+  return wsize;
+}
+
+/**
+ * Abstract method for writing the start of lists and sets. List and sets on
+ * the wire differ only by the type indicator.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeCollectionBegin(int8_t elemType, int32_t size) {
+  uint32_t wsize = 0;
+  if (size <= 14) {
+    wsize += writeByte(size << 4 | getCompactType(elemType));
+  } else {
+    wsize += writeByte(0xf0 | getCompactType(elemType));
+    wsize += writeVarint32(size);
+  }
+  return wsize;
+}
+
+/**
+ * Write an i32 as a varint. Results in 1-5 bytes on the wire.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeVarint32(uint32_t n) {
+  uint8_t buf[5];
+  uint32_t wsize = encodeVarint32(n, buf);
+  trans_->write(buf, wsize);
+  return wsize;
+}
+
+/**
+ * Write an i64 as a varint. Results in 1-10 bytes on the wire.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::writeVarint64(uint64_t n) {
+  uint8_t buf[10];
+  uint32_t wsize = encodeVarint64(n, buf);
+  trans_->write(buf, wsize);
+  return wsize;
+}
+
+/**
+ * Encode an i32 as a varint into buf, which must have room for 5 bytes.
+ * Returns the number of bytes used.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::encodeVarint32(uint32_t n, uint8_t* buf) {
+  uint32_t wsize = 0;
+
+  while (true) {
+    if ((n & ~0x7F) == 0) {
+      buf[wsize++] = (int8_t)n;
+      break;
+    } else {
+      buf[wsize++] = (int8_t)((n & 0x7F) | 0x80);
+      n >>= 7;
+    }
+  }
+  return wsize;
+}
+
+/**
+ * Encode an i64 as a varint into buf, which must have room for 10 bytes.
+ * Returns the number of bytes used.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::encodeVarint64(uint64_t n, uint8_t* buf) {
+  uint32_t wsize = 0;
+
+  while (true) {
+    if ((n & ~0x7FL) == 0) {
+      buf[wsize++] = (int8_t)n;
+      break;
+    } else {
+      buf[wsize++] = (int8_t)((n & 0x7F) | 0x80);
+      n >>= 7;
+    }
+  }
+  return wsize;
+}
+
+/**
+ * Convert l into a zigzag long. This allows negative numbers to be
+ * represented compactly as a varint.
+ */
+template <class Transport_>
+uint64_t TCompactProtocolT<Transport_>::i64ToZigzag(const int64_t l) {
+  return (l << 1) ^ (l >> 63);
+}
+
+/**
+ * Convert n into a zigzag int. This allows negative numbers to be
+ * represented compactly as a varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::i32ToZigzag(const int32_t n) {
+  return (n << 1) ^ (n >> 31);
+}
+
+/**
+ * Given a TType value, find the appropriate TCompactProtocol.Type value
+ */
+template <class Transport_>
+int8_t TCompactProtocolT<Transport_>::getCompactType(int8_t ttype) {
+  return TTypeToCType[ttype];
+}
+
+//
+// Reading Methods
+//
+
+/**
+ * Read a message header.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readMessageBegin(std::string& name,
+                                                         TMessageType& messageType,
+                                                         int32_t& seqid) {
+  const char* nameBuf;
+  uint32_t nameLen;
+  uint32_t rsize = readMessageBegin(nameBuf, nameLen, messageType, seqid);
+  name.assign(nameBuf, nameLen);
+  return rsize;
+}
+
+/**
+ * Read a message header, returning the name as a view.  The name is the
+ * last thing in the header, so when the transport can lend it out the view
+ * points straight into the transport's buffer.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readMessageBegin(const char*& name,
+                                                         uint32_t& nameLen,
+                                                         TMessageType& messageType,
+                                                         int32_t& seqid) {
+  uint32_t rsize = 0;
+  int8_t protocolId;
+  int8_t versionAndType;
+  int8_t version;
+
+  rsize += readByte(protocolId);
+  if (protocolId != PROTOCOL_ID) {
+    throw TProtocolException(TProtocolException::BAD_VERSION, "Bad protocol identifier");
+  }
+
+  rsize += readByte(versionAndType);
+  version = (int8_t)(versionAndType & VERSION_MASK);
+  if (version != VERSION_N) {
+    throw TProtocolException(TProtocolException::BAD_VERSION, "Bad protocol version");
+  }
+
+  messageType = (TMessageType)((versionAndType >> TYPE_SHIFT_AMOUNT) & 0x03);
+  rsize += readVarint32(seqid);
+
+  int32_t size;
+  rsize += readVarint32(size);
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  nameLen = (uint32_t)size;
+  if (size == 0) {
+    name = "";
+    return rsize;
+  }
+
+  uint32_t got = nameLen;
+  const uint8_t* borrow_buf = borrowInput(NULL, &got);
+  if (borrow_buf) {
+    name = (const char*)borrow_buf;
+    consumeInput(nameLen);
+  } else {
+    this->messageName_.resize(nameLen);
+    trans_->readAll(reinterpret_cast<uint8_t*>(&this->messageName_[0]), nameLen);
+    name = this->messageName_.data();
+  }
+
+  return rsize + nameLen;
+}
+
+/**
+ * Read a struct begin.  The compact protocol doesn't send struct names, so
+ * the name is always empty.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStructBegin(std::string& name) {
+  name = "";
+  return readStructBegin();
+}
+
+/**
+ * Read a struct begin. There's nothing on the wire for this, but it is our
+ * opportunity to push a new struct begin marker on the field stack.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStructBegin() {
+  lastField_.push(lastFieldId_);
+  lastFieldId_ = 0;
+  return 0;
+}
+
+/**
+ * Doesn't actually consume any wire data, just removes the last field for
+ * this struct from the field stack.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readStructEnd() {
+  lastFieldId_ = lastField_.top();
+  lastField_.pop();
+  return 0;
+}
+
+/**
+ * Read a field header off the wire.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readFieldBegin(std::string& /* name */,
+                                                       TType& fieldType,
+                                                       int16_t& fieldId) {
+  return readFieldBegin(fieldType, fieldId);
+}
+
+/**
+ * Read a field header off the wire, without a name.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readFieldBegin(TType& fieldType,
+                                                       int16_t& fieldId) {
+  uint32_t rsize = 0;
+  int8_t byte;
+  int8_t type;
+
+  rsize += readByte(byte);
+  type = (byte & 0x0f);
+
+  // if it's a stop, then we can return immediately, as the struct is over.
+  if (type == T_STOP) {
+    fieldType = T_STOP;
+    fieldId = 0;
+    return rsize;
+  }
+
+  // mask off the 4 MSB of the type header. it could contain a field id delta.
+  int16_t modifier = (int16_t)(((uint8_t)byte & 0xf0) >> 4);
+  if (modifier == 0) {
+    // not a delta, look ahead for the zigzag varint field id.
+    rsize += readI16(fieldId);
+  } else {
+    fieldId = (int16_t)(lastFieldId_ + modifier);
+  }
+  fieldType = getTType(type);
+
+  // if this happens to be a boolean field, the value is encoded in the type
+  if (type == CT_BOOLEAN_TRUE || type == CT_BOOLEAN_FALSE) {
+    // save the boolean value in a special instance variable.
+    boolValue_.hasBoolValue = true;
+    boolValue_.boolValue = (type == CT_BOOLEAN_TRUE ? true : false);
+  }
+
+  // push the new field onto the field stack so we can keep the deltas going.
+  lastFieldId_ = fieldId;
+  return rsize;
+}
+
+/**
+ * Read a map header off the wire. If the size is zero, skip reading the key
+ * and value type. This means that 0-length maps will yield TMaps without the
+ * "correct" types.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readMapBegin(TType& keyType,
+                                                     TType& valType,
+                                                     uint32_t& size) {
+  uint32_t rsize = 0;
+  int8_t kvType = 0;
+  int32_t msize = 0;
+
+  rsize += readVarint32(msize);
+  if (msize != 0)
+    rsize += readByte(kvType);
+
+  if (msize < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  } else if (container_limit_ && msize > container_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  keyType = getTType((int8_t)((uint8_t)kvType >> 4));
+  valType = getTType((int8_t)((uint8_t)kvType & 0xf));
+  size = (uint32_t)msize;
+
+  return rsize;
+}
+
+/**
+ * Read a list header off the wire. If the list size is 0-14, the size will
+ * be packed into the element type header. If it's a longer list, the 4 MSB
+ * of the element type header will be 0xF, and a varint will follow with the
+ * true size.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readListBegin(TType& elemType,
+                                                      uint32_t& size) {
+  int8_t size_and_type;
+  uint32_t rsize = 0;
+  int32_t lsize;
+
+  rsize += readByte(size_and_type);
+
+  lsize = ((uint8_t)size_and_type >> 4) & 0x0f;
+  if (lsize == 15) {
+    rsize += readVarint32(lsize);
+  }
+
+  if (lsize < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  } else if (container_limit_ && lsize > container_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  elemType = getTType((int8_t)(size_and_type & 0x0f));
+  size = (uint32_t)lsize;
+
+  return rsize;
+}
+
+/**
+ * Read a set header off the wire. If the set size is 0-14, the size will
+ * be packed into the element type header. If it's a longer set, the 4 MSB
+ * of the element type header will be 0xF, and a varint will follow with the
+ * true size.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readSetBegin(TType& elemType,
+                                                     uint32_t& size) {
+  return readListBegin(elemType, size);
+}
+
+/**
+ * Read a boolean off the wire. If this is a boolean field, the value should
+ * already have been read during readFieldBegin, so we'll just consume the
+ * pre-stored value. Otherwise, read a byte.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBool(bool& value) {
+  if (boolValue_.hasBoolValue == true) {
+    value = boolValue_.boolValue;
+    boolValue_.hasBoolValue = false;
+    return 0;
+  } else {
+    int8_t val;
+    readByte(val);
+    value = (val == CT_BOOLEAN_TRUE);
+    return 1;
+  }
+}
+
+/**
+ * Read a single byte off the wire. Nothing interesting here.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readByte(int8_t& byte) {
+  uint8_t buf[1];
+  const uint8_t* b = readFixed(buf, 1);
+  byte = *(int8_t*)b;
+  return 1;
+}
+
+/**
+ * Read an i16 from the wire as a zigzag varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI16(int16_t& i16) {
+  int32_t value;
+  uint32_t rsize = readVarint32(value);
+  i16 = (int16_t)zigzagToI32(value);
+  return rsize;
+}
+
+/**
+ * Read an i32 from the wire as a zigzag varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI32(int32_t& i32) {
+  int32_t value;
+  uint32_t rsize = readVarint32(value);
+  i32 = zigzagToI32(value);
+  return rsize;
+}
+
+/**
+ * Read an i64 from the wire as a zigzag varint.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI64(int64_t& i64) {
+  int64_t value;
+  uint32_t rsize = readVarint64(value);
+  i64 = zigzagToI64(value);
+  return rsize;
+}
+
+/**
+ * No magic here - just read a double off the wire.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readDouble(double& dub) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  uint64_t bits;
+  uint8_t buf[8];
+  const uint8_t* b = readFixed(buf, 8);
+  memcpy(&bits, b, 8);
+  bits = letohll(bits);
+  dub = bitwise_cast<double>(bits);
+  return 8;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readString(std::string& str) {
+  return readBinary(str);
+}
+
+/**
+ * Read a byte[] from the wire.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinary(std::string& str) {
+  int32_t rsize = 0;
+  int32_t size;
+
+  rsize += readVarint32(size);
+  // Catch empty string case
+  if (size == 0) {
+    str = "";
+    return rsize;
+  }
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  // Try to borrow first, so the string is built with a single copy.
+  uint32_t got = size;
+  const uint8_t* borrow_buf = borrowInput(NULL, &got);
+  if (borrow_buf) {
+    str.assign((const char*)borrow_buf, size);
+    consumeInput(size);
+    return rsize + (uint32_t)size;
+  }
+
+  // Otherwise read straight into the string's own storage.
+  str.resize(size);
+  trans_->readAll(reinterpret_cast<uint8_t*>(&str[0]), size);
+
+  return rsize + (uint32_t)size;
+}
+
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readString(const char*& str,
+                                                   uint32_t& len) {
+  return readBinary(str, len);
+}
+
+/**
+ * Read a byte[] from the wire as a view.  It points into the transport's
+ * buffer if the transport can lend the bytes out, and into stringBuf_
+ * otherwise.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readBinary(const char*& str,
+                                                   uint32_t& len) {
+  int32_t rsize = 0;
+  int32_t size;
+
+  rsize += readVarint32(size);
+  // Catch empty string case
+  if (size == 0) {
+    str = "";
+    len = 0;
+    return rsize;
+  }
+
+  // Catch error cases
+  if (size < 0) {
+    throw TProtocolException(TProtocolException::NEGATIVE_SIZE);
+  }
+  if (string_limit_ > 0 && size > string_limit_) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+
+  len = (uint32_t)size;
+  uint32_t got = len;
+  const uint8_t* borrow_buf = borrowInput(NULL, &got);
+  if (borrow_buf) {
+    str = (const char*)borrow_buf;
+    consumeInput(len);
+  } else {
+    this->stringBuf_.resize(len);
+    trans_->readAll(reinterpret_cast<uint8_t*>(&this->stringBuf_[0]), len);
+    str = this->stringBuf_.data();
+  }
+
+  return rsize + len;
+}
+
+/**
+ * Read a run of bytes straight into place.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readByteArray(int8_t* values,
+                                                      uint32_t size) {
+  trans_->readAll((uint8_t*)values, size);
+  return size;
+}
+
+/**
+ * Read a run of zigzag varint i32s.  The values are decoded in place from
+ * the transport's buffer and consumed in one go; only a value that
+ * straddles the end of the buffer (and everything, on transports that
+ * can't lend their buffer out) goes through readVarint32().
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI32Array(int32_t* values,
+                                                     uint32_t size) {
+  uint32_t rsize = 0;
+  uint32_t i = 0;
+  while (i < size) {
+    uint32_t avail = 1;
+    const uint8_t* buf = borrowInput(NULL, &avail);
+    if (buf != NULL) {
+      uint32_t pos = 0;
+      while (i < size) {
+        uint64_t val;
+        uint32_t len = decodeVarint64(buf + pos, avail - pos, val);
+        if (len == 0) {
+          break;
+        }
+        pos += len;
+        values[i++] = zigzagToI32((uint32_t)val);
+      }
+      consumeInput(pos);
+      rsize += pos;
+    }
+    if (i < size) {
+      int32_t value;
+      rsize += readVarint32(value);
+      values[i++] = zigzagToI32(value);
+    }
+  }
+  return rsize;
+}
+
+/**
+ * Read a run of zigzag varint i64s, the same way as readI32Array().
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readI64Array(int64_t* values,
+                                                     uint32_t size) {
+  uint32_t rsize = 0;
+  uint32_t i = 0;
+  while (i < size) {
+    uint32_t avail = 1;
+    const uint8_t* buf = borrowInput(NULL, &avail);
+    if (buf != NULL) {
+      uint32_t pos = 0;
+      while (i < size) {
+        uint64_t val;
+        uint32_t len = decodeVarint64(buf + pos, avail - pos, val);
+        if (len == 0) {
+          break;
+        }
+        pos += len;
+        values[i++] = zigzagToI64(val);
+      }
+      consumeInput(pos);
+      rsize += pos;
+    }
+    if (i < size) {
+      int64_t value;
+      rsize += readVarint64(value);
+      values[i++] = zigzagToI64(value);
+    }
+  }
+  return rsize;
+}
+
+/**
+ * Read a run of doubles straight into place, and fix up their byte order.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readDoubleArray(double* values,
+                                                        uint32_t size) {
+  BOOST_STATIC_ASSERT(sizeof(double) == sizeof(uint64_t));
+  BOOST_STATIC_ASSERT(std::numeric_limits<double>::is_iec559);
+
+  if (size > std::numeric_limits<uint32_t>::max() / 8) {
+    throw TProtocolException(TProtocolException::SIZE_LIMIT);
+  }
+  trans_->readAll((uint8_t*)values, size * 8);
+  for (uint32_t i = 0; i < size; ++i) {
+    // Swap the bits without ever holding them in a double
+    uint64_t bits;
+    memcpy(&bits, &values[i], 8);
+    bits = letohll(bits);
+    memcpy(&values[i], &bits, 8);
+  }
+  return size * 8;
+}
+
+/**
+ * Read an i32 from the wire as a varint. The MSB of each byte is set
+ * if there is another byte to follow. This can read up to 5 bytes.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readVarint32(int32_t& i32) {
+  int64_t val;
+  uint32_t rsize = readVarint64(val);
+  i32 = (int32_t)val;
+  return rsize;
+}
+
+/**
+ * Read an i64 from the wire as a proper varint. The MSB of each byte is set
+ * if there is another byte to follow. This can read up to 10 bytes.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::readVarint64(int64_t& i64) {
+  uint32_t rsize = 0;
+  uint64_t val = 0;
+  int shift = 0;
+  uint32_t buf_size = 1;
+  const uint8_t* borrowed = borrowInput(NULL, &buf_size);
+
+  // Fast path.  Only ask for what is already buffered, so a varint near the
+  // end of a message can't make the transport wait for bytes that aren't
+  // coming.
+  if (borrowed != NULL) {
+    rsize = decodeVarint64(borrowed, buf_size, val);
+    if (rsize > 0) {
+      i64 = val;
+      consumeInput(rsize);
+      return rsize;
+    }
+  }
+
+  // Slow path.
+  while (true) {
+    uint8_t byte;
+    rsize += trans_->readAll(&byte, 1);
+    val |= (uint64_t)(byte & 0x7f) << shift;
+    shift += 7;
+    if (!(byte & 0x80)) {
+      i64 = val;
+      return rsize;
+    }
+    // Might as well check for invalid data on the slow path too.
+    if (UNLIKELY(rsize >= 10)) {
+      throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+    }
+  }
+}
+
+/**
+ * Decode a varint from the len bytes at buf.  Returns the number of bytes
+ * the varint took up, or 0 if it runs past the end of buf.
+ *
+ * With 10 bytes or more to look at, the first eight are handled as one
+ * 64 bit word: the first clear continuation bit gives the length, and the
+ * 7 bit groups are squeezed together with a few shifts and masks instead
+ * of a loop.  Only varints longer than eight bytes (i64s of 2^56 and up)
+ * look at bytes one by one.
+ */
+template <class Transport_>
+uint32_t TCompactProtocolT<Transport_>::decodeVarint64(const uint8_t* buf,
+                                                       uint32_t len,
+                                                       uint64_t& val) {
+  if (len < 10) {
+    uint64_t result = 0;
+    for (uint32_t rsize = 0; rsize < len; ) {
+      uint8_t byte = buf[rsize];
+      result |= (uint64_t)(byte & 0x7f) << (7 * rsize);
+      rsize++;
+      if (!(byte & 0x80)) {
+        val = result;
+        return rsize;
+      }
+    }
+    return 0;
+  }
+
+  uint64_t word;
+  memcpy(&word, buf, sizeof(word));
+  word = letohll(word);
+
+  uint64_t stops = ~word & 0x8080808080808080ULL;
+  uint32_t rsize;
+  if (stops != 0) {
+#ifdef __GNUC__
+    rsize = (__builtin_ctzll(stops) >> 3) + 1;
+#else
+    rsize = 1;
+    while (!(stops & 0x80)) {
+      stops >>= 8;
+      ++rsize;
+    }
+#endif
+    if (rsize < 8) {
+      word &= ((uint64_t)1 << (rsize * 8)) - 1;
+    }
+  } else {
+    rsize = 8;
+  }
+
+  // Squeeze the 7 bit groups of each byte pair, then of each pair of
+  // 14 bit groups, then of the two 28 bit groups.
+  word &= 0x7f7f7f7f7f7f7f7fULL;
+  word = ((word & 0x7f007f007f007f00ULL) >> 1) | (word & 0x007f007f007f007fULL);
+  word = ((word & 0x3fff00003fff0000ULL) >> 2) | (word & 0x00003fff00003fffULL);
+  word = ((word & 0x0fffffff00000000ULL) >> 4) | (word & 0x000000000fffffffULL);
+
+  if (UNLIKELY(stops == 0)) {
+    for (int shift = 56; rsize < 10; shift += 7) {
+      uint8_t byte = buf[rsize++];
+      word |= (uint64_t)(byte & 0x7f) << shift;
+      if (!(byte & 0x80)) {
+        val = word;
+        return rsize;
+      }
+    }
+    // Have to check for invalid data so we don't crash.
+    throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+  }
+
+  val = word;
+  return rsize;
+}
+
+/**
+ * Convert from zigzag int to int.
+ */
+template <class Transport_>
+int32_t TCompactProtocolT<Transport_>::zigzagToI32(uint32_t n) {
+  return (n >> 1) ^ -(n & 1);
+}
+
+/**
+ * Convert from zigzag long to long.
+ */
+template <class Transport_>
+int64_t TCompactProtocolT<Transport_>::zigzagToI64(uint64_t n) {
+  return (n >> 1) ^ -(n & 1);
+}
+
+template <class Transport_>
+TType TCompactProtocolT<Transport_>::getTType(int8_t type) {
+  switch (type) {
+    case T_STOP:
+      return T_STOP;
+    case CT_BOOLEAN_FALSE:
+    case CT_BOOLEAN_TRUE:
+      return T_BOOL;
+    case CT_BYTE:
+      return T_BYTE;
+    case CT_I16:
+      return T_I16;
+    case CT_I32:
+      return T_I32;
+    case CT_I64:
+      return T_I64;
+    case CT_DOUBLE:
+      return T_DOUBLE;
+    case CT_BINARY:
+      return T_STRING;
+    case CT_LIST:
+      return T_LIST;
+    case CT_SET:
+      return T_SET;
+    case CT_MAP:
+      return T_MAP;
+    case CT_STRUCT:
+      return T_STRUCT;
+    default:
+      throw TException("don't know what type: " + type);
+  }
+  return T_STOP;
+}
+
+}}} // apache::thrift::protocol
+
+#undef UNLIKELY
+
+#endif // _THRIFT_PROTOCOL_TCOMPACTPROTOCOL_TCC_
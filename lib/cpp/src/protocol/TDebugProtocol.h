@@ -46,7 +46,7 @@ Complaints are not. :R
  * Reading from this protocol is not supported.
  *
  */
-class TDebugProtocol : public TWriteOnlyProtocol {
+class TDebugProtocol : public TWriteOnlyProtocol<TDebugProtocol> {
  private:
   enum write_state_t
   { UNINIT
@@ -59,7 +59,7 @@ class TDebugProtocol : public TWriteOnlyProtocol {
 
  public:
   TDebugProtocol(boost::shared_ptr<TTransport> trans)
-    : TWriteOnlyProtocol(trans, "TDebugProtocol")
+    : TWriteOnlyProtocol<TDebugProtocol>(trans, "TDebugProtocol")
     , string_limit_(DEFAULT_STRING_LIMIT)
     , string_prefix_size_(DEFAULT_STRING_PREFIX_SIZE)
   {
@@ -78,11 +78,11 @@ class TDebugProtocol : public TWriteOnlyProtocol {
   }
 
 
-  virtual uint32_t writeMessageBegin(const std::string& name,
-                                     const TMessageType messageType,
-                                     const int32_t seqid);
+  uint32_t writeMessageBegin(const std::string& name,
+                             const TMessageType messageType,
+                             const int32_t seqid);
 
-  virtual uint32_t writeMessageEnd();
+  uint32_t writeMessageEnd();
 
 
   uint32_t writeStructBegin(const char* name);
@@ -126,8 +126,12 @@ class TDebugProtocol : public TWriteOnlyProtocol {
   uint32_t writeDouble(const double dub);
 
   uint32_t writeString(const std::string& str);
+  // Provide the default (pointer, length) writeString()
+  using TWriteOnlyProtocol<TDebugProtocol>::writeString;
 
   uint32_t writeBinary(const std::string& str);
+  // Provide the default (pointer, length) writeBinary()
+  using TWriteOnlyProtocol<TDebugProtocol>::writeBinary;
 
 
  private:
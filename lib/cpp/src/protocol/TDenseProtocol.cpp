@@ -76,12 +76,16 @@ We use the following strategies for maintaining this invariant:
   the key and the value.  As a result, we potentially have to switch
   between map key state and map value state after reading/writing any object.
 - This job is handled by the stateTransition method.  It is called after
-  reading/writing every object.  It pops the current TypeSpec off the stack,
-  then optionally pushes a new one on, depending on what the next TypeSpec is.
-  If it is a struct, the job is left to the next writeFieldBegin.  If it is a
-  set or list, the just-popped typespec is pushed back on.  If it is a map,
-  the top of the key/value stack is toggled, and the appropriate TypeSpec
-  is pushed.
+  reading/writing every object.  It looks at the TypeSpec under the current
+  one to decide what comes next.  If it is a struct, the current TypeSpec
+  is popped, and the job is left to the next writeFieldBegin.  If it is a
+  set or list, the current TypeSpec is also the next one, so it stays.  If
+  it is a map, the key/value flag is toggled, and the current TypeSpec is
+  replaced with the appropriate one.
+
+The stacks are fixed arrays in the protocol object that share one depth, so
+none of this allocates, and the index and key/value "stacks" are just the
+entries at the same level as their struct or map.
 
 Optional fields are a little tricky also.  We write a zero byte if they are
 absent and prefix them with an 0x01 byte if they are present
@@ -92,10 +96,10 @@ absent and prefix them with an 0x01 byte if they are present
 #include "TDenseProtocol.h"
 #include "TReflectionLocal.h"
 
-// Leaving this on for now.  Disabling it will turn off asserts, which should
-// give a performance boost.  When we have *really* thorough test cases,
-// we should drop this.
-#define DEBUG_TDENSEPROTOCOL
+// Define this to check that the generated code matches the TypeSpec at
+// every step.  Only bugs in the calling code can trip these checks, so
+// they are off by default.
+// #define DEBUG_TDENSEPROTOCOL
 
 // NOTE: Assertions should *only* be used to detect bugs in code,
 //       either in TDenseProtocol itself, or in code using it.
@@ -112,8 +116,10 @@ absent and prefix them with an 0x01 byte if they are present
 using std::string;
 
 #ifdef __GNUC__
+#define LIKELY(val) (__builtin_expect((val), 1))
 #define UNLIKELY(val) (__builtin_expect((val), 0))
 #else
+#define LIKELY(val) (val)
 #define UNLIKELY(val) (val)
 #endif
 
@@ -123,9 +129,11 @@ const int TDenseProtocol::FP_PREFIX_LEN =
   apache::thrift::reflection::local::FP_PREFIX_LEN;
 
 // Top TypeSpec.  TypeSpec of the structure being encoded.
-#define TTS  (ts_stack_.back())  // type = TypeSpec*
+#define TTS  (ts_stack_[depth_ - 1])  // type = TypeSpec*
 // InDeX.  Index into TTS of the current/next field to encode.
-#define IDX (idx_stack_.back())  // type = int
+#define IDX (idx_stack_[depth_ - 1])  // type = int32_t
+// Map Key/Value.  Whether the map in TTS is at a key.
+#define MKV (mkv_stack_[depth_ - 1])  // type = bool
 // Field TypeSpec.  TypeSpec of the current/next field to encode.
 #define FTS (TTS->tstruct.specs[IDX])  // type = TypeSpec*
 // Field MeTa.  Metadata of the current/next field to encode.
@@ -140,7 +148,7 @@ const int TDenseProtocol::FP_PREFIX_LEN =
  * according to our typespec.  Aborts if the test fails and debugging in on.
  */
 inline void TDenseProtocol::checkTType(const TType ttype) {
-  assert(!ts_stack_.empty());
+  assert(depth_ > 0);
   assert(TTS->ttype == ttype);
 }
 
@@ -149,32 +157,36 @@ inline void TDenseProtocol::checkTType(const TType ttype) {
  * See top-of-file comments.
  */
 inline void TDenseProtocol::stateTransition() {
-  TypeSpec* old_tts = ts_stack_.back();
-  ts_stack_.pop_back();
-
-  // If this is the end of the top-level write, we should have just popped
+  // If this is the end of the top-level write, we should be done with
   // the TypeSpec passed to the constructor.
-  if (ts_stack_.empty()) {
-    assert(old_tts = type_spec_);
+  if (depth_ == 1) {
+    assert(TTS == type_spec_);
+    depth_ = 0;
     return;
   }
 
+  // The popped TypeSpec is still at ts_stack_[depth_] for the asserts.
+  depth_--;
+
   switch (TTS->ttype) {
 
     case T_STRUCT:
-      assert(old_tts == FTS);
+      // Popped.
+      assert(ts_stack_[depth_] == FTS);
       break;
 
     case T_LIST:
     case T_SET:
-      assert(old_tts == ST1);
-      ts_stack_.push_back(old_tts);
+      // The next element has the same TypeSpec.
+      assert(ts_stack_[depth_] == ST1);
+      depth_++;
       break;
 
     case T_MAP:
-      assert(old_tts == (mkv_stack_.back() ? ST1 : ST2));
-      mkv_stack_.back() = !mkv_stack_.back();
-      ts_stack_.push_back(mkv_stack_.back() ? ST1 : ST2);
+      assert(ts_stack_[depth_] == (MKV ? ST1 : ST2));
+      MKV = !MKV;
+      ts_stack_[depth_] = MKV ? ST1 : ST2;
+      depth_++;
       break;
 
     default:
@@ -184,77 +196,130 @@ inline void TDenseProtocol::stateTransition() {
   }
 }
 
+/**
+ * Pushes the TypeSpec of a field or container element.
+ */
+inline void TDenseProtocol::pushTypeSpec(TypeSpec* ts) {
+  if (UNLIKELY(depth_ == MAX_DEPTH)) {
+    resetState();
+    throw TProtocolException(TProtocolException::SIZE_LIMIT,
+                             "TDenseProtocol: structures nested too deeply.");
+  }
+  ts_stack_[depth_++] = ts;
+}
+
+/**
+ * Writes to the transport, without a virtual call when it is a TBufferBase.
+ */
+inline void TDenseProtocol::writeOutput(const uint8_t* buf, uint32_t len) {
+  if (buffer_ != NULL) {
+    buffer_->write(buf, len);
+  } else {
+    trans_->write(buf, len);
+  }
+}
+
 
 /*
  * Variable-length quantity functions.
  */
 
-inline uint32_t TDenseProtocol::vlqRead(uint64_t& vlq) {
-  uint32_t used = 0;
-  uint64_t val = 0;
+uint32_t TDenseProtocol::vlqRead(uint64_t& vlq) {
   uint8_t buf[10];  // 64 bits / (7 bits/byte) = 10 bytes.
-  uint32_t buf_size = sizeof(buf);
-  const uint8_t* borrowed = trans_->borrow(buf, &buf_size);
+  uint32_t avail = 1;
+  const uint8_t* borrowed = borrowInput(buf, &avail);
 
-  // Fast path.  TODO(dreiss): Make it faster.
+  // Fast path: everything we need is already buffered.  Small numbers
+  // (sizes, field values, enums) are by far the most common, so check for
+  // one and two bytes first.
   if (borrowed != NULL) {
-    while (true) {
-      uint8_t byte = borrowed[used];
-      used++;
+    uint8_t byte = borrowed[0];
+    if (!(byte & 0x80)) {
+      vlq = byte;
+      consumeInput(1);
+      return 1;
+    }
+    uint64_t val = byte & 0x7f;
+    if (avail >= 2) {
+      byte = borrowed[1];
       val = (val << 7) | (byte & 0x7f);
       if (!(byte & 0x80)) {
         vlq = val;
-        trans_->consume(used);
-        return used;
-      }
-      // Have to check for invalid data so we don't crash.
-      if (UNLIKELY(used == sizeof(buf))) {
-        resetState();
-        throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+        consumeInput(2);
+        return 2;
       }
     }
-  }
-
-  // Slow path.
-  else {
-    while (true) {
-      uint8_t byte;
-      used += trans_->readAll(&byte, 1);
+    uint32_t max = avail < sizeof(buf) ? avail : sizeof(buf);
+    for (uint32_t used = 2; used < max; used++) {
+      byte = borrowed[used];
       val = (val << 7) | (byte & 0x7f);
       if (!(byte & 0x80)) {
         vlq = val;
-        return used;
-      }
-      // Might as well check for invalid data on the slow path too.
-      if (UNLIKELY(used >= sizeof(buf))) {
-        resetState();
-        throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+        consumeInput(used + 1);
+        return used + 1;
       }
     }
+    // Have to check for invalid data so we don't crash.
+    if (UNLIKELY(max == sizeof(buf))) {
+      resetState();
+      throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+    }
+    // Otherwise it runs past the end of the buffer; start over slowly.
+  }
+
+  return vlqReadSlow(vlq);
+}
+
+uint32_t TDenseProtocol::vlqReadSlow(uint64_t& vlq) {
+  uint32_t used = 0;
+  uint64_t val = 0;
+  while (true) {
+    uint8_t byte;
+    used += trans_->readAll(&byte, 1);
+    val = (val << 7) | (byte & 0x7f);
+    if (!(byte & 0x80)) {
+      vlq = val;
+      return used;
+    }
+    // Might as well check for invalid data on the slow path too.
+    if (UNLIKELY(used >= 10)) {
+      resetState();
+      throw TProtocolException(TProtocolException::INVALID_DATA, "Variable-length int over 10 bytes.");
+    }
   }
 }
 
-inline uint32_t TDenseProtocol::vlqWrite(uint64_t vlq) {
+uint32_t TDenseProtocol::vlqWrite(uint64_t vlq) {
   uint8_t buf[10];  // 64 bits / (7 bits/byte) = 10 bytes.
-  int32_t pos = sizeof(buf) - 1;
-
-  // Write the thing from back to front.
-  buf[pos] = vlq & 0x7f;
-  vlq >>= 7;
-  pos--;
-
-  while (vlq > 0) {
-    assert(pos >= 0);
-    buf[pos] = (vlq | 0x80);
-    vlq >>= 7;
-    pos--;
+
+  if (vlq < 0x80) {
+    buf[0] = (uint8_t)vlq;
+    writeOutput(buf, 1);
+    return 1;
   }
 
-  // Back up one step before writing.
-  pos++;
+  // Count the 7 bit groups, then write them most significant first, with
+  // the high bit set on all but the last.
+  uint32_t len = 2;
+  while (len < sizeof(buf) && (vlq >> (7 * len)) != 0) {
+    len++;
+  }
+  uint8_t* pos = buf;
+  switch (len) {
+    case 10: *pos++ = (uint8_t)(vlq >> 63) | 0x80;
+    case 9:  *pos++ = (uint8_t)(vlq >> 56) | 0x80;
+    case 8:  *pos++ = (uint8_t)(vlq >> 49) | 0x80;
+    case 7:  *pos++ = (uint8_t)(vlq >> 42) | 0x80;
+    case 6:  *pos++ = (uint8_t)(vlq >> 35) | 0x80;
+    case 5:  *pos++ = (uint8_t)(vlq >> 28) | 0x80;
+    case 4:  *pos++ = (uint8_t)(vlq >> 21) | 0x80;
+    case 3:  *pos++ = (uint8_t)(vlq >> 14) | 0x80;
+    default: *pos++ = (uint8_t)(vlq >> 7) | 0x80;
+  }
+  *pos = (uint8_t)vlq & 0x7f;
 
-  trans_->write(buf+pos, sizeof(buf) - pos);
-  return sizeof(buf) - pos;
+  writeOutput(buf, len);
+  return len;
 }
 
 
@@ -285,7 +350,7 @@ uint32_t TDenseProtocol::writeStructBegin(const char* name) {
 
   // The TypeSpec stack should be empty if this is the top-level read/write.
   // If it is, we push the TypeSpec passed to the constructor.
-  if (ts_stack_.empty()) {
+  if (depth_ == 0) {
     assert(standalone_);
 
     if (type_spec_ == NULL) {
@@ -293,20 +358,20 @@ uint32_t TDenseProtocol::writeStructBegin(const char* name) {
       throw TException("TDenseProtocol: No type specified.");
     } else {
       assert(type_spec_->ttype == T_STRUCT);
-      ts_stack_.push_back(type_spec_);
+      ts_stack_[depth_++] = type_spec_;
       // Write out a prefix of the structure fingerprint.
-      trans_->write(type_spec_->fp_prefix, FP_PREFIX_LEN);
+      writeOutput(type_spec_->fp_prefix, FP_PREFIX_LEN);
       xfer += FP_PREFIX_LEN;
     }
   }
 
   // We need a new field index for this structure.
-  idx_stack_.push_back(0);
+  checkTType(T_STRUCT);
+  IDX = 0;
   return 0;
 }
 
 uint32_t TDenseProtocol::writeStructEnd() {
-  idx_stack_.pop_back();
   stateTransition();
   return 0;
 }
@@ -319,16 +384,22 @@ uint32_t TDenseProtocol::writeFieldBegin(const char* name,
   // Skip over optional fields.
   while (FMT.tag != fieldId) {
     // TODO(dreiss): Old meta here.
-    assert(FTS->ttype != T_STOP);
-    assert(FMT.is_optional);
+    if (UNLIKELY(FTS->ttype == T_STOP || !FMT.is_optional)) {
+      resetState();
+      throw TProtocolException(TProtocolException::INVALID_DATA,
+          "TDenseProtocol: field does not match type_spec.");
+    }
     // Write a zero byte so the reader can skip it.
     xfer += subWriteBool(false);
     // And advance to the next field.
     IDX++;
   }
 
-  // TODO(dreiss): give a better exception.
-  assert(FTS->ttype == fieldType);
+  if (UNLIKELY(FTS->ttype != fieldType)) {
+    resetState();
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+        "TDenseProtocol: field type does not match type_spec.");
+  }
 
   if (FMT.is_optional) {
     subWriteBool(true);
@@ -338,9 +409,9 @@ uint32_t TDenseProtocol::writeFieldBegin(const char* name,
   // writeFieldStop shares all lot of logic up to this point.
   // Instead of replicating it all, we just call this method from that one
   // and use a gross special case here.
-  if (UNLIKELY(FTS->ttype != T_STOP)) {
+  if (LIKELY(FTS->ttype != T_STOP)) {
     // For normal fields, push the TypeSpec that we're about to use.
-    ts_stack_.push_back(FTS);
+    pushTypeSpec(FTS);
   }
   return xfer;
 }
@@ -363,17 +434,15 @@ uint32_t TDenseProtocol::writeMapBegin(const TType keyType,
   assert(keyType == ST1->ttype);
   assert(valType == ST2->ttype);
 
-  ts_stack_.push_back(ST1);
-  mkv_stack_.push_back(true);
+  MKV = true;
+  pushTypeSpec(ST1);
 
   return subWriteI32((int32_t)size);
 }
 
 uint32_t TDenseProtocol::writeMapEnd() {
-  // Pop off the value type, as well as our entry in the map key/value stack.
-  // stateTransition takes care of popping off our TypeSpec.
-  ts_stack_.pop_back();
-  mkv_stack_.pop_back();
+  // Pop off the key type.  stateTransition takes care of popping off ours.
+  depth_--;
   stateTransition();
   return 0;
 }
@@ -383,13 +452,13 @@ uint32_t TDenseProtocol::writeListBegin(const TType elemType,
   checkTType(T_LIST);
 
   assert(elemType == ST1->ttype);
-  ts_stack_.push_back(ST1);
+  pushTypeSpec(ST1);
   return subWriteI32((int32_t)size);
 }
 
 uint32_t TDenseProtocol::writeListEnd() {
   // Pop off the element type.  stateTransition takes care of popping off ours.
-  ts_stack_.pop_back();
+  depth_--;
   stateTransition();
   return 0;
 }
@@ -399,13 +468,13 @@ uint32_t TDenseProtocol::writeSetBegin(const TType elemType,
   checkTType(T_SET);
 
   assert(elemType == ST1->ttype);
-  ts_stack_.push_back(ST1);
+  pushTypeSpec(ST1);
   return subWriteI32((int32_t)size);
 }
 
 uint32_t TDenseProtocol::writeSetEnd() {
   // Pop off the element type.  stateTransition takes care of popping off ours.
-  ts_stack_.pop_back();
+  depth_--;
   stateTransition();
   return 0;
 }
@@ -413,13 +482,16 @@ uint32_t TDenseProtocol::writeSetEnd() {
 uint32_t TDenseProtocol::writeBool(const bool value) {
   checkTType(T_BOOL);
   stateTransition();
-  return TBinaryProtocol::writeBool(value);
+  uint8_t tmp = value ? 1 : 0;
+  writeOutput(&tmp, 1);
+  return 1;
 }
 
 uint32_t TDenseProtocol::writeByte(const int8_t byte) {
   checkTType(T_BYTE);
   stateTransition();
-  return TBinaryProtocol::writeByte(byte);
+  writeOutput((const uint8_t*)&byte, 1);
+  return 1;
 }
 
 uint32_t TDenseProtocol::writeI16(const int16_t i16) {
@@ -464,7 +536,7 @@ uint32_t TDenseProtocol::subWriteString(const std::string& str) {
   uint32_t size = str.size();
   uint32_t xfer = subWriteI32((int32_t)size);
   if (size > 0) {
-    trans_->write((uint8_t*)str.data(), size);
+    writeOutput((const uint8_t*)str.data(), size);
   }
   return xfer + size;
 }
@@ -509,7 +581,7 @@ uint32_t TDenseProtocol::readMessageEnd() {
 uint32_t TDenseProtocol::readStructBegin(string& name) {
   uint32_t xfer = 0;
 
-  if (ts_stack_.empty()) {
+  if (depth_ == 0) {
     assert(standalone_);
 
     if (type_spec_ == NULL) {
@@ -517,12 +589,13 @@ uint32_t TDenseProtocol::readStructBegin(string& name) {
       throw TException("TDenseProtocol: No type specified.");
     } else {
       assert(type_spec_->ttype == T_STRUCT);
-      ts_stack_.push_back(type_spec_);
+      ts_stack_[depth_++] = type_spec_;
 
       // Check the fingerprint prefix.
       uint8_t buf[FP_PREFIX_LEN];
-      xfer += trans_->read(buf, FP_PREFIX_LEN);
-      if (std::memcmp(buf, type_spec_->fp_prefix, FP_PREFIX_LEN) != 0) {
+      const uint8_t* fp = readFixed(buf, FP_PREFIX_LEN);
+      xfer += FP_PREFIX_LEN;
+      if (std::memcmp(fp, type_spec_->fp_prefix, FP_PREFIX_LEN) != 0) {
         resetState();
         throw TProtocolException(TProtocolException::INVALID_DATA,
             "Fingerprint in data does not match type_spec.");
@@ -531,12 +604,12 @@ uint32_t TDenseProtocol::readStructBegin(string& name) {
   }
 
   // We need a new field index for this structure.
-  idx_stack_.push_back(0);
+  checkTType(T_STRUCT);
+  IDX = 0;
   return 0;
 }
 
 uint32_t TDenseProtocol::readStructEnd() {
-  idx_stack_.pop_back();
   stateTransition();
   return 0;
 }
@@ -564,8 +637,8 @@ uint32_t TDenseProtocol::readFieldBegin(string& name,
 
   // Normally, we push the TypeSpec that we are about to read,
   // but no reading is done for T_STOP.
-  if (FTS->ttype != T_STOP) {
-    ts_stack_.push_back(FTS);
+  if (LIKELY(FTS->ttype != T_STOP)) {
+    pushTypeSpec(FTS);
   }
   return xfer;
 }
@@ -595,15 +668,14 @@ uint32_t TDenseProtocol::readMapBegin(TType& keyType,
   keyType = ST1->ttype;
   valType = ST2->ttype;
 
-  ts_stack_.push_back(ST1);
-  mkv_stack_.push_back(true);
+  MKV = true;
+  pushTypeSpec(ST1);
 
   return xfer;
 }
 
 uint32_t TDenseProtocol::readMapEnd() {
-  ts_stack_.pop_back();
-  mkv_stack_.pop_back();
+  depth_--;
   stateTransition();
   return 0;
 }
@@ -626,13 +698,13 @@ uint32_t TDenseProtocol::readListBegin(TType& elemType,
 
   elemType = ST1->ttype;
 
-  ts_stack_.push_back(ST1);
+  pushTypeSpec(ST1);
 
   return xfer;
 }
 
 uint32_t TDenseProtocol::readListEnd() {
-  ts_stack_.pop_back();
+  depth_--;
   stateTransition();
   return 0;
 }
@@ -655,13 +727,13 @@ uint32_t TDenseProtocol::readSetBegin(TType& elemType,
 
   elemType = ST1->ttype;
 
-  ts_stack_.push_back(ST1);
+  pushTypeSpec(ST1);
 
   return xfer;
 }
 
 uint32_t TDenseProtocol::readSetEnd() {
-  ts_stack_.pop_back();
+  depth_--;
   stateTransition();
   return 0;
 }
@@ -25,11 +25,6 @@
 namespace apache { namespace thrift { namespace protocol {
 
 /**
- * !!!WARNING!!!
- * This class is still highly experimental.  Incompatible changes
- * WILL be made to it without notice.  DO NOT USE IT YET unless
- * you are coordinating your testing with the author.
- *
  * The dense protocol is designed to use as little space as possible.
  *
  * There are two types of dense protocol instances.  Standalone instances
@@ -40,7 +35,11 @@ namespace apache { namespace thrift { namespace protocol {
  * To use a standalone dense protocol object, you must set the type_spec
  * property (either in the constructor, or with setTypeSpec) to the local
  * reflection TypeSpec of the structures you will write to (or read from) the
- * protocol instance.
+ * protocol instance.  The TypeSpecs are generated by "thrift --gen cpp:dense".
+ *
+ * The wire format is fixed: DenseProtoTest checks it byte for byte, so data
+ * written by one version can be read by any other as long as the structure
+ * definitions are the same.
  *
  * BEST PRACTICES:
  * - Never use optional for primitives or containers.
@@ -56,7 +55,8 @@ namespace apache { namespace thrift { namespace protocol {
  * methods within our versions.
  *
  */
-class TDenseProtocol : public TBinaryProtocol {
+class TDenseProtocol
+  : public TVirtualProtocol<TDenseProtocol, TBinaryProtocol> {
  protected:
   static const int32_t VERSION_MASK = 0xffff0000;
   // VERSION_1 (0x80010000)  is taken by TBinaryProtocol.
@@ -72,8 +72,9 @@ class TDenseProtocol : public TBinaryProtocol {
    */
   TDenseProtocol(boost::shared_ptr<TTransport> trans,
                  TypeSpec* type_spec = NULL) :
-    TBinaryProtocol(trans),
+    TVirtualProtocol<TDenseProtocol, TBinaryProtocol>(trans),
     type_spec_(type_spec),
+    depth_(0),
     standalone_(true)
   {}
 
@@ -89,56 +90,60 @@ class TDenseProtocol : public TBinaryProtocol {
    * Writing functions.
    */
 
-  virtual uint32_t writeMessageBegin(const std::string& name,
-                                     const TMessageType messageType,
-                                     const int32_t seqid);
+  uint32_t writeMessageBegin(const std::string& name,
+                             const TMessageType messageType,
+                             const int32_t seqid);
 
-  virtual uint32_t writeMessageEnd();
+  uint32_t writeMessageEnd();
 
 
-  virtual uint32_t writeStructBegin(const char* name);
+  uint32_t writeStructBegin(const char* name);
 
-  virtual uint32_t writeStructEnd();
+  uint32_t writeStructEnd();
 
-  virtual uint32_t writeFieldBegin(const char* name,
-                                   const TType fieldType,
-                                   const int16_t fieldId);
+  uint32_t writeFieldBegin(const char* name,
+                           const TType fieldType,
+                           const int16_t fieldId);
 
-  virtual uint32_t writeFieldEnd();
+  uint32_t writeFieldEnd();
 
-  virtual uint32_t writeFieldStop();
+  uint32_t writeFieldStop();
 
-  virtual uint32_t writeMapBegin(const TType keyType,
-                                 const TType valType,
-                                 const uint32_t size);
+  uint32_t writeMapBegin(const TType keyType,
+                         const TType valType,
+                         const uint32_t size);
 
-  virtual uint32_t writeMapEnd();
+  uint32_t writeMapEnd();
 
-  virtual uint32_t writeListBegin(const TType elemType,
-                                  const uint32_t size);
+  uint32_t writeListBegin(const TType elemType,
+                          const uint32_t size);
 
-  virtual uint32_t writeListEnd();
+  uint32_t writeListEnd();
 
-  virtual uint32_t writeSetBegin(const TType elemType,
-                                 const uint32_t size);
+  uint32_t writeSetBegin(const TType elemType,
+                         const uint32_t size);
 
-  virtual uint32_t writeSetEnd();
+  uint32_t writeSetEnd();
 
-  virtual uint32_t writeBool(const bool value);
+  uint32_t writeBool(const bool value);
 
-  virtual uint32_t writeByte(const int8_t byte);
+  uint32_t writeByte(const int8_t byte);
 
-  virtual uint32_t writeI16(const int16_t i16);
+  uint32_t writeI16(const int16_t i16);
 
-  virtual uint32_t writeI32(const int32_t i32);
+  uint32_t writeI32(const int32_t i32);
 
-  virtual uint32_t writeI64(const int64_t i64);
+  uint32_t writeI64(const int64_t i64);
 
-  virtual uint32_t writeDouble(const double dub);
+  uint32_t writeDouble(const double dub);
 
-  virtual uint32_t writeString(const std::string& str);
+  uint32_t writeString(const std::string& str);
+  // Provide the default (pointer, length) writeString()
+  using TVirtualProtocol<TDenseProtocol, TBinaryProtocol>::writeString;
 
-  virtual uint32_t writeBinary(const std::string& str);
+  uint32_t writeBinary(const std::string& str);
+  // Provide the default (pointer, length) writeBinary()
+  using TVirtualProtocol<TDenseProtocol, TBinaryProtocol>::writeBinary;
 
 
   /*
@@ -160,16 +165,22 @@ class TDenseProtocol : public TBinaryProtocol {
   uint32_t readMessageBegin(std::string& name,
                             TMessageType& messageType,
                             int32_t& seqid);
+  // Provide the default name-free readMessageBegin()
+  using TVirtualProtocol<TDenseProtocol, TBinaryProtocol>::readMessageBegin;
 
   uint32_t readMessageEnd();
 
   uint32_t readStructBegin(std::string& name);
+  // Provide the default name-free readStructBegin()
+  using TVirtualProtocol<TDenseProtocol, TBinaryProtocol>::readStructBegin;
 
   uint32_t readStructEnd();
 
   uint32_t readFieldBegin(std::string& name,
                           TType& fieldType,
                           int16_t& fieldId);
+  // Provide the default name-free readFieldBegin()
+  using TVirtualProtocol<TDenseProtocol, TBinaryProtocol>::readFieldBegin;
 
   uint32_t readFieldEnd();
 
@@ -190,6 +201,8 @@ class TDenseProtocol : public TBinaryProtocol {
   uint32_t readSetEnd();
 
   uint32_t readBool(bool& value);
+  // Provide the default readBool() implementation for std::vector<bool>
+  using TVirtualProtocol<TDenseProtocol, TBinaryProtocol>::readBool;
 
   uint32_t readByte(int8_t& byte);
 
@@ -202,8 +215,12 @@ class TDenseProtocol : public TBinaryProtocol {
   uint32_t readDouble(double& dub);
 
   uint32_t readString(std::string& str);
+  // Provide the default (pointer, length) readString()
+  using TVirtualProtocol<TDenseProtocol, TBinaryProtocol>::readString;
 
   uint32_t readBinary(std::string& str);
+  // Provide the default (pointer, length) readBinary()
+  using TVirtualProtocol<TDenseProtocol, TBinaryProtocol>::readBinary;
 
   /*
    * Helper reading functions (don't do state transitions).
@@ -217,32 +234,42 @@ class TDenseProtocol : public TBinaryProtocol {
   }
 
 
+ protected:
+
+  // Read and write variable-length integers.
+  // Uses the same technique as the MIDI file format.
+  uint32_t vlqRead(uint64_t& vlq);
+  uint32_t vlqWrite(uint64_t vlq);
+
  private:
 
+  // Deepest nesting of structures and containers we can follow.
+  static const int32_t MAX_DEPTH = 64;
+
   // Implementation functions, documented in the .cpp.
   inline void checkTType(const TType ttype);
   inline void stateTransition();
-
-  // Read and write variable-length integers.
-  // Uses the same technique as the MIDI file format.
-  inline uint32_t vlqRead(uint64_t& vlq);
-  inline uint32_t vlqWrite(uint64_t vlq);
+  inline void pushTypeSpec(TypeSpec* ts);
+  inline void writeOutput(const uint8_t* buf, uint32_t len);
+  uint32_t vlqReadSlow(uint64_t& vlq);
 
   // Called before throwing an exception to make the object reusable.
   void resetState() {
-    ts_stack_.clear();
-    idx_stack_.clear();
-    mkv_stack_.clear();
+    depth_ = 0;
   }
 
   // TypeSpec of the top-level structure to write,
   // for standalone protocol objects.
   TypeSpec* type_spec_;
 
-  std::vector<TypeSpec*> ts_stack_;   // TypeSpec stack.
-  std::vector<int>       idx_stack_;  // InDeX stack.
-  std::vector<bool>      mkv_stack_;  // Map Key/Vlue stack.
-                                      // True = key, False = value.
+  // The stacks are preallocated so nothing is allocated while reading or
+  // writing.  They are parallel: each level has a TypeSpec, and a field index
+  // if that is a structure or a key/value flag if it is a map.
+  TypeSpec* ts_stack_[MAX_DEPTH];   // TypeSpec stack.
+  int32_t   idx_stack_[MAX_DEPTH];  // InDeX stack.
+  bool      mkv_stack_[MAX_DEPTH];  // Map Key/Value stack.
+                                    // True = key, False = value.
+  int32_t   depth_;                 // Levels in use.
 
   // True iff this is a standalone instance (no RPC).
   bool standalone_;
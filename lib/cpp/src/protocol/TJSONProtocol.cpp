@@ -19,8 +19,19 @@
 
 #include "TJSONProtocol.h"
 
+#include <errno.h>
+#include <locale.h>
 #include <math.h>
-#include <boost/lexical_cast.hpp>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <exception>
+#include <limits>
+#ifdef __AVX2__
+#include <immintrin.h>
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "TBase64Utils.h"
 #include <transport/TTransportException.h>
 
@@ -172,17 +183,23 @@ const static uint8_t kEscapeCharVals[7] = {
 
 // Static helper functions
 
+// Throw a protocol exception for finding ch2 instead of ch. Kept apart so
+// that readSyntaxChar() stays small enough to inline.
+static void throwUnexpectedChar(uint8_t ch, uint8_t ch2) {
+  throw TProtocolException(TProtocolException::INVALID_DATA,
+                           "Expected \'" + std::string((char *)&ch, 1) +
+                           "\'; got \'" + std::string((char *)&ch2, 1) +
+                           "\'.");
+}
+
 // Read 1 character from the transport trans and verify that it is the
 // expected character ch.
 // Throw a protocol exception if it is not.
-static uint32_t readSyntaxChar(TJSONProtocol::LookaheadReader &reader,
-                               uint8_t ch) {
+static inline uint32_t readSyntaxChar(TJSONProtocol::LookaheadReader &reader,
+                                      uint8_t ch) {
   uint8_t ch2 = reader.read();
   if (ch2 != ch) {
-    throw TProtocolException(TProtocolException::INVALID_DATA,
-                             "Expected \'" + std::string((char *)&ch, 1) +
-                             "\'; got \'" + std::string((char *)&ch2, 1) +
-                             "\'.");
+    throwUnexpectedChar(ch, ch2);
   }
   return 1;
 }
@@ -215,6 +232,63 @@ static uint8_t hexChar(uint8_t val) {
   }
 }
 
+// Return a pointer to the first character in [p, end) that is '"' or '\\',
+// or a control character if Controls is true, or end if there is none.
+// Those are the characters that need escaping in a JSON string, and the ones
+// ending a run of plain characters when reading one. Checks 32 or 16
+// characters at a time where the CPU allows.
+template <bool Controls>
+static const uint8_t *findJSONSpecial(const uint8_t *p, const uint8_t *end) {
+#ifdef __AVX2__
+  const __m256i quote32 = _mm256_set1_epi8(kJSONStringDelimiter);
+  const __m256i backslash32 = _mm256_set1_epi8(kJSONBackslash);
+  const __m256i control32 = _mm256_set1_epi8(0x1f);
+  while (end - p >= 32) {
+    __m256i v = _mm256_loadu_si256((const __m256i *)p);
+    __m256i special = _mm256_or_si256(_mm256_cmpeq_epi8(v, quote32),
+                                      _mm256_cmpeq_epi8(v, backslash32));
+    if (Controls) {
+      // unsigned v <= 0x1f
+      special = _mm256_or_si256(special, _mm256_cmpeq_epi8(
+          _mm256_max_epu8(v, control32), control32));
+    }
+    uint32_t mask = (uint32_t)_mm256_movemask_epi8(special);
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 32;
+  }
+#endif
+#ifdef __SSE2__
+  const __m128i quote = _mm_set1_epi8(kJSONStringDelimiter);
+  const __m128i backslash = _mm_set1_epi8(kJSONBackslash);
+  const __m128i control = _mm_set1_epi8(0x1f);
+  while (end - p >= 16) {
+    __m128i v = _mm_loadu_si128((const __m128i *)p);
+    __m128i special = _mm_or_si128(_mm_cmpeq_epi8(v, quote),
+                                   _mm_cmpeq_epi8(v, backslash));
+    if (Controls) {
+      special = _mm_or_si128(special, _mm_cmpeq_epi8(
+          _mm_max_epu8(v, control), control));
+    }
+    uint32_t mask = (uint32_t)_mm_movemask_epi8(special);
+    if (mask) {
+      return p + __builtin_ctz(mask);
+    }
+    p += 16;
+  }
+#endif
+  while (p != end) {
+    uint8_t ch = *p;
+    if ((Controls && ch < 0x20) ||
+        ch == kJSONStringDelimiter || ch == kJSONBackslash) {
+      break;
+    }
+    ++p;
+  }
+  return p;
+}
+
 // Return true if the character ch is in [-+0-9.Ee]; false otherwise
 static bool isJSONNumeric(uint8_t ch) {
   switch (ch) {
@@ -239,139 +313,252 @@ static bool isJSONNumeric(uint8_t ch) {
 }
 
 
-/**
- * Class to serve as base JSON context and as base class for other context
- * implementations
- */
-class TJSONContext {
-
- public:
-
-  TJSONContext() {};
-
-  virtual ~TJSONContext() {};
-
-  /**
-   * Write context data to the transport. Default is to do nothing.
-   */
-  virtual uint32_t write(TTransport &trans) {
-    return 0;
-  };
-
-  /**
-   * Read context data from the transport. Default is to do nothing.
-   */
-  virtual uint32_t read(TJSONProtocol::LookaheadReader &reader) {
-    return 0;
-  };
+// Formats the integer num into the end of the buffer ending at end, returning
+// where the digits start
+static char *formatJSONInteger(int64_t num, char *end) {
+  uint64_t mag = (num < 0) ? (0 - (uint64_t)num) : (uint64_t)num;
+  char *p = end;
+  do {
+    *--p = '0' + (char)(mag % 10);
+    mag /= 10;
+  } while (mag != 0);
+  if (num < 0) {
+    *--p = '-';
+  }
+  return p;
+}
 
-  /**
-   * Return true if numbers need to be escaped as strings in this context.
-   * Default behavior is to return false.
-   */
-  virtual bool escapeNum() {
+// Parses str as a decimal integer of type NumberType, with an optional sign.
+// Returns false if it is not one or it does not fit. Negative values are
+// accepted for unsigned types and wrap around, as boost::lexical_cast does.
+template <typename NumberType>
+static bool parseJSONInteger(const std::string &str, NumberType &num) {
+  const char *p = str.data();
+  const char *end = p + str.size();
+  bool negative = false;
+  if ((p != end) && ((*p == '-') || (*p == '+'))) {
+    negative = (*p == '-');
+    ++p;
+  }
+  if (p == end) {
     return false;
   }
-};
-
-// Context class for object member key-value pairs
-class JSONPairContext : public TJSONContext {
-
-public:
-
-  JSONPairContext() :
-    first_(true),
-    colon_(true) {
+  uint64_t limit = (uint64_t)std::numeric_limits<NumberType>::max();
+  if (negative && std::numeric_limits<NumberType>::is_signed) {
+    limit += 1;
   }
-
-  uint32_t write(TTransport &trans) {
-    if (first_) {
-      first_ = false;
-      colon_ = true;
-      return 0;
-    }
-    else {
-      trans.write(colon_ ? &kJSONPairSeparator : &kJSONElemSeparator, 1);
-      colon_ = !colon_;
-      return 1;
+  uint64_t mag = 0;
+  for (; p != end; ++p) {
+    uint32_t digit = (uint8_t)*p - '0';
+    if ((digit > 9) || (mag > (limit - digit) / 10)) {
+      return false;
     }
+    mag = mag * 10 + digit;
   }
+  num = (NumberType)(negative ? (0 - mag) : mag);
+  return true;
+}
+
+// The decimal point of the C library's LC_NUMERIC locale, which snprintf()
+// and strtod() use, or NULL if it is '.'
+static const char *localeDecimalPoint() {
+  const char *point = localeconv()->decimal_point;
+  return (point[0] == '.' && point[1] == '\0') ? NULL : point;
+}
 
-  uint32_t read(TJSONProtocol::LookaheadReader &reader) {
-    if (first_) {
-      first_ = false;
-      colon_ = true;
-      return 0;
+static const char *skipDigits(const char *p, const char *end) {
+  while ((p != end) && ((uint32_t)((uint8_t)*p - '0') <= 9)) {
+    ++p;
+  }
+  return p;
+}
+
+// Parses str as a decimal double, with an optional sign, fraction and
+// exponent. Returns false if it is not one or it is too large, as
+// boost::lexical_cast did, whatever the locale.
+static bool parseJSONDouble(const std::string &str, double &num) {
+  // strtod() would also take whitespace, hex, "inf" and "nan"
+  const char *p = str.data();
+  const char *end = p + str.size();
+  if ((p != end) && ((*p == '-') || (*p == '+'))) {
+    ++p;
+  }
+  const char *digits = p;
+  p = skipDigits(p, end);
+  size_t numDigits = p - digits;
+  const char *point = NULL;
+  if ((p != end) && (*p == '.')) {
+    point = p;
+    digits = ++p;
+    p = skipDigits(p, end);
+    numDigits += p - digits;
+  }
+  if (numDigits == 0) {
+    return false;
+  }
+  if ((p != end) && ((*p == 'e') || (*p == 'E'))) {
+    ++p;
+    if ((p != end) && ((*p == '-') || (*p == '+'))) {
+      ++p;
     }
-    else {
-      uint8_t ch = (colon_ ? kJSONPairSeparator : kJSONElemSeparator);
-      colon_ = !colon_;
-      return readSyntaxChar(reader, ch);
+    digits = p;
+    p = skipDigits(p, end);
+    if (p == digits) {
+      return false;
     }
   }
-
-  // Numbers must be turned into strings if they are the key part of a pair
-  virtual bool escapeNum() {
-    return colon_;
+  if (p != end) {
+    return false;
   }
 
-  private:
-
-    bool first_;
-    bool colon_;
-};
-
-// Context class for lists
-class JSONListContext : public TJSONContext {
-
-public:
-
-  JSONListContext() :
-    first_(true) {
+  std::string localized;
+  const char *decimalPoint = (point != NULL) ? localeDecimalPoint() : NULL;
+  if (decimalPoint != NULL) {
+    localized = str;
+    localized.replace(point - str.data(), 1, decimalPoint);
   }
-
-  uint32_t write(TTransport &trans) {
-    if (first_) {
-      first_ = false;
-      return 0;
-    }
-    else {
-      trans.write(&kJSONElemSeparator, 1);
-      return 1;
-    }
+  const std::string &input = (decimalPoint != NULL) ? localized : str;
+  char *parsed;
+  errno = 0;
+  num = strtod(input.c_str(), &parsed);
+  if ((errno == ERANGE) && ((num == HUGE_VAL) || (num == -HUGE_VAL))) {
+    return false;
   }
+  return parsed == input.c_str() + input.size();
+}
 
-  uint32_t read(TJSONProtocol::LookaheadReader &reader) {
-    if (first_) {
-      first_ = false;
-      return 0;
-    }
-    else {
-      return readSyntaxChar(reader, kJSONElemSeparator);
+
+// Calls resetRead() if the read it is declared in throws, so the next read
+// starts afresh rather than in the middle of a value, on what it borrowed
+// from a transport that may have been reset since
+class TJSONProtocol::ReadGuard {
+ public:
+  explicit ReadGuard(TJSONProtocol &proto) : proto_(proto) {}
+
+  ~ReadGuard() {
+    if (std::uncaught_exception()) {
+      proto_.resetRead();
     }
   }
 
-  private:
-    bool first_;
+ private:
+  TJSONProtocol &proto_;
 };
 
-
 TJSONProtocol::TJSONProtocol(boost::shared_ptr<TTransport> ptrans) :
-  TProtocol(ptrans),
-  context_(new TJSONContext()),
+  TVirtualProtocol<TJSONProtocol>(ptrans),
+  depth_(0),
+  context_(CONTEXT_BASE),
   reader_(*ptrans) {
 }
 
 TJSONProtocol::~TJSONProtocol() {}
 
-void TJSONProtocol::pushContext(boost::shared_ptr<TJSONContext> c) {
-  contexts_.push(context_);
-  context_ = c;
+void TJSONProtocol::pushContext(ContextState state) {
+  if (depth_ < INLINE_CONTEXTS) {
+    contexts_[depth_] = context_;
+  }
+  else {
+    deepContexts_.push_back(context_);
+  }
+  ++depth_;
+  context_ = state;
+}
+
+void TJSONProtocol::resetRead() {
+  depth_ = 0;
+  deepContexts_.clear();
+  context_ = CONTEXT_BASE;
+  reader_.reset();
 }
 
 void TJSONProtocol::popContext() {
-  context_ = contexts_.top();
-  contexts_.pop();
+  --depth_;
+  if (depth_ < INLINE_CONTEXTS) {
+    context_ = (ContextState)contexts_[depth_];
+  }
+  else {
+    context_ = (ContextState)deepContexts_.back();
+    deepContexts_.pop_back();
+  }
+  if (depth_ == 0) {
+    // Done with the outermost value, give the transport back what was read
+    reader_.release();
+  }
+}
+
+// Write the separator that goes before the next value in the current context
+uint32_t TJSONProtocol::writeContext() {
+  switch (context_) {
+  case CONTEXT_LIST_FIRST:
+    context_ = CONTEXT_LIST;
+    return 0;
+  case CONTEXT_LIST:
+    trans_->write(&kJSONElemSeparator, 1);
+    return 1;
+  case CONTEXT_PAIR_FIRST:
+    context_ = CONTEXT_PAIR_KEY;
+    return 0;
+  case CONTEXT_PAIR_KEY:
+    context_ = CONTEXT_PAIR_VALUE;
+    trans_->write(&kJSONPairSeparator, 1);
+    return 1;
+  case CONTEXT_PAIR_VALUE:
+    context_ = CONTEXT_PAIR_KEY;
+    trans_->write(&kJSONElemSeparator, 1);
+    return 1;
+  default:
+    return 0;
+  }
+}
+
+// Read and check the separator that goes before the next value in the current
+// context
+uint32_t TJSONProtocol::readContext() {
+  switch (context_) {
+  case CONTEXT_LIST_FIRST:
+    context_ = CONTEXT_LIST;
+    return 0;
+  case CONTEXT_LIST:
+    return readSyntaxChar(reader_, kJSONElemSeparator);
+  case CONTEXT_PAIR_FIRST:
+    context_ = CONTEXT_PAIR_KEY;
+    return 0;
+  case CONTEXT_PAIR_KEY:
+    context_ = CONTEXT_PAIR_VALUE;
+    return readSyntaxChar(reader_, kJSONPairSeparator);
+  case CONTEXT_PAIR_VALUE:
+    context_ = CONTEXT_PAIR_KEY;
+    return readSyntaxChar(reader_, kJSONElemSeparator);
+  default:
+    return 0;
+  }
+}
+
+void TJSONProtocol::LookaheadReader::fill() {
+  release();
+  uint32_t len = 1;
+  const uint8_t *buf = trans_->borrow(NULL, &len);
+  if (buf != NULL) {
+    start_ = pos_ = buf;
+    end_ = buf + len;
+  }
+  else {
+    // Only take one byte, so nothing after the message is lost
+    trans_->readAll(&data_, 1);
+    pos_ = &data_;
+    end_ = pos_ + 1;
+  }
+}
+
+void TJSONProtocol::LookaheadReader::release() {
+  // A byte read into data_ is ours, so a peeked one stays
+  if (start_ != NULL) {
+    if (pos_ != start_) {
+      trans_->consume(pos_ - start_);
+    }
+    start_ = pos_ = end_ = NULL;
+  }
 }
 
 // Write the character ch as a JSON escape sequence ("\u00xx")
@@ -419,13 +606,22 @@ uint32_t TJSONProtocol::writeJSONChar(uint8_t ch) {
 // Write out the contents of the string str as a JSON string, escaping
 // characters as appropriate.
 uint32_t TJSONProtocol::writeJSONString(const std::string &str) {
-  uint32_t result = context_->write(*trans_);
+  uint32_t result = writeContext();
   result += 2; // For quotes
   trans_->write(&kJSONStringDelimiter, 1);
-  std::string::const_iterator iter(str.begin());
-  std::string::const_iterator end(str.end());
+  const uint8_t *iter = (const uint8_t *)str.data();
+  const uint8_t *end = iter + str.length();
   while (iter != end) {
-    result += writeJSONChar(*iter++);
+    // Write everything up to the next character needing an escape at once
+    const uint8_t *escape = findJSONSpecial<true>(iter, end);
+    if (escape != iter) {
+      trans_->write(iter, escape - iter);
+      result += escape - iter;
+      iter = escape;
+    }
+    if (iter != end) {
+      result += writeJSONChar(*iter++);
+    }
   }
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
@@ -434,24 +630,20 @@ uint32_t TJSONProtocol::writeJSONString(const std::string &str) {
 // Write out the contents of the string as JSON string, base64-encoding
 // the string's contents, and escaping as appropriate
 uint32_t TJSONProtocol::writeJSONBase64(const std::string &str) {
-  uint32_t result = context_->write(*trans_);
+  uint32_t result = writeContext();
   result += 2; // For quotes
   trans_->write(&kJSONStringDelimiter, 1);
-  uint8_t b[4];
-  const uint8_t *bytes = (const uint8_t *)str.c_str();
+  // Encode a multiple of 3 bytes at a time, so only the end has padding
+  uint8_t b[4096];
+  const uint8_t *bytes = (const uint8_t *)str.data();
   uint32_t len = str.length();
-  while (len >= 3) {
-    // Encode 3 bytes at a time
-    base64_encode(bytes, 3, b);
-    trans_->write(b, 4);
-    result += 4;
-    bytes += 3;
-    len -=3;
-  }
-  if (len) { // Handle remainder
-    base64_encode(bytes, len, b);
-    trans_->write(b, len + 1);
-    result += len + 1;
+  while (len > 0) {
+    uint32_t chunk = (len < 3072) ? len : 3072;
+    uint32_t encoded = base64_encode_block(bytes, chunk, b);
+    trans_->write(b, encoded);
+    result += encoded;
+    bytes += chunk;
+    len -= chunk;
   }
   trans_->write(&kJSONStringDelimiter, 1);
   return result;
@@ -461,67 +653,70 @@ uint32_t TJSONProtocol::writeJSONBase64(const std::string &str) {
 // if the context requires it (eg: key in a map pair).
 template <typename NumberType>
 uint32_t TJSONProtocol::writeJSONInteger(NumberType num) {
-  uint32_t result = context_->write(*trans_);
-  std::string val(boost::lexical_cast<std::string>(num));
-  bool escapeNum = context_->escapeNum();
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+  uint32_t result = writeContext();
+  // Room for the quotes, a sign and 19 digits
+  char buf[24];
+  char *end = buf + sizeof(buf) - 1;
+  char *val = formatJSONInteger((int64_t)num, end);
+  if (escapeNum()) {
+    *--val = kJSONStringDelimiter;
+    *end++ = kJSONStringDelimiter;
   }
-  trans_->write((const uint8_t *)val.c_str(), val.length());
-  result += val.length();
-  if (escapeNum) {
-    trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
-  return result;
+  trans_->write((const uint8_t *)val, end - val);
+  return result + (end - val);
 }
 
 // Convert the given double to a JSON string, which is either the number,
 // "NaN" or "Infinity" or "-Infinity".
 uint32_t TJSONProtocol::writeJSONDouble(double num) {
-  uint32_t result = context_->write(*trans_);
-  std::string val(boost::lexical_cast<std::string>(num));
-
-  // Normalize output of boost::lexical_cast for NaNs and Infinities
-  bool special = false;
-  switch (val[0]) {
-  case 'N':
-  case 'n':
-    val = kThriftNan;
-    special = true;
-    break;
-  case 'I':
-  case 'i':
-    val = kThriftInfinity;
-    special = true;
-    break;
-  case '-':
-    if ((val[1] == 'I') || (val[1] == 'i')) {
-      val = kThriftNegativeInfinity;
-      special = true;
-    }
-    break;
+  uint32_t result = writeContext();
+  const std::string *special = NULL;
+  if (num != num) {
+    special = &kThriftNan;
+  }
+  else if (num == HUGE_VAL) {
+    special = &kThriftInfinity;
+  }
+  else if (num == -HUGE_VAL) {
+    special = &kThriftNegativeInfinity;
   }
 
-  bool escapeNum = special || context_->escapeNum();
-  if (escapeNum) {
+  if (special != NULL) {
     trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
-  }
-  trans_->write((const uint8_t *)val.c_str(), val.length());
-  result += val.length();
-  if (escapeNum) {
+    trans_->write((const uint8_t *)special->data(), special->length());
     trans_->write(&kJSONStringDelimiter, 1);
-    result += 1;
+    return result + special->length() + 2;
   }
-  return result;
+
+  // 17 significant digits always read back as the same double, and are what
+  // boost::lexical_cast used to produce
+  char buf[32];
+  char *val = buf + 1;
+  int len = snprintf(val, sizeof(buf) - 2, "%.17g", num);
+  const char *decimalPoint = localeDecimalPoint();
+  if (decimalPoint != NULL) {
+    // JSON wants a '.' whatever the locale says
+    char *point = strstr(val, decimalPoint);
+    if (point != NULL) {
+      size_t pointLen = strlen(decimalPoint);
+      *point = '.';
+      memmove(point + 1, point + pointLen, val + len - (point + pointLen) + 1);
+      len -= pointLen - 1;
+    }
+  }
+  if (escapeNum()) {
+    *--val = kJSONStringDelimiter;
+    val[++len] = kJSONStringDelimiter;
+    ++len;
+  }
+  trans_->write((const uint8_t *)val, len);
+  return result + len;
 }
 
 uint32_t TJSONProtocol::writeJSONObjectStart() {
-  uint32_t result = context_->write(*trans_);
+  uint32_t result = writeContext();
   trans_->write(&kJSONObjectStart, 1);
-  pushContext(boost::shared_ptr<TJSONContext>(new JSONPairContext()));
+  pushContext(CONTEXT_PAIR_FIRST);
   return result + 1;
 }
 
@@ -532,9 +727,9 @@ uint32_t TJSONProtocol::writeJSONObjectEnd() {
 }
 
 uint32_t TJSONProtocol::writeJSONArrayStart() {
-  uint32_t result = context_->write(*trans_);
+  uint32_t result = writeContext();
   trans_->write(&kJSONArrayStart, 1);
-  pushContext(boost::shared_ptr<TJSONContext>(new JSONListContext()));
+  pushContext(CONTEXT_LIST_FIRST);
   return result + 1;
 }
 
@@ -628,8 +823,6 @@ uint32_t TJSONProtocol::writeBool(const bool value) {
 }
 
 uint32_t TJSONProtocol::writeByte(const int8_t byte) {
-  // writeByte() must be handled specially becuase boost::lexical cast sees
-  // int8_t as a text type instead of an integer type
   return writeJSONInteger((int16_t)byte);
 }
 
@@ -680,55 +873,58 @@ uint32_t TJSONProtocol::readJSONEscapeChar(uint8_t *out) {
 
 // Decodes a JSON string, including unescaping, and returns the string via str
 uint32_t TJSONProtocol::readJSONString(std::string &str, bool skipContext) {
-  uint32_t result = (skipContext ? 0 : context_->read(reader_));
+  uint32_t result = (skipContext ? 0 : readContext());
   result += readJSONSyntaxChar(kJSONStringDelimiter);
   uint8_t ch;
   str.clear();
   while (true) {
+    // Take everything up to the closing quote or an escape at once
+    uint32_t len;
+    const uint8_t *buf = reader_.buffer(&len);
+    uint32_t run = findJSONSpecial<false>(buf, buf + len) - buf;
+    if (run > 0) {
+      str.append((const char *)buf, run);
+      reader_.skip(run);
+      result += run;
+      if (run == len) {
+        continue;
+      }
+    }
     ch = reader_.read();
     ++result;
     if (ch == kJSONStringDelimiter) {
       break;
     }
-    if (ch == kJSONBackslash) {
-      ch = reader_.read();
-      ++result;
-      if (ch == kJSONEscapeChar) {
-        result += readJSONEscapeChar(&ch);
-      }
-      else {
-        size_t pos = kEscapeChars.find(ch);
-        if (pos == std::string::npos) {
-          throw TProtocolException(TProtocolException::INVALID_DATA,
-                                   "Expected control char, got '" +
-                                   std::string((const char *)&ch, 1)  + "'.");
-        }
-        ch = kEscapeCharVals[pos];
+    // ch is a backslash
+    ch = reader_.read();
+    ++result;
+    if (ch == kJSONEscapeChar) {
+      result += readJSONEscapeChar(&ch);
+    }
+    else {
+      size_t pos = kEscapeChars.find(ch);
+      if (pos == std::string::npos) {
+        throw TProtocolException(TProtocolException::INVALID_DATA,
+                                 "Expected control char, got '" +
+                                 std::string((const char *)&ch, 1)  + "'.");
       }
+      ch = kEscapeCharVals[pos];
     }
     str += ch;
   }
+  if (depth_ == 0) {
+    reader_.release();
+  }
   return result;
 }
 
 // Reads a block of base64 characters, decoding it, and returns via str
 uint32_t TJSONProtocol::readJSONBase64(std::string &str) {
-  std::string tmp;
-  uint32_t result = readJSONString(tmp);
-  uint8_t *b = (uint8_t *)tmp.c_str();
-  uint32_t len = tmp.length();
-  str.clear();
-  while (len >= 4) {
-    base64_decode(b, 4);
-    str.append((const char *)b, 3);
-    b += 4;
-    len -= 4;
-  }
-  // Don't decode if we hit the end or got a single leftover byte (invalid
-  // base64 but legal for skip of regular string type)
-  if (len > 1) {
-    base64_decode(b, len);
-    str.append((const char *)b, len - 1);
+  uint32_t result = readJSONString(str);
+  // A single leftover byte is not decoded (invalid base64 but legal for skip
+  // of regular string type)
+  if (!str.empty()) {
+    str.resize(base64_decode_block((uint8_t *)&str[0], str.length()));
   }
   return result;
 }
@@ -739,13 +935,18 @@ uint32_t TJSONProtocol::readJSONNumericChars(std::string &str) {
   uint32_t result = 0;
   str.clear();
   while (true) {
-    uint8_t ch = reader_.peek();
-    if (!isJSONNumeric(ch)) {
+    uint32_t len;
+    const uint8_t *buf = reader_.buffer(&len);
+    uint32_t run = 0;
+    while (run < len && isJSONNumeric(buf[run])) {
+      ++run;
+    }
+    str.append((const char *)buf, run);
+    reader_.skip(run);
+    result += run;
+    if (run < len) {
       break;
     }
-    reader_.read();
-    str += ch;
-    ++result;
   }
   return result;
 }
@@ -754,30 +955,29 @@ uint32_t TJSONProtocol::readJSONNumericChars(std::string &str) {
 // returning them via num
 template <typename NumberType>
 uint32_t TJSONProtocol::readJSONInteger(NumberType &num) {
-  uint32_t result = context_->read(reader_);
-  if (context_->escapeNum()) {
+  uint32_t result = readContext();
+  if (escapeNum()) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
   }
-  std::string str;
-  result += readJSONNumericChars(str);
-  try {
-    num = boost::lexical_cast<NumberType>(str);
-  }
-  catch (boost::bad_lexical_cast e) {
-    throw new TProtocolException(TProtocolException::INVALID_DATA,
-                                 "Expected numeric value; got \"" + str +
-                                  "\"");
+  result += readJSONNumericChars(numericChars_);
+  if (!parseJSONInteger(numericChars_, num)) {
+    throw TProtocolException(TProtocolException::INVALID_DATA,
+                             "Expected numeric value; got \"" +
+                             numericChars_ + "\"");
   }
-  if (context_->escapeNum()) {
+  if (escapeNum()) {
     result += readJSONSyntaxChar(kJSONStringDelimiter);
   }
+  if (depth_ == 0) {
+    reader_.release();
+  }
   return result;
 }
 
 // Reads a JSON number or string and interprets it as a double.
 uint32_t TJSONProtocol::readJSONDouble(double &num) {
-  uint32_t result = context_->read(reader_);
-  std::string str;
+  uint32_t result = readContext();
+  std::string &str = numericChars_;
   if (reader_.peek() == kJSONStringDelimiter) {
     result += readJSONString(str, true);
     // Check for NaN, Infinity and -Infinity
@@ -791,43 +991,40 @@ uint32_t TJSONProtocol::readJSONDouble(double &num) {
       num = -HUGE_VAL;
     }
     else {
-      if (!context_->escapeNum()) {
+      if (!escapeNum()) {
         // Throw exception -- we should not be in a string in this case
-        throw new TProtocolException(TProtocolException::INVALID_DATA,
-                                     "Numeric data unexpectedly quoted");
-      }
-      try {
-        num = boost::lexical_cast<double>(str);
+        throw TProtocolException(TProtocolException::INVALID_DATA,
+                                 "Numeric data unexpectedly quoted");
       }
-      catch (boost::bad_lexical_cast e) {
-        throw new TProtocolException(TProtocolException::INVALID_DATA,
-                                     "Expected numeric value; got \"" + str +
-                                     "\"");
+      if (!parseJSONDouble(str, num)) {
+        throw TProtocolException(TProtocolException::INVALID_DATA,
+                                 "Expected numeric value; got \"" + str +
+                                 "\"");
       }
     }
   }
   else {
-    if (context_->escapeNum()) {
+    if (escapeNum()) {
       // This will throw - we should have had a quote if escapeNum == true
       readJSONSyntaxChar(kJSONStringDelimiter);
     }
     result += readJSONNumericChars(str);
-    try {
-      num = boost::lexical_cast<double>(str);
-    }
-    catch (boost::bad_lexical_cast e) {
-      throw new TProtocolException(TProtocolException::INVALID_DATA,
-                                   "Expected numeric value; got \"" + str +
-                                   "\"");
+    if (!parseJSONDouble(str, num)) {
+      throw TProtocolException(TProtocolException::INVALID_DATA,
+                               "Expected numeric value; got \"" + str +
+                               "\"");
     }
   }
+  if (depth_ == 0) {
+    reader_.release();
+  }
   return result;
 }
 
 uint32_t TJSONProtocol::readJSONObjectStart() {
-  uint32_t result = context_->read(reader_);
+  uint32_t result = readContext();
   result += readJSONSyntaxChar(kJSONObjectStart);
-  pushContext(boost::shared_ptr<TJSONContext>(new JSONPairContext()));
+  pushContext(CONTEXT_PAIR_FIRST);
   return result;
 }
 
@@ -838,9 +1035,9 @@ uint32_t TJSONProtocol::readJSONObjectEnd() {
 }
 
 uint32_t TJSONProtocol::readJSONArrayStart() {
-  uint32_t result = context_->read(reader_);
+  uint32_t result = readContext();
   result += readJSONSyntaxChar(kJSONArrayStart);
-  pushContext(boost::shared_ptr<TJSONContext>(new JSONListContext()));
+  pushContext(CONTEXT_LIST_FIRST);
   return result;
 }
 
@@ -853,6 +1050,11 @@ uint32_t TJSONProtocol::readJSONArrayEnd() {
 uint32_t TJSONProtocol::readMessageBegin(std::string& name,
                                          TMessageType& messageType,
                                          int32_t& seqid) {
+  ReadGuard guard(*this);
+  if (depth_ != 0) {
+    // A message is never nested, so the last one was given up on part way
+    resetRead();
+  }
   uint32_t result = readJSONArrayStart();
   uint64_t tmpVal = 0;
   result += readJSONInteger(tmpVal);
@@ -869,20 +1071,24 @@ uint32_t TJSONProtocol::readMessageBegin(std::string& name,
 }
 
 uint32_t TJSONProtocol::readMessageEnd() {
+  ReadGuard guard(*this);
   return readJSONArrayEnd();
 }
 
 uint32_t TJSONProtocol::readStructBegin(std::string& name) {
+  ReadGuard guard(*this);
   return readJSONObjectStart();
 }
 
 uint32_t TJSONProtocol::readStructEnd() {
+  ReadGuard guard(*this);
   return readJSONObjectEnd();
 }
 
 uint32_t TJSONProtocol::readFieldBegin(std::string& name,
                                        TType& fieldType,
                                        int16_t& fieldId) {
+  ReadGuard guard(*this);
   uint32_t result = 0;
   // Check if we hit the end of the list
   uint8_t ch = reader_.peek();
@@ -908,6 +1114,7 @@ uint32_t TJSONProtocol::readFieldEnd() {
 uint32_t TJSONProtocol::readMapBegin(TType& keyType,
                                      TType& valType,
                                      uint32_t& size) {
+  ReadGuard guard(*this);
   uint64_t tmpVal = 0;
   std::string tmpStr;
   uint32_t result = readJSONArrayStart();
@@ -922,11 +1129,13 @@ uint32_t TJSONProtocol::readMapBegin(TType& keyType,
 }
 
 uint32_t TJSONProtocol::readMapEnd() {
+  ReadGuard guard(*this);
   return readJSONObjectEnd() + readJSONArrayEnd();
 }
 
 uint32_t TJSONProtocol::readListBegin(TType& elemType,
                                       uint32_t& size) {
+  ReadGuard guard(*this);
   uint64_t tmpVal = 0;
   std::string tmpStr;
   uint32_t result = readJSONArrayStart();
@@ -938,11 +1147,13 @@ uint32_t TJSONProtocol::readListBegin(TType& elemType,
 }
 
 uint32_t TJSONProtocol::readListEnd() {
+  ReadGuard guard(*this);
   return readJSONArrayEnd();
 }
 
 uint32_t TJSONProtocol::readSetBegin(TType& elemType,
                                      uint32_t& size) {
+  ReadGuard guard(*this);
   uint64_t tmpVal = 0;
   std::string tmpStr;
   uint32_t result = readJSONArrayStart();
@@ -954,16 +1165,17 @@ uint32_t TJSONProtocol::readSetBegin(TType& elemType,
 }
 
 uint32_t TJSONProtocol::readSetEnd() {
+  ReadGuard guard(*this);
   return readJSONArrayEnd();
 }
 
 uint32_t TJSONProtocol::readBool(bool& value) {
+  ReadGuard guard(*this);
   return readJSONInteger(value);
 }
 
-// readByte() must be handled properly becuase boost::lexical cast sees int8_t
-// as a text type instead of an integer type
 uint32_t TJSONProtocol::readByte(int8_t& byte) {
+  ReadGuard guard(*this);
   int16_t tmp = (int16_t) byte;
   uint32_t result =  readJSONInteger(tmp);
   assert(tmp < 256);
@@ -972,26 +1184,32 @@ uint32_t TJSONProtocol::readByte(int8_t& byte) {
 }
 
 uint32_t TJSONProtocol::readI16(int16_t& i16) {
+  ReadGuard guard(*this);
   return readJSONInteger(i16);
 }
 
 uint32_t TJSONProtocol::readI32(int32_t& i32) {
+  ReadGuard guard(*this);
   return readJSONInteger(i32);
 }
 
 uint32_t TJSONProtocol::readI64(int64_t& i64) {
+  ReadGuard guard(*this);
   return readJSONInteger(i64);
 }
 
 uint32_t TJSONProtocol::readDouble(double& dub) {
+  ReadGuard guard(*this);
   return readJSONDouble(dub);
 }
 
 uint32_t TJSONProtocol::readString(std::string &str) {
+  ReadGuard guard(*this);
   return readJSONString(str);
 }
 
 uint32_t TJSONProtocol::readBinary(std::string &str) {
+  ReadGuard guard(*this);
   return readJSONBase64(str);
 }
 
@@ -20,15 +20,13 @@
 #ifndef _THRIFT_PROTOCOL_TJSONPROTOCOL_H_
 #define _THRIFT_PROTOCOL_TJSONPROTOCOL_H_ 1
 
-#include "TProtocol.h"
+#include "TVirtualProtocol.h"
 
-#include <stack>
+#include <string>
+#include <vector>
 
 namespace apache { namespace thrift { namespace protocol {
 
-// Forward declaration
-class TJSONContext;
-
 /**
  * JSON protocol for Thrift.
  *
@@ -80,11 +78,9 @@ class TJSONContext;
  * More discussion of the double handling is probably warranted. The aim of
  * the current implementation is to match as closely as possible the behavior
  * of Java's Double.toString(), which has no precision loss.  Implementors in
- * other languages should strive to achieve that where possible. I have not
- * yet verified whether boost:lexical_cast, which is doing that work for me in
- * C++, loses any precision, but I am leaving this as a future improvement. I
- * may try to provide a C component for this, so that other languages could
- * bind to the same underlying implementation for maximum consistency.
+ * other languages should strive to achieve that where possible. C++ writes
+ * doubles with 17 significant digits, which is always enough to read back
+ * the same value, although not always the shortest text that would be.
  *
  * Note further that JavaScript itself is not capable of representing
  * floating point infinities -- presumably when we have a JavaScript Thrift
@@ -92,7 +88,7 @@ class TJSONContext;
  * transmission. I don't know of any work-around for this issue.
  *
  */
-class TJSONProtocol : public TProtocol {
+class TJSONProtocol : public TVirtualProtocol<TJSONProtocol> {
  public:
 
   TJSONProtocol(boost::shared_ptr<TTransport> ptrans);
@@ -101,10 +97,43 @@ class TJSONProtocol : public TProtocol {
 
  private:
 
-  void pushContext(boost::shared_ptr<TJSONContext> c);
+  /**
+   * Where we are in the JSON being written or read, which decides the
+   * separator that goes before the next value.
+   */
+  enum ContextState {
+    // Top level, no separators
+    CONTEXT_BASE,
+    // Array, before the first element and after it
+    CONTEXT_LIST_FIRST,
+    CONTEXT_LIST,
+    // Object, before the first key, after a key and after a value
+    CONTEXT_PAIR_FIRST,
+    CONTEXT_PAIR_KEY,
+    CONTEXT_PAIR_VALUE
+  };
+
+  void pushContext(ContextState state);
 
   void popContext();
 
+  /**
+   * Forgets the value being read, dropping rather than consuming what was
+   * borrowed from the transport.
+   */
+  void resetRead();
+
+  class ReadGuard;
+
+  uint32_t writeContext();
+
+  uint32_t readContext();
+
+  // Numbers must be turned into strings if they are the key part of a pair
+  bool escapeNum() const {
+    return context_ == CONTEXT_PAIR_FIRST || context_ == CONTEXT_PAIR_KEY;
+  }
+
   uint32_t writeJSONEscapeChar(uint8_t ch);
 
   uint32_t writeJSONChar(uint8_t ch);
@@ -202,8 +231,12 @@ class TJSONProtocol : public TProtocol {
   uint32_t writeDouble(const double dub);
 
   uint32_t writeString(const std::string& str);
+  // Provide the default (pointer, length) writeString()
+  using TVirtualProtocol<TJSONProtocol>::writeString;
 
   uint32_t writeBinary(const std::string& str);
+  // Provide the default (pointer, length) writeBinary()
+  using TVirtualProtocol<TJSONProtocol>::writeBinary;
 
   /**
    * Reading functions
@@ -212,16 +245,22 @@ class TJSONProtocol : public TProtocol {
   uint32_t readMessageBegin(std::string& name,
                             TMessageType& messageType,
                             int32_t& seqid);
+  // Provide the default name-free readMessageBegin()
+  using TVirtualProtocol<TJSONProtocol>::readMessageBegin;
 
   uint32_t readMessageEnd();
 
   uint32_t readStructBegin(std::string& name);
+  // Provide the default name-free readStructBegin()
+  using TVirtualProtocol<TJSONProtocol>::readStructBegin;
 
   uint32_t readStructEnd();
 
   uint32_t readFieldBegin(std::string& name,
                           TType& fieldType,
                           int16_t& fieldId);
+  // Provide the default name-free readFieldBegin()
+  using TVirtualProtocol<TJSONProtocol>::readFieldBegin;
 
   uint32_t readFieldEnd();
 
@@ -243,6 +282,9 @@ class TJSONProtocol : public TProtocol {
 
   uint32_t readBool(bool& value);
 
+  // Provide the default readBool() implementation for std::vector<bool>
+  using TVirtualProtocol<TJSONProtocol>::readBool;
+
   uint32_t readByte(int8_t& byte);
 
   uint32_t readI16(int16_t& i16);
@@ -254,46 +296,110 @@ class TJSONProtocol : public TProtocol {
   uint32_t readDouble(double& dub);
 
   uint32_t readString(std::string& str);
+  // Provide the default (pointer, length) readString()
+  using TVirtualProtocol<TJSONProtocol>::readString;
 
   uint32_t readBinary(std::string& str);
+  // Provide the default (pointer, length) readBinary()
+  using TVirtualProtocol<TJSONProtocol>::readBinary;
 
+  /**
+   * Reads the transport a buffer at a time, through borrow() and consume(),
+   * or a byte at a time if it has no buffer to lend.
+   *
+   * What has been read from a borrowed buffer is consumed when the next one
+   * is needed and when release() is called, which the protocol does after
+   * the outermost value of each message or struct. In between, nobody else
+   * may use the transport. If a read throws, what was borrowed is dropped
+   * unconsumed, and the next read starts at the top level.
+   */
   class LookaheadReader {
 
    public:
 
     LookaheadReader(TTransport &trans) :
       trans_(&trans),
-      hasData_(false) {
+      start_(NULL),
+      pos_(NULL),
+      end_(NULL) {
     }
 
     uint8_t read() {
-      if (hasData_) {
-        hasData_ = false;
-      }
-      else {
-        trans_->readAll(&data_, 1);
+      if (pos_ == end_) {
+        fill();
       }
-      return data_;
+      return *pos_++;
     }
 
     uint8_t peek() {
-      if (!hasData_) {
-        trans_->readAll(&data_, 1);
+      if (pos_ == end_) {
+        fill();
+      }
+      return *pos_;
+    }
+
+    /**
+     * Returns the characters that can be read without going to the
+     * transport, setting len to how many; always at least one.
+     */
+    const uint8_t *buffer(uint32_t *len) {
+      if (pos_ == end_) {
+        fill();
       }
-      hasData_ = true;
-      return data_;
+      *len = end_ - pos_;
+      return pos_;
+    }
+
+    /**
+     * Moves past len characters returned by buffer().
+     */
+    void skip(uint32_t len) {
+      pos_ += len;
+    }
+
+    /**
+     * Consumes what has been read from the transport, and stops using its
+     * buffer.
+     */
+    void release();
+
+    /**
+     * Stops using the transport's buffer without consuming anything, for
+     * when the transport may no longer have it.
+     */
+    void reset() {
+      start_ = pos_ = end_ = NULL;
     }
 
    private:
+    void fill();
+
     TTransport *trans_;
-    bool hasData_;
+    // The borrowed buffer, from where it started, or NULL if reading a byte
+    // at a time into data_
+    const uint8_t *start_;
+    const uint8_t *pos_;
+    const uint8_t *end_;
     uint8_t data_;
   };
 
  private:
 
-  std::stack<boost::shared_ptr<TJSONContext> > contexts_;
-  boost::shared_ptr<TJSONContext> context_;
+  /**
+   * Enclosing contexts are saved inline, which is enough for a few dozen
+   * levels of nested structs and containers; deeper ones go to a vector that
+   * is kept around, so pushing a context never allocates after warm-up.
+   */
+  static const uint32_t INLINE_CONTEXTS = 64;
+
+  uint8_t contexts_[INLINE_CONTEXTS];
+  std::vector<uint8_t> deepContexts_;
+  uint32_t depth_;
+  ContextState context_;
+
+  // Scratch space for numbers being read
+  std::string numericChars_;
+
   LookaheadReader reader_;
 };
 
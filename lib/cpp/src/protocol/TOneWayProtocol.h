@@ -21,6 +21,7 @@
 #define _THRIFT_PROTOCOL_TONEWAYPROTOCOL_H_ 1
 
 #include "TProtocol.h"
+#include "TVirtualProtocol.h"
 
 namespace apache { namespace thrift { namespace protocol {
 
@@ -29,14 +30,15 @@ namespace apache { namespace thrift { namespace protocol {
  * not read.
  *
  */
-class TWriteOnlyProtocol : public TProtocol {
+template <class Protocol_, class Super_=TProtocolDefaults>
+class TWriteOnlyProtocol : public TVirtualProtocol<Protocol_, Super_> {
  public:
   /**
    * @param subclass_name  The name of the concrete subclass.
    */
   TWriteOnlyProtocol(boost::shared_ptr<TTransport> trans,
                      const std::string& subclass_name)
-    : TProtocol(trans)
+    : TVirtualProtocol<Protocol_, Super_>(trans)
     , subclass_(subclass_name)
   {}
 
@@ -52,6 +54,8 @@ class TWriteOnlyProtocol : public TProtocol {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
         subclass_ + " does not support reading (yet).");
   }
+  // Provide the default name-free readMessageBegin()
+  using TVirtualProtocol<Protocol_, Super_>::readMessageBegin;
 
   uint32_t readMessageEnd() {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
@@ -62,6 +66,8 @@ class TWriteOnlyProtocol : public TProtocol {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
         subclass_ + " does not support reading (yet).");
   }
+  // Provide the default name-free readStructBegin()
+  using TVirtualProtocol<Protocol_, Super_>::readStructBegin;
 
   uint32_t readStructEnd() {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
@@ -74,6 +80,8 @@ class TWriteOnlyProtocol : public TProtocol {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
         subclass_ + " does not support reading (yet).");
   }
+  // Provide the default name-free readFieldBegin()
+  using TVirtualProtocol<Protocol_, Super_>::readFieldBegin;
 
   uint32_t readFieldEnd() {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
@@ -118,6 +126,8 @@ class TWriteOnlyProtocol : public TProtocol {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
         subclass_ + " does not support reading (yet).");
   }
+  // Provide the default readBool() implementation for std::vector<bool>
+  using TVirtualProtocol<Protocol_, Super_>::readBool;
 
   uint32_t readByte(int8_t& byte) {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
@@ -148,11 +158,15 @@ class TWriteOnlyProtocol : public TProtocol {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
         subclass_ + " does not support reading (yet).");
   }
+  // Provide the default (pointer, length) readString()
+  using TVirtualProtocol<Protocol_, Super_>::readString;
 
   uint32_t readBinary(std::string& str) {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
         subclass_ + " does not support reading (yet).");
   }
+  // Provide the default (pointer, length) readBinary()
+  using TVirtualProtocol<Protocol_, Super_>::readBinary;
 
  private:
   std::string subclass_;
@@ -164,14 +178,15 @@ class TWriteOnlyProtocol : public TProtocol {
  * not written.
  *
  */
-class TReadOnlyProtocol : public TProtocol {
+template <class Protocol_, class Super_=TProtocolDefaults>
+class TReadOnlyProtocol : public TVirtualProtocol<Protocol_, Super_> {
  public:
   /**
    * @param subclass_name  The name of the concrete subclass.
    */
   TReadOnlyProtocol(boost::shared_ptr<TTransport> trans,
                     const std::string& subclass_name)
-    : TProtocol(trans)
+    : TVirtualProtocol<Protocol_, Super_>(trans)
     , subclass_(subclass_name)
   {}
 
@@ -289,11 +304,15 @@ class TReadOnlyProtocol : public TProtocol {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
         subclass_ + " does not support writing (yet).");
   }
+  // Provide the default (pointer, length) writeString()
+  using TVirtualProtocol<Protocol_, Super_>::writeString;
 
   uint32_t writeBinary(const std::string& str) {
     throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
         subclass_ + " does not support writing (yet).");
   }
+  // Provide the default (pointer, length) writeBinary()
+  using TVirtualProtocol<Protocol_, Super_>::writeBinary;
 
  private:
   std::string subclass_;
@@ -29,6 +29,7 @@
 #include <netinet/in.h>
 #include <sys/types.h>
 #include <string>
+#include <vector>
 #include <map>
 
 
@@ -165,6 +166,109 @@ enum TMessageType {
   T_ONEWAY     = 4
 };
 
+/**
+ * Helper template for implementing TProtocol::skip().
+ *
+ * Templatized to avoid having to make virtual function calls.
+ */
+template <class Protocol_>
+uint32_t skip(Protocol_& prot, TType type) {
+  switch (type) {
+  case T_BOOL:
+    {
+      bool boolv;
+      return prot.readBool(boolv);
+    }
+  case T_BYTE:
+    {
+      int8_t bytev;
+      return prot.readByte(bytev);
+    }
+  case T_I16:
+    {
+      int16_t i16;
+      return prot.readI16(i16);
+    }
+  case T_I32:
+    {
+      int32_t i32;
+      return prot.readI32(i32);
+    }
+  case T_I64:
+    {
+      int64_t i64;
+      return prot.readI64(i64);
+    }
+  case T_DOUBLE:
+    {
+      double dub;
+      return prot.readDouble(dub);
+    }
+  case T_STRING:
+    {
+      std::string str;
+      return prot.readBinary(str);
+    }
+  case T_STRUCT:
+    {
+      uint32_t result = 0;
+      int16_t fid;
+      TType ftype;
+      result += prot.readStructBegin();
+      while (true) {
+        result += prot.readFieldBegin(ftype, fid);
+        if (ftype == T_STOP) {
+          break;
+        }
+        result += skip(prot, ftype);
+        result += prot.readFieldEnd();
+      }
+      result += prot.readStructEnd();
+      return result;
+    }
+  case T_MAP:
+    {
+      uint32_t result = 0;
+      TType keyType;
+      TType valType;
+      uint32_t i, size;
+      result += prot.readMapBegin(keyType, valType, size);
+      for (i = 0; i < size; i++) {
+        result += skip(prot, keyType);
+        result += skip(prot, valType);
+      }
+      result += prot.readMapEnd();
+      return result;
+    }
+  case T_SET:
+    {
+      uint32_t result = 0;
+      TType elemType;
+      uint32_t i, size;
+      result += prot.readSetBegin(elemType, size);
+      for (i = 0; i < size; i++) {
+        result += skip(prot, elemType);
+      }
+      result += prot.readSetEnd();
+      return result;
+    }
+  case T_LIST:
+    {
+      uint32_t result = 0;
+      TType elemType;
+      uint32_t i, size;
+      result += prot.readListBegin(elemType, size);
+      for (i = 0; i < size; i++) {
+        result += skip(prot, elemType);
+      }
+      result += prot.readListEnd();
+      return result;
+    }
+  default:
+    return 0;
+  }
+}
+
 /**
  * Abstract class for a thrift protocol driver. These are all the methods that
  * a protocol must implement. Essentially, there must be some way of reading
@@ -178,6 +282,12 @@ enum TMessageType {
  * when parsing an input XML stream, reading should be batched rather than
  * looking ahead character by character for a close tag).
  *
+ * The read and write methods are non-virtual and call a virtual *_virt()
+ * version.  Protocol implementations should derive from TVirtualProtocol,
+ * which implements the *_virt() methods in terms of the subclass's own
+ * non-virtual methods.  Code that knows the concrete protocol type (such as
+ * the templated read/write methods emitted by the "templates" option of the
+ * C++ generator) then calls it without a virtual call per field.
  */
 class TProtocol {
  public:
@@ -187,215 +297,523 @@ class TProtocol {
    * Writing functions.
    */
 
-  virtual uint32_t writeMessageBegin(const std::string& name,
-                                     const TMessageType messageType,
-                                     const int32_t seqid) = 0;
+  virtual uint32_t writeMessageBegin_virt(const std::string& name,
+                                          const TMessageType messageType,
+                                          const int32_t seqid) = 0;
+
+  virtual uint32_t writeMessageEnd_virt() = 0;
+
+  virtual uint32_t writeStructBegin_virt(const char* name) = 0;
+
+  virtual uint32_t writeStructEnd_virt() = 0;
+
+  virtual uint32_t writeFieldBegin_virt(const char* name,
+                                        const TType fieldType,
+                                        const int16_t fieldId) = 0;
 
-  virtual uint32_t writeMessageEnd() = 0;
+  virtual uint32_t writeFieldEnd_virt() = 0;
 
+  virtual uint32_t writeFieldStop_virt() = 0;
 
-  virtual uint32_t writeStructBegin(const char* name) = 0;
+  virtual uint32_t writeMapBegin_virt(const TType keyType,
+                                      const TType valType,
+                                      const uint32_t size) = 0;
 
-  virtual uint32_t writeStructEnd() = 0;
+  virtual uint32_t writeMapEnd_virt() = 0;
 
-  virtual uint32_t writeFieldBegin(const char* name,
-                                   const TType fieldType,
-                                   const int16_t fieldId) = 0;
+  virtual uint32_t writeListBegin_virt(const TType elemType,
+                                       const uint32_t size) = 0;
 
-  virtual uint32_t writeFieldEnd() = 0;
+  virtual uint32_t writeListEnd_virt() = 0;
 
-  virtual uint32_t writeFieldStop() = 0;
+  virtual uint32_t writeSetBegin_virt(const TType elemType,
+                                      const uint32_t size) = 0;
 
-  virtual uint32_t writeMapBegin(const TType keyType,
-                                 const TType valType,
-                                 const uint32_t size) = 0;
+  virtual uint32_t writeSetEnd_virt() = 0;
 
-  virtual uint32_t writeMapEnd() = 0;
+  virtual uint32_t writeBool_virt(const bool value) = 0;
 
-  virtual uint32_t writeListBegin(const TType elemType,
-                                  const uint32_t size) = 0;
+  virtual uint32_t writeByte_virt(const int8_t byte) = 0;
+
+  virtual uint32_t writeI16_virt(const int16_t i16) = 0;
+
+  virtual uint32_t writeI32_virt(const int32_t i32) = 0;
+
+  virtual uint32_t writeI64_virt(const int64_t i64) = 0;
+
+  virtual uint32_t writeDouble_virt(const double dub) = 0;
+
+  virtual uint32_t writeString_virt(const std::string& str) = 0;
+
+  virtual uint32_t writeBinary_virt(const std::string& str) = 0;
+
+  uint32_t writeMessageBegin(const std::string& name,
+                             const TMessageType messageType,
+                             const int32_t seqid) {
+    return writeMessageBegin_virt(name, messageType, seqid);
+  }
+
+  uint32_t writeMessageEnd() {
+    return writeMessageEnd_virt();
+  }
+
+  uint32_t writeStructBegin(const char* name) {
+    return writeStructBegin_virt(name);
+  }
+
+  uint32_t writeStructEnd() {
+    return writeStructEnd_virt();
+  }
+
+  uint32_t writeFieldBegin(const char* name,
+                           const TType fieldType,
+                           const int16_t fieldId) {
+    return writeFieldBegin_virt(name, fieldType, fieldId);
+  }
+
+  uint32_t writeFieldEnd() {
+    return writeFieldEnd_virt();
+  }
+
+  uint32_t writeFieldStop() {
+    return writeFieldStop_virt();
+  }
+
+  uint32_t writeMapBegin(const TType keyType,
+                         const TType valType,
+                         const uint32_t size) {
+    return writeMapBegin_virt(keyType, valType, size);
+  }
+
+  uint32_t writeMapEnd() {
+    return writeMapEnd_virt();
+  }
+
+  uint32_t writeListBegin(const TType elemType,
+                          const uint32_t size) {
+    return writeListBegin_virt(elemType, size);
+  }
 
-  virtual uint32_t writeListEnd() = 0;
+  uint32_t writeListEnd() {
+    return writeListEnd_virt();
+  }
 
-  virtual uint32_t writeSetBegin(const TType elemType,
-                                 const uint32_t size) = 0;
+  uint32_t writeSetBegin(const TType elemType,
+                         const uint32_t size) {
+    return writeSetBegin_virt(elemType, size);
+  }
 
-  virtual uint32_t writeSetEnd() = 0;
+  uint32_t writeSetEnd() {
+    return writeSetEnd_virt();
+  }
 
-  virtual uint32_t writeBool(const bool value) = 0;
+  uint32_t writeBool(const bool value) {
+    return writeBool_virt(value);
+  }
 
-  virtual uint32_t writeByte(const int8_t byte) = 0;
+  uint32_t writeByte(const int8_t byte) {
+    return writeByte_virt(byte);
+  }
 
-  virtual uint32_t writeI16(const int16_t i16) = 0;
+  uint32_t writeI16(const int16_t i16) {
+    return writeI16_virt(i16);
+  }
 
-  virtual uint32_t writeI32(const int32_t i32) = 0;
+  uint32_t writeI32(const int32_t i32) {
+    return writeI32_virt(i32);
+  }
 
-  virtual uint32_t writeI64(const int64_t i64) = 0;
+  uint32_t writeI64(const int64_t i64) {
+    return writeI64_virt(i64);
+  }
 
-  virtual uint32_t writeDouble(const double dub) = 0;
+  uint32_t writeDouble(const double dub) {
+    return writeDouble_virt(dub);
+  }
 
-  virtual uint32_t writeString(const std::string& str) = 0;
+  uint32_t writeString(const std::string& str) {
+    return writeString_virt(str);
+  }
 
-  virtual uint32_t writeBinary(const std::string& str) = 0;
+  uint32_t writeBinary(const std::string& str) {
+    return writeBinary_virt(str);
+  }
 
   /**
    * Reading functions
    */
 
-  virtual uint32_t readMessageBegin(std::string& name,
-                                    TMessageType& messageType,
-                                    int32_t& seqid) = 0;
+  virtual uint32_t readMessageBegin_virt(std::string& name,
+                                         TMessageType& messageType,
+                                         int32_t& seqid) = 0;
+
+  virtual uint32_t readMessageEnd_virt() = 0;
+
+  virtual uint32_t readStructBegin_virt(std::string& name) = 0;
+
+  virtual uint32_t readStructEnd_virt() = 0;
+
+  virtual uint32_t readFieldBegin_virt(std::string& name,
+                                       TType& fieldType,
+                                       int16_t& fieldId) = 0;
+
+  virtual uint32_t readFieldEnd_virt() = 0;
+
+  virtual uint32_t readMapBegin_virt(TType& keyType,
+                                     TType& valType,
+                                     uint32_t& size) = 0;
+
+  virtual uint32_t readMapEnd_virt() = 0;
+
+  virtual uint32_t readListBegin_virt(TType& elemType,
+                                      uint32_t& size) = 0;
+
+  virtual uint32_t readListEnd_virt() = 0;
+
+  virtual uint32_t readSetBegin_virt(TType& elemType,
+                                     uint32_t& size) = 0;
+
+  virtual uint32_t readSetEnd_virt() = 0;
+
+  virtual uint32_t readBool_virt(bool& value) = 0;
+
+  virtual uint32_t readByte_virt(int8_t& byte) = 0;
+
+  virtual uint32_t readI16_virt(int16_t& i16) = 0;
+
+  virtual uint32_t readI32_virt(int32_t& i32) = 0;
 
-  virtual uint32_t readMessageEnd() = 0;
+  virtual uint32_t readI64_virt(int64_t& i64) = 0;
 
-  virtual uint32_t readStructBegin(std::string& name) = 0;
+  virtual uint32_t readDouble_virt(double& dub) = 0;
 
-  virtual uint32_t readStructEnd() = 0;
+  virtual uint32_t readString_virt(std::string& str) = 0;
 
-  virtual uint32_t readFieldBegin(std::string& name,
-                                  TType& fieldType,
-                                  int16_t& fieldId) = 0;
+  virtual uint32_t readBinary_virt(std::string& str) = 0;
 
-  virtual uint32_t readFieldEnd() = 0;
+  uint32_t readMessageBegin(std::string& name,
+                            TMessageType& messageType,
+                            int32_t& seqid) {
+    return readMessageBegin_virt(name, messageType, seqid);
+  }
+
+  uint32_t readMessageEnd() {
+    return readMessageEnd_virt();
+  }
 
-  virtual uint32_t readMapBegin(TType& keyType,
-                                TType& valType,
-                                uint32_t& size) = 0;
+  uint32_t readStructBegin(std::string& name) {
+    return readStructBegin_virt(name);
+  }
 
-  virtual uint32_t readMapEnd() = 0;
+  uint32_t readStructEnd() {
+    return readStructEnd_virt();
+  }
+
+  uint32_t readFieldBegin(std::string& name,
+                          TType& fieldType,
+                          int16_t& fieldId) {
+    return readFieldBegin_virt(name, fieldType, fieldId);
+  }
+
+  uint32_t readFieldEnd() {
+    return readFieldEnd_virt();
+  }
+
+  uint32_t readMapBegin(TType& keyType,
+                        TType& valType,
+                        uint32_t& size) {
+    return readMapBegin_virt(keyType, valType, size);
+  }
+
+  uint32_t readMapEnd() {
+    return readMapEnd_virt();
+  }
 
-  virtual uint32_t readListBegin(TType& elemType,
-                                 uint32_t& size) = 0;
+  uint32_t readListBegin(TType& elemType,
+                         uint32_t& size) {
+    return readListBegin_virt(elemType, size);
+  }
 
-  virtual uint32_t readListEnd() = 0;
+  uint32_t readListEnd() {
+    return readListEnd_virt();
+  }
 
-  virtual uint32_t readSetBegin(TType& elemType,
-                                uint32_t& size) = 0;
+  uint32_t readSetBegin(TType& elemType,
+                        uint32_t& size) {
+    return readSetBegin_virt(elemType, size);
+  }
 
-  virtual uint32_t readSetEnd() = 0;
+  uint32_t readSetEnd() {
+    return readSetEnd_virt();
+  }
 
-  virtual uint32_t readBool(bool& value) = 0;
+  uint32_t readBool(bool& value) {
+    return readBool_virt(value);
+  }
 
-  virtual uint32_t readByte(int8_t& byte) = 0;
+  uint32_t readByte(int8_t& byte) {
+    return readByte_virt(byte);
+  }
 
-  virtual uint32_t readI16(int16_t& i16) = 0;
+  uint32_t readI16(int16_t& i16) {
+    return readI16_virt(i16);
+  }
 
-  virtual uint32_t readI32(int32_t& i32) = 0;
+  uint32_t readI32(int32_t& i32) {
+    return readI32_virt(i32);
+  }
 
-  virtual uint32_t readI64(int64_t& i64) = 0;
+  uint32_t readI64(int64_t& i64) {
+    return readI64_virt(i64);
+  }
 
-  virtual uint32_t readDouble(double& dub) = 0;
+  uint32_t readDouble(double& dub) {
+    return readDouble_virt(dub);
+  }
 
-  virtual uint32_t readString(std::string& str) = 0;
+  uint32_t readString(std::string& str) {
+    return readString_virt(str);
+  }
 
-  virtual uint32_t readBinary(std::string& str) = 0;
+  uint32_t readBinary(std::string& str) {
+    return readBinary_virt(str);
+  }
 
-  uint32_t readBool(std::vector<bool>::reference ref) {
-    bool value;
-    uint32_t rv = readBool(value);
-    ref = value;
-    return rv;
+  uint32_t readBool(std::vector<bool>::reference value) {
+    return readBool_virt(value);
+  }
+
+  virtual uint32_t readBool_virt(std::vector<bool>::reference value) = 0;
+
+  /**
+   * Name-free variants of the read functions above.  Struct and field names
+   * are never needed to decode a struct, so generated code calls these and
+   * avoids a std::string per struct.
+   *
+   * The message name comes back as a (pointer, length) view.  Protocols that
+   * can borrow from the transport point it straight into the transport's
+   * buffer, otherwise it points into storage owned by the protocol.  Either
+   * way it is only valid until the next read from this protocol.
+   */
+  uint32_t readMessageBegin(const char*& name,
+                            uint32_t& nameLen,
+                            TMessageType& messageType,
+                            int32_t& seqid) {
+    return readMessageBegin_virt(name, nameLen, messageType, seqid);
+  }
+
+  uint32_t readStructBegin() {
+    return readStructBegin_virt();
+  }
+
+  uint32_t readFieldBegin(TType& fieldType,
+                          int16_t& fieldId) {
+    return readFieldBegin_virt(fieldType, fieldId);
+  }
+
+  virtual uint32_t readMessageBegin_virt(const char*& name,
+                                         uint32_t& nameLen,
+                                         TMessageType& messageType,
+                                         int32_t& seqid) {
+    uint32_t result = readMessageBegin_virt(messageName_, messageType, seqid);
+    name = messageName_.data();
+    nameLen = messageName_.size();
+    return result;
+  }
+
+  virtual uint32_t readStructBegin_virt() {
+    std::string name;
+    return readStructBegin_virt(name);
+  }
+
+  virtual uint32_t readFieldBegin_virt(TType& fieldType,
+                                       int16_t& fieldId) {
+    std::string name;
+    return readFieldBegin_virt(name, fieldType, fieldId);
+  }
+
+  /**
+   * (pointer, length) variants of the string functions, for strings that
+   * don't live in a std::string (like the arena-backed strings of generated
+   * code built with the "arena" option).
+   *
+   * The strings read come back as views with the same lifetime rules as the
+   * message name view above.
+   */
+  uint32_t writeString(const char* str, uint32_t len) {
+    return writeString_virt(str, len);
+  }
+
+  uint32_t writeBinary(const char* str, uint32_t len) {
+    return writeBinary_virt(str, len);
+  }
+
+  uint32_t readString(const char*& str, uint32_t& len) {
+    return readString_virt(str, len);
+  }
+
+  uint32_t readBinary(const char*& str, uint32_t& len) {
+    return readBinary_virt(str, len);
+  }
+
+  virtual uint32_t writeString_virt(const char* str, uint32_t len) {
+    return writeString_virt(std::string(str, len));
+  }
+
+  virtual uint32_t writeBinary_virt(const char* str, uint32_t len) {
+    return writeBinary_virt(std::string(str, len));
+  }
+
+  virtual uint32_t readString_virt(const char*& str, uint32_t& len) {
+    uint32_t result = readString_virt(stringBuf_);
+    str = stringBuf_.data();
+    len = stringBuf_.size();
+    return result;
+  }
+
+  virtual uint32_t readBinary_virt(const char*& str, uint32_t& len) {
+    uint32_t result = readBinary_virt(stringBuf_);
+    str = stringBuf_.data();
+    len = stringBuf_.size();
+    return result;
+  }
+
+  /**
+   * Bulk variants of the numeric functions, used by generated code for lists
+   * and sets of numbers.  They move size elements and nothing else; the
+   * list or set header goes through the usual functions.  The defaults call
+   * the single value functions in a loop, protocols that can do better (like
+   * binary, which byte swaps whole arrays, and compact, which decodes whole
+   * runs of varints straight out of the transport's buffer) override them.
+   */
+  uint32_t writeByteArray(const int8_t* values, uint32_t size) {
+    return writeByteArray_virt(values, size);
+  }
+
+  uint32_t writeI16Array(const int16_t* values, uint32_t size) {
+    return writeI16Array_virt(values, size);
+  }
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t size) {
+    return writeI32Array_virt(values, size);
+  }
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t size) {
+    return writeI64Array_virt(values, size);
+  }
+
+  uint32_t writeDoubleArray(const double* values, uint32_t size) {
+    return writeDoubleArray_virt(values, size);
+  }
+
+  uint32_t readByteArray(int8_t* values, uint32_t size) {
+    return readByteArray_virt(values, size);
+  }
+
+  uint32_t readI16Array(int16_t* values, uint32_t size) {
+    return readI16Array_virt(values, size);
+  }
+
+  uint32_t readI32Array(int32_t* values, uint32_t size) {
+    return readI32Array_virt(values, size);
+  }
+
+  uint32_t readI64Array(int64_t* values, uint32_t size) {
+    return readI64Array_virt(values, size);
+  }
+
+  uint32_t readDoubleArray(double* values, uint32_t size) {
+    return readDoubleArray_virt(values, size);
+  }
+
+  virtual uint32_t writeByteArray_virt(const int8_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += writeByte_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t writeI16Array_virt(const int16_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += writeI16_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t writeI32Array_virt(const int32_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += writeI32_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t writeI64Array_virt(const int64_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += writeI64_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t writeDoubleArray_virt(const double* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += writeDouble_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t readByteArray_virt(int8_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += readByte_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t readI16Array_virt(int16_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += readI16_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t readI32Array_virt(int32_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += readI32_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t readI64Array_virt(int64_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += readI64_virt(values[i]);
+    }
+    return xfer;
+  }
+
+  virtual uint32_t readDoubleArray_virt(double* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += readDouble_virt(values[i]);
+    }
+    return xfer;
   }
 
   /**
    * Method to arbitrarily skip over data.
    */
   uint32_t skip(TType type) {
-    switch (type) {
-    case T_BOOL:
-      {
-        bool boolv;
-        return readBool(boolv);
-      }
-    case T_BYTE:
-      {
-        int8_t bytev;
-        return readByte(bytev);
-      }
-    case T_I16:
-      {
-        int16_t i16;
-        return readI16(i16);
-      }
-    case T_I32:
-      {
-        int32_t i32;
-        return readI32(i32);
-      }
-    case T_I64:
-      {
-        int64_t i64;
-        return readI64(i64);
-      }
-    case T_DOUBLE:
-      {
-        double dub;
-        return readDouble(dub);
-      }
-    case T_STRING:
-      {
-        std::string str;
-        return readBinary(str);
-      }
-    case T_STRUCT:
-      {
-        uint32_t result = 0;
-        std::string name;
-        int16_t fid;
-        TType ftype;
-        result += readStructBegin(name);
-        while (true) {
-          result += readFieldBegin(name, ftype, fid);
-          if (ftype == T_STOP) {
-            break;
-          }
-          result += skip(ftype);
-          result += readFieldEnd();
-        }
-        result += readStructEnd();
-        return result;
-      }
-    case T_MAP:
-      {
-        uint32_t result = 0;
-        TType keyType;
-        TType valType;
-        uint32_t i, size;
-        result += readMapBegin(keyType, valType, size);
-        for (i = 0; i < size; i++) {
-          result += skip(keyType);
-          result += skip(valType);
-        }
-        result += readMapEnd();
-        return result;
-      }
-    case T_SET:
-      {
-        uint32_t result = 0;
-        TType elemType;
-        uint32_t i, size;
-        result += readSetBegin(elemType, size);
-        for (i = 0; i < size; i++) {
-          result += skip(elemType);
-        }
-        result += readSetEnd();
-        return result;
-      }
-    case T_LIST:
-      {
-        uint32_t result = 0;
-        TType elemType;
-        uint32_t i, size;
-        result += readListBegin(elemType, size);
-        for (i = 0; i < size; i++) {
-          result += skip(elemType);
-        }
-        result += readListEnd();
-        return result;
-      }
-    default:
-      return 0;
-    }
+    return skip_virt(type);
+  }
+  virtual uint32_t skip_virt(TType type) {
+    return ::apache::thrift::protocol::skip(*this, type);
   }
 
   inline boost::shared_ptr<TTransport> getTransport() {
@@ -420,6 +838,14 @@ class TProtocol {
   boost::shared_ptr<TTransport> ptrans_;
   TTransport* trans_;
 
+  // Backs the message name view when it can't point into the transport.
+  // Kept between messages so it stops allocating once it fits the longest
+  // method name.
+  std::string messageName_;
+
+  // Likewise for the string views.
+  std::string stringBuf_;
+
  private:
   TProtocol() {}
 };
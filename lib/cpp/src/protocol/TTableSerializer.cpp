@@ -0,0 +1,195 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include "TTableSerializer.h"
+
+#include <TReflectionLocal.h>
+
+using apache::thrift::reflection::local::FieldMeta;
+using apache::thrift::reflection::local::TypeSpec;
+
+namespace apache { namespace thrift { namespace protocol { namespace table {
+
+/**
+ * Finds the index of the field with tag fid, or returns num_fields.  Fields
+ * usually arrive in order, so the one after the last is tried first.
+ */
+static inline uint32_t findField(const FieldMeta* metas,
+                                 uint32_t num_fields,
+                                 int16_t fid,
+                                 uint32_t next) {
+  if (next < num_fields && metas[next].tag == fid) {
+    return next;
+  }
+  uint32_t lo = 0;
+  uint32_t hi = num_fields;
+  while (lo < hi) {
+    uint32_t mid = (lo + hi) / 2;
+    if (metas[mid].tag < fid) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  if (lo < num_fields && metas[lo].tag == fid) {
+    return lo;
+  }
+  return num_fields;
+}
+
+uint32_t read(TProtocol* iprot, void* obj, const StructTable& table) {
+  const FieldMeta* metas = table.spec->tstruct.metas;
+  TypeSpec** specs = table.spec->tstruct.specs;
+  char* base = static_cast<char*>(obj);
+
+  uint32_t xfer = 0;
+  TType ftype;
+  int16_t fid;
+  // Bit i is set once required field i has been read
+  uint64_t isset_required = 0;
+  uint32_t next = 0;
+
+  xfer += iprot->readStructBegin();
+
+  while (true) {
+    xfer += iprot->readFieldBegin(ftype, fid);
+    if (ftype == T_STOP) {
+      break;
+    }
+
+    uint32_t i = findField(metas, table.num_fields, fid, next);
+    if (i == table.num_fields || specs[i]->ttype != ftype) {
+      xfer += iprot->skip(ftype);
+      xfer += iprot->readFieldEnd();
+      continue;
+    }
+
+    const FieldTable& field = table.fields[i];
+    void* value = base + field.offset;
+    if (field.read != NULL) {
+      xfer += field.read(iprot, value);
+    } else {
+      switch (ftype) {
+      case T_BOOL:
+        xfer += iprot->readBool(*static_cast<bool*>(value));
+        break;
+      case T_BYTE:
+        xfer += iprot->readByte(*static_cast<int8_t*>(value));
+        break;
+      case T_I16:
+        xfer += iprot->readI16(*static_cast<int16_t*>(value));
+        break;
+      case T_I32:
+        xfer += iprot->readI32(*static_cast<int32_t*>(value));
+        break;
+      case T_I64:
+        xfer += iprot->readI64(*static_cast<int64_t*>(value));
+        break;
+      case T_DOUBLE:
+        xfer += iprot->readDouble(*static_cast<double*>(value));
+        break;
+      case T_STRING:
+        xfer += iprot->readString(*static_cast<std::string*>(value));
+        break;
+      default:
+        throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                                 "table::read: no reader for field.");
+      }
+    }
+
+    if (field.isset_offset >= 0) {
+      *reinterpret_cast<bool*>(base + field.isset_offset) = true;
+    } else {
+      isset_required |= (uint64_t)1 << i;
+    }
+    next = i + 1;
+
+    xfer += iprot->readFieldEnd();
+  }
+
+  xfer += iprot->readStructEnd();
+
+  // Throw if any required fields are missing, after reading the struct end
+  // like the generated code does
+  if (isset_required != table.required_fields) {
+    throw TProtocolException(TProtocolException::INVALID_DATA);
+  }
+
+  return xfer;
+}
+
+uint32_t write(TProtocol* oprot, const void* obj, const StructTable& table) {
+  const FieldMeta* metas = table.spec->tstruct.metas;
+  TypeSpec** specs = table.spec->tstruct.specs;
+  const char* base = static_cast<const char*>(obj);
+
+  uint32_t xfer = 0;
+  xfer += oprot->writeStructBegin(table.name);
+
+  for (uint32_t i = 0; i < table.num_fields; ++i) {
+    const FieldTable& field = table.fields[i];
+    if (metas[i].is_optional &&
+        !*reinterpret_cast<const bool*>(base + field.isset_offset)) {
+      continue;
+    }
+
+    TType ftype = specs[i]->ttype;
+    xfer += oprot->writeFieldBegin(field.name, ftype, metas[i].tag);
+
+    const void* value = base + field.offset;
+    if (field.write != NULL) {
+      xfer += field.write(oprot, value);
+    } else {
+      switch (ftype) {
+      case T_BOOL:
+        xfer += oprot->writeBool(*static_cast<const bool*>(value));
+        break;
+      case T_BYTE:
+        xfer += oprot->writeByte(*static_cast<const int8_t*>(value));
+        break;
+      case T_I16:
+        xfer += oprot->writeI16(*static_cast<const int16_t*>(value));
+        break;
+      case T_I32:
+        xfer += oprot->writeI32(*static_cast<const int32_t*>(value));
+        break;
+      case T_I64:
+        xfer += oprot->writeI64(*static_cast<const int64_t*>(value));
+        break;
+      case T_DOUBLE:
+        xfer += oprot->writeDouble(*static_cast<const double*>(value));
+        break;
+      case T_STRING:
+        xfer += oprot->writeString(*static_cast<const std::string*>(value));
+        break;
+      default:
+        throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                                 "table::write: no writer for field.");
+      }
+    }
+
+    xfer += oprot->writeFieldEnd();
+  }
+
+  xfer += oprot->writeFieldStop();
+  xfer += oprot->writeStructEnd();
+  return xfer;
+}
+
+}}}} // apache::thrift::protocol::table
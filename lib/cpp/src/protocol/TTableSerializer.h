@@ -0,0 +1,369 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TTABLESERIALIZER_H_
+#define _THRIFT_PROTOCOL_TTABLESERIALIZER_H_ 1
+
+#include "TProtocol.h"
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+/**
+ * A table-driven reader and writer for generated structs.
+ *
+ * Normally "thrift --gen cpp" unrolls a read() and a write() function for
+ * every struct, one block of code per field.  For a struct generated with the
+ * "table" option (or annotated with cpp.serializer = "table"), read() and
+ * write() instead hand a StructTable to table::read() and table::write(),
+ * which walk it field by field.  The table is the struct's local reflection
+ * TypeSpec (see TReflectionLocal.h), which gives the tags, types and
+ * optionality of the fields, plus a FieldTable for each field that gives its
+ * name and where it lives in the C++ object.
+ *
+ * Bools, numbers and strings are read and written by the interpreter itself.
+ * Binary strings, enums, nested structs and containers have a C++ type the
+ * TypeSpec does not describe, so their FieldTable points to a reader and
+ * writer instantiated from the codec templates below, like
+ * readField< List<std::vector<int32_t>, I32> >.  There is one instantiation
+ * for each C++ type, shared by every field and struct that uses it, rather
+ * than a copy of the code for each field.
+ *
+ * Any protocol works, through the virtual TProtocol interface, and the bytes
+ * written are the same as the generated code would write.  Note that the
+ * TypeSpecs of structs from included files are referenced, not regenerated,
+ * so those files must be generated with the "dense" or "table" option too.
+ */
+
+namespace apache { namespace thrift { namespace protocol { namespace table {
+
+/**
+ * offsetof() for the generated classes, which are not PODs, so offsetof()
+ * itself would draw warnings.
+ */
+#define THRIFT_FIELD_OFFSET(TYPE, FIELD) \
+  (reinterpret_cast<const char*>(&reinterpret_cast<const TYPE*>(16)->FIELD) - \
+   reinterpret_cast<const char*>(16))
+
+typedef uint32_t (*FieldReader)(TProtocol* iprot, void* value);
+typedef uint32_t (*FieldWriter)(TProtocol* oprot, const void* value);
+
+/**
+ * How to find one field in a generated object.
+ */
+struct FieldTable {
+  const char* name;
+  ptrdiff_t offset;
+  // Offset of the field's flag in __isset, or -1 for a required field, which
+  // has no flag
+  ptrdiff_t isset_offset;
+  // NULL for bools, numbers and (non-binary) strings
+  FieldReader read;
+  FieldWriter write;
+};
+
+/**
+ * Everything table::read() and table::write() need to know about a struct.
+ * The fields are in the same order as the TypeSpec's, that is, by tag.
+ */
+struct StructTable {
+  const char* name;
+  const reflection::local::TypeSpec* spec;
+  const FieldTable* fields;
+  uint32_t num_fields;
+  // Bit i is set if field i is required
+  uint64_t required_fields;
+};
+
+/**
+ * Reads the struct laid out by table into obj.  Like the generated code, it
+ * skips unknown fields and fields of the wrong type, and throws
+ * TProtocolException::INVALID_DATA if a required field is missing.  Only the
+ * first 64 fields can be required.
+ */
+uint32_t read(TProtocol* iprot, void* obj, const StructTable& table);
+
+/**
+ * Writes obj, laid out by table, skipping optional fields that are not set.
+ */
+uint32_t write(TProtocol* oprot, const void* obj, const StructTable& table);
+
+/**
+ * The codecs.  Each has the C++ type it reads and writes, the TType it is
+ * on the wire, and static read() and write() functions.  The ones for bools,
+ * numbers and strings are only needed inside containers.
+ */
+
+struct Bool {
+  typedef bool type;
+  static const TType ttype = T_BOOL;
+  static uint32_t read(TProtocol* iprot, bool& value) {
+    return iprot->readBool(value);
+  }
+  static uint32_t read(TProtocol* iprot, std::vector<bool>::reference value) {
+    return iprot->readBool(value);
+  }
+  static uint32_t write(TProtocol* oprot, bool value) {
+    return oprot->writeBool(value);
+  }
+};
+
+struct Byte {
+  typedef int8_t type;
+  static const TType ttype = T_BYTE;
+  static uint32_t read(TProtocol* iprot, int8_t& value) {
+    return iprot->readByte(value);
+  }
+  static uint32_t write(TProtocol* oprot, int8_t value) {
+    return oprot->writeByte(value);
+  }
+};
+
+struct I16 {
+  typedef int16_t type;
+  static const TType ttype = T_I16;
+  static uint32_t read(TProtocol* iprot, int16_t& value) {
+    return iprot->readI16(value);
+  }
+  static uint32_t write(TProtocol* oprot, int16_t value) {
+    return oprot->writeI16(value);
+  }
+};
+
+struct I32 {
+  typedef int32_t type;
+  static const TType ttype = T_I32;
+  static uint32_t read(TProtocol* iprot, int32_t& value) {
+    return iprot->readI32(value);
+  }
+  static uint32_t write(TProtocol* oprot, int32_t value) {
+    return oprot->writeI32(value);
+  }
+};
+
+struct I64 {
+  typedef int64_t type;
+  static const TType ttype = T_I64;
+  static uint32_t read(TProtocol* iprot, int64_t& value) {
+    return iprot->readI64(value);
+  }
+  static uint32_t write(TProtocol* oprot, int64_t value) {
+    return oprot->writeI64(value);
+  }
+};
+
+struct Double {
+  typedef double type;
+  static const TType ttype = T_DOUBLE;
+  static uint32_t read(TProtocol* iprot, double& value) {
+    return iprot->readDouble(value);
+  }
+  static uint32_t write(TProtocol* oprot, double value) {
+    return oprot->writeDouble(value);
+  }
+};
+
+struct String {
+  typedef std::string type;
+  static const TType ttype = T_STRING;
+  static uint32_t read(TProtocol* iprot, std::string& value) {
+    return iprot->readString(value);
+  }
+  static uint32_t write(TProtocol* oprot, const std::string& value) {
+    return oprot->writeString(value);
+  }
+};
+
+struct Binary {
+  typedef std::string type;
+  static const TType ttype = T_STRING;
+  static uint32_t read(TProtocol* iprot, std::string& value) {
+    return iprot->readBinary(value);
+  }
+  static uint32_t write(TProtocol* oprot, const std::string& value) {
+    return oprot->writeBinary(value);
+  }
+};
+
+template <class Enum_>
+struct Enum {
+  typedef Enum_ type;
+  static const TType ttype = T_I32;
+  static uint32_t read(TProtocol* iprot, Enum_& value) {
+    int32_t ecast;
+    uint32_t xfer = iprot->readI32(ecast);
+    value = (Enum_)ecast;
+    return xfer;
+  }
+  static uint32_t write(TProtocol* oprot, Enum_ value) {
+    return oprot->writeI32((int32_t)value);
+  }
+};
+
+template <class Struct_>
+struct Struct {
+  typedef Struct_ type;
+  static const TType ttype = T_STRUCT;
+  static uint32_t read(TProtocol* iprot, Struct_& value) {
+    return value.read(iprot);
+  }
+  static uint32_t write(TProtocol* oprot, const Struct_& value) {
+    return value.write(oprot);
+  }
+};
+
+/**
+ * Reads every element of a list that has already been sized.  Vectors of
+ * numbers go through the bulk array functions.
+ */
+template <class Elem_, class Container_>
+inline uint32_t readElements(TProtocol* iprot, Container_& list) {
+  uint32_t xfer = 0;
+  typename Container_::iterator iter;
+  for (iter = list.begin(); iter != list.end(); ++iter) {
+    xfer += Elem_::read(iprot, *iter);
+  }
+  return xfer;
+}
+
+template <class Elem_, class Container_>
+inline uint32_t writeElements(TProtocol* oprot, const Container_& list) {
+  uint32_t xfer = 0;
+  typename Container_::const_iterator iter;
+  for (iter = list.begin(); iter != list.end(); ++iter) {
+    xfer += Elem_::write(oprot, *iter);
+  }
+  return xfer;
+}
+
+#define THRIFT_TABLE_ARRAY(Type_, Name_)                                   \
+  template <class Elem_>                                                  \
+  inline uint32_t readElements(TProtocol* iprot,                          \
+                               std::vector<Type_>& list) {                \
+    return list.empty() ? 0 : iprot->read##Name_##Array(&list[0],          \
+                                                       list.size());       \
+  }                                                                       \
+  template <class Elem_>                                                  \
+  inline uint32_t writeElements(TProtocol* oprot,                         \
+                                const std::vector<Type_>& list) {         \
+    return list.empty() ? 0 : oprot->write##Name_##Array(&list[0],         \
+                                                        list.size());      \
+  }
+
+THRIFT_TABLE_ARRAY(int8_t, Byte)
+THRIFT_TABLE_ARRAY(int16_t, I16)
+THRIFT_TABLE_ARRAY(int32_t, I32)
+THRIFT_TABLE_ARRAY(int64_t, I64)
+THRIFT_TABLE_ARRAY(double, Double)
+
+#undef THRIFT_TABLE_ARRAY
+
+template <class Container_, class Elem_>
+struct List {
+  typedef Container_ type;
+  static const TType ttype = T_LIST;
+  static uint32_t read(TProtocol* iprot, Container_& list) {
+    TType etype;
+    uint32_t size;
+    list.clear();
+    uint32_t xfer = iprot->readListBegin(etype, size);
+    list.resize(size);
+    xfer += readElements<Elem_>(iprot, list);
+    xfer += iprot->readListEnd();
+    return xfer;
+  }
+  static uint32_t write(TProtocol* oprot, const Container_& list) {
+    uint32_t xfer = oprot->writeListBegin(Elem_::ttype, list.size());
+    xfer += writeElements<Elem_>(oprot, list);
+    xfer += oprot->writeListEnd();
+    return xfer;
+  }
+};
+
+template <class Container_, class Elem_>
+struct Set {
+  typedef Container_ type;
+  static const TType ttype = T_SET;
+  // Sets are read by way of a vector
+  static uint32_t read(TProtocol* iprot, Container_& set) {
+    TType etype;
+    uint32_t size;
+    set.clear();
+    uint32_t xfer = iprot->readSetBegin(etype, size);
+    std::vector<typename Container_::value_type> values(size);
+    xfer += readElements<Elem_>(iprot, values);
+    set.insert(values.begin(), values.end());
+    xfer += iprot->readSetEnd();
+    return xfer;
+  }
+  static uint32_t write(TProtocol* oprot, const Container_& set) {
+    uint32_t xfer = oprot->writeSetBegin(Elem_::ttype, set.size());
+    xfer += writeElements<Elem_>(oprot, set);
+    xfer += oprot->writeSetEnd();
+    return xfer;
+  }
+};
+
+template <class Container_, class Key_, class Val_>
+struct Map {
+  typedef Container_ type;
+  static const TType ttype = T_MAP;
+  static uint32_t read(TProtocol* iprot, Container_& map) {
+    TType ktype;
+    TType vtype;
+    uint32_t size;
+    map.clear();
+    uint32_t xfer = iprot->readMapBegin(ktype, vtype, size);
+    for (uint32_t i = 0; i < size; ++i) {
+      typename Container_::key_type key;
+      xfer += Key_::read(iprot, key);
+      xfer += Val_::read(iprot, map[key]);
+    }
+    xfer += iprot->readMapEnd();
+    return xfer;
+  }
+  static uint32_t write(TProtocol* oprot, const Container_& map) {
+    uint32_t xfer = oprot->writeMapBegin(Key_::ttype, Val_::ttype, map.size());
+    typename Container_::const_iterator iter;
+    for (iter = map.begin(); iter != map.end(); ++iter) {
+      xfer += Key_::write(oprot, iter->first);
+      xfer += Val_::write(oprot, iter->second);
+    }
+    xfer += oprot->writeMapEnd();
+    return xfer;
+  }
+};
+
+/**
+ * The FieldReader and FieldWriter of a codec, for FieldTable.
+ */
+template <class Codec_>
+uint32_t readField(TProtocol* iprot, void* value) {
+  return Codec_::read(iprot, *static_cast<typename Codec_::type*>(value));
+}
+
+template <class Codec_>
+uint32_t writeField(TProtocol* oprot, const void* value) {
+  return Codec_::write(oprot, *static_cast<const typename Codec_::type*>(value));
+}
+
+}}}} // apache::thrift::protocol::table
+
+#endif // #ifndef _THRIFT_PROTOCOL_TTABLESERIALIZER_H_
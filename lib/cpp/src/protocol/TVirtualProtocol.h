@@ -0,0 +1,781 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_PROTOCOL_TVIRTUALPROTOCOL_H_
+#define _THRIFT_PROTOCOL_TVIRTUALPROTOCOL_H_ 1
+
+#include <protocol/TProtocol.h>
+
+namespace apache { namespace thrift { namespace protocol {
+
+using apache::thrift::transport::TTransport;
+
+/**
+ * Helper class that provides default implementations of TProtocol methods.
+ *
+ * This class provides default implementations of the non-virtual TProtocol
+ * methods.  It exists primarily so TVirtualProtocol can derive from it.  It
+ * prevents TVirtualProtocol methods from causing infinite recursion if the
+ * non-virtual methods are not overridden by the TVirtualProtocol subclass.
+ *
+ * You probably don't want to use this class directly.  Use TVirtualProtocol
+ * instead.
+ */
+class TProtocolDefaults : public TProtocol {
+ public:
+  uint32_t writeMessageBegin(const std::string& /* name */,
+                             const TMessageType /* messageType */,
+                             const int32_t /* seqid */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeMessageEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeStructBegin(const char* /* name */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeStructEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeFieldBegin(const char* /* name */,
+                           const TType /* fieldType */,
+                           const int16_t /* fieldId */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeFieldEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeFieldStop() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeMapBegin(const TType /* keyType */,
+                         const TType /* valType */,
+                         const uint32_t /* size */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeMapEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeListBegin(const TType /* elemType */,
+                          const uint32_t /* size */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeListEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeSetBegin(const TType /* elemType */,
+                         const uint32_t /* size */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeSetEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeBool(const bool /* value */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeByte(const int8_t /* byte */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeI16(const int16_t /* i16 */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeI32(const int32_t /* i32 */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeI64(const int64_t /* i64 */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeDouble(const double /* dub */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeString(const std::string& /* str */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeBinary(const std::string& /* str */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t readMessageBegin(std::string& /* name */,
+                            TMessageType& /* messageType */,
+                            int32_t& /* seqid */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readMessageEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readStructBegin(std::string& /* name */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readStructEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readFieldBegin(std::string& /* name */,
+                          TType& /* fieldType */,
+                          int16_t& /* fieldId */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readFieldEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readMapBegin(TType& /* keyType */,
+                        TType& /* valType */,
+                        uint32_t& /* size */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readMapEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readListBegin(TType& /* elemType */,
+                         uint32_t& /* size */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readListEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readSetBegin(TType& /* elemType */,
+                        uint32_t& /* size */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readSetEnd() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readBool(bool& /* value */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readByte(int8_t& /* byte */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readI16(int16_t& /* i16 */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readI32(int32_t& /* i32 */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readI64(int64_t& /* i64 */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readDouble(double& /* dub */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readString(std::string& /* str */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readBinary(std::string& /* str */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readMessageBegin(const char*& /* name */,
+                            uint32_t& /* nameLen */,
+                            TMessageType& /* messageType */,
+                            int32_t& /* seqid */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readStructBegin() {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readFieldBegin(TType& /* fieldType */,
+                          int16_t& /* fieldId */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t writeString(const char* /* str */, uint32_t /* len */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t writeBinary(const char* /* str */, uint32_t /* len */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support writing (yet).");
+  }
+
+  uint32_t readString(const char*& /* str */, uint32_t& /* len */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t readBinary(const char*& /* str */, uint32_t& /* len */) {
+    throw TProtocolException(TProtocolException::NOT_IMPLEMENTED,
+                             "this protocol does not support reading (yet).");
+  }
+
+  uint32_t skip(TType type) {
+    return ::apache::thrift::protocol::skip(*this, type);
+  }
+
+ protected:
+  TProtocolDefaults(boost::shared_ptr<TTransport> ptrans)
+    : TProtocol(ptrans)
+  {}
+};
+
+/**
+ * Concrete TProtocol classes should inherit from TVirtualProtocol
+ * so they don't have to manually override virtual methods.
+ *
+ * To define a protocol class using TVirtualProtocol:
+ * 1) Derive your subclass from TVirtualProtocol<your class>
+ *      e.g:  class MyProtocol : public TVirtualProtocol<MyProtocol> {
+ * 2) Provide your own non-virtual implementations of the read and write
+ *    methods.  Any that are left out throw NOT_IMPLEMENTED.
+ * 3) Add "using TVirtualProtocol<MyProtocol>::readBool;" if you define
+ *    readBool(bool&), so the std::vector<bool> overload stays visible.
+ *    Likewise for readMessageBegin, readStructBegin and readFieldBegin,
+ *    whose name-free overloads TVirtualProtocol provides, and for the
+ *    string functions, whose (pointer, length) overloads it provides.
+ */
+template <class Protocol_, class Super_=TProtocolDefaults>
+class TVirtualProtocol : public Super_ {
+ public:
+  /**
+   * Writing functions.
+   */
+
+  virtual uint32_t writeMessageBegin_virt(const std::string& name,
+                                          const TMessageType messageType,
+                                          const int32_t seqid) {
+    return static_cast<Protocol_*>(this)->writeMessageBegin(name, messageType, seqid);
+  }
+
+  virtual uint32_t writeMessageEnd_virt() {
+    return static_cast<Protocol_*>(this)->writeMessageEnd();
+  }
+
+  virtual uint32_t writeStructBegin_virt(const char* name) {
+    return static_cast<Protocol_*>(this)->writeStructBegin(name);
+  }
+
+  virtual uint32_t writeStructEnd_virt() {
+    return static_cast<Protocol_*>(this)->writeStructEnd();
+  }
+
+  virtual uint32_t writeFieldBegin_virt(const char* name,
+                                        const TType fieldType,
+                                        const int16_t fieldId) {
+    return static_cast<Protocol_*>(this)->writeFieldBegin(name, fieldType, fieldId);
+  }
+
+  virtual uint32_t writeFieldEnd_virt() {
+    return static_cast<Protocol_*>(this)->writeFieldEnd();
+  }
+
+  virtual uint32_t writeFieldStop_virt() {
+    return static_cast<Protocol_*>(this)->writeFieldStop();
+  }
+
+  virtual uint32_t writeMapBegin_virt(const TType keyType,
+                                      const TType valType,
+                                      const uint32_t size) {
+    return static_cast<Protocol_*>(this)->writeMapBegin(keyType, valType, size);
+  }
+
+  virtual uint32_t writeMapEnd_virt() {
+    return static_cast<Protocol_*>(this)->writeMapEnd();
+  }
+
+  virtual uint32_t writeListBegin_virt(const TType elemType,
+                                       const uint32_t size) {
+    return static_cast<Protocol_*>(this)->writeListBegin(elemType, size);
+  }
+
+  virtual uint32_t writeListEnd_virt() {
+    return static_cast<Protocol_*>(this)->writeListEnd();
+  }
+
+  virtual uint32_t writeSetBegin_virt(const TType elemType,
+                                      const uint32_t size) {
+    return static_cast<Protocol_*>(this)->writeSetBegin(elemType, size);
+  }
+
+  virtual uint32_t writeSetEnd_virt() {
+    return static_cast<Protocol_*>(this)->writeSetEnd();
+  }
+
+  virtual uint32_t writeBool_virt(const bool value) {
+    return static_cast<Protocol_*>(this)->writeBool(value);
+  }
+
+  virtual uint32_t writeByte_virt(const int8_t byte) {
+    return static_cast<Protocol_*>(this)->writeByte(byte);
+  }
+
+  virtual uint32_t writeI16_virt(const int16_t i16) {
+    return static_cast<Protocol_*>(this)->writeI16(i16);
+  }
+
+  virtual uint32_t writeI32_virt(const int32_t i32) {
+    return static_cast<Protocol_*>(this)->writeI32(i32);
+  }
+
+  virtual uint32_t writeI64_virt(const int64_t i64) {
+    return static_cast<Protocol_*>(this)->writeI64(i64);
+  }
+
+  virtual uint32_t writeDouble_virt(const double dub) {
+    return static_cast<Protocol_*>(this)->writeDouble(dub);
+  }
+
+  virtual uint32_t writeString_virt(const std::string& str) {
+    return static_cast<Protocol_*>(this)->writeString(str);
+  }
+
+  virtual uint32_t writeBinary_virt(const std::string& str) {
+    return static_cast<Protocol_*>(this)->writeBinary(str);
+  }
+
+  /**
+   * Reading functions
+   */
+
+  virtual uint32_t readMessageBegin_virt(std::string& name,
+                                         TMessageType& messageType,
+                                         int32_t& seqid) {
+    return static_cast<Protocol_*>(this)->readMessageBegin(name, messageType, seqid);
+  }
+
+  virtual uint32_t readMessageEnd_virt() {
+    return static_cast<Protocol_*>(this)->readMessageEnd();
+  }
+
+  virtual uint32_t readStructBegin_virt(std::string& name) {
+    return static_cast<Protocol_*>(this)->readStructBegin(name);
+  }
+
+  virtual uint32_t readStructEnd_virt() {
+    return static_cast<Protocol_*>(this)->readStructEnd();
+  }
+
+  virtual uint32_t readFieldBegin_virt(std::string& name,
+                                       TType& fieldType,
+                                       int16_t& fieldId) {
+    return static_cast<Protocol_*>(this)->readFieldBegin(name, fieldType, fieldId);
+  }
+
+  virtual uint32_t readFieldEnd_virt() {
+    return static_cast<Protocol_*>(this)->readFieldEnd();
+  }
+
+  virtual uint32_t readMapBegin_virt(TType& keyType,
+                                     TType& valType,
+                                     uint32_t& size) {
+    return static_cast<Protocol_*>(this)->readMapBegin(keyType, valType, size);
+  }
+
+  virtual uint32_t readMapEnd_virt() {
+    return static_cast<Protocol_*>(this)->readMapEnd();
+  }
+
+  virtual uint32_t readListBegin_virt(TType& elemType,
+                                      uint32_t& size) {
+    return static_cast<Protocol_*>(this)->readListBegin(elemType, size);
+  }
+
+  virtual uint32_t readListEnd_virt() {
+    return static_cast<Protocol_*>(this)->readListEnd();
+  }
+
+  virtual uint32_t readSetBegin_virt(TType& elemType,
+                                     uint32_t& size) {
+    return static_cast<Protocol_*>(this)->readSetBegin(elemType, size);
+  }
+
+  virtual uint32_t readSetEnd_virt() {
+    return static_cast<Protocol_*>(this)->readSetEnd();
+  }
+
+  virtual uint32_t readBool_virt(bool& value) {
+    return static_cast<Protocol_*>(this)->readBool(value);
+  }
+
+  virtual uint32_t readByte_virt(int8_t& byte) {
+    return static_cast<Protocol_*>(this)->readByte(byte);
+  }
+
+  virtual uint32_t readI16_virt(int16_t& i16) {
+    return static_cast<Protocol_*>(this)->readI16(i16);
+  }
+
+  virtual uint32_t readI32_virt(int32_t& i32) {
+    return static_cast<Protocol_*>(this)->readI32(i32);
+  }
+
+  virtual uint32_t readI64_virt(int64_t& i64) {
+    return static_cast<Protocol_*>(this)->readI64(i64);
+  }
+
+  virtual uint32_t readDouble_virt(double& dub) {
+    return static_cast<Protocol_*>(this)->readDouble(dub);
+  }
+
+  virtual uint32_t readString_virt(std::string& str) {
+    return static_cast<Protocol_*>(this)->readString(str);
+  }
+
+  virtual uint32_t readBinary_virt(std::string& str) {
+    return static_cast<Protocol_*>(this)->readBinary(str);
+  }
+
+  virtual uint32_t readBool_virt(std::vector<bool>::reference value) {
+    return readBool(value);
+  }
+
+  virtual uint32_t readMessageBegin_virt(const char*& name,
+                                         uint32_t& nameLen,
+                                         TMessageType& messageType,
+                                         int32_t& seqid) {
+    return static_cast<Protocol_*>(this)->readMessageBegin(name, nameLen, messageType, seqid);
+  }
+
+  virtual uint32_t readStructBegin_virt() {
+    return static_cast<Protocol_*>(this)->readStructBegin();
+  }
+
+  virtual uint32_t readFieldBegin_virt(TType& fieldType,
+                                       int16_t& fieldId) {
+    return static_cast<Protocol_*>(this)->readFieldBegin(fieldType, fieldId);
+  }
+
+  virtual uint32_t writeString_virt(const char* str, uint32_t len) {
+    return static_cast<Protocol_*>(this)->writeString(str, len);
+  }
+
+  virtual uint32_t writeBinary_virt(const char* str, uint32_t len) {
+    return static_cast<Protocol_*>(this)->writeBinary(str, len);
+  }
+
+  virtual uint32_t readString_virt(const char*& str, uint32_t& len) {
+    return static_cast<Protocol_*>(this)->readString(str, len);
+  }
+
+  virtual uint32_t readBinary_virt(const char*& str, uint32_t& len) {
+    return static_cast<Protocol_*>(this)->readBinary(str, len);
+  }
+
+  virtual uint32_t writeByteArray_virt(const int8_t* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->writeByteArray(values, size);
+  }
+
+  virtual uint32_t writeI16Array_virt(const int16_t* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->writeI16Array(values, size);
+  }
+
+  virtual uint32_t writeI32Array_virt(const int32_t* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->writeI32Array(values, size);
+  }
+
+  virtual uint32_t writeI64Array_virt(const int64_t* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->writeI64Array(values, size);
+  }
+
+  virtual uint32_t writeDoubleArray_virt(const double* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->writeDoubleArray(values, size);
+  }
+
+  virtual uint32_t readByteArray_virt(int8_t* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->readByteArray(values, size);
+  }
+
+  virtual uint32_t readI16Array_virt(int16_t* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->readI16Array(values, size);
+  }
+
+  virtual uint32_t readI32Array_virt(int32_t* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->readI32Array(values, size);
+  }
+
+  virtual uint32_t readI64Array_virt(int64_t* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->readI64Array(values, size);
+  }
+
+  virtual uint32_t readDoubleArray_virt(double* values, uint32_t size) {
+    return static_cast<Protocol_*>(this)->readDoubleArray(values, size);
+  }
+
+  virtual uint32_t skip_virt(TType type) {
+    return static_cast<Protocol_*>(this)->skip(type);
+  }
+
+  /*
+   * Provide a default skip() implementation that uses non-virtual read
+   * methods.
+   *
+   * Note: subclasses that use TVirtualProtocol to derive from another protocol
+   * implementation (i.e., not TProtocolDefaults) should beware that this may
+   * override any non-default skip() implementation provided by the parent
+   * protocol class.  They may need to redefine skip() to call the correct
+   * parent implementation, if desired.
+   */
+  uint32_t skip(TType type) {
+    Protocol_* const prot = static_cast<Protocol_*>(this);
+    return ::apache::thrift::protocol::skip(*prot, type);
+  }
+
+  /*
+   * Provide a default readBool() implementation for use with
+   * std::vector<bool>, that behaves the same as reading into a normal bool.
+   *
+   * Subclasses can override this if desired, but there normally shouldn't
+   * be a need to.
+   */
+  uint32_t readBool(std::vector<bool>::reference value) {
+    bool b = false;
+    uint32_t ret = static_cast<Protocol_*>(this)->readBool(b);
+    value = b;
+    return ret;
+  }
+  using Super_::readBool; // so we don't hide readBool(bool&)
+
+  /*
+   * Provide default name-free read functions on top of the subclass's
+   * versions that take names.  Protocols that can do better (like binary
+   * and compact, which borrow the message name from the transport) define
+   * their own.
+   */
+  uint32_t readMessageBegin(const char*& name,
+                            uint32_t& nameLen,
+                            TMessageType& messageType,
+                            int32_t& seqid) {
+    uint32_t result = static_cast<Protocol_*>(this)->readMessageBegin(
+      this->messageName_, messageType, seqid);
+    name = this->messageName_.data();
+    nameLen = this->messageName_.size();
+    return result;
+  }
+  using Super_::readMessageBegin;
+
+  uint32_t readStructBegin() {
+    std::string name;
+    return static_cast<Protocol_*>(this)->readStructBegin(name);
+  }
+  using Super_::readStructBegin;
+
+  uint32_t readFieldBegin(TType& fieldType,
+                          int16_t& fieldId) {
+    std::string name;
+    return static_cast<Protocol_*>(this)->readFieldBegin(name, fieldType, fieldId);
+  }
+  using Super_::readFieldBegin;
+
+  /*
+   * Likewise, provide default (pointer, length) string functions on top of
+   * the subclass's std::string versions.
+   */
+  uint32_t writeString(const char* str, uint32_t len) {
+    return static_cast<Protocol_*>(this)->writeString(std::string(str, len));
+  }
+  using Super_::writeString;
+
+  uint32_t writeBinary(const char* str, uint32_t len) {
+    return static_cast<Protocol_*>(this)->writeBinary(std::string(str, len));
+  }
+  using Super_::writeBinary;
+
+  uint32_t readString(const char*& str, uint32_t& len) {
+    uint32_t result = static_cast<Protocol_*>(this)->readString(this->stringBuf_);
+    str = this->stringBuf_.data();
+    len = this->stringBuf_.size();
+    return result;
+  }
+  using Super_::readString;
+
+  uint32_t readBinary(const char*& str, uint32_t& len) {
+    uint32_t result = static_cast<Protocol_*>(this)->readBinary(this->stringBuf_);
+    str = this->stringBuf_.data();
+    len = this->stringBuf_.size();
+    return result;
+  }
+  using Super_::readBinary;
+
+  /*
+   * Provide default bulk numeric functions that loop over the subclass's
+   * single value functions.
+   */
+  uint32_t writeByteArray(const int8_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeByte(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeI16Array(const int16_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeI16(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeI32Array(const int32_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeI32(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeI64Array(const int64_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeI64(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t writeDoubleArray(const double* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->writeDouble(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readByteArray(int8_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readByte(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readI16Array(int16_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readI16(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readI32Array(int32_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readI32(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readI64Array(int64_t* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readI64(values[i]);
+    }
+    return xfer;
+  }
+
+  uint32_t readDoubleArray(double* values, uint32_t size) {
+    uint32_t xfer = 0;
+    for (uint32_t i = 0; i < size; ++i) {
+      xfer += static_cast<Protocol_*>(this)->readDouble(values[i]);
+    }
+    return xfer;
+  }
+
+ protected:
+  TVirtualProtocol(boost::shared_ptr<TTransport> ptrans)
+    : Super_(ptrans)
+  {}
+};
+
+}}} // apache::thrift::protocol
+
+#endif // #define _THRIFT_PROTOCOL_TVIRTUALPROTOCOL_H_ 1
@@ -19,13 +19,16 @@
 
 #include "TNonblockingServer.h"
 #include <concurrency/Exception.h>
+#include <concurrency/PosixThreadFactory.h>
 #include <transport/TSocket.h>
+#include <transport/TCompressedFramedTransport.h>
 
 #include <iostream>
 #include <sys/socket.h>
 #include <netinet/in.h>
 #include <netinet/tcp.h>
 #include <netdb.h>
+#include <sys/uio.h>
 #include <fcntl.h>
 #include <errno.h>
 #include <assert.h>
@@ -48,15 +51,19 @@ class TConnection::Task: public Runnable {
   Task(boost::shared_ptr<TProcessor> processor,
        boost::shared_ptr<TProtocol> input,
        boost::shared_ptr<TProtocol> output,
-       TConnection* connection) :
+       TArena* arena,
+       TConnection* connection,
+       Request* request = NULL) :
     processor_(processor),
     input_(input),
     output_(output),
-    connection_(connection) {}
+    arena_(arena),
+    connection_(connection),
+    request_(request) {}
 
   void run() {
     try {
-      while (processor_->process(input_, output_)) {
+      while (processor_->process(input_, output_, arena_)) {
         if (!input_->getTransport()->peek()) {
           break;
         }
@@ -73,7 +80,10 @@ class TConnection::Task: public Runnable {
     }
 
     // Signal completion back to the libevent thread via a pipe
-    if (!connection_->notifyServer()) {
+    bool notified = (request_ != NULL ?
+                     connection_->completeRequest(request_) :
+                     connection_->notifyServer());
+    if (!notified) {
       throw TException("TNonblockingServer::Task::run: failed write on notify pipe");
     }
   }
@@ -82,16 +92,58 @@ class TConnection::Task: public Runnable {
     return connection_;
   }
 
+  /// The request this task processes, or NULL for a whole connection
+  Request* getRequest() {
+    return request_;
+  }
+
  private:
   boost::shared_ptr<TProcessor> processor_;
   boost::shared_ptr<TProtocol> input_;
   boost::shared_ptr<TProtocol> output_;
+  TArena* arena_;
   TConnection* connection_;
+  Request* request_;
+};
+
+class TConnection::Request {
+ public:
+  Request() :
+    buffer((uint8_t*)std::malloc(STARTING_CONNECTION_BUFFER_SIZE)),
+    bufferSize(STARTING_CONNECTION_BUFFER_SIZE),
+    input(new TMemoryBuffer(NULL, 0)),
+    output(new TMemoryBuffer()),
+    aborted(false) {
+    if (buffer == NULL) {
+      throw TException("Out of memory.");
+    }
+  }
+
+  ~Request() {
+    std::free(buffer);
+  }
+
+  /// The request frame, traded with the connection's read buffer
+  uint8_t* buffer;
+  uint32_t bufferSize;
+
+  boost::shared_ptr<TMemoryBuffer> input;
+  boost::shared_ptr<TMemoryBuffer> output;
+  boost::shared_ptr<TTransport> factoryInput;
+  boost::shared_ptr<TTransport> factoryOutput;
+  boost::shared_ptr<TProtocol> inputProtocol;
+  boost::shared_ptr<TProtocol> outputProtocol;
+  TArena arena;
+
+  /// Dropped before it was processed
+  bool aborted;
 };
 
-void TConnection::init(int socket, short eventFlags, TNonblockingServer* s) {
+void TConnection::init(int socket, short eventFlags, TNonblockingServer* s,
+                       TNonblockingIOThread* ioThread) {
   socket_ = socket;
   server_ = s;
+  ioThread_ = ioThread;
   appState_ = APP_INIT;
   eventFlags_ = 0;
 
@@ -105,124 +157,181 @@ void TConnection::init(int socket, short eventFlags, TNonblockingServer* s) {
   socketState_ = SOCKET_RECV;
   appState_ = APP_INIT;
 
+  maxRequestsInFlight_ = s->getMaxRequestsInFlight();
+  pipelined_ = s->isThreadPoolProcessing() && maxRequestsInFlight_ > 1;
+  requestsInFlight_ = 0;
+  closing_ = false;
+
   // Set flags, which also registers the event
   setFlags(eventFlags);
 
-  // get input/transports
-  factoryInputTransport_ = s->getInputTransportFactory()->getTransport(inputTransport_);
-  factoryOutputTransport_ = s->getOutputTransportFactory()->getTransport(outputTransport_);
+  createProtocols(inputTransport_, outputTransport_,
+                  factoryInputTransport_, factoryOutputTransport_,
+                  inputProtocol_, outputProtocol_);
+}
+
+void TConnection::createProtocols(boost::shared_ptr<TMemoryBuffer> input,
+                                  boost::shared_ptr<TMemoryBuffer> output,
+                                  boost::shared_ptr<TTransport>& factoryInput,
+                                  boost::shared_ptr<TTransport>& factoryOutput,
+                                  boost::shared_ptr<TProtocol>& inputProtocol,
+                                  boost::shared_ptr<TProtocol>& outputProtocol) {
+  // get input/transports.  The request frame is already complete in the
+  // input buffer, which observes it without copying; with the bypass on the
+  // protocol borrows from it directly and no input transport is made.
+  if (server_->getBypassInputTransportFactory()) {
+    factoryInput = input;
+  } else {
+    factoryInput = server_->getInputTransportFactory()->getTransport(input);
+  }
+  factoryOutput = server_->getOutputTransportFactory()->getTransport(output);
+
+  // We read and write the frames ourselves, so compressed framed transports
+  // only have to deal with their payloads.
+  TCompressedFramedTransport* compressed;
+  if ((compressed = dynamic_cast<TCompressedFramedTransport*>(factoryInput.get()))) {
+    compressed->setFramed(false);
+  }
+  if ((compressed = dynamic_cast<TCompressedFramedTransport*>(factoryOutput.get()))) {
+    compressed->setFramed(false);
+  }
 
   // Create protocol
-  inputProtocol_ = s->getInputProtocolFactory()->getProtocol(factoryInputTransport_);
-  outputProtocol_ = s->getOutputProtocolFactory()->getProtocol(factoryOutputTransport_);
+  inputProtocol = server_->getInputProtocolFactory()->getProtocol(factoryInput);
+  outputProtocol = server_->getOutputProtocolFactory()->getProtocol(factoryOutput);
 }
 
 void TConnection::workSocket() {
-  int flags=0, got=0, left=0, sent=0;
-  uint32_t fetch = 0;
+  uint32_t frameLen = 0;
 
   switch (socketState_) {
   case SOCKET_RECV:
-    // It is an error to be in this state if we already have all the data
-    assert(readBufferPos_ < readWant_);
-
-    // Double the buffer size until it is big enough
-    if (readWant_ > readBufferSize_) {
-      uint32_t newSize = readBufferSize_;
-      while (readWant_ > newSize) {
-        newSize *= 2;
-      }
-      uint8_t* newBuffer = (uint8_t*)std::realloc(readBuffer_, newSize);
-      if (newBuffer == NULL) {
-        GlobalOutput("TConnection::workSocket() realloc");
-        close();
-        return;
-      }
-      readBuffer_ = newBuffer;
-      readBufferSize_ = newSize;
-    }
-
-    // Read from the socket
-    fetch = readWant_ - readBufferPos_;
-    got = recv(socket_, readBuffer_ + readBufferPos_, fetch, 0);
-
-    if (got > 0) {
-      // Move along in the buffer
-      readBufferPos_ += got;
-
-      // Check that we did not overdo it
-      assert(readBufferPos_ <= readWant_);
-
-      // We are done reading, move onto the next state
-      if (readBufferPos_ == readWant_) {
-        transition();
-      }
-      return;
-    } else if (got == -1) {
-      // Blocking errors are okay, just move on
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        return;
-      }
-
-      if (errno != ECONNRESET) {
-        GlobalOutput.perror("TConnection::workSocket() recv -1 ", errno);
-      }
+    // We are done reading, move onto the next state
+    if (readSocket() && readBufferPos_ == readWant_) {
+      transition();
     }
-
-    // Whenever we get down here it means a remote disconnect
-    close();
-
     return;
 
   case SOCKET_SEND:
+    // The frame on the wire is the size header followed by writeBuffer_
+    frameLen = sizeof(writeFrameSize_) + writeBufferSize_;
+
     // Should never have position past size
-    assert(writeBufferPos_ <= writeBufferSize_);
+    assert(writeBufferPos_ <= frameLen);
 
     // If there is no data to send, then let us move on
-    if (writeBufferPos_ == writeBufferSize_) {
+    if (writeBufferPos_ == frameLen) {
       GlobalOutput("WARNING: Send state with no data to send\n");
       transition();
       return;
     }
 
-    flags = 0;
-    #ifdef MSG_NOSIGNAL
-    // Note the use of MSG_NOSIGNAL to suppress SIGPIPE errors, instead we
-    // check for the EPIPE return condition and close the socket in that case
-    flags |= MSG_NOSIGNAL;
-    #endif // ifdef MSG_NOSIGNAL
+    // We are done!
+    if (writeSocket() && writeBufferPos_ == frameLen) {
+      transition();
+    }
+    return;
 
-    left = writeBufferSize_ - writeBufferPos_;
-    sent = send(socket_, writeBuffer_ + writeBufferPos_, left, flags);
+  default:
+    GlobalOutput.printf("Unexpected Socket State %d", socketState_);
+    assert(0);
+  }
+}
 
-    if (sent <= 0) {
-      // Blocking errors are okay, just move on
-      if (errno == EAGAIN || errno == EWOULDBLOCK) {
-        return;
-      }
-      if (errno != EPIPE) {
-        GlobalOutput.perror("TConnection::workSocket() send -1 ", errno);
-      }
+bool TConnection::readSocket() {
+  // It is an error to be in this state if we already have all the data
+  assert(readBufferPos_ < readWant_);
+
+  // Double the buffer size until it is big enough
+  if (readWant_ > readBufferSize_) {
+    uint32_t newSize = readBufferSize_;
+    while (readWant_ > newSize) {
+      newSize *= 2;
+    }
+    uint8_t* newBuffer = (uint8_t*)std::realloc(readBuffer_, newSize);
+    if (newBuffer == NULL) {
+      GlobalOutput("TConnection::workSocket() realloc");
       close();
-      return;
+      return false;
     }
+    readBuffer_ = newBuffer;
+    readBufferSize_ = newSize;
+  }
 
-    writeBufferPos_ += sent;
+  // Read from the socket
+  uint32_t fetch = readWant_ - readBufferPos_;
+  int got = recv(socket_, readBuffer_ + readBufferPos_, fetch, 0);
 
-    // Did we overdo it?
-    assert(writeBufferPos_ <= writeBufferSize_);
+  if (got > 0) {
+    // Move along in the buffer
+    readBufferPos_ += got;
 
-    // We are done!
-    if (writeBufferPos_ == writeBufferSize_) {
-      transition();
+    // Check that we did not overdo it
+    assert(readBufferPos_ <= readWant_);
+    return true;
+  } else if (got == -1) {
+    // Blocking errors are okay, just move on
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return true;
     }
 
-    return;
+    if (errno != ECONNRESET) {
+      GlobalOutput.perror("TConnection::workSocket() recv -1 ", errno);
+    }
+  }
 
-  default:
-    GlobalOutput.printf("Unexpected Socket State %d", socketState_);
-    assert(0);
+  // Whenever we get down here it means a remote disconnect
+  close();
+  return false;
+}
+
+bool TConnection::writeSocket() {
+  struct iovec iov[2];
+  struct msghdr msg;
+  uint32_t frameLen = sizeof(writeFrameSize_) + writeBufferSize_;
+  assert(writeBufferPos_ < frameLen);
+
+  int flags = 0;
+  #ifdef MSG_NOSIGNAL
+  // Note the use of MSG_NOSIGNAL to suppress SIGPIPE errors, instead we
+  // check for the EPIPE return condition and close the socket in that case
+  flags |= MSG_NOSIGNAL;
+  #endif // ifdef MSG_NOSIGNAL
+
+  // Gather whatever is left of the header and the body into one sendmsg
+  memset(&msg, 0, sizeof(msg));
+  msg.msg_iov = iov;
+  if (writeBufferPos_ < sizeof(writeFrameSize_)) {
+    iov[0].iov_base = (uint8_t*)&writeFrameSize_ + writeBufferPos_;
+    iov[0].iov_len = sizeof(writeFrameSize_) - writeBufferPos_;
+    iov[1].iov_base = writeBuffer_;
+    iov[1].iov_len = writeBufferSize_;
+    msg.msg_iovlen = 2;
+  } else {
+    iov[0].iov_base =
+      writeBuffer_ + (writeBufferPos_ - sizeof(writeFrameSize_));
+    iov[0].iov_len = frameLen - writeBufferPos_;
+    msg.msg_iovlen = 1;
   }
+  int sent = sendmsg(socket_, &msg, flags);
+
+  if (sent <= 0) {
+    // Blocking errors are okay, just move on
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      return true;
+    }
+    if (errno != EPIPE) {
+      GlobalOutput.perror("TConnection::workSocket() send -1 ", errno);
+    }
+    close();
+    return false;
+  }
+
+  writeBufferPos_ += sent;
+
+  // Did we overdo it?
+  assert(writeBufferPos_ <= frameLen);
+  return true;
 }
 
 /**
@@ -238,6 +347,11 @@ void TConnection::transition() {
   switch (appState_) {
 
   case APP_READ_REQUEST:
+    if (pipelined_) {
+      dispatchRequest();
+      return;
+    }
+
     // We are done reading the request, package the read buffer into transport
     // and get back some data from the dispatch function
     // If we've used these transport buffers enough times, reset them to avoid bloating
@@ -258,11 +372,6 @@ void TConnection::transition() {
       }
     }
 
-    // Prepend four bytes of blank space to the buffer so we can
-    // write the frame size there later.
-    outputTransport_->getWritePtr(4);
-    outputTransport_->wroteBytes(4);
-
     server_->incrementActiveProcessors();
 
     if (server_->isThreadPoolProcessing()) {
@@ -273,6 +382,7 @@ void TConnection::transition() {
         boost::shared_ptr<Runnable>(new Task(server_->getProcessor(),
                                              inputProtocol_,
                                              outputProtocol_,
+                                             &arena_,
                                              this));
       // The application is now waiting on the task to finish
       appState_ = APP_WAIT_TASK;
@@ -293,7 +403,8 @@ void TConnection::transition() {
     } else {
       try {
         // Invoke the processor
-        server_->getProcessor()->process(inputProtocol_, outputProtocol_);
+        server_->getProcessor()->process(inputProtocol_, outputProtocol_,
+                                         &arena_);
       } catch (TTransportException &ttx) {
         GlobalOutput.printf("TTransportException: Server::process() %s", ttx.what());
         server_->decrementActiveProcessors();
@@ -326,16 +437,14 @@ void TConnection::transition() {
 
     // If the function call generated return data, then move into the send
     // state and get going
-    // 4 bytes were reserved for frame size
-    if (writeBufferSize_ > 4) {
+    if (writeBufferSize_ > 0) {
 
       // Move into write state
       writeBufferPos_ = 0;
       socketState_ = SOCKET_SEND;
 
-      // Put the frame size into the write buffer
-      int32_t frameSize = (int32_t)htonl(writeBufferSize_ - 4);
-      memcpy(writeBuffer_, &frameSize, 4);
+      // The frame size goes out ahead of the buffer, in the same sendmsg
+      writeFrameSize_ = (int32_t)htonl(writeBufferSize_);
 
       // Socket into write mode
       appState_ = APP_SEND_RESULT;
@@ -360,6 +469,9 @@ void TConnection::transition() {
   LABEL_APP_INIT:
   case APP_INIT:
 
+    // The response is out, so nothing refers to the request's arena any more
+    arena_.reset();
+
     // reset the input buffer if we used it enough times that it might be bloated
     if (numReadsSinceReset_ > 512)
     {
@@ -479,7 +591,7 @@ void TConnection::setFlags(short eventFlags) {
    * its own ev.
    */
   event_set(&event_, socket_, eventFlags_, TConnection::eventHandler, this);
-  event_base_set(server_->getEventBase(), &event_);
+  event_base_set(ioThread_->getEventBase(), &event_);
 
   // Add the event
   if (event_add(&event_, 0) == -1) {
@@ -487,6 +599,199 @@ void TConnection::setFlags(short eventFlags) {
   }
 }
 
+void TConnection::notified() {
+  if (pipelined_ && appState_ != APP_INIT) {
+    collectResponses();
+  } else {
+    transition();
+  }
+}
+
+bool TConnection::completeRequest(Request* request) {
+  // One notification per batch: the IO thread collects all of completed_
+  // when it gets one, so a notification per request could arrive after the
+  // connection has been recycled.  Notify while still holding the lock, as
+  // once the IO thread has collected the last request the connection may
+  // be gone.
+  Guard g(completedMutex_);
+  bool notify = completed_.empty();
+  completed_.push_back(request);
+  return !notify || notifyServer();
+}
+
+void TConnection::abortRequest(Request* request) {
+  request->aborted = true;
+  if (!completeRequest(request)) {
+    throw TException("TConnection::abortRequest: failed write on notify pipe");
+  }
+}
+
+void TConnection::workPipelined(short which) {
+  if (which & EV_WRITE) {
+    if (!writeResponses()) {
+      return;
+    }
+    setPipelinedFlags();
+  }
+
+  // Reads stop while the connection is at its limit of requests
+  if ((which & EV_READ) && (eventFlags_ & EV_READ)) {
+    if (readSocket() && readBufferPos_ == readWant_) {
+      transition();
+    }
+  }
+}
+
+void TConnection::dispatchRequest() {
+  Request* request = getRequest();
+
+  // The request takes the frame along with the read buffer, and leaves its
+  // old buffer for reading the next frame into
+  std::swap(readBuffer_, request->buffer);
+  std::swap(readBufferSize_, request->bufferSize);
+  request->input->resetBuffer(request->buffer, readBufferPos_);
+  request->output->resetBuffer();
+
+  ++requestsInFlight_;
+  server_->incrementActiveProcessors();
+
+  boost::shared_ptr<Runnable> task(new Task(server_->getProcessor(),
+                                            request->inputProtocol,
+                                            request->outputProtocol,
+                                            &request->arena,
+                                            this,
+                                            request));
+  try {
+    server_->addTask(task);
+  } catch (IllegalStateException & ise) {
+    // The ThreadManager is not ready to handle any more tasks (it's probably shutting down).
+    GlobalOutput.printf("IllegalStateException: Server::process() %s", ise.what());
+    --requestsInFlight_;
+    server_->decrementActiveProcessors();
+    releaseRequest(request);
+    close();
+    return;
+  }
+
+  // Go on with the next frame while the request runs
+  readBufferPos_ = 0;
+  readWant_ = 4;
+  appState_ = APP_READ_FRAME_SIZE;
+  setPipelinedFlags();
+}
+
+void TConnection::collectResponses() {
+  std::vector<Request*> done;
+  {
+    Guard g(completedMutex_);
+    done.swap(completed_);
+  }
+  if (done.empty()) {
+    return;
+  }
+
+  bool aborted = false;
+  for (std::vector<Request*>::iterator it = done.begin(); it != done.end(); ++it) {
+    Request* request = *it;
+    server_->decrementActiveProcessors();
+    if (closing_ || request->aborted || request->output->available_read() == 0) {
+      // Nothing to send: a oneway call, or one we won't answer
+      aborted = aborted || request->aborted;
+      --requestsInFlight_;
+      releaseRequest(request);
+    } else {
+      writeQueue_.push_back(request);
+    }
+  }
+
+  if (closing_) {
+    // Once the last request is back nothing refers to us any more
+    if (requestsInFlight_ == 0) {
+      closing_ = false;
+      server_->returnConnection(this);
+    }
+    return;
+  }
+
+  // The client would wait forever for the dropped response
+  if (aborted) {
+    close();
+    return;
+  }
+
+  startResponse();
+  setPipelinedFlags();
+}
+
+bool TConnection::writeResponses() {
+  while (writeBuffer_ != NULL) {
+    if (!writeSocket()) {
+      return false;
+    }
+    if (writeBufferPos_ < sizeof(writeFrameSize_) + writeBufferSize_) {
+      // The socket is full, wait until it drains
+      return true;
+    }
+
+    Request* request = writeQueue_.front();
+    writeQueue_.pop_front();
+    --requestsInFlight_;
+    releaseRequest(request);
+
+    writeBuffer_ = NULL;
+    writeBufferSize_ = 0;
+    writeBufferPos_ = 0;
+    startResponse();
+  }
+  return true;
+}
+
+void TConnection::startResponse() {
+  if (writeBuffer_ == NULL && !writeQueue_.empty()) {
+    writeQueue_.front()->output->getBuffer(&writeBuffer_, &writeBufferSize_);
+    writeFrameSize_ = (int32_t)htonl(writeBufferSize_);
+    writeBufferPos_ = 0;
+  }
+}
+
+void TConnection::setPipelinedFlags() {
+  short eventFlags = 0;
+  if (requestsInFlight_ < maxRequestsInFlight_) {
+    eventFlags |= EV_READ;
+  }
+  if (writeBuffer_ != NULL) {
+    eventFlags |= EV_WRITE;
+  }
+  setFlags(eventFlags ? (eventFlags | EV_PERSIST) : 0);
+}
+
+TConnection::Request* TConnection::getRequest() {
+  if (!freeRequests_.empty()) {
+    Request* request = freeRequests_.back();
+    freeRequests_.pop_back();
+    return request;
+  }
+
+  Request* request = new Request();
+  createProtocols(request->input, request->output,
+                  request->factoryInput, request->factoryOutput,
+                  request->inputProtocol, request->outputProtocol);
+  return request;
+}
+
+void TConnection::releaseRequest(Request* request) {
+  request->arena.reset();
+  request->aborted = false;
+  freeRequests_.push_back(request);
+}
+
+void TConnection::deleteRequests() {
+  for (size_t i = 0; i < freeRequests_.size(); ++i) {
+    delete freeRequests_[i];
+  }
+  freeRequests_.clear();
+}
+
 /**
  * Closes a connection
  */
@@ -506,18 +811,45 @@ void TConnection::close() {
   factoryInputTransport_->close();
   factoryOutputTransport_->close();
 
+  arena_.reset();
+
+  if (pipelined_) {
+    // Responses not sent yet are dropped
+    while (!writeQueue_.empty()) {
+      releaseRequest(writeQueue_.front());
+      writeQueue_.pop_front();
+      --requestsInFlight_;
+    }
+    writeBuffer_ = NULL;
+    writeBufferSize_ = 0;
+    writeBufferPos_ = 0;
+
+    // Workers still hold requests of ours; the last one to come back
+    // returns the connection
+    if (requestsInFlight_ > 0) {
+      closing_ = true;
+      return;
+    }
+  }
+
   // Give this object back to the server that owns it
   server_->returnConnection(this);
 }
 
 void TConnection::checkIdleBufferMemLimit(size_t limit) {
+  // Idle connections don't keep buffers for requests in flight either
+  deleteRequests();
+
   if (readBufferSize_ > limit) {
-    readBufferSize_ = limit;
-    readBuffer_ = (uint8_t*)std::realloc(readBuffer_, readBufferSize_);
-    if (readBuffer_ == NULL) {
+    // This runs while the server holds its connection lock, so on failure
+    // just keep the larger buffer rather than closing (and returning) again
+    uint8_t* newBuffer = (uint8_t*)std::realloc(readBuffer_, limit);
+    if (newBuffer == NULL) {
       GlobalOutput("TConnection::checkIdleBufferMemLimit() realloc");
-      close();
+      return;
     }
+    readBuffer_ = newBuffer;
+    readBufferSize_ = limit;
   }
 }
 
@@ -526,21 +858,54 @@ void TConnection::checkIdleBufferMemLimit(size_t limit) {
  * by allocating a new one entirely
  */
 TConnection* TNonblockingServer::createConnection(int socket, short flags) {
+  Guard g(connMutex_);
+
+  TNonblockingIOThread* ioThread = selectIOThread();
+
   // Check the stack
   if (connectionStack_.empty()) {
-    return new TConnection(socket, flags, this);
+    return new TConnection(socket, flags, this, ioThread);
   } else {
     TConnection* result = connectionStack_.top();
     connectionStack_.pop();
-    result->init(socket, flags, this);
+    result->init(socket, flags, this, ioThread);
     return result;
   }
 }
 
+/**
+ * Picks the IO thread for a new connection according to ioThreadSelection_
+ */
+TNonblockingIOThread* TNonblockingServer::selectIOThread() {
+  assert(!ioThreads_.empty());
+  size_t index = 0;
+
+  if (ioThreads_.size() > 1) {
+    if (ioThreadSelection_ == T_IO_THREAD_LEAST_CONNECTIONS) {
+      for (size_t i = 1; i < ioThreads_.size(); ++i) {
+        if (ioThreads_[i]->getNumConnections() <
+            ioThreads_[index]->getNumConnections()) {
+          index = i;
+        }
+      }
+    } else {
+      index = nextIOThread_++ % ioThreads_.size();
+    }
+  }
+
+  TNonblockingIOThread* ioThread = ioThreads_[index].get();
+  ioThread->incrementNumConnections();
+  return ioThread;
+}
+
 /**
  * Returns a connection to the stack
  */
 void TNonblockingServer::returnConnection(TConnection* connection) {
+  Guard g(connMutex_);
+
+  connection->getIOThread()->decrementNumConnections();
+
   if (connectionStackLimit_ &&
       (connectionStack_.size() >= connectionStackLimit_)) {
     delete connection;
@@ -594,9 +959,9 @@ void TNonblockingServer::handleEvent(int fd, short which) {
       return;
     }
 
-    // Create a new TConnection for this client socket.
-    TConnection* clientConnection =
-      createConnection(clientSocket, EV_READ | EV_PERSIST);
+    // Create a new TConnection for this client socket.  Its events are
+    // registered by the IO thread it is bound to, on that thread's base.
+    TConnection* clientConnection = createConnection(clientSocket, 0);
 
     // Fail fast if we could not create a TConnection object
     if (clientConnection == NULL) {
@@ -605,8 +970,17 @@ void TNonblockingServer::handleEvent(int fd, short which) {
       return;
     }
 
-    // Put this client connection into the proper state
-    clientConnection->transition();
+    // Put this client connection into the proper state, either right here
+    // if it belongs to the accepting thread or by handing it over to the
+    // IO thread that owns it
+    if (clientConnection->getIOThread()->getThreadNumber() == 0) {
+      clientConnection->transition();
+    } else if (!clientConnection->notifyServer()) {
+      GlobalOutput.perror("thriftServerEventHandler: IO thread notify ", errno);
+      close(clientSocket);
+      returnConnection(clientConnection);
+      return;
+    }
 
     // addrLen is written by the accept() call, so needs to be set before the next call.
     addrLen = sizeof(addr);
@@ -727,63 +1101,51 @@ void TNonblockingServer::listenSocket(int s) {
   serverSocket_ = s;
 }
 
-void TNonblockingServer::createNotificationPipe() {
-  if (pipe(notificationPipeFDs_) != 0) {
-    GlobalOutput.perror("TNonblockingServer::createNotificationPipe ", errno);
-      throw TException("can't create notification pipe");
-  }
-  int flags;
-  if ((flags = fcntl(notificationPipeFDs_[0], F_GETFL, 0)) < 0 ||
-      fcntl(notificationPipeFDs_[0], F_SETFL, flags | O_NONBLOCK) < 0) {
-    close(notificationPipeFDs_[0]);
-    close(notificationPipeFDs_[1]);
-    throw TException("TNonblockingServer::createNotificationPipe() O_NONBLOCK");
-  }
-}
-
 /**
  * Register the core libevent events onto the proper base.
  */
 void TNonblockingServer::registerEvents(event_base* base) {
   assert(serverSocket_ != -1);
-  assert(!eventBase_);
-  eventBase_ = base;
+  assert(ioThreads_.empty());
 
   // Print some libevent stats
   GlobalOutput.printf("libevent %s method %s",
           event_get_version(),
           event_get_method());
 
-  // Register the server event
-  event_set(&serverEvent_,
-            serverSocket_,
-            EV_READ | EV_PERSIST,
-            TNonblockingServer::eventHandler,
-            this);
-  event_base_set(eventBase_, &serverEvent_);
-
-  // Add the event and start up the server
-  if (-1 == event_add(&serverEvent_, 0)) {
-    throw TException("TNonblockingServer::serve(): coult not event_add");
+  for (size_t id = 0; id < numIOThreads_; ++id) {
+    // Only the first IO thread listens for new connections
+    boost::shared_ptr<TNonblockingIOThread> thread(
+      new TNonblockingIOThread(this, id, id == 0 ? serverSocket_ : -1));
+    thread->registerEvents(id == 0 ? base : NULL);
+
+    // A stop() that came before this thread existed still has to stop it
+    Guard g(connMutex_);
+    ioThreads_.push_back(thread);
+    if (stop_) {
+      thread->breakLoop();
+    }
   }
-  if (threadPoolProcessing_) {
-    // Create an event to be notified when a task finishes
-    event_set(&notificationEvent_,
-              getNotificationRecvFD(),
-              EV_READ | EV_PERSIST,
-              TConnection::taskHandler,
-              this);
 
-    // Attach to the base
-    event_base_set(eventBase_, &notificationEvent_);
-
-    // Add the event and start up the server
-    if (-1 == event_add(&notificationEvent_, 0)) {
-      throw TException("TNonblockingServer::serve(): notification event_add fail");
+  // The first IO thread runs in whichever thread drives base; start the rest
+  if (numIOThreads_ > 1) {
+    PosixThreadFactory threadFactory(PosixThreadFactory::ROUND_ROBIN,
+                                     PosixThreadFactory::NORMAL,
+                                     1,
+                                     false);
+    for (size_t id = 1; id < numIOThreads_; ++id) {
+      boost::shared_ptr<Thread> thread =
+        threadFactory.newThread(ioThreads_[id]);
+      ioThreadHandles_.push_back(thread);
+      thread->start();
     }
   }
 }
 
+event_base* TNonblockingServer::getEventBase() const {
+  return ioThreads_.empty() ? NULL : ioThreads_[0]->getEventBase();
+}
+
 void TNonblockingServer::setThreadManager(boost::shared_ptr<ThreadManager> threadManager) {
   threadManager_ = threadManager;
   if (threadManager != NULL) {
@@ -795,6 +1157,7 @@ void TNonblockingServer::setThreadManager(boost::shared_ptr<ThreadManager> threa
 }
 
 bool  TNonblockingServer::serverOverloaded() {
+  Guard g(connMutex_);
   size_t activeConnections = numTConnections_ - connectionStack_.size();
   if (numActiveProcessors_ > maxActiveProcessors_ ||
       activeConnections > maxConnections_) {
@@ -820,8 +1183,13 @@ bool TNonblockingServer::drainPendingTask() {
   if (threadManager_) {
     boost::shared_ptr<Runnable> task = threadManager_->removeNextPending();
     if (task) {
-      TConnection* connection =
-        static_cast<TConnection::Task*>(task.get())->getTConnection();
+      TConnection::Task* connectionTask =
+        static_cast<TConnection::Task*>(task.get());
+      TConnection* connection = connectionTask->getTConnection();
+      if (connectionTask->getRequest() != NULL) {
+        connection->abortRequest(connectionTask->getRequest());
+        return true;
+      }
       assert(connection && connection->getServer()
              && connection->getState() == APP_WAIT_TASK);
       connection->forceClose();
@@ -832,8 +1200,13 @@ bool TNonblockingServer::drainPendingTask() {
 }
 
 void TNonblockingServer::expireClose(boost::shared_ptr<Runnable> task) {
-  TConnection* connection =
-    static_cast<TConnection::Task*>(task.get())->getTConnection();
+  TConnection::Task* connectionTask =
+    static_cast<TConnection::Task*>(task.get());
+  TConnection* connection = connectionTask->getTConnection();
+  if (connectionTask->getRequest() != NULL) {
+    connection->abortRequest(connectionTask->getRequest());
+    return;
+  }
   assert(connection && connection->getServer()
 	 && connection->getState() == APP_WAIT_TASK);
   connection->forceClose();
@@ -847,11 +1220,6 @@ void TNonblockingServer::serve() {
   // Init socket
   listenSocket();
 
-  if (threadPoolProcessing_) {
-    // Init task completion notification pipe
-    createNotificationPipe();
-  }
-
   // Initialize libevent core
   registerEvents(static_cast<event_base*>(event_init()));
 
@@ -860,8 +1228,146 @@ void TNonblockingServer::serve() {
     eventHandler_->preServe();
   }
 
-  // Run libevent engine, never returns, invokes calls to eventHandler
+  // Run libevent engine of the first IO thread in this thread, invokes
+  // calls to eventHandler until stop() is called
+  ioThreads_[0]->run();
+
+  // Whatever ended the first IO thread, take the others down with it
+  stop();
+  joinIOThreads();
+}
+
+void TNonblockingServer::stop() {
+  Guard g(connMutex_);
+  stop_ = true;
+  for (size_t i = 0; i < ioThreads_.size(); ++i) {
+    ioThreads_[i]->breakLoop();
+  }
+}
+
+void TNonblockingServer::joinIOThreads() {
+  for (size_t i = 0; i < ioThreadHandles_.size(); ++i) {
+    ioThreadHandles_[i]->join();
+  }
+  ioThreadHandles_.clear();
+}
+
+TNonblockingServer::~TNonblockingServer() {
+  // The IO threads refer to the server, so they must be gone before it is
+  stop();
+  joinIOThreads();
+  ioThreads_.clear();
+
+  if (serverSocket_ >= 0) {
+    close(serverSocket_);
+  }
+}
+
+TNonblockingIOThread::TNonblockingIOThread(TNonblockingServer* server,
+                                           size_t number,
+                                           int listenSocket) :
+  server_(server),
+  number_(number),
+  listenSocket_(listenSocket),
+  eventBase_(NULL),
+  ownEventBase_(false),
+  numConnections_(0) {
+  notificationPipeFDs_[0] = -1;
+  notificationPipeFDs_[1] = -1;
+}
+
+TNonblockingIOThread::~TNonblockingIOThread() {
+  if (eventBase_ != NULL) {
+    event_del(&notificationEvent_);
+    if (listenSocket_ >= 0) {
+      event_del(&serverEvent_);
+    }
+    if (ownEventBase_) {
+      event_base_free(eventBase_);
+    }
+  }
+  for (int i = 0; i < 2; ++i) {
+    if (notificationPipeFDs_[i] >= 0) {
+      ::close(notificationPipeFDs_[i]);
+    }
+  }
+}
+
+void TNonblockingIOThread::createNotificationPipe() {
+  if (pipe(notificationPipeFDs_) != 0) {
+    GlobalOutput.perror("TNonblockingServer::createNotificationPipe ", errno);
+      throw TException("can't create notification pipe");
+  }
+  int flags;
+  if ((flags = fcntl(notificationPipeFDs_[0], F_GETFL, 0)) < 0 ||
+      fcntl(notificationPipeFDs_[0], F_SETFL, flags | O_NONBLOCK) < 0) {
+    ::close(notificationPipeFDs_[0]);
+    ::close(notificationPipeFDs_[1]);
+    notificationPipeFDs_[0] = notificationPipeFDs_[1] = -1;
+    throw TException("TNonblockingServer::createNotificationPipe() O_NONBLOCK");
+  }
+}
+
+/**
+ * Register the IO thread's libevent events onto its base.
+ */
+void TNonblockingIOThread::registerEvents(event_base* base) {
+  assert(!eventBase_);
+
+  if (base == NULL) {
+    base = event_base_new();
+    if (base == NULL) {
+      throw TException("TNonblockingServer::serve(): event_base_new failed");
+    }
+    ownEventBase_ = true;
+  }
+  eventBase_ = base;
+
+  if (listenSocket_ >= 0) {
+    // Register the server event
+    event_set(&serverEvent_,
+              listenSocket_,
+              EV_READ | EV_PERSIST,
+              TNonblockingServer::eventHandler,
+              server_);
+    event_base_set(eventBase_, &serverEvent_);
+
+    // Add the event and start up the server
+    if (-1 == event_add(&serverEvent_, 0)) {
+      throw TException("TNonblockingServer::serve(): coult not event_add");
+    }
+  }
+
+  // Tasks completing on the thread manager and connections handed over by
+  // the accepting thread are both signalled through this pipe
+  createNotificationPipe();
+
+  // Create an event to be notified when a task finishes
+  event_set(&notificationEvent_,
+            getNotificationRecvFD(),
+            EV_READ | EV_PERSIST,
+            TConnection::taskHandler,
+            this);
+
+  // Attach to the base
+  event_base_set(eventBase_, &notificationEvent_);
+
+  // Add the event and start up the server
+  if (-1 == event_add(&notificationEvent_, 0)) {
+    throw TException("TNonblockingServer::serve(): notification event_add fail");
+  }
+}
+
+void TNonblockingIOThread::run() {
   event_base_loop(eventBase_, 0);
 }
 
+void TNonblockingIOThread::breakLoop() {
+  TConnection* connection = NULL;
+  if (write(getNotificationSendFD(), (const void*)&connection,
+            sizeof(TConnection*)) != sizeof(TConnection*)) {
+    GlobalOutput.perror("TNonblockingIOThread::breakLoop() ", errno);
+  }
+}
+
 }}} // apache::thrift::server
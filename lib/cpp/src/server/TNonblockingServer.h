@@ -21,12 +21,16 @@
 #define _THRIFT_SERVER_TNONBLOCKINGSERVER_H_ 1
 
 #include <Thrift.h>
+#include <TArena.h>
 #include <server/TServer.h>
 #include <transport/TBufferTransports.h>
 #include <concurrency/ThreadManager.h>
+#include <concurrency/Mutex.h>
 #include <climits>
+#include <deque>
 #include <stack>
 #include <string>
+#include <vector>
 #include <errno.h>
 #include <cstdlib>
 #include <unistd.h>
@@ -38,18 +42,37 @@ using apache::thrift::transport::TMemoryBuffer;
 using apache::thrift::protocol::TProtocol;
 using apache::thrift::concurrency::Runnable;
 using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::Mutex;
 
 // Forward declaration of class
 class TConnection;
+class TNonblockingIOThread;
 
 /**
  * This is a non-blocking server in C++ for high performance that operates a
- * single IO thread. It assumes that all incoming requests are framed with a
- * 4 byte length indicator and writes out responses using the same framing.
+ * set of IO threads (by default only one). It assumes that all incoming
+ * requests are framed with a 4 byte length indicator and writes out responses
+ * using the same framing.
  *
  * It does not use the TServerTransport framework, but rather has socket
  * operations hardcoded for use with select.
  *
+ * When more than one IO thread is configured, the first IO thread accepts
+ * new connections and hands each one off to an IO thread chosen by the
+ * TIOThreadSelection policy.  A connection stays on that IO thread for as
+ * long as its socket is open.  Without a thread manager each IO thread runs
+ * the processor itself, so with several IO threads the handler and any
+ * server event handler are called from several threads at once and must
+ * be thread-safe.
+ *
+ * With a thread manager, a connection normally processes one request at a
+ * time.  Raising the number of requests in flight lets a connection keep
+ * reading while its earlier requests run on different workers, and write
+ * each response as soon as it is ready.  Responses then leave in completion
+ * order, so only clients that match them to requests by sequence id, like
+ * the generated asynchronous clients, should use such a server.
+ *
  */
 
 
@@ -60,6 +83,12 @@ enum TOverloadAction {
   T_OVERLOAD_DRAIN_TASK_QUEUE  ///< Drop some tasks from head of task queue */
 };
 
+/// How accepted connections are spread over the IO threads.
+enum TIOThreadSelection {
+  T_IO_THREAD_ROUND_ROBIN,        ///< Cycle through the IO threads */
+  T_IO_THREAD_LEAST_CONNECTIONS   ///< Pick the thread with fewest sockets */
+};
+
 class TNonblockingServer : public TServer {
  private:
   /// Listen backlog
@@ -77,6 +106,12 @@ class TNonblockingServer : public TServer {
   /// Default limit on connections in handler/task processing
   static const int MAX_ACTIVE_PROCESSORS = INT_MAX;
 
+  /// Default number of IO threads
+  static const size_t DEFAULT_IO_THREADS = 1;
+
+  /// Default limit on requests a connection has in flight
+  static const size_t DEFAULT_MAX_REQUESTS_IN_FLIGHT = 1;
+
   /// Server socket file descriptor
   int serverSocket_;
 
@@ -89,14 +124,29 @@ class TNonblockingServer : public TServer {
   /// Is thread pool processing?
   bool threadPoolProcessing_;
 
-  /// The event base for libevent
-  event_base* eventBase_;
+  /// Number of IO threads to run
+  size_t numIOThreads_;
 
-  /// Event struct, used with eventBase_ for connection events
-  struct event serverEvent_;
+  /// How new connections are assigned to IO threads
+  TIOThreadSelection ioThreadSelection_;
 
-  /// Event struct, used with eventBase_ for task completion notification
-  struct event notificationEvent_;
+  /// Index of the next IO thread for round-robin assignment
+  size_t nextIOThread_;
+
+  /// The IO threads; the first one also owns the listen socket
+  std::vector<boost::shared_ptr<TNonblockingIOThread> > ioThreads_;
+
+  /// Thread handles for all IO threads but the first, which runs in serve()
+  std::vector<boost::shared_ptr<Thread> > ioThreadHandles_;
+
+  /// Has stop() been called?  Guarded by connMutex_.
+  bool stop_;
+
+  /**
+   * Guards the connection stack, the connection counters and the per IO
+   * thread connection counts, all of which are touched by every IO thread.
+   */
+  Mutex connMutex_;
 
   /// Number of TConnection object we've created
   size_t numTConnections_;
@@ -113,6 +163,12 @@ class TNonblockingServer : public TServer {
   /// Limit for number of open connections
   size_t maxConnections_;
 
+  /// Limit on requests read from a connection and not yet answered
+  size_t maxRequestsInFlight_;
+
+  /// Do protocols read request frames without the input transport factory?
+  bool bypassInputTransportFactory_;
+
   /// Time in milliseconds before an unperformed task expires (0 == infinite).
   int64_t taskExpireTime_;
 
@@ -142,9 +198,6 @@ class TNonblockingServer : public TServer {
   /// Count of connections dropped on overload since server started
   uint64_t nTotalConnectionsDropped_;
 
-  /// File descriptors for pipe used for task completion notification.
-  int notificationPipeFDs_[2];
-
   /**
    * This is a stack of all the objects that have been created but that
    * are NOT currently in use. When we close a connection, we place it on this
@@ -163,6 +216,17 @@ class TNonblockingServer : public TServer {
    */
   void handleEvent(int fd, short which);
 
+  /**
+   * Choose the IO thread that will own a newly accepted connection, and
+   * account the connection to it.  Caller must hold connMutex_.
+   *
+   * @return the selected IO thread.
+   */
+  TNonblockingIOThread* selectIOThread();
+
+  /// Wait for all IO threads but the first to finish.
+  void joinIOThreads();
+
  public:
   TNonblockingServer(boost::shared_ptr<TProcessor> processor,
                      int port) :
@@ -170,12 +234,17 @@ class TNonblockingServer : public TServer {
     serverSocket_(-1),
     port_(port),
     threadPoolProcessing_(false),
-    eventBase_(NULL),
+    numIOThreads_(DEFAULT_IO_THREADS),
+    ioThreadSelection_(T_IO_THREAD_ROUND_ROBIN),
+    nextIOThread_(0),
+    stop_(false),
     numTConnections_(0),
     numActiveProcessors_(0),
     connectionStackLimit_(CONNECTION_STACK_LIMIT),
     maxActiveProcessors_(MAX_ACTIVE_PROCESSORS),
     maxConnections_(MAX_CONNECTIONS),
+    maxRequestsInFlight_(DEFAULT_MAX_REQUESTS_IN_FLIGHT),
+    bypassInputTransportFactory_(false),
     taskExpireTime_(0),
     overloadHysteresis_(0.8),
     overloadAction_(T_OVERLOAD_NO_ACTION),
@@ -192,12 +261,17 @@ class TNonblockingServer : public TServer {
     serverSocket_(-1),
     port_(port),
     threadManager_(threadManager),
-    eventBase_(NULL),
+    numIOThreads_(DEFAULT_IO_THREADS),
+    ioThreadSelection_(T_IO_THREAD_ROUND_ROBIN),
+    nextIOThread_(0),
+    stop_(false),
     numTConnections_(0),
     numActiveProcessors_(0),
     connectionStackLimit_(CONNECTION_STACK_LIMIT),
     maxActiveProcessors_(MAX_ACTIVE_PROCESSORS),
     maxConnections_(MAX_CONNECTIONS),
+    maxRequestsInFlight_(DEFAULT_MAX_REQUESTS_IN_FLIGHT),
+    bypassInputTransportFactory_(false),
     taskExpireTime_(0),
     overloadHysteresis_(0.8),
     overloadAction_(T_OVERLOAD_NO_ACTION),
@@ -223,12 +297,17 @@ class TNonblockingServer : public TServer {
     serverSocket_(-1),
     port_(port),
     threadManager_(threadManager),
-    eventBase_(NULL),
+    numIOThreads_(DEFAULT_IO_THREADS),
+    ioThreadSelection_(T_IO_THREAD_ROUND_ROBIN),
+    nextIOThread_(0),
+    stop_(false),
     numTConnections_(0),
     numActiveProcessors_(0),
     connectionStackLimit_(CONNECTION_STACK_LIMIT),
     maxActiveProcessors_(MAX_ACTIVE_PROCESSORS),
     maxConnections_(MAX_CONNECTIONS),
+    maxRequestsInFlight_(DEFAULT_MAX_REQUESTS_IN_FLIGHT),
+    bypassInputTransportFactory_(false),
     taskExpireTime_(0),
     overloadHysteresis_(0.8),
     overloadAction_(T_OVERLOAD_NO_ACTION),
@@ -243,7 +322,7 @@ class TNonblockingServer : public TServer {
     setThreadManager(threadManager);
   }
 
-  ~TNonblockingServer() {}
+  ~TNonblockingServer();
 
   void setThreadManager(boost::shared_ptr<ThreadManager> threadManager);
 
@@ -273,13 +352,68 @@ class TNonblockingServer : public TServer {
     return threadPoolProcessing_;
   }
 
+  /**
+   * Get the number of IO threads the server will run.
+   *
+   * @return number of IO threads.
+   */
+  size_t getNumIOThreads() const {
+    return numIOThreads_;
+  }
+
+  /**
+   * Set the number of IO threads the server will run.  Each IO thread has
+   * its own event base and task completion pipe.  Must be called before
+   * serve().
+   *
+   * Without a thread manager, requests are processed on the IO threads, so
+   * more than one IO thread means the handler is called concurrently and
+   * must be thread-safe, just as it must be with a thread manager.
+   *
+   * @param numThreads number of IO threads, at least 1.
+   */
+  void setNumIOThreads(size_t numThreads) {
+    numIOThreads_ = (numThreads > 0 ? numThreads : 1);
+  }
+
+  /**
+   * Get the policy used to assign new connections to IO threads.
+   *
+   * @return a TIOThreadSelection enum value.
+   */
+  TIOThreadSelection getIOThreadSelection() const {
+    return ioThreadSelection_;
+  }
+
+  /**
+   * Set the policy used to assign new connections to IO threads.
+   *
+   * @param selection a TIOThreadSelection enum value.
+   */
+  void setIOThreadSelection(TIOThreadSelection selection) {
+    ioThreadSelection_ = selection;
+  }
+
+  /**
+   * Return an IO thread.  Only valid once the server is serving.
+   *
+   * @param index of the IO thread, 0 is the one that accepts connections.
+   * @return pointer to the IO thread.
+   */
+  TNonblockingIOThread* getIOThread(size_t index) const {
+    return ioThreads_[index].get();
+  }
+
   void addTask(boost::shared_ptr<Runnable> task) {
     threadManager_->add(task, 0LL, taskExpireTime_);
   }
 
-  event_base* getEventBase() const {
-    return eventBase_;
-  }
+  /**
+   * Get the event base of the IO thread that accepts connections.
+   *
+   * @return the libevent base, or NULL if not yet serving.
+   */
+  event_base* getEventBase() const;
 
   /// Increment our count of the number of connected sockets.
   void incrementNumConnections() {
@@ -323,11 +457,13 @@ class TNonblockingServer : public TServer {
 
   /// Increment the count of connections currently processing.
   void incrementActiveProcessors() {
+    concurrency::Guard g(connMutex_);
     ++numActiveProcessors_;
   }
 
   /// Decrement the count of connections currently processing.
   void decrementActiveProcessors() {
+    concurrency::Guard g(connMutex_);
     if (numActiveProcessors_ > 0) {
       --numActiveProcessors_;
     }
@@ -408,6 +544,52 @@ class TNonblockingServer : public TServer {
     overloadAction_ = overloadAction;
   }
 
+  /**
+   * Get the number of requests a connection may have in flight.
+   *
+   * @return current setting.
+   */
+  size_t getMaxRequestsInFlight() const {
+    return maxRequestsInFlight_;
+  }
+
+  /**
+   * Set the number of requests a connection may have in flight, that is
+   * read but not yet answered.  Anything above 1 only takes effect with a
+   * thread manager, and lets responses go out of order.  Connections
+   * accepted from then on use the new setting.
+   *
+   * @param maxRequestsInFlight new setting, at least 1.
+   */
+  void setMaxRequestsInFlight(size_t maxRequestsInFlight) {
+    maxRequestsInFlight_ = (maxRequestsInFlight > 0 ? maxRequestsInFlight : 1);
+  }
+
+  /**
+   * Get whether request frames are read without the input transport factory.
+   *
+   * @return current setting.
+   */
+  bool getBypassInputTransportFactory() const {
+    return bypassInputTransportFactory_;
+  }
+
+  /**
+   * Have the input protocol read each request frame straight from the
+   * connection's buffer, without a transport from the input transport
+   * factory in between.  The server reads whole frames into memory before
+   * processing them, so a factory that only buffers, like
+   * TBufferedTransportFactory, just copies every byte once more; this
+   * avoids that copy.  Do not turn it on with factories whose transports
+   * change or look at the bytes, since they are skipped entirely.  Off by
+   * default.  Connections accepted from then on use the new setting.
+   *
+   * @param bypass true to skip the input transport factory.
+   */
+  void setBypassInputTransportFactory(bool bypass) {
+    bypassInputTransportFactory_ = bypass;
+  }
+
   /**
    * Get the time in milliseconds after which a task expires (0 == infinite).
    *
@@ -466,7 +648,7 @@ class TNonblockingServer : public TServer {
   /**
    * Return an initialized connection object.  Creates or recovers from
    * pool a TConnection and initializes it with the provided socket FD
-   * and flags.
+   * and flags, and binds it to one of the IO threads.
    *
    * @param socket FD of socket associated with this connection.
    * @param flags initial lib_event flags for this connection.
@@ -514,8 +696,66 @@ class TNonblockingServer : public TServer {
    */
   void listenSocket(int fd);
 
-  /// Create the pipe used to notify I/O process of task completion.
-  void createNotificationPipe();
+  /**
+   * Register the core libevent events onto the proper base.  The listen
+   * socket and the first IO thread use the given base; any further IO
+   * threads get event bases of their own and are started here.
+   *
+   * @param base pointer to the event base to be initialized.
+   */
+  void registerEvents(event_base* base);
+
+  /**
+   * Main workhorse function, starts up the server listening on a port and
+   * loops over the libevent handler.  Returns once the server is stopped
+   * and all of its IO threads have finished.
+   */
+  void serve();
+
+  /**
+   * Break the event loops of all IO threads, which makes serve() return.
+   * May be called from any thread, including before serve() has started
+   * them.
+   */
+  void stop();
+};
+
+/**
+ * One IO thread of a TNonblockingServer.  It owns a libevent base and a pipe
+ * on which worker threads (and the accepting thread) post the TConnection
+ * objects that need attention from this thread.  Every TConnection is served
+ * by exactly one IO thread, so connection state needs no locking.
+ */
+class TNonblockingIOThread : public Runnable {
+ public:
+  /**
+   * Create an IO thread.
+   *
+   * @param server the server this thread belongs to.
+   * @param number index of the thread within the server.
+   * @param listenSocket listen socket to watch, or -1 if this thread does
+   *                     not accept connections.
+   */
+  TNonblockingIOThread(TNonblockingServer* server,
+                       size_t number,
+                       int listenSocket);
+
+  ~TNonblockingIOThread();
+
+  /// Return the server this IO thread belongs to.
+  TNonblockingServer* getServer() const {
+    return server_;
+  }
+
+  /// Return the index of this IO thread within the server.
+  size_t getThreadNumber() const {
+    return number_;
+  }
+
+  /// Return the libevent base of this IO thread.
+  event_base* getEventBase() const {
+    return eventBase_;
+  }
 
   /**
    * Get notification pipe send descriptor.
@@ -536,17 +776,71 @@ class TNonblockingServer : public TServer {
   }
 
   /**
-   * Register the core libevent events onto the proper base.
+   * Return the number of connections assigned to this thread.  Guarded by
+   * the owning server's connection mutex.
+   */
+  size_t getNumConnections() const {
+    return numConnections_;
+  }
+
+  /// Account a connection to this thread (server's connection mutex held).
+  void incrementNumConnections() {
+    ++numConnections_;
+  }
+
+  /// Remove a connection from this thread (server's connection mutex held).
+  void decrementNumConnections() {
+    if (numConnections_ > 0) {
+      --numConnections_;
+    }
+  }
+
+  /**
+   * Create the notification pipe and register this thread's events.
    *
-   * @param base pointer to the event base to be initialized.
+   * @param base event base to use, or NULL to create a private one.
    */
   void registerEvents(event_base* base);
 
+  /// Loop over the libevent handler until the event base is broken out of.
+  void run();
+
   /**
-   * Main workhorse function, starts up the server listening on a port and
-   * loops over the libevent handler.
+   * Make run() return.  Safe to call from any thread: the request goes
+   * through the notification pipe like any other.
    */
-  void serve();
+  void breakLoop();
+
+ private:
+  /// Create the pipe used to notify this thread of task completion.
+  void createNotificationPipe();
+
+  /// Server that owns this thread
+  TNonblockingServer* server_;
+
+  /// Index of this thread within the server
+  size_t number_;
+
+  /// Listen socket watched by this thread, or -1
+  int listenSocket_;
+
+  /// The event base for libevent
+  event_base* eventBase_;
+
+  /// Did we create eventBase_ (and so must free it)?
+  bool ownEventBase_;
+
+  /// Event struct, used with eventBase_ for connection events
+  struct event serverEvent_;
+
+  /// Event struct, used with eventBase_ for task completion notification
+  struct event notificationEvent_;
+
+  /// File descriptors for pipe used for task completion notification.
+  int notificationPipeFDs_[2];
+
+  /// Number of connections assigned to this thread
+  size_t numConnections_;
 };
 
 /// Two states for sockets, recv and send mode
@@ -577,6 +871,11 @@ enum TAppState {
  * essentially encapsulates a socket that has some associated libevent state.
  */
 class TConnection {
+ public:
+
+  /// A request in flight, with its own buffers and protocols
+  class Request;
+
  private:
 
   /// Starting size for new connection buffer
@@ -585,6 +884,9 @@ class TConnection {
   /// Server handle
   TNonblockingServer* server_;
 
+  /// IO thread that serves this connection
+  TNonblockingIOThread* ioThread_;
+
   /// Socket handle
   int socket_;
 
@@ -618,7 +920,10 @@ class TConnection {
   /// Write buffer size
   uint32_t writeBufferSize_;
 
-  /// How far through writing are we?
+  /// Frame size header sent ahead of writeBuffer_, in network byte order
+  int32_t writeFrameSize_;
+
+  /// How far through writing the frame header and writeBuffer_ are we?
   uint32_t writeBufferPos_;
 
   /// How many times have we read since our last buffer reset?
@@ -649,6 +954,32 @@ class TConnection {
   /// Protocol encoder
   boost::shared_ptr<TProtocol> outputProtocol_;
 
+  /// Arena for the request being processed, reset once its response is out
+  TArena arena_;
+
+  /// Are several requests in flight at once (see setMaxRequestsInFlight)?
+  bool pipelined_;
+
+  /// Limit on requestsInFlight_
+  size_t maxRequestsInFlight_;
+
+  /// Requests read and not yet answered, including writeQueue_
+  size_t requestsInFlight_;
+
+  /// Closed, but waiting for requests still on workers to come back
+  bool closing_;
+
+  /// Finished requests whose responses are to be written, in order
+  std::deque<Request*> writeQueue_;
+
+  /// Request objects to reuse
+  std::vector<Request*> freeRequests_;
+
+  /// Requests the workers have finished, guarded by completedMutex_; the
+  /// IO thread is notified when it stops being empty
+  std::vector<Request*> completed_;
+  Mutex completedMutex_;
+
   /// Go into read mode
   void setRead() {
     setFlags(EV_READ | EV_PERSIST);
@@ -682,12 +1013,69 @@ class TConnection {
   /// Close this connection and free or reset its resources.
   void close();
 
+  /**
+   * Read from the socket toward readWant_.
+   *
+   * @return false if the connection was closed.
+   */
+  bool readSocket();
+
+  /**
+   * Write as much of the frame header and writeBuffer_ as the socket takes.
+   *
+   * @return false if the connection was closed.
+   */
+  bool writeSocket();
+
+  /**
+   * Wrap a pair of buffers into the server's transports and protocols.
+   */
+  void createProtocols(boost::shared_ptr<TMemoryBuffer> input,
+                       boost::shared_ptr<TMemoryBuffer> output,
+                       boost::shared_ptr<TTransport>& factoryInput,
+                       boost::shared_ptr<TTransport>& factoryOutput,
+                       boost::shared_ptr<TProtocol>& inputProtocol,
+                       boost::shared_ptr<TProtocol>& outputProtocol);
+
+  /**
+   * Socket handler with several requests in flight, which reads and writes
+   * at the same time.
+   *
+   * @param which the flags libevent passed.
+   */
+  void workPipelined(short which);
+
+  /// Hand the request in readBuffer_ to a worker and go on reading.
+  void dispatchRequest();
+
+  /// Queue the responses of requests the workers have finished.
+  void collectResponses();
+
+  /// Write queued responses until the socket would block.
+  bool writeResponses();
+
+  /// Point the write buffer at the response at the head of writeQueue_.
+  void startResponse();
+
+  /// Read while below the in-flight limit, write while responses wait.
+  void setPipelinedFlags();
+
+  /// Take a request object from freeRequests_ or make one.
+  Request* getRequest();
+
+  /// Return a request object once it is answered or dropped.
+  void releaseRequest(Request* request);
+
+  /// Delete the pooled request objects.
+  void deleteRequests();
+
  public:
 
   class Task;
 
   /// Constructor
-  TConnection(int socket, short eventFlags, TNonblockingServer *s) {
+  TConnection(int socket, short eventFlags, TNonblockingServer *s,
+              TNonblockingIOThread* ioThread) {
     readBuffer_ = (uint8_t*)std::malloc(STARTING_CONNECTION_BUFFER_SIZE);
     if (readBuffer_ == NULL) {
       throw new apache::thrift::TException("Out of memory.");
@@ -703,11 +1091,12 @@ class TConnection {
     inputTransport_ = boost::shared_ptr<TMemoryBuffer>(new TMemoryBuffer(readBuffer_, readBufferSize_));
     outputTransport_ = boost::shared_ptr<TMemoryBuffer>(new TMemoryBuffer());
 
-    init(socket, eventFlags, s);
+    init(socket, eventFlags, s, ioThread);
     server_->incrementNumConnections();
   }
 
   ~TConnection() {
+    deleteRequests();
     std::free(readBuffer_);
     server_->decrementNumConnections();
   }
@@ -720,7 +1109,8 @@ class TConnection {
   void checkIdleBufferMemLimit(size_t limit);
 
   /// Initialize
-  void init(int socket, short eventFlags, TNonblockingServer *s);
+  void init(int socket, short eventFlags, TNonblockingServer *s,
+            TNonblockingIOThread* ioThread);
 
   /**
    * This is called when the application transitions from one state into
@@ -737,25 +1127,35 @@ class TConnection {
    * @param which the flags associated with the event.
    * @param v void* callback arg where we placed TConnection's "this".
    */
-  static void eventHandler(int fd, short /* which */, void* v) {
+  static void eventHandler(int fd, short which, void* v) {
     assert(fd == ((TConnection*)v)->socket_);
-    ((TConnection*)v)->workSocket();
+    if (((TConnection*)v)->pipelined_) {
+      ((TConnection*)v)->workPipelined(which);
+    } else {
+      ((TConnection*)v)->workSocket();
+    }
   }
 
   /**
    * C-callable event handler for signaling task completion.  Provides a
    * callback that libevent can understand that will read a connection
-   * object's address from a pipe and call connection->transition() for
+   * object's address from a pipe and call connection->notified() for
    * that object.
    *
    * @param fd the descriptor the event occured on.
+   * @param v void* callback arg where we placed the TNonblockingIOThread.
    */
-  static void taskHandler(int fd, short /* which */, void* /* v */) {
+  static void taskHandler(int fd, short /* which */, void* v) {
     TConnection* connection;
     ssize_t nBytes;
     while ((nBytes = read(fd, (void*)&connection, sizeof(TConnection*)))
         == sizeof(TConnection*)) {
-      connection->transition();
+      // A NULL connection asks the IO thread to stop, see breakLoop()
+      if (connection == NULL) {
+        event_base_loopbreak(((TNonblockingIOThread*)v)->getEventBase());
+        return;
+      }
+      connection->notified();
     }
     if (nBytes > 0) {
       throw TException("TConnection::taskHandler unexpected partial read");
@@ -765,16 +1165,43 @@ class TConnection {
     }
   }
 
+  /**
+   * Called on the IO thread for every notification posted by
+   * notifyServer().
+   */
+  void notified();
+
+  /**
+   * Hand a request back from the worker that processed it, and notify the
+   * IO thread if it has not been told about completed_ already.  There is
+   * at most one notification outstanding, which collects every request
+   * finished by the time it arrives.
+   *
+   * @param request the finished request.
+   * @return true if successful, false if unable to notify (check errno).
+   */
+  bool completeRequest(Request* request);
+
+  /**
+   * Give up on a request that will not be processed (expired or drained
+   * on overload), which closes the connection.
+   *
+   * @param request the dropped request.
+   */
+  void abortRequest(Request* request);
+
   /**
    * Notification to server that processing has ended on this request.
    * Can be called either when processing is completed or when a waiting
-   * task has been preemptively terminated (on overload).
+   * task has been preemptively terminated (on overload).  The notification
+   * is delivered to the IO thread serving this connection, which will call
+   * transition() on it.
    *
    * @return true if successful, false if unable to notify (check errno).
    */
   bool notifyServer() {
     TConnection* connection = this;
-    if (write(server_->getNotificationSendFD(), (const void*)&connection,
+    if (write(ioThread_->getNotificationSendFD(), (const void*)&connection,
              sizeof(TConnection*)) != sizeof(TConnection*)) {
       return false;
     }
@@ -795,6 +1222,11 @@ class TConnection {
     return server_;
   }
 
+  /// return the IO thread this connection is bound to.
+  TNonblockingIOThread* getIOThread() {
+    return ioThread_;
+  }
+
   /// get state of connection.
   TAppState getState() {
     return appState_;
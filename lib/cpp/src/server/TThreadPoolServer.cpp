@@ -18,11 +18,23 @@
  */
 
 #include "server/TThreadPoolServer.h"
+#include "transport/TBufferTransports.h"
+#include "transport/TSocket.h"
 #include "transport/TTransportException.h"
+#include "concurrency/Monitor.h"
+#include "concurrency/PosixThreadFactory.h"
 #include "concurrency/Thread.h"
 #include "concurrency/ThreadManager.h"
+#include <boost/enable_shared_from_this.hpp>
 #include <string>
 #include <iostream>
+#include <map>
+#include <vector>
+#include <errno.h>
+#include <unistd.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
 
 namespace apache { namespace thrift { namespace server {
 
@@ -104,6 +116,320 @@ public:
 
 };
 
+#ifdef HAVE_SYS_EPOLL_H
+
+/**
+ * Parks per-request connections in an epoll set and hands each one that
+ * becomes readable to the ThreadManager for a single request.  Connections
+ * are registered with EPOLLONESHOT, so at any time a connection is either
+ * waiting here or being served by exactly one worker, which rearms it when
+ * the request is done.  shutdown() closes the waiting connections and waits
+ * for the workers to close the rest.
+ */
+class TThreadPoolServer::Poller
+  : public Runnable, public boost::enable_shared_from_this<Poller> {
+
+ public:
+
+  struct Connection {
+    int fd;
+    shared_ptr<TProtocol> input;
+    shared_ptr<TProtocol> output;
+    // The input transport as a TBufferBase, or NULL if it isn't one
+    TBufferBase* inputBuffer;
+    // Whether a worker has it, rather than epoll
+    bool busy;
+  };
+
+  class Request;
+
+  Poller(TThreadPoolServer& server) :
+    server_(server),
+    eventHandler_(server.getEventHandler()),
+    epollFd_(-1),
+    stopping_(false),
+    closing_(0) {
+    wakeFds_[0] = wakeFds_[1] = -1;
+    epollFd_ = epoll_create(1024);
+    if (epollFd_ < 0) {
+      int errno_copy = errno;
+      GlobalOutput.perror("TThreadPoolServer::Poller epoll_create() ", errno_copy);
+      throw TException("TThreadPoolServer: epoll_create() failed");
+    }
+    if (pipe(wakeFds_) != 0) {
+      int errno_copy = errno;
+      ::close(epollFd_);
+      GlobalOutput.perror("TThreadPoolServer::Poller pipe() ", errno_copy);
+      throw TException("TThreadPoolServer: pipe() failed");
+    }
+    struct epoll_event ev;
+    ev.events = EPOLLIN;
+    ev.data.fd = wakeFds_[0];
+    epoll_ctl(epollFd_, EPOLL_CTL_ADD, wakeFds_[0], &ev);
+  }
+
+  ~Poller() {
+    while (!connections_.empty()) {
+      close(connections_.begin()->second);
+    }
+    ::close(wakeFds_[0]);
+    ::close(wakeFds_[1]);
+    ::close(epollFd_);
+  }
+
+  void add(int fd, shared_ptr<TProtocol> input, shared_ptr<TProtocol> output) {
+    shared_ptr<Connection> conn(new Connection);
+    conn->fd = fd;
+    conn->input = input;
+    conn->output = output;
+    conn->inputBuffer = dynamic_cast<TBufferBase*>(input->getTransport().get());
+    conn->busy = false;
+
+    {
+      Synchronized s(monitor_);
+      connections_[fd] = conn;
+    }
+    if (eventHandler_ != NULL) {
+      eventHandler_->clientBegin(input, output);
+    }
+    arm(conn, EPOLL_CTL_ADD);
+  }
+
+  /**
+   * Waits for the connection's next request, or closes it if the poller is
+   * shutting down.
+   */
+  void rearm(shared_ptr<Connection> conn) {
+    bool stopping;
+    {
+      Synchronized s(monitor_);
+      stopping = stopping_;
+      if (!stopping) {
+        conn->busy = false;
+      }
+    }
+    if (stopping) {
+      close(conn);
+    } else {
+      arm(conn, EPOLL_CTL_MOD);
+    }
+  }
+
+  void close(shared_ptr<Connection> conn) {
+    {
+      Synchronized s(monitor_);
+      connections_.erase(conn->fd);
+      ++closing_;
+    }
+    epoll_ctl(epollFd_, EPOLL_CTL_DEL, conn->fd, NULL);
+
+    if (eventHandler_ != NULL) {
+      eventHandler_->clientEnd(conn->input, conn->output);
+    }
+    try {
+      conn->input->getTransport()->close();
+    } catch (TTransportException& ttx) {
+      string errStr = string("TThreadPoolServer input close failed: ") + ttx.what();
+      GlobalOutput(errStr.c_str());
+    }
+    try {
+      conn->output->getTransport()->close();
+    } catch (TTransportException& ttx) {
+      string errStr = string("TThreadPoolServer output close failed: ") + ttx.what();
+      GlobalOutput(errStr.c_str());
+    }
+
+    Synchronized s(monitor_);
+    --closing_;
+    monitor_.notifyAll();
+  }
+
+  /**
+   * Makes run() return.  Connections stay registered until shutdown().
+   */
+  void stop() {
+    uint8_t b = 0;
+    if (write(wakeFds_[1], &b, 1) != 1) {
+      GlobalOutput.perror("TThreadPoolServer::Poller wakeup write() ", errno);
+    }
+  }
+
+  /**
+   * Closes every connection waiting in the poller, and waits until the
+   * workers have closed the ones they are serving.  Call once run() has
+   * returned.
+   */
+  void shutdown() {
+    std::vector<shared_ptr<Connection> > idle;
+    {
+      Synchronized s(monitor_);
+      stopping_ = true;
+      std::map<int, shared_ptr<Connection> >::iterator it;
+      for (it = connections_.begin(); it != connections_.end(); ++it) {
+        if (!it->second->busy) {
+          it->second->busy = true;
+          idle.push_back(it->second);
+        }
+      }
+    }
+    for (size_t i = 0; i < idle.size(); ++i) {
+      close(idle[i]);
+    }
+
+    Synchronized s(monitor_);
+    while (!connections_.empty() || closing_ > 0) {
+      monitor_.wait();
+    }
+  }
+
+  void run();
+
+ private:
+
+  void arm(shared_ptr<Connection> conn, int op) {
+    struct epoll_event ev;
+    ev.events = EPOLLIN | EPOLLONESHOT;
+    ev.data.fd = conn->fd;
+    if (epoll_ctl(epollFd_, op, conn->fd, &ev) != 0) {
+      GlobalOutput.perror("TThreadPoolServer::Poller epoll_ctl() ", errno);
+      close(conn);
+    }
+  }
+
+  TThreadPoolServer& server_;
+  shared_ptr<TServerEventHandler> eventHandler_;
+  int epollFd_;
+  int wakeFds_[2];
+  Monitor monitor_;
+  std::map<int, shared_ptr<Connection> > connections_;
+  bool stopping_;
+  // Connections that close() has taken out of connections_ but not finished
+  int closing_;
+};
+
+/**
+ * Serves one request on a connection that the poller found readable.
+ */
+class TThreadPoolServer::Poller::Request : public Runnable {
+
+ public:
+
+  Request(shared_ptr<Poller> poller,
+          shared_ptr<TProcessor> processor,
+          shared_ptr<Connection> conn) :
+    poller_(poller),
+    processor_(processor),
+    conn_(conn) {
+  }
+
+  void run() {
+    bool keepOpen = false;
+    try {
+      // The poller also reports EOF and errors as readable, which peek()
+      // turns into false or an exception.
+      if (conn_->input->getTransport()->peek()) {
+        // Requests that were read ahead into the transport's buffer won't
+        // show up in epoll, so serve them before going back to the poller.
+        do {
+          keepOpen = processor_->process(conn_->input, conn_->output);
+        } while (keepOpen && conn_->inputBuffer != NULL &&
+                 conn_->inputBuffer->hasBufferedRead());
+      }
+    } catch (TTransportException& ttx) {
+      // Client went away in the middle of a request
+      keepOpen = false;
+    } catch (TException& x) {
+      string errStr = string("TThreadPoolServer exception: ") + x.what();
+      GlobalOutput(errStr.c_str());
+      keepOpen = false;
+    } catch (std::exception &x) {
+      string errStr = string("TThreadPoolServer, std::exception: ") + x.what();
+      GlobalOutput(errStr.c_str());
+      keepOpen = false;
+    } catch (...) {
+      GlobalOutput("TThreadPoolServer, unexpected exception in "
+                   "TThreadPoolServer::Poller::Request::run()");
+      keepOpen = false;
+    }
+
+    if (keepOpen) {
+      poller_->rearm(conn_);
+    } else {
+      poller_->close(conn_);
+    }
+  }
+
+ private:
+  shared_ptr<Poller> poller_;
+  shared_ptr<TProcessor> processor_;
+  shared_ptr<Connection> conn_;
+};
+
+void TThreadPoolServer::Poller::run() {
+  const int kMaxEvents = 64;
+  struct epoll_event events[kMaxEvents];
+
+  while (true) {
+    int n = epoll_wait(epollFd_, events, kMaxEvents, -1);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      GlobalOutput.perror("TThreadPoolServer::Poller epoll_wait() ", errno);
+      return;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      int fd = events[i].data.fd;
+      if (fd == wakeFds_[0]) {
+        return;
+      }
+
+      shared_ptr<Connection> conn;
+      {
+        Synchronized s(monitor_);
+        std::map<int, shared_ptr<Connection> >::iterator it = connections_.find(fd);
+        if (it != connections_.end()) {
+          conn = it->second;
+          conn->busy = true;
+        }
+      }
+      if (conn == NULL) {
+        continue;
+      }
+
+      try {
+        server_.threadManager_->add(
+          shared_ptr<Runnable>(new Request(shared_from_this(),
+                                           server_.getProcessor(), conn)),
+          server_.timeout_);
+      } catch (TException& tx) {
+        string errStr = string("TThreadPoolServer: dropping connection: ") + tx.what();
+        GlobalOutput(errStr.c_str());
+        close(conn);
+      }
+    }
+  }
+}
+
+#endif // #ifdef HAVE_SYS_EPOLL_H
+
+class TThreadPoolServer::Acceptor : public Runnable {
+
+ public:
+
+  Acceptor(TThreadPoolServer& server) :
+    server_(server) {
+  }
+
+  void run() {
+    server_.acceptConnections();
+  }
+
+ private:
+  TThreadPoolServer& server_;
+};
+
 TThreadPoolServer::TThreadPoolServer(shared_ptr<TProcessor> processor,
                                      shared_ptr<TServerTransport> serverTransport,
                                      shared_ptr<TTransportFactory> transportFactory,
@@ -111,7 +437,7 @@ TThreadPoolServer::TThreadPoolServer(shared_ptr<TProcessor> processor,
                                      shared_ptr<ThreadManager> threadManager) :
   TServer(processor, serverTransport, transportFactory, protocolFactory),
   threadManager_(threadManager),
-  stop_(false), timeout_(0) {}
+  stop_(false), timeout_(0), perRequest_(false), acceptThreads_(1) {}
 
 TThreadPoolServer::TThreadPoolServer(shared_ptr<TProcessor> processor,
                                      shared_ptr<TServerTransport> serverTransport,
@@ -123,18 +449,12 @@ TThreadPoolServer::TThreadPoolServer(shared_ptr<TProcessor> processor,
   TServer(processor, serverTransport, inputTransportFactory, outputTransportFactory,
           inputProtocolFactory, outputProtocolFactory),
   threadManager_(threadManager),
-  stop_(false), timeout_(0) {}
+  stop_(false), timeout_(0), perRequest_(false), acceptThreads_(1) {}
 
 
 TThreadPoolServer::~TThreadPoolServer() {}
 
 void TThreadPoolServer::serve() {
-  shared_ptr<TTransport> client;
-  shared_ptr<TTransport> inputTransport;
-  shared_ptr<TTransport> outputTransport;
-  shared_ptr<TProtocol> inputProtocol;
-  shared_ptr<TProtocol> outputProtocol;
-
   try {
     // Start the server listening
     serverTransport_->listen();
@@ -144,11 +464,91 @@ void TThreadPoolServer::serve() {
     return;
   }
 
+#ifdef HAVE_SYS_EPOLL_H
+  shared_ptr<Thread> pollerThread;
+  if (perRequest_) {
+    try {
+      poller_.reset(new Poller(*this));
+      pollerThread = PosixThreadFactory(PosixThreadFactory::ROUND_ROBIN,
+                                        PosixThreadFactory::NORMAL,
+                                        1, false).newThread(poller_);
+      pollerThread->start();
+    } catch (TException& tx) {
+      string errStr = string("TThreadPoolServer::run() poller: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+      poller_.reset();
+      serverTransport_->close();
+      return;
+    }
+  }
+#else
+  if (perRequest_) {
+    GlobalOutput("TThreadPoolServer: per-request mode needs epoll, "
+                 "serving a task per connection");
+  }
+#endif
+
   // Run the preServe event
   if (eventHandler_ != NULL) {
     eventHandler_->preServe();
   }
 
+  // This thread accepts too
+  std::vector<shared_ptr<Thread> > acceptors;
+  PosixThreadFactory acceptorFactory(PosixThreadFactory::ROUND_ROBIN,
+                                     PosixThreadFactory::NORMAL, 1, false);
+  for (int i = 1; i < acceptThreads_; ++i) {
+    try {
+      shared_ptr<Thread> thread =
+        acceptorFactory.newThread(shared_ptr<Runnable>(new Acceptor(*this)));
+      thread->start();
+      acceptors.push_back(thread);
+    } catch (TException& tx) {
+      string errStr = string("TThreadPoolServer: Could not start accept thread: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+      break;
+    }
+  }
+
+  acceptConnections();
+
+  for (size_t i = 0; i < acceptors.size(); ++i) {
+    acceptors[i]->join();
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  // Close the connections parked in the poller, and let the workers finish
+  // and close the rest, so no clientEnd() comes after serve() returns
+  if (poller_ != NULL) {
+    poller_->stop();
+    pollerThread->join();
+    pollerThread.reset();
+    poller_->shutdown();
+    poller_.reset();
+  }
+#endif
+
+  // If stopped manually, join the existing threads
+  if (stop_) {
+    try {
+      serverTransport_->close();
+      threadManager_->join();
+    } catch (TException &tx) {
+      string errStr = string("TThreadPoolServer: Exception shutting down: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+    }
+    stop_ = false;
+  }
+
+}
+
+void TThreadPoolServer::acceptConnections() {
+  shared_ptr<TTransport> client;
+  shared_ptr<TTransport> inputTransport;
+  shared_ptr<TTransport> outputTransport;
+  shared_ptr<TProtocol> inputProtocol;
+  shared_ptr<TProtocol> outputProtocol;
+
   while (!stop_) {
     try {
       client.reset();
@@ -166,6 +566,15 @@ void TThreadPoolServer::serve() {
       inputProtocol = inputProtocolFactory_->getProtocol(inputTransport);
       outputProtocol = outputProtocolFactory_->getProtocol(outputTransport);
 
+#ifdef HAVE_SYS_EPOLL_H
+      // Park socket clients in the poller between requests
+      TSocket* socket = dynamic_cast<TSocket*>(client.get());
+      if (poller_ != NULL && socket != NULL) {
+        poller_->add(socket->getSocketFD(), inputProtocol, outputProtocol);
+        continue;
+      }
+#endif
+
       // Add to threadmanager pool
       threadManager_->add(shared_ptr<TThreadPoolServer::Task>(new TThreadPoolServer::Task(*this, processor_, inputProtocol, outputProtocol)), timeout_);
 
@@ -195,18 +604,10 @@ void TThreadPoolServer::serve() {
     }
   }
 
-  // If stopped manually, join the existing threads
-  if (stop_) {
-    try {
-      serverTransport_->close();
-      threadManager_->join();
-    } catch (TException &tx) {
-      string errStr = string("TThreadPoolServer: Exception shutting down: ") + tx.what();
-      GlobalOutput(errStr.c_str());
-    }
-    stop_ = false;
+  // Pass the interrupt on to the next accept thread
+  if (stop_ && acceptThreads_ > 1) {
+    serverTransport_->interrupt();
   }
-
 }
 
 int64_t TThreadPoolServer::getTimeout() const {
@@ -217,4 +618,20 @@ void TThreadPoolServer::setTimeout(int64_t value) {
   timeout_ = value;
 }
 
+bool TThreadPoolServer::getPerRequest() const {
+  return perRequest_;
+}
+
+void TThreadPoolServer::setPerRequest(bool value) {
+  perRequest_ = value;
+}
+
+int TThreadPoolServer::getAcceptThreads() const {
+  return acceptThreads_;
+}
+
+void TThreadPoolServer::setAcceptThreads(int value) {
+  acceptThreads_ = (value > 0 ? value : 1);
+}
+
 }}} // apache::thrift::server
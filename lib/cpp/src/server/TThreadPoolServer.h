@@ -33,9 +33,23 @@ using apache::thrift::protocol::TProtocolFactory;
 using apache::thrift::transport::TServerTransport;
 using apache::thrift::transport::TTransportFactory;
 
+/**
+ * Server that hands accepted connections to a ThreadManager.
+ *
+ * By default each connection is a single task that processes requests until
+ * the client goes away, so a pool of N workers serves N clients at a time.
+ * With setPerRequest(true), connections instead wait in an epoll set between
+ * requests and only take a worker while a request is being processed.
+ *
+ * Connections are accepted on one thread unless setAcceptThreads() asks for
+ * more, which pays off with a server transport built for it, such as
+ * TShardedServerSocket with a shard per accept thread.
+ */
 class TThreadPoolServer : public TServer {
  public:
   class Task;
+  class Poller;
+  class Acceptor;
 
   TThreadPoolServer(boost::shared_ptr<TProcessor> processor,
                     boost::shared_ptr<TServerTransport> serverTransport,
@@ -59,6 +73,25 @@ class TThreadPoolServer : public TServer {
 
   virtual void setTimeout(int64_t value);
 
+  /**
+   * Whether to schedule requests rather than connections on the pool.  Only
+   * TSocket clients on platforms with epoll are served this way; anything
+   * else falls back to a task per connection.  Takes effect on the next
+   * call to serve().
+   */
+  virtual bool getPerRequest() const;
+
+  virtual void setPerRequest(bool value);
+
+  /**
+   * How many threads accept connections, 1 by default.  Takes effect on the
+   * next call to serve(), which accepts on the calling thread and starts
+   * the others.
+   */
+  virtual int getAcceptThreads() const;
+
+  virtual void setAcceptThreads(int value);
+
   virtual void stop() {
     stop_ = true;
     serverTransport_->interrupt();
@@ -72,6 +105,18 @@ class TThreadPoolServer : public TServer {
 
   volatile int64_t timeout_;
 
+  bool perRequest_;
+
+  int acceptThreads_;
+
+  boost::shared_ptr<Poller> poller_;
+
+  /**
+   * Accepts connections and hands them out until the server is stopped.
+   * Runs on every accept thread.
+   */
+  void acceptConnections();
+
 };
 
 }}} // apache::thrift::server
@@ -22,6 +22,7 @@
 #include "concurrency/PosixThreadFactory.h"
 
 #include <string>
+#include <vector>
 #include <iostream>
 #include <pthread.h>
 #include <unistd.h>
@@ -109,13 +110,29 @@ public:
   shared_ptr<TProtocol> output_;
 };
 
+class TThreadedServer::Acceptor: public Runnable {
+
+public:
+
+  Acceptor(TThreadedServer& server) :
+    server_(server) {
+  }
+
+  void run() {
+    server_.acceptConnections();
+  }
+
+ private:
+  TThreadedServer& server_;
+};
 
 TThreadedServer::TThreadedServer(shared_ptr<TProcessor> processor,
                                  shared_ptr<TServerTransport> serverTransport,
                                  shared_ptr<TTransportFactory> transportFactory,
                                  shared_ptr<TProtocolFactory> protocolFactory):
   TServer(processor, serverTransport, transportFactory, protocolFactory),
-  stop_(false) {
+  stop_(false),
+  acceptThreads_(1) {
   threadFactory_ = shared_ptr<PosixThreadFactory>(new PosixThreadFactory());
 }
 
@@ -126,19 +143,14 @@ TThreadedServer::TThreadedServer(boost::shared_ptr<TProcessor> processor,
                                  boost::shared_ptr<ThreadFactory> threadFactory):
   TServer(processor, serverTransport, transportFactory, protocolFactory),
   threadFactory_(threadFactory),
-  stop_(false) {
+  stop_(false),
+  acceptThreads_(1) {
 }
 
 TThreadedServer::~TThreadedServer() {}
 
 void TThreadedServer::serve() {
 
-  shared_ptr<TTransport> client;
-  shared_ptr<TTransport> inputTransport;
-  shared_ptr<TTransport> outputTransport;
-  shared_ptr<TProtocol> inputProtocol;
-  shared_ptr<TProtocol> outputProtocol;
-
   try {
     // Start the server listening
     serverTransport_->listen();
@@ -153,6 +165,58 @@ void TThreadedServer::serve() {
     eventHandler_->preServe();
   }
 
+  // This thread accepts too
+  std::vector<shared_ptr<Thread> > acceptors;
+  PosixThreadFactory acceptorFactory(PosixThreadFactory::ROUND_ROBIN,
+                                     PosixThreadFactory::NORMAL, 1, false);
+  for (int i = 1; i < acceptThreads_; ++i) {
+    try {
+      shared_ptr<Thread> thread =
+        acceptorFactory.newThread(shared_ptr<Runnable>(new Acceptor(*this)));
+      thread->start();
+      acceptors.push_back(thread);
+    } catch (TException& tx) {
+      string errStr = string("TThreadedServer: Could not start accept thread: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+      break;
+    }
+  }
+
+  acceptConnections();
+
+  for (size_t i = 0; i < acceptors.size(); ++i) {
+    acceptors[i]->join();
+  }
+
+  // If stopped manually, make sure to close server transport
+  if (stop_) {
+    try {
+      serverTransport_->close();
+    } catch (TException &tx) {
+      string errStr = string("TThreadedServer: Exception shutting down: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+    }
+    try {
+      Synchronized s(tasksMonitor_);
+      while (!tasks_.empty()) {
+        tasksMonitor_.wait();
+      }
+    } catch (TException &tx) {
+      string errStr = string("TThreadedServer: Exception joining workers: ") + tx.what();
+      GlobalOutput(errStr.c_str());
+    }
+    stop_ = false;
+  }
+
+}
+
+void TThreadedServer::acceptConnections() {
+  shared_ptr<TTransport> client;
+  shared_ptr<TTransport> inputTransport;
+  shared_ptr<TTransport> outputTransport;
+  shared_ptr<TProtocol> inputProtocol;
+  shared_ptr<TProtocol> outputProtocol;
+
   while (!stop_) {
     try {
       client.reset();
@@ -218,26 +282,10 @@ void TThreadedServer::serve() {
     }
   }
 
-  // If stopped manually, make sure to close server transport
-  if (stop_) {
-    try {
-      serverTransport_->close();
-    } catch (TException &tx) {
-      string errStr = string("TThreadedServer: Exception shutting down: ") + tx.what();
-      GlobalOutput(errStr.c_str());
-    }
-    try {
-      Synchronized s(tasksMonitor_);
-      while (!tasks_.empty()) {
-        tasksMonitor_.wait();
-      }
-    } catch (TException &tx) {
-      string errStr = string("TThreadedServer: Exception joining workers: ") + tx.what();
-      GlobalOutput(errStr.c_str());
-    }
-    stop_ = false;
+  // Pass the interrupt on to the next accept thread
+  if (stop_ && acceptThreads_ > 1) {
+    serverTransport_->interrupt();
   }
-
 }
 
 }}} // apache::thrift::server
@@ -39,6 +39,7 @@ class TThreadedServer : public TServer {
 
  public:
   class Task;
+  class Acceptor;
 
   TThreadedServer(boost::shared_ptr<TProcessor> processor,
                   boost::shared_ptr<TServerTransport> serverTransport,
@@ -60,9 +61,30 @@ class TThreadedServer : public TServer {
     serverTransport_->interrupt();
   }
 
+  /**
+   * How many threads accept connections, 1 by default.  Takes effect on the
+   * next call to serve(), which accepts on the calling thread and starts
+   * the others.  More than one pays off with a server transport built for
+   * it, such as TShardedServerSocket with a shard per accept thread.
+   */
+  int getAcceptThreads() const {
+    return acceptThreads_;
+  }
+
+  void setAcceptThreads(int value) {
+    acceptThreads_ = (value > 0 ? value : 1);
+  }
+
  protected:
+  /**
+   * Accepts connections and starts their threads until the server is
+   * stopped.  Runs on every accept thread.
+   */
+  void acceptConnections();
+
   boost::shared_ptr<ThreadFactory> threadFactory_;
   volatile bool stop_;
+  int acceptThreads_;
 
   Monitor tasksMonitor_;
   std::set<Task*> tasks_;
@@ -83,11 +83,17 @@ void TBufferedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   // This case also covers the case where the buffer is empty,
   // but it is clearer (I think) to think of it as two separate cases.
   if ((have_bytes + len >= 2*wBufSize_) || (have_bytes == 0)) {
-    // TODO(dreiss): writev
     if (have_bytes > 0) {
-      transport_->write(wBuf_.get(), have_bytes);
+      // Hand both buffers to the underlying transport in one go.
+      struct iovec iov[2];
+      iov[0].iov_base = wBuf_.get();
+      iov[0].iov_len = have_bytes;
+      iov[1].iov_base = const_cast<uint8_t*>(buf);
+      iov[1].iov_len = len;
+      transport_->writev(iov, 2);
+    } else {
+      transport_->write(buf, len);
     }
-    transport_->write(buf, len);
     wBase_ = wBuf_.get();
     return;
   }
@@ -238,12 +244,22 @@ void TFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
   wBase_ += len;
 }
 
+void TFramedTransport::gatherWrite(const uint8_t* buf, uint32_t len) {
+  GatherPiece piece;
+  piece.bufferOffset = wBase_ - wBuf_.get();
+  piece.data = buf;
+  piece.len = len;
+  gatherPieces_.push_back(piece);
+  gatherBytes_ += len;
+}
+
 void TFramedTransport::flush()  {
   int32_t sz_hbo, sz_nbo;
   assert(wBufSize_ > sizeof(sz_nbo));
 
   // Slip the frame size into the start of the buffer.
-  sz_hbo = wBase_ - (wBuf_.get() + sizeof(sz_nbo));
+  uint32_t have = wBase_ - wBuf_.get();
+  sz_hbo = have - sizeof(sz_nbo) + gatherBytes_;
   sz_nbo = (int32_t)htonl((uint32_t)(sz_hbo));
   memcpy(wBuf_.get(), (uint8_t*)&sz_nbo, sizeof(sz_nbo));
 
@@ -254,8 +270,37 @@ void TFramedTransport::flush()  {
     // up an exception
     wBase_ = wBuf_.get() + sizeof(sz_nbo);
 
-    // Write size and frame body.
-    transport_->write(wBuf_.get(), sizeof(sz_nbo)+sz_hbo);
+    if (gatherPieces_.empty()) {
+      // Write size and frame body.
+      transport_->write(wBuf_.get(), sizeof(sz_nbo)+sz_hbo);
+    } else {
+      // Interleave the buffered bytes with the gathered caller buffers
+      // and write the whole frame with a single writev.
+      gatherIov_.clear();
+      uint32_t prev = 0;
+      struct iovec iov;
+      for (size_t i = 0; i < gatherPieces_.size(); ++i) {
+        const GatherPiece& piece = gatherPieces_[i];
+        if (piece.bufferOffset > prev) {
+          iov.iov_base = wBuf_.get() + prev;
+          iov.iov_len = piece.bufferOffset - prev;
+          gatherIov_.push_back(iov);
+          prev = piece.bufferOffset;
+        }
+        iov.iov_base = const_cast<uint8_t*>(piece.data);
+        iov.iov_len = piece.len;
+        gatherIov_.push_back(iov);
+      }
+      if (have > prev) {
+        iov.iov_base = wBuf_.get() + prev;
+        iov.iov_len = have - prev;
+        gatherIov_.push_back(iov);
+      }
+      gatherPieces_.clear();
+      gatherBytes_ = 0;
+
+      transport_->writev(&gatherIov_[0], gatherIov_.size());
+    }
   }
 
   // Flush the underlying transport.
@@ -21,9 +21,11 @@
 #define _THRIFT_TRANSPORT_TBUFFERTRANSPORTS_H_ 1
 
 #include <cstring>
+#include <vector>
 #include "boost/scoped_array.hpp"
 
 #include <transport/TTransport.h>
+#include <transport/TVirtualTransport.h>
 
 #ifdef __GNUC__
 #define TDB_LIKELY(val) (__builtin_expect((val), 1))
@@ -40,13 +42,13 @@ namespace apache { namespace thrift { namespace transport {
  * Base class for all transports that use read/write buffers for performance.
  *
  * TBufferBase is designed to implement the fast-path "memcpy" style
- * operations that work in the common case.  It does so with small and
- * (eventually) nonvirtual, inlinable methods.  TBufferBase is an abstract
+ * operations that work in the common case.  It does so with small,
+ * nonvirtual, inlinable methods.  TBufferBase is an abstract
  * class.  Subclasses are expected to define the "slow path" operations
  * that have to be done when the buffers are full or empty.
  *
  */
-class TBufferBase : public TTransport {
+class TBufferBase : public TVirtualTransport<TBufferBase> {
 
  public:
 
@@ -56,7 +58,6 @@ class TBufferBase : public TTransport {
    * When we have enough data buffered to fulfill the read, we can satisfy it
    * with a single memcpy, then adjust our internal pointers.  If the buffer
    * is empty, we call out to our slow path, implemented by a subclass.
-   * This method is meant to eventually be nonvirtual and inlinable.
    */
   uint32_t read(uint8_t* buf, uint32_t len) {
     uint8_t* new_rBase = rBase_ + len;
@@ -68,14 +69,26 @@ class TBufferBase : public TTransport {
     return readSlow(buf, len);
   }
 
+  /**
+   * Shortcutted version of readAll.
+   */
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    uint8_t* new_rBase = rBase_ + len;
+    if (TDB_LIKELY(new_rBase <= rBound_)) {
+      std::memcpy(buf, rBase_, len);
+      rBase_ = new_rBase;
+      return len;
+    }
+    return apache::thrift::transport::readAll(*this, buf, len);
+  }
+
   /**
    * Fast-path write.
    *
    * When we have enough empty space in our buffer to accomodate the write, we
    * can satisfy it with a single memcpy, then adjust our internal pointers.
    * If the buffer is full, we call out to our slow path, implemented by a
-   * subclass.  This method is meant to eventually be nonvirtual and
-   * inlinable.
+   * subclass.
    */
   void write(const uint8_t* buf, uint32_t len) {
     uint8_t* new_wBase = wBase_ + len;
@@ -100,6 +113,30 @@ class TBufferBase : public TTransport {
     return borrowSlow(buf, len);
   }
 
+  /**
+   * Borrow and consume in one, for readers that know exactly how many bytes
+   * they want (like protocols reading fixed-width values).  Returns NULL,
+   * without going to the slow path, when fewer than len bytes are buffered;
+   * the caller should fall back to readAll() then.
+   */
+  const uint8_t* borrowAndConsume(uint32_t len) {
+    uint8_t* new_rBase = rBase_ + len;
+    if (TDB_LIKELY(new_rBase <= rBound_)) {
+      const uint8_t* borrowed = rBase_;
+      rBase_ = new_rBase;
+      return borrowed;
+    }
+    return NULL;
+  }
+
+  /**
+   * Whether there is unread data in the read buffer, so that the next read
+   * will not touch the underlying transport.
+   */
+  bool hasBufferedRead() const {
+    return rBase_ < rBound_;
+  }
+
   /**
    * Consume doesn't require a slow path.
    */
@@ -232,26 +269,27 @@ class TUnderlyingTransport : public TBufferBase {
  * stored to an in memory buffer before being written out.
  *
  */
-class TBufferedTransport : public TUnderlyingTransport {
+class TBufferedTransport
+  : public TVirtualTransport<TBufferedTransport, TUnderlyingTransport> {
  public:
 
   /// Use default buffer sizes.
   TBufferedTransport(boost::shared_ptr<TTransport> transport)
-    : TUnderlyingTransport(transport)
+    : TVirtualTransport<TBufferedTransport, TUnderlyingTransport>(transport)
   {
     initPointers();
   }
 
   /// Use specified buffer sizes.
   TBufferedTransport(boost::shared_ptr<TTransport> transport, uint32_t sz)
-    : TUnderlyingTransport(transport, sz)
+    : TVirtualTransport<TBufferedTransport, TUnderlyingTransport>(transport, sz)
   {
     initPointers();
   }
 
   /// Use specified read and write buffer sizes.
   TBufferedTransport(boost::shared_ptr<TTransport> transport, uint32_t rsz, uint32_t wsz)
-    : TUnderlyingTransport(transport, rsz, wsz)
+    : TVirtualTransport<TBufferedTransport, TUnderlyingTransport>(transport, rsz, wsz)
   {
     initPointers();
   }
@@ -283,6 +321,14 @@ class TBufferedTransport : public TUnderlyingTransport {
    */
   virtual const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len);
 
+  /*
+   * TVirtualTransport provides a default implementation of readAll().
+   * We want to use the TBufferBase version instead.
+   */
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    return TBufferBase::readAll(buf, len);
+  }
+
  protected:
   void initPointers() {
     setReadBuffer(rBuf_.get(), 0);
@@ -319,22 +365,62 @@ class TBufferedTransportFactory : public TTransportFactory {
  * other end to always do fixed-length reads.
  *
  */
-class TFramedTransport : public TUnderlyingTransport {
+class TFramedTransport
+  : public TVirtualTransport<TFramedTransport, TUnderlyingTransport> {
  public:
 
   /// Use default buffer sizes.
   TFramedTransport(boost::shared_ptr<TTransport> transport)
-    : TUnderlyingTransport(transport)
+    : TVirtualTransport<TFramedTransport, TUnderlyingTransport>(transport)
+    , gatherThreshold_(0)
+    , gatherBytes_(0)
   {
     initPointers();
   }
 
   TFramedTransport(boost::shared_ptr<TTransport> transport, uint32_t sz)
-    : TUnderlyingTransport(transport, sz)
+    : TVirtualTransport<TFramedTransport, TUnderlyingTransport>(transport, sz)
+    , gatherThreshold_(0)
+    , gatherBytes_(0)
   {
     initPointers();
   }
 
+  /// Smallest allowed gather threshold; keeps short strings copied.
+  static const uint32_t MIN_GATHER_WRITE_THRESHOLD = 64;
+
+  /**
+   * writeBorrowed() calls of at least this many bytes are not copied into
+   * the frame buffer.  Instead the caller's buffer is remembered and handed
+   * to the underlying transport's writev() together with the frame header
+   * and the rest of the frame at flush() time.  TBinaryProtocol and
+   * TCompactProtocol borrow string and binary values this way, which holds
+   * for generated clients and processors since they flush right after
+   * writing a message.  Plain write() always copies, whatever the threshold.
+   *
+   * @param threshold minimum write size to gather, or 0 (the default) to
+   *                  always copy.  Nonzero values are raised to at least
+   *                  MIN_GATHER_WRITE_THRESHOLD.
+   */
+  void setGatherWriteThreshold(uint32_t threshold) {
+    if (threshold != 0 && threshold < MIN_GATHER_WRITE_THRESHOLD) {
+      threshold = MIN_GATHER_WRITE_THRESHOLD;
+    }
+    gatherThreshold_ = threshold;
+  }
+
+  uint32_t getGatherWriteThreshold() const {
+    return gatherThreshold_;
+  }
+
+  void writeBorrowed(const uint8_t* buf, uint32_t len) {
+    if (TDB_UNLIKELY(gatherThreshold_ != 0 && len >= gatherThreshold_)) {
+      gatherWrite(buf, len);
+      return;
+    }
+    TBufferBase::write(buf, len);
+  }
+
   virtual uint32_t readSlow(uint8_t* buf, uint32_t len);
 
   virtual void writeSlow(const uint8_t* buf, uint32_t len);
@@ -343,6 +429,14 @@ class TFramedTransport : public TUnderlyingTransport {
 
   const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len);
 
+  /*
+   * TVirtualTransport provides a default implementation of readAll().
+   * We want to use the TBufferBase version instead.
+   */
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    return TBufferBase::readAll(buf, len);
+  }
+
  protected:
   /**
    * Reads a frame of input from the underlying stream.
@@ -357,6 +451,24 @@ class TFramedTransport : public TUnderlyingTransport {
     int32_t pad = 0;
     this->write((uint8_t*)&pad, sizeof(pad));
   }
+
+  /// Remember a large caller buffer as part of the current frame.
+  void gatherWrite(const uint8_t* buf, uint32_t len);
+
+  /**
+   * A caller buffer that goes out after the first bufferOffset bytes of
+   * wBuf_ (offsets, since wBuf_ may be reallocated before the flush).
+   */
+  struct GatherPiece {
+    uint32_t bufferOffset;
+    const uint8_t* data;
+    uint32_t len;
+  };
+
+  uint32_t gatherThreshold_;
+  uint32_t gatherBytes_;
+  std::vector<GatherPiece> gatherPieces_;
+  std::vector<struct iovec> gatherIov_;
 };
 
 /**
@@ -388,7 +500,7 @@ class TFramedTransportFactory : public TTransportFactory {
  * doubles as necessary.  We've considered using scoped
  *
  */
-class TMemoryBuffer : public TBufferBase {
+class TMemoryBuffer : public TVirtualTransport<TMemoryBuffer, TBufferBase> {
  private:
 
   // Common initialization done by all constructors.
@@ -623,6 +735,14 @@ class TMemoryBuffer : public TBufferBase {
   // that had been provided by getWritePtr().
   void wroteBytes(uint32_t len);
 
+  /*
+   * TVirtualTransport provides a default implementation of readAll().
+   * We want to use the TBufferBase version instead.
+   */
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    return TBufferBase::readAll(buf, len);
+  }
+
  protected:
   void swap(TMemoryBuffer& that) {
     using std::swap;
@@ -0,0 +1,410 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <arpa/inet.h>
+#include <transport/TCompressedFramedTransport.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+using boost::shared_ptr;
+
+// LZ FORMAT
+//
+// A compressed frame is a series of sequences, each of which is a run of
+// literal bytes followed by a back reference into the output.  A sequence
+// starts with a token byte holding the literal count in its high nibble and
+// the match length minus 4 in its low one.  A nibble of 15 means more bytes
+// of length follow, each added in, until one is less than 255.  Then come
+// the literals, the match offset as two little endian bytes, and any
+// extra match length bytes.  The last sequence stops after its literals.
+
+static const uint32_t LZ_MIN_MATCH = 4;
+static const uint32_t LZ_MAX_OFFSET = 65535;
+static const uint32_t LZ_EMPTY = 0xffffffff;
+
+static inline uint32_t lzRead32(const uint8_t* p) {
+  uint32_t v;
+  memcpy(&v, p, sizeof(v));
+  return v;
+}
+
+static inline uint8_t* lzWriteLength(uint8_t* op, uint32_t len) {
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = (uint8_t)len;
+  return op;
+}
+
+static inline uint8_t* lzWriteSequence(uint8_t* op,
+                                       const uint8_t* literals, uint32_t litLen,
+                                       uint32_t offset, uint32_t matchLen) {
+  uint8_t* token = op++;
+  *token = (uint8_t)(std::min(litLen, 15U) << 4);
+  if (litLen >= 15) {
+    op = lzWriteLength(op, litLen - 15);
+  }
+  memcpy(op, literals, litLen);
+  op += litLen;
+
+  if (matchLen != 0) {
+    *op++ = (uint8_t)offset;
+    *op++ = (uint8_t)(offset >> 8);
+    matchLen -= LZ_MIN_MATCH;
+    *token |= (uint8_t)std::min(matchLen, 15U);
+    if (matchLen >= 15) {
+      op = lzWriteLength(op, matchLen - 15);
+    }
+  }
+  return op;
+}
+
+uint32_t TLZFrameCodec::compress(const uint8_t* in, uint32_t len, uint8_t* out) {
+  uint32_t* table = table_.get();
+  std::fill(table, table + TABLE_SIZE, LZ_EMPTY);
+
+  uint8_t* op = out;
+  uint32_t anchor = 0;
+  uint32_t ip = 0;
+
+  while (ip + LZ_MIN_MATCH <= len) {
+    uint32_t seq = lzRead32(in + ip);
+    uint32_t hash = (seq * 2654435761U) >> (32 - HASH_BITS);
+    uint32_t ref = table[hash];
+    table[hash] = ip;
+
+    if (ref == LZ_EMPTY || ip - ref > LZ_MAX_OFFSET || lzRead32(in + ref) != seq) {
+      // Step faster through data that doesn't compress
+      ip += 1 + ((ip - anchor) >> 6);
+      continue;
+    }
+
+    uint32_t matchLen = LZ_MIN_MATCH;
+    while (ip + matchLen < len && in[ref + matchLen] == in[ip + matchLen]) {
+      ++matchLen;
+    }
+
+    op = lzWriteSequence(op, in + anchor, ip - anchor, ip - ref, matchLen);
+    ip += matchLen;
+    anchor = ip;
+  }
+
+  op = lzWriteSequence(op, in + anchor, len - anchor, 0, 0);
+  return op - out;
+}
+
+static inline bool lzReadLength(const uint8_t*& ip, const uint8_t* end, uint32_t& len) {
+  uint8_t b;
+  do {
+    if (ip == end) {
+      return false;
+    }
+    b = *ip++;
+    len += b;
+  } while (b == 255);
+  return true;
+}
+
+void TLZFrameCodec::decompress(const uint8_t* in, uint32_t len,
+                               uint8_t* out, uint32_t outLen) {
+  const uint8_t* ip = in;
+  const uint8_t* end = in + len;
+  uint32_t op = 0;
+
+  while (ip < end) {
+    uint8_t token = *ip++;
+
+    uint32_t litLen = token >> 4;
+    if (litLen == 15 && !lzReadLength(ip, end, litLen)) {
+      break;
+    }
+    if (litLen > (uint32_t)(end - ip) || litLen > outLen - op) {
+      break;
+    }
+    memcpy(out + op, ip, litLen);
+    ip += litLen;
+    op += litLen;
+
+    if (ip == end) {
+      if (op == outLen) {
+        return;
+      }
+      break;
+    }
+
+    if (end - ip < 2) {
+      break;
+    }
+    uint32_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+    uint32_t matchLen = token & 15;
+    if (matchLen == 15 && !lzReadLength(ip, end, matchLen)) {
+      break;
+    }
+    matchLen += LZ_MIN_MATCH;
+    if (offset == 0 || offset > op || matchLen > outLen - op) {
+      break;
+    }
+
+    uint8_t* dst = out + op;
+    const uint8_t* src = dst - offset;
+    if (offset >= matchLen) {
+      memcpy(dst, src, matchLen);
+    } else {
+      // Overlapping copies repeat the last offset bytes
+      for (uint32_t i = 0; i < matchLen; ++i) {
+        dst[i] = src[i];
+      }
+    }
+    op += matchLen;
+  }
+
+  throw TTransportException(TTransportException::CORRUPTED_DATA,
+                            "TLZFrameCodec: corrupted frame");
+}
+
+TCompressedFramedTransport::TCompressedFramedTransport(shared_ptr<TTransport> transport,
+                                                       shared_ptr<TFrameCodec> codec,
+                                                       uint32_t minCompressSize)
+  : TVirtualTransport<TCompressedFramedTransport, TUnderlyingTransport>(transport)
+  , codec_(codec)
+  , minCompressSize_(minCompressSize)
+  , framed_(true)
+  , lastReadCodecId_(TFrameCodec::NONE)
+  , cBufSize_(0)
+{
+  if (codec_ == NULL) {
+    codec_.reset(new TLZFrameCodec());
+  }
+  if (codec_->getId() != TFrameCodec::LZ) {
+    addCodec(shared_ptr<TFrameCodec>(new TLZFrameCodec()));
+  }
+  addCodec(codec_);
+  initPointers();
+}
+
+void TCompressedFramedTransport::addCodec(shared_ptr<TFrameCodec> codec) {
+  uint8_t id = codec->getId();
+  if (id == TFrameCodec::NONE) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "TCompressedFramedTransport: codec ID 0 is reserved");
+  }
+  if (codecs_.size() <= id) {
+    codecs_.resize(id + 1);
+  }
+  codecs_[id] = codec;
+}
+
+void TCompressedFramedTransport::ensureCompressedCapacity(uint32_t size) {
+  if (size > cBufSize_) {
+    cBuf_.reset(new uint8_t[size]);
+    cBufSize_ = size;
+  }
+}
+
+uint32_t TCompressedFramedTransport::readSlow(uint8_t* buf, uint32_t len) {
+  uint32_t want = len;
+  uint32_t have = rBound_ - rBase_;
+
+  // We should only take the slow path if we can't satisfy the read
+  // with the data already in the buffer.
+  assert(have < want);
+
+  // Copy out whatever we have.
+  if (have > 0) {
+    memcpy(buf, rBase_, have);
+    want -= have;
+    buf += have;
+  }
+
+  // Read another frame.
+  readFrame();
+
+  // Hand over whatever we have.
+  uint32_t give = std::min(want, static_cast<uint32_t>(rBound_ - rBase_));
+  memcpy(buf, rBase_, give);
+  rBase_ += give;
+  want -= give;
+
+  return (len - want);
+}
+
+uint32_t TCompressedFramedTransport::readRemaining() {
+  uint32_t have = 0;
+  while (true) {
+    if (have == cBufSize_) {
+      // Double buffer size until sufficient, keeping what we have.
+      uint32_t size = std::max(cBufSize_ * 2, (uint32_t)DEFAULT_BUFFER_SIZE);
+      uint8_t* newBuf = new uint8_t[size];
+      memcpy(newBuf, cBuf_.get(), have);
+      cBuf_.reset(newBuf);
+      cBufSize_ = size;
+    }
+    uint32_t got = transport_->read(cBuf_.get() + have, cBufSize_ - have);
+    if (got == 0) {
+      return have;
+    }
+    have += got;
+  }
+}
+
+void TCompressedFramedTransport::readFrame() {
+  // Read the size of the next frame, unless the underlying transport is a
+  // single frame already.
+  int32_t sz = -1;
+  if (framed_) {
+    transport_->readAll((uint8_t*)&sz, sizeof(sz));
+    sz = ntohl(sz);
+    if (sz < (int32_t)(HEADER_SIZE - sizeof(sz))) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "TCompressedFramedTransport: frame too short");
+    }
+  }
+
+  uint8_t header[HEADER_SIZE - sizeof(sz)];
+  transport_->readAll(header, sizeof(header));
+  uint8_t id = header[0];
+  int32_t usz;
+  memcpy(&usz, header + 1, sizeof(usz));
+  usz = ntohl(usz);
+  if (usz < 0) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "TCompressedFramedTransport: negative frame size");
+  }
+
+  if (usz > static_cast<int32_t>(rBufSize_)) {
+    rBuf_.reset(new uint8_t[usz]);
+    rBufSize_ = usz;
+  }
+
+  if (id == TFrameCodec::NONE) {
+    if (framed_ && sz != (int32_t)(sizeof(header) + usz)) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "TCompressedFramedTransport: bad frame size");
+    }
+    transport_->readAll(rBuf_.get(), usz);
+  } else {
+    if (id >= codecs_.size() || codecs_[id] == NULL) {
+      throw TTransportException(TTransportException::CORRUPTED_DATA,
+                                "TCompressedFramedTransport: unknown codec");
+    }
+    uint32_t csz;
+    if (framed_) {
+      csz = sz - sizeof(header);
+      ensureCompressedCapacity(csz);
+      transport_->readAll(cBuf_.get(), csz);
+    } else {
+      csz = readRemaining();
+    }
+    codecs_[id]->decompress(cBuf_.get(), csz, rBuf_.get(), usz);
+  }
+
+  lastReadCodecId_ = id;
+  setReadBuffer(rBuf_.get(), usz);
+}
+
+void TCompressedFramedTransport::writeSlow(const uint8_t* buf, uint32_t len) {
+  // Double buffer size until sufficient.
+  uint32_t have = wBase_ - wBuf_.get();
+  while (wBufSize_ < len + have) {
+    wBufSize_ *= 2;
+  }
+
+  // Allocate new buffer.
+  uint8_t* new_buf = new uint8_t[wBufSize_];
+
+  // Copy the old buffer to the new one.
+  memcpy(new_buf, wBuf_.get(), have);
+
+  // Now point buf to the new one.
+  wBuf_.reset(new_buf);
+  wBase_ = wBuf_.get() + have;
+  wBound_ = wBuf_.get() + wBufSize_;
+
+  // Copy the data into the new buffer.
+  memcpy(wBase_, buf, len);
+  wBase_ += len;
+}
+
+void TCompressedFramedTransport::flush() {
+  uint32_t usz = wBase_ - wBuf_.get() - HEADER_SIZE;
+
+  if (usz > 0) {
+    // Reset wBase_ prior to the underlying write, so the buffer is in a sane
+    // state if the write throws.
+    wBase_ = wBuf_.get() + HEADER_SIZE;
+
+    uint8_t* frame = wBuf_.get();
+    uint8_t id = TFrameCodec::NONE;
+    uint32_t psz = usz;
+
+    if (usz >= minCompressSize_) {
+      ensureCompressedCapacity(HEADER_SIZE + codec_->maxCompressedSize(usz));
+      uint32_t csz = codec_->compress(wBuf_.get() + HEADER_SIZE, usz,
+                                      cBuf_.get() + HEADER_SIZE);
+      // Frames that don't shrink go out as they are
+      if (csz < usz) {
+        frame = cBuf_.get();
+        id = codec_->getId();
+        psz = csz;
+      }
+    }
+
+    int32_t sz_nbo = (int32_t)htonl(HEADER_SIZE - sizeof(int32_t) + psz);
+    int32_t usz_nbo = (int32_t)htonl(usz);
+    memcpy(frame, &sz_nbo, sizeof(sz_nbo));
+    frame[sizeof(sz_nbo)] = id;
+    memcpy(frame + sizeof(sz_nbo) + 1, &usz_nbo, sizeof(usz_nbo));
+
+    if (framed_) {
+      transport_->write(frame, HEADER_SIZE + psz);
+    } else {
+      transport_->write(frame + sizeof(sz_nbo), HEADER_SIZE - sizeof(sz_nbo) + psz);
+    }
+  }
+
+  // Flush the underlying transport.
+  transport_->flush();
+}
+
+const uint8_t* TCompressedFramedTransport::borrowSlow(uint8_t* buf, uint32_t* len) {
+  // Don't borrow across frames, as with TFramedTransport.
+  return NULL;
+}
+
+shared_ptr<TTransport>
+TCompressedFramedTransportFactory::getTransport(shared_ptr<TTransport> trans) {
+  shared_ptr<TFrameCodec> codec;
+  if (codec_ != NULL) {
+    codec = codec_->clone();
+  }
+  TCompressedFramedTransport* transport =
+    new TCompressedFramedTransport(trans, codec, minCompressSize_);
+  shared_ptr<TTransport> result(transport);
+  for (size_t i = 0; i < codecs_.size(); ++i) {
+    transport->addCodec(codecs_[i]->clone());
+  }
+  return result;
+}
+
+}}} // apache::thrift::transport
@@ -0,0 +1,243 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TCOMPRESSEDFRAMEDTRANSPORT_H_
+#define _THRIFT_TRANSPORT_TCOMPRESSEDFRAMEDTRANSPORT_H_ 1
+
+#include <vector>
+#include <boost/shared_ptr.hpp>
+#include <boost/scoped_array.hpp>
+
+#include <transport/TBufferTransports.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * Compresses and decompresses whole frames for TCompressedFramedTransport.
+ *
+ * Codecs keep state between frames (tables, streams) and are not thread
+ * safe, so every transport gets its own instances through clone().
+ */
+class TFrameCodec {
+ public:
+
+  /**
+   * Codec IDs as they appear in the frame header.
+   */
+  enum CodecId
+  { NONE = 0
+  , ZLIB = 1
+  , LZ = 2
+  };
+
+  virtual ~TFrameCodec() {}
+
+  virtual uint8_t getId() const = 0;
+
+  /**
+   * Largest output compress() can produce for len bytes of input.
+   */
+  virtual uint32_t maxCompressedSize(uint32_t len) = 0;
+
+  /**
+   * Compresses len bytes into out, which has room for
+   * maxCompressedSize(len) bytes.
+   *
+   * @return The compressed size
+   */
+  virtual uint32_t compress(const uint8_t* in, uint32_t len, uint8_t* out) = 0;
+
+  /**
+   * Decompresses len bytes into exactly outLen bytes at out.
+   *
+   * @throws TTransportException CORRUPTED_DATA if the input doesn't
+   *         decompress to outLen bytes.
+   */
+  virtual void decompress(const uint8_t* in, uint32_t len,
+                          uint8_t* out, uint32_t outLen) = 0;
+
+  /**
+   * A new codec with the same settings, for another transport.
+   */
+  virtual boost::shared_ptr<TFrameCodec> clone() const = 0;
+};
+
+/**
+ * A fast byte-oriented LZ77 codec in the style of LZ4's block format:
+ * literal runs and back references of at least 4 bytes within the last
+ * 64KB, found through a single-entry hash table.  It trades ratio for
+ * speed, compressing at several hundred MB/s and decompressing faster.
+ */
+class TLZFrameCodec : public TFrameCodec {
+ public:
+  TLZFrameCodec() : table_(new uint32_t[TABLE_SIZE]) {}
+
+  uint8_t getId() const {
+    return LZ;
+  }
+
+  uint32_t maxCompressedSize(uint32_t len) {
+    return len + len / 255 + 16;
+  }
+
+  uint32_t compress(const uint8_t* in, uint32_t len, uint8_t* out);
+
+  void decompress(const uint8_t* in, uint32_t len,
+                  uint8_t* out, uint32_t outLen);
+
+  boost::shared_ptr<TFrameCodec> clone() const {
+    return boost::shared_ptr<TFrameCodec>(new TLZFrameCodec());
+  }
+
+ private:
+  static const int HASH_BITS = 12;
+  static const uint32_t TABLE_SIZE = 1 << HASH_BITS;
+
+  boost::scoped_array<uint32_t> table_;
+};
+
+/**
+ * A framed transport that compresses each frame on its own.
+ *
+ * Frames are TFramedTransport frames whose payload starts with a codec ID
+ * byte and the uncompressed size, so servers that frame messages
+ * themselves (TNonblockingServer) can carry them.  Writes use one codec,
+ * except that frames smaller than the compression threshold, or that
+ * don't shrink, go out uncompressed.  Reads accept any codec that has
+ * been added to the transport; the LZ codec is always there.  The
+ * compression and decompression buffers grow to the largest frame seen
+ * and are reused from then on.
+ */
+class TCompressedFramedTransport
+  : public TVirtualTransport<TCompressedFramedTransport, TUnderlyingTransport> {
+ public:
+
+  static const uint32_t DEFAULT_MIN_COMPRESS_SIZE = 512;
+
+  /// Frame size, codec ID and uncompressed size.
+  static const uint32_t HEADER_SIZE = 9;
+
+  /**
+   * @param transport       The transport to read frames from and write them to
+   * @param codec           The codec to compress frames with, by default LZ
+   * @param minCompressSize Frames smaller than this aren't compressed
+   */
+  TCompressedFramedTransport(boost::shared_ptr<TTransport> transport,
+                             boost::shared_ptr<TFrameCodec> codec =
+                               boost::shared_ptr<TFrameCodec>(),
+                             uint32_t minCompressSize = DEFAULT_MIN_COMPRESS_SIZE);
+
+  /**
+   * Lets the transport read frames compressed with codec, and replaces
+   * any codec with the same ID.
+   */
+  void addCodec(boost::shared_ptr<TFrameCodec> codec);
+
+  /**
+   * Whether the transport writes and reads the frame size itself (the
+   * default).  Without it, each write goes out as the payload of one frame
+   * and the underlying transport holds exactly one frame to read, which is
+   * how TNonblockingServer hands over frames.
+   */
+  void setFramed(bool framed) {
+    framed_ = framed;
+  }
+
+  bool getFramed() const {
+    return framed_;
+  }
+
+  uint8_t getLastReadCodecId() const {
+    return lastReadCodecId_;
+  }
+
+  virtual uint32_t readSlow(uint8_t* buf, uint32_t len);
+
+  virtual void writeSlow(const uint8_t* buf, uint32_t len);
+
+  virtual void flush();
+
+  const uint8_t* borrowSlow(uint8_t* buf, uint32_t* len);
+
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    return TBufferBase::readAll(buf, len);
+  }
+
+ protected:
+  /**
+   * Reads and decompresses a frame from the underlying stream.
+   */
+  void readFrame();
+
+  /**
+   * Reads the rest of the underlying transport into cBuf_.
+   */
+  uint32_t readRemaining();
+
+  void ensureCompressedCapacity(uint32_t size);
+
+  void initPointers() {
+    setReadBuffer(NULL, 0);
+    setWriteBuffer(wBuf_.get() + HEADER_SIZE, wBufSize_ - HEADER_SIZE);
+  }
+
+  boost::shared_ptr<TFrameCodec> codec_;
+  std::vector<boost::shared_ptr<TFrameCodec> > codecs_;
+  uint32_t minCompressSize_;
+  bool framed_;
+  uint8_t lastReadCodecId_;
+
+  // Compressed frames on their way in or out, after HEADER_SIZE bytes
+  uint32_t cBufSize_;
+  boost::scoped_array<uint8_t> cBuf_;
+};
+
+/**
+ * Wraps transports into compressed framed ones.  Every transport gets its
+ * own copies of the factory's codecs.
+ */
+class TCompressedFramedTransportFactory : public TTransportFactory {
+ public:
+  TCompressedFramedTransportFactory(boost::shared_ptr<TFrameCodec> codec =
+                                      boost::shared_ptr<TFrameCodec>(),
+                                    uint32_t minCompressSize =
+                                      TCompressedFramedTransport::DEFAULT_MIN_COMPRESS_SIZE) :
+    codec_(codec),
+    minCompressSize_(minCompressSize) {}
+
+  virtual ~TCompressedFramedTransportFactory() {}
+
+  /**
+   * Lets the transports read frames compressed with codec.
+   */
+  void addCodec(boost::shared_ptr<TFrameCodec> codec) {
+    codecs_.push_back(codec);
+  }
+
+  virtual boost::shared_ptr<TTransport> getTransport(boost::shared_ptr<TTransport> trans);
+
+ private:
+  boost::shared_ptr<TFrameCodec> codec_;
+  uint32_t minCompressSize_;
+  std::vector<boost::shared_ptr<TFrameCodec> > codecs_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TCOMPRESSEDFRAMEDTRANSPORT_H_
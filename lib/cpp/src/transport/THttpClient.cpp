@@ -93,6 +93,21 @@ uint32_t THttpClient::read(uint8_t* buf, uint32_t len) {
   return readBuffer_.read(buf, len);
 }
 
+const uint8_t* THttpClient::borrow(uint8_t* buf, uint32_t* len) {
+  // Lends the rest of the body read so far, or of the current chunk
+  if (readBuffer_.available_read() == 0) {
+    readBuffer_.resetBuffer();
+    if (readMoreData() == 0) {
+      return NULL;
+    }
+  }
+  return readBuffer_.borrow(buf, len);
+}
+
+void THttpClient::consume(uint32_t len) {
+  readBuffer_.consume(len);
+}
+
 void THttpClient::readEnd() {
   // Read any pending chunked data (footers etc.)
   if (chunked_) {
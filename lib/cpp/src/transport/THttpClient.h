@@ -32,7 +32,7 @@ namespace apache { namespace thrift { namespace transport {
  * chunked transfer encoding, keepalive, etc. Tested against Apache.
  *
  */
-class THttpClient : public TTransport {
+class THttpClient : public TVirtualTransport<THttpClient> {
  public:
   THttpClient(boost::shared_ptr<TTransport> transport, std::string host, std::string path="");
 
@@ -58,6 +58,10 @@ class THttpClient : public TTransport {
 
   uint32_t read(uint8_t* buf, uint32_t len);
 
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len);
+
+  void consume(uint32_t len);
+
   void readEnd();
 
   void write(const uint8_t* buf, uint32_t len);
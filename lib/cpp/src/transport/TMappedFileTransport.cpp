@@ -0,0 +1,381 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#include "TMappedFileTransport.h"
+
+#include <fcntl.h>
+#include <errno.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+using namespace std;
+
+TMappedFileTransport::TMappedFileTransport(string path)
+  : fd_(-1)
+  , filename_(path)
+  , map_(NULL)
+  , mapSize_(0)
+  , offset_(0)
+  , inEvent_(false)
+  , eventHeader_(0)
+  , eventPos_(0)
+  , eventEnd_(0)
+  , readTimeout_(TFileTransport::NO_TAIL_READ_TIMEOUT)
+  , chunkSize_(DEFAULT_CHUNK_SIZE)
+  , maxEventSize_(0)
+  , maxCorruptedEvents_(0)
+  , eofSleepTime_(DEFAULT_EOF_SLEEP_TIME_US)
+  , lastBadChunk_(0)
+  , numCorruptedEventsInChunk_(0)
+{
+  fd_ = ::open(filename_.c_str(), O_RDONLY);
+  if (fd_ == -1) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TMappedFileTransport: ::open() file: " + filename_, errno_copy);
+    throw TTransportException(TTransportException::NOT_OPEN, filename_, errno_copy);
+  }
+
+  try {
+    remap();
+  } catch (...) {
+    ::close(fd_);
+    throw;
+  }
+}
+
+TMappedFileTransport::~TMappedFileTransport() {
+  if (map_ != NULL) {
+    munmap(map_, mapSize_);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+bool TMappedFileTransport::remap() {
+  struct stat f_info;
+  if (fstat(fd_, &f_info) < 0) {
+    int errno_copy = errno;
+    throw TTransportException(TTransportException::UNKNOWN,
+                              "TMappedFileTransport::remap() (fstat)",
+                              errno_copy);
+  }
+
+  if (f_info.st_size <= mapSize_) {
+    return false;
+  }
+
+  void* map = mmap(NULL, f_info.st_size, PROT_READ, MAP_SHARED, fd_, 0);
+  if (map == MAP_FAILED) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TMappedFileTransport: mmap() file: " + filename_, errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN,
+                              "TMappedFileTransport::remap() (mmap)",
+                              errno_copy);
+  }
+  // Let the kernel read ahead aggressively and drop pages behind us
+  madvise(map, f_info.st_size, MADV_SEQUENTIAL);
+
+  if (map_ != NULL) {
+    munmap(map_, mapSize_);
+  }
+  map_ = (uint8_t*)map;
+  mapSize_ = f_info.st_size;
+  return true;
+}
+
+uint32_t TMappedFileTransport::readAll(uint8_t* buf, uint32_t len) {
+  uint32_t have = 0;
+  uint32_t get = 0;
+
+  while (have < len) {
+    get = read(buf+have, len-have);
+    if (get <= 0) {
+      throw TEOFException();
+    }
+    have += get;
+  }
+
+  return have;
+}
+
+bool TMappedFileTransport::peek() {
+  if (!inEvent_ && !nextEvent()) {
+    return false;
+  }
+  return eventEnd_ > eventPos_;
+}
+
+uint32_t TMappedFileTransport::read(uint8_t* buf, uint32_t len) {
+  // did not manage to read an event from the file. This could have happened
+  // if the timeout expired
+  if (!inEvent_ && !nextEvent()) {
+    return 0;
+  }
+
+  // read as much of the current event as possible
+  uint32_t remaining = (uint32_t)(eventEnd_ - eventPos_);
+  if (remaining <= len) {
+    memcpy(buf, map_ + eventPos_, remaining);
+    inEvent_ = false;
+    return remaining;
+  }
+
+  memcpy(buf, map_ + eventPos_, len);
+  eventPos_ += len;
+  return len;
+}
+
+const uint8_t* TMappedFileTransport::borrow(uint8_t* /* buf */, uint32_t* len) {
+  if (!inEvent_ && !nextEvent()) {
+    return NULL;
+  }
+
+  uint32_t remaining = (uint32_t)(eventEnd_ - eventPos_);
+  if (remaining < *len) {
+    return NULL;
+  }
+  *len = remaining;
+  return map_ + eventPos_;
+}
+
+void TMappedFileTransport::consume(uint32_t len) {
+  if (!inEvent_ || (off_t)len > eventEnd_ - eventPos_) {
+    throw TTransportException(TTransportException::BAD_ARGS,
+                              "consume did not follow a borrow.");
+  }
+  eventPos_ += len;
+  if (eventPos_ == eventEnd_) {
+    inEvent_ = false;
+  }
+}
+
+bool TMappedFileTransport::nextEvent() {
+  int readTries = 0;
+
+  while (true) {
+    // event sizes never straddle a chunk boundary; the writer pads up to it
+    if (offset_ / chunkSize_ != (offset_ + 3) / chunkSize_) {
+      offset_ = (offset_ / chunkSize_ + 1) * chunkSize_;
+    }
+
+    if (offset_ + 4 > mapSize_) {
+      if (!remap() && !waitForData(&readTries)) {
+        return false;
+      }
+      continue;
+    }
+
+    uint32_t eventSize;
+    memcpy(&eventSize, map_ + offset_, 4);
+
+    // 0 length event indicates padding
+    if (eventSize == 0) {
+      offset_ += 4;
+      continue;
+    }
+
+    // check if the event is corrupted and perform recovery if required
+    if (isEventCorrupted(eventSize)) {
+      performRecovery();
+      continue;
+    }
+
+    // the writer may not be done with it yet
+    if (offset_ + 4 + eventSize > mapSize_) {
+      if (!remap() && !waitForData(&readTries)) {
+        return false;
+      }
+      continue;
+    }
+
+    eventHeader_ = offset_;
+    eventPos_ = offset_ + 4;
+    eventEnd_ = eventPos_ + eventSize;
+    offset_ = eventEnd_;
+    inEvent_ = true;
+    return true;
+  }
+}
+
+bool TMappedFileTransport::waitForData(int* readTries) {
+  if (readTimeout_ == TFileTransport::TAIL_READ_TIMEOUT) {
+    // wait indefinitely if there is no timeout
+    usleep(eofSleepTime_);
+    return true;
+  } else if (readTimeout_ > 0 && *readTries == 0) {
+    usleep(readTimeout_ * 1000);
+    (*readTries)++;
+    return true;
+  }
+  // no timeout, or it already expired once
+  return false;
+}
+
+bool TMappedFileTransport::isEventCorrupted(uint32_t eventSize) {
+  // an error is triggered if:
+  if ( (maxEventSize_ > 0) &&  (eventSize > maxEventSize_)) {
+    // 1. Event size is larger than user-speficied max-event size
+    T_ERROR("Read corrupt event. Event size(%u) greater than max event size (%u)",
+            eventSize, maxEventSize_);
+    return true;
+  } else if (eventSize > chunkSize_) {
+    // 2. Event size is larger than chunk size
+    T_ERROR("Read corrupt event. Event size(%u) greater than chunk size (%u)",
+            eventSize, chunkSize_);
+    return true;
+  } else if ((offset_ / chunkSize_) != ((offset_ + 4 + eventSize - 1) / chunkSize_)) {
+    // 3. size indicates that event crosses chunk boundary
+    T_ERROR("Read corrupt event. Event crosses chunk boundary. Event size:%u  Offset:%ld",
+            eventSize, (long)(offset_ + 4));
+    return true;
+  }
+
+  return false;
+}
+
+void TMappedFileTransport::performRecovery() {
+  uint32_t curChunk = offset_ / chunkSize_;
+  if (lastBadChunk_ == curChunk) {
+    numCorruptedEventsInChunk_++;
+  } else {
+    lastBadChunk_ = curChunk;
+    numCorruptedEventsInChunk_ = 1;
+  }
+
+  if (numCorruptedEventsInChunk_ < maxCorruptedEvents_) {
+    // maybe there was an error in reading the file from disk
+    // seek to the beginning of chunk and try again
+    seekToChunk(curChunk);
+  } else {
+
+    // just skip ahead to the next chunk if we not already at the last chunk
+    if (curChunk != (getNumChunks() - 1)) {
+      seekToChunk(curChunk + 1);
+    } else if (readTimeout_ == TFileTransport::TAIL_READ_TIMEOUT) {
+      // if tailing the file, wait until there is enough data to start
+      // the next chunk
+      while(curChunk == (getNumChunks() - 1)) {
+        usleep(DEFAULT_CORRUPTED_SLEEP_TIME_US);
+      }
+      seekToChunk(curChunk + 1);
+    } else {
+      // pretty hosed at this stage, leave the read position at the bad
+      // event and punt on the error
+      char errorMsg[1024];
+      sprintf(errorMsg, "TMappedFileTransport: log file corrupted at offset: %lu",
+              (unsigned long)offset_);
+      GlobalOutput(errorMsg);
+      throw TTransportException(errorMsg);
+    }
+  }
+}
+
+void TMappedFileTransport::seekToChunk(int32_t chunk) {
+  remap();
+
+  int32_t numChunks = getNumChunks();
+
+  // file is empty, seeking to chunk is pointless
+  if (numChunks == 0) {
+    return;
+  }
+
+  // negative indicates reverse seek (from the end)
+  if (chunk < 0) {
+    chunk += numChunks;
+  }
+
+  // too large a value for reverse seek, just seek to beginning
+  if (chunk < 0) {
+    chunk = 0;
+  }
+
+  // cannot seek past EOF
+  bool seekToEnd = false;
+  if (chunk >= numChunks) {
+    seekToEnd = true;
+    chunk = numChunks - 1;
+  }
+
+  offset_ = off_t(chunk) * chunkSize_;
+  eventHeader_ = offset_;
+  inEvent_ = false;
+
+  if (seekToEnd) {
+    // skip the events in the last chunk, without touching their contents
+    off_t endOffset = mapSize_;
+    int32_t oldReadTimeout = readTimeout_;
+    readTimeout_ = TFileTransport::NO_TAIL_READ_TIMEOUT;
+    while (offset_ < endOffset && nextEvent()) {
+      inEvent_ = false;
+    }
+    readTimeout_ = oldReadTimeout;
+    return;
+  }
+
+  // start reading the chunk in now
+  off_t start = offset_ - offset_ % sysconf(_SC_PAGESIZE);
+  off_t end = offset_ + chunkSize_;
+  if (end > mapSize_) {
+    end = mapSize_;
+  }
+  if (end > start) {
+    madvise(map_ + start, end - start, MADV_WILLNEED);
+  }
+}
+
+void TMappedFileTransport::seekToEnd() {
+  seekToChunk(getNumChunks());
+}
+
+uint32_t TMappedFileTransport::getNumChunks() {
+  struct stat f_info;
+  int rv = fstat(fd_, &f_info);
+
+  if (rv < 0) {
+    int errno_copy = errno;
+    throw TTransportException(TTransportException::UNKNOWN,
+                              "TMappedFileTransport::getNumChunks() (fstat)",
+                              errno_copy);
+  }
+
+  if (f_info.st_size > 0) {
+    return ((f_info.st_size)/chunkSize_) + 1;
+  }
+
+  // empty file has no chunks
+  return 0;
+}
+
+uint32_t TMappedFileTransport::getCurChunk() {
+  // the chunk of the event being read, or of the last one
+  return eventHeader_ / chunkSize_;
+}
+
+}}} // apache::thrift::transport
@@ -0,0 +1,168 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_
+#define _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_ 1
+
+#include "TFileTransport.h"
+
+#include <string>
+#include <sys/types.h>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * Reads files written by TFileTransport through a memory mapping.
+ *
+ * Events are never copied: read() copies straight out of the mapping, and
+ * borrow() hands out pointers into it, valid until the next read() or
+ * consume().  The mapping is read sequentially with readahead, seeking to a
+ * chunk is just a matter of moving the read position, and a file that grows
+ * while being tailed is mapped again as needed.
+ *
+ * Events are returned one at a time, exactly like TFileTransport: read()
+ * never returns bytes from two events, and corrupted events are skipped the
+ * same way, governed by setMaxCorruptedEvents().
+ */
+class TMappedFileTransport : public TFileReaderTransport {
+ public:
+  TMappedFileTransport(std::string path);
+  ~TMappedFileTransport();
+
+  bool isOpen() {
+    return fd_ >= 0;
+  }
+
+  uint32_t readAll(uint8_t* buf, uint32_t len);
+  uint32_t read(uint8_t* buf, uint32_t len);
+  bool peek();
+
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len);
+  void consume(uint32_t len);
+
+  /*
+   * Override TTransport *_virt() functions to invoke our implementations.
+   * We cannot use TVirtualTransport to provide these, since we need to inherit
+   * virtually from TTransport.
+   */
+  virtual uint32_t read_virt(uint8_t* buf, uint32_t len) {
+    return this->read(buf, len);
+  }
+  virtual uint32_t readAll_virt(uint8_t* buf, uint32_t len) {
+    return this->readAll(buf, len);
+  }
+  virtual const uint8_t* borrow_virt(uint8_t* buf, uint32_t* len) {
+    return this->borrow(buf, len);
+  }
+  virtual void consume_virt(uint32_t len) {
+    this->consume(len);
+  }
+
+  // log-file specific functions
+  void seekToChunk(int32_t chunk);
+  void seekToEnd();
+  uint32_t getNumChunks();
+  uint32_t getCurChunk();
+
+  void setReadTimeout(int32_t readTimeout) {
+    readTimeout_ = readTimeout;
+  }
+  int32_t getReadTimeout() {
+    return readTimeout_;
+  }
+
+  void setChunkSize(uint32_t chunkSize) {
+    if (chunkSize) {
+      chunkSize_ = chunkSize;
+    }
+  }
+  uint32_t getChunkSize() {
+    return chunkSize_;
+  }
+
+  void setMaxEventSize(uint32_t maxEventSize) {
+    maxEventSize_ = maxEventSize;
+  }
+  uint32_t getMaxEventSize() {
+    return maxEventSize_;
+  }
+
+  void setMaxCorruptedEvents(uint32_t maxCorruptedEvents) {
+    maxCorruptedEvents_ = maxCorruptedEvents;
+  }
+  uint32_t getMaxCorruptedEvents() {
+    return maxCorruptedEvents_;
+  }
+
+  void setEofSleepTimeUs(uint32_t eofSleepTime) {
+    if (eofSleepTime) {
+      eofSleepTime_ = eofSleepTime;
+    }
+  }
+  uint32_t getEofSleepTimeUs() {
+    return eofSleepTime_;
+  }
+
+ private:
+  // Makes the next event current, returns false if there is none yet
+  bool nextEvent();
+
+  // Maps the file again if it has grown, returns whether it had
+  bool remap();
+
+  // Waits for the file to grow according to the read timeout, returns
+  // false if the caller should give up
+  bool waitForData(int* readTries);
+
+  bool isEventCorrupted(uint32_t eventSize);
+  void performRecovery();
+
+  // The mapping, covering the first mapSize_ bytes of the file
+  int fd_;
+  std::string filename_;
+  uint8_t* map_;
+  off_t mapSize_;
+
+  // Where the next event header is
+  off_t offset_;
+
+  // The current event, if inEvent_
+  bool inEvent_;
+  off_t eventHeader_;
+  off_t eventPos_;
+  off_t eventEnd_;
+
+  int32_t readTimeout_;
+  uint32_t chunkSize_;
+  uint32_t maxEventSize_;
+  uint32_t maxCorruptedEvents_;
+  uint32_t eofSleepTime_;
+
+  // event corruption information
+  uint32_t lastBadChunk_;
+  uint32_t numCorruptedEventsInChunk_;
+
+  static const uint32_t DEFAULT_CHUNK_SIZE = 16 * 1024 * 1024;
+  static const uint32_t DEFAULT_EOF_SLEEP_TIME_US = 500 * 1000;
+  static const uint32_t DEFAULT_CORRUPTED_SLEEP_TIME_US = 1 * 1000 * 1000;
+};
+
+}}} // apache::thrift::transport
+
+#endif // _THRIFT_TRANSPORT_TMAPPEDFILETRANSPORT_H_
@@ -52,6 +52,9 @@ TServerSocket::TServerSocket(int port) :
   retryDelay_(0),
   tcpSendBuffer_(0),
   tcpRecvBuffer_(0),
+  reusePort_(false),
+  cork_(false),
+  zeroCopyThreshold_(0),
   intSock1_(-1),
   intSock2_(-1) {}
 
@@ -65,6 +68,9 @@ TServerSocket::TServerSocket(int port, int sendTimeout, int recvTimeout) :
   retryDelay_(0),
   tcpSendBuffer_(0),
   tcpRecvBuffer_(0),
+  reusePort_(false),
+  cork_(false),
+  zeroCopyThreshold_(0),
   intSock1_(-1),
   intSock2_(-1) {}
 
@@ -96,6 +102,18 @@ void TServerSocket::setTcpRecvBuffer(int tcpRecvBuffer) {
   tcpRecvBuffer_ = tcpRecvBuffer;
 }
 
+void TServerSocket::setReusePort(bool reusePort) {
+  reusePort_ = reusePort;
+}
+
+void TServerSocket::setCork(bool cork) {
+  cork_ = cork;
+}
+
+void TServerSocket::setZeroCopyThreshold(uint32_t bytes) {
+  zeroCopyThreshold_ = bytes;
+}
+
 void TServerSocket::listen() {
   int sv[2];
   if (-1 == socketpair(AF_LOCAL, SOCK_STREAM, 0, sv)) {
@@ -149,6 +167,20 @@ void TServerSocket::listen() {
     throw TTransportException(TTransportException::NOT_OPEN, "Could not set SO_REUSEADDR", errno_copy);
   }
 
+  if (reusePort_) {
+#ifdef SO_REUSEPORT
+    if (-1 == setsockopt(serverSocket_, SOL_SOCKET, SO_REUSEPORT,
+                         &one, sizeof(one))) {
+      int errno_copy = errno;
+      GlobalOutput.perror("TServerSocket::listen() setsockopt() SO_REUSEPORT ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN, "Could not set SO_REUSEPORT", errno_copy);
+    }
+#else
+    GlobalOutput("TServerSocket::listen() SO_REUSEPORT not supported");
+#endif
+  }
+
   // Set TCP buffer sizes
   if (tcpSendBuffer_ > 0) {
     if (-1 == setsockopt(serverSocket_, SOL_SOCKET, SO_SNDBUF,
@@ -265,6 +297,8 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
   }
 
   struct pollfd fds[2];
+  struct sockaddr_storage clientAddress;
+  int clientSocket;
 
   int maxEintrs = 5;
   int numEintrs = 0;
@@ -293,7 +327,9 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
       // Check for an interrupt signal
       if (intSock2_ >= 0 && (fds[1].revents & POLLIN)) {
         int8_t buf;
-        if (-1 == recv(intSock2_, &buf, sizeof(int8_t), 0)) {
+        // Other threads may be woken by the same byte
+        if (-1 == recv(intSock2_, &buf, sizeof(int8_t), MSG_DONTWAIT) &&
+            errno != EAGAIN && errno != EWOULDBLOCK) {
           GlobalOutput.perror("TServerSocket::acceptImpl() recv() interrupt ", errno);
         }
         throw TTransportException(TTransportException::INTERRUPTED);
@@ -301,7 +337,21 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
 
       // Check for the actual server socket being ready
       if (fds[0].revents & POLLIN) {
-        break;
+        int size = sizeof(clientAddress);
+        clientSocket = ::accept(serverSocket_,
+                                (struct sockaddr *) &clientAddress,
+                                (socklen_t *) &size);
+        if (clientSocket >= 0) {
+          break;
+        }
+        // Another thread accepting on this socket got the connection, or
+        // the client gave up on it already
+        if (errno == EAGAIN || errno == EWOULDBLOCK || errno == ECONNABORTED) {
+          continue;
+        }
+        int errno_copy = errno;
+        GlobalOutput.perror("TServerSocket::acceptImpl() ::accept() ", errno_copy);
+        throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
       }
     } else {
       GlobalOutput("TServerSocket::acceptImpl() poll 0");
@@ -309,18 +359,6 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
     }
   }
 
-  struct sockaddr_storage clientAddress;
-  int size = sizeof(clientAddress);
-  int clientSocket = ::accept(serverSocket_,
-                              (struct sockaddr *) &clientAddress,
-                              (socklen_t *) &size);
-
-  if (clientSocket < 0) {
-    int errno_copy = errno;
-    GlobalOutput.perror("TServerSocket::acceptImpl() ::accept() ", errno_copy);
-    throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
-  }
-
   // Make sure client socket is blocking
   int flags = fcntl(clientSocket, F_GETFL, 0);
   if (flags == -1) {
@@ -342,6 +380,12 @@ shared_ptr<TTransport> TServerSocket::acceptImpl() {
   if (recvTimeout_ > 0) {
     client->setRecvTimeout(recvTimeout_);
   }
+  if (cork_) {
+    client->setCork(true);
+  }
+  if (zeroCopyThreshold_ > 0) {
+    client->setZeroCopyThreshold(zeroCopyThreshold_);
+  }
 
   return client;
 }
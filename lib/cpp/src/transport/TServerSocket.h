@@ -48,6 +48,27 @@ class TServerSocket : public TServerTransport {
   void setTcpSendBuffer(int tcpSendBuffer);
   void setTcpRecvBuffer(int tcpRecvBuffer);
 
+  /**
+   * Sets SO_REUSEPORT on the listen socket, so that several sockets can
+   * listen on the same port and the kernel spreads connections over them.
+   * Must be set before listen().
+   */
+  void setReusePort(bool reusePort);
+
+  /**
+   * Options applied to every accepted socket; see TSocket::setCork() and
+   * TSocket::setZeroCopyThreshold().
+   */
+  void setCork(bool cork);
+  void setZeroCopyThreshold(uint32_t bytes);
+
+  /**
+   * The listen socket, or -1 if not listening.
+   */
+  int getSocketFD() {
+    return serverSocket_;
+  }
+
   void listen();
   void close();
 
@@ -66,6 +87,9 @@ class TServerSocket : public TServerTransport {
   int retryDelay_;
   int tcpSendBuffer_;
   int tcpRecvBuffer_;
+  bool reusePort_;
+  bool cork_;
+  uint32_t zeroCopyThreshold_;
 
   int intSock1_;
   int intSock2_;
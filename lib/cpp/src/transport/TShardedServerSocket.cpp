@@ -0,0 +1,277 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <config.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/poll.h>
+#ifdef HAVE_SYS_EPOLL_H
+#include <sys/epoll.h>
+#endif
+#include <fcntl.h>
+#include <errno.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include "TSocket.h"
+#include "TShardedServerSocket.h"
+
+namespace apache { namespace thrift { namespace transport {
+
+using namespace std;
+using boost::shared_ptr;
+using apache::thrift::concurrency::Guard;
+
+TShardedServerSocket::TShardedServerSocket(int port, int numShards) :
+  port_(port),
+  numShards_(numShards > 0 ? numShards : 1),
+  sendTimeout_(0),
+  recvTimeout_(0),
+  tcpSendBuffer_(0),
+  tcpRecvBuffer_(0),
+  numThreads_(0),
+  interrupted_(false) {
+  intPipe_[0] = intPipe_[1] = -1;
+  pthread_key_create(&shardKey_, NULL);
+}
+
+TShardedServerSocket::~TShardedServerSocket() {
+  close();
+  pthread_key_delete(shardKey_);
+}
+
+void TShardedServerSocket::setSendTimeout(int sendTimeout) {
+  sendTimeout_ = sendTimeout;
+}
+
+void TShardedServerSocket::setRecvTimeout(int recvTimeout) {
+  recvTimeout_ = recvTimeout;
+}
+
+void TShardedServerSocket::setTcpSendBuffer(int tcpSendBuffer) {
+  tcpSendBuffer_ = tcpSendBuffer;
+}
+
+void TShardedServerSocket::setTcpRecvBuffer(int tcpRecvBuffer) {
+  tcpRecvBuffer_ = tcpRecvBuffer;
+}
+
+void TShardedServerSocket::listen() {
+  if (-1 == pipe(intPipe_)) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TShardedServerSocket::listen() pipe() ", errno_copy);
+    intPipe_[0] = intPipe_[1] = -1;
+    throw TTransportException(TTransportException::NOT_OPEN, "Could not create interrupt pipe", errno_copy);
+  }
+  interrupted_ = false;
+
+#ifdef SO_REUSEPORT
+  int numSockets = numShards_;
+#else
+  int numSockets = 1;
+  if (numShards_ > 1) {
+    GlobalOutput("TShardedServerSocket::listen() no SO_REUSEPORT, sharing one socket");
+  }
+#endif
+
+  for (int i = 0; i < numSockets; ++i) {
+    Shard shard;
+    shard.socket.reset(new TServerSocket(port_));
+    shard.socket->setTcpSendBuffer(tcpSendBuffer_);
+    shard.socket->setTcpRecvBuffer(tcpRecvBuffer_);
+    shard.socket->setReusePort(numSockets > 1);
+    shard.pollFd = -1;
+    try {
+      shard.socket->listen();
+    } catch (TTransportException& ttx) {
+      close();
+      throw;
+    }
+    shard.fd = shard.socket->getSocketFD();
+    shards_.push_back(shard);
+  }
+
+#ifdef HAVE_SYS_EPOLL_H
+  // A shard's epoll set holds its socket, the interrupt pipe, and the
+  // sockets of the later shards that no thread has claimed yet
+  Guard g(mutex_);
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    shards_[i].pollFd = epoll_create(2);
+    if (shards_[i].pollFd == -1) {
+      int errno_copy = errno;
+      GlobalOutput.perror("TShardedServerSocket::listen() epoll_create() ", errno_copy);
+      close();
+      throw TTransportException(TTransportException::NOT_OPEN, "Could not create epoll set", errno_copy);
+    }
+    watch(shards_[i].pollFd, intPipe_[0]);
+    watch(shards_[i].pollFd, shards_[i].fd);
+    for (size_t j = max(i + 1, (size_t)numThreads_); j < shards_.size(); ++j) {
+      watch(shards_[i].pollFd, shards_[j].fd);
+    }
+  }
+#endif
+}
+
+void TShardedServerSocket::watch(int pollFd, int fd) {
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event ev;
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (-1 == epoll_ctl(pollFd, EPOLL_CTL_ADD, fd, &ev)) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TShardedServerSocket::listen() epoll_ctl() ", errno_copy);
+    close();
+    throw TTransportException(TTransportException::NOT_OPEN, "Could not add to epoll set", errno_copy);
+  }
+#endif
+}
+
+size_t TShardedServerSocket::claimShard() {
+  Guard g(mutex_);
+  size_t shard = numThreads_++;
+  if (shard < shards_.size()) {
+#ifdef HAVE_SYS_EPOLL_H
+    // The threads before this one stop waiting on the shard
+    for (size_t i = 0; i < shard; ++i) {
+      struct epoll_event ev;
+      epoll_ctl(shards_[i].pollFd, EPOLL_CTL_DEL, shards_[shard].fd, &ev);
+    }
+#endif
+    return shard;
+  }
+  // More threads than shards, they take turns
+  return shard % shards_.size();
+}
+
+int TShardedServerSocket::tryAccept(int fd) {
+  int clientSocket = ::accept(fd, NULL, NULL);
+  if (clientSocket < 0 &&
+      errno != EAGAIN && errno != EWOULDBLOCK &&
+      errno != EINTR && errno != ECONNABORTED) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TShardedServerSocket::acceptImpl() ::accept() ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN, "accept()", errno_copy);
+  }
+  return clientSocket;
+}
+
+void TShardedServerSocket::wait(size_t shard) {
+#ifdef HAVE_SYS_EPOLL_H
+  struct epoll_event events[2];
+  int ret = epoll_wait(shards_[shard].pollFd, events, 2, -1);
+#else
+  std::vector<struct pollfd> fds;
+  struct pollfd fd;
+  fd.events = POLLIN;
+  fd.revents = 0;
+  fd.fd = intPipe_[0];
+  fds.push_back(fd);
+  fd.fd = shards_[shard].fd;
+  fds.push_back(fd);
+  for (size_t i = max(shard + 1, (size_t)numThreads_); i < shards_.size(); ++i) {
+    fd.fd = shards_[i].fd;
+    fds.push_back(fd);
+  }
+  int ret = poll(&fds[0], fds.size(), -1);
+#endif
+  if (ret < 0 && errno != EINTR) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TShardedServerSocket::wait() ", errno_copy);
+    throw TTransportException(TTransportException::UNKNOWN, "Unknown", errno_copy);
+  }
+}
+
+shared_ptr<TTransport> TShardedServerSocket::acceptImpl() {
+  if (shards_.empty()) {
+    throw TTransportException(TTransportException::NOT_OPEN, "TShardedServerSocket not listening");
+  }
+
+  intptr_t index = (intptr_t)pthread_getspecific(shardKey_);
+  if (index == 0) {
+    index = claimShard() + 1;
+    pthread_setspecific(shardKey_, (void*)index);
+  }
+  size_t shard = (index - 1) % shards_.size();
+
+  // Only wait once the accept queues are empty
+  int clientSocket;
+  while (true) {
+    if (interrupted_) {
+      throw TTransportException(TTransportException::INTERRUPTED);
+    }
+    clientSocket = tryAccept(shards_[shard].fd);
+    // Until every shard has a thread, the unclaimed ones are served by all
+    for (size_t i = numThreads_; clientSocket < 0 && i < shards_.size(); ++i) {
+      clientSocket = tryAccept(shards_[i].fd);
+    }
+    if (clientSocket >= 0) {
+      break;
+    }
+    wait(shard);
+  }
+
+  // Make sure client socket is blocking
+  int flags = fcntl(clientSocket, F_GETFL, 0);
+  if (flags == -1 || -1 == fcntl(clientSocket, F_SETFL, flags & ~O_NONBLOCK)) {
+    int errno_copy = errno;
+    GlobalOutput.perror("TShardedServerSocket::acceptImpl() fcntl() ", errno_copy);
+    ::close(clientSocket);
+    throw TTransportException(TTransportException::UNKNOWN, "fcntl()", errno_copy);
+  }
+
+  shared_ptr<TSocket> client(new TSocket(clientSocket));
+  if (sendTimeout_ > 0) {
+    client->setSendTimeout(sendTimeout_);
+  }
+  if (recvTimeout_ > 0) {
+    client->setRecvTimeout(recvTimeout_);
+  }
+
+  return client;
+}
+
+void TShardedServerSocket::interrupt() {
+  interrupted_ = true;
+  if (intPipe_[1] >= 0) {
+    int8_t byte = 0;
+    if (-1 == write(intPipe_[1], &byte, sizeof(int8_t))) {
+      GlobalOutput.perror("TShardedServerSocket::interrupt() write() ", errno);
+    }
+  }
+}
+
+void TShardedServerSocket::close() {
+  for (size_t i = 0; i < shards_.size(); ++i) {
+    if (shards_[i].pollFd >= 0) {
+      ::close(shards_[i].pollFd);
+    }
+    shards_[i].socket->close();
+  }
+  shards_.clear();
+  if (intPipe_[0] >= 0) {
+    ::close(intPipe_[0]);
+  }
+  if (intPipe_[1] >= 0) {
+    ::close(intPipe_[1]);
+  }
+  intPipe_[0] = intPipe_[1] = -1;
+  interrupted_ = false;
+}
+
+}}} // apache::thrift::transport
@@ -0,0 +1,130 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#ifndef _THRIFT_TRANSPORT_TSHARDEDSERVERSOCKET_H_
+#define _THRIFT_TRANSPORT_TSHARDEDSERVERSOCKET_H_ 1
+
+#include <pthread.h>
+#include <vector>
+#include "TServerTransport.h"
+#include "TServerSocket.h"
+#include <concurrency/Mutex.h>
+#include <boost/shared_ptr.hpp>
+
+namespace apache { namespace thrift { namespace transport {
+
+/**
+ * A server transport for several threads accepting at once.
+ *
+ * The port is listened on by a number of SO_REUSEPORT sockets, the shards,
+ * and the kernel spreads incoming connections over them.  Each thread that
+ * calls accept() is assigned a shard the first time and keeps it, so with
+ * as many accepting threads as shards, every thread drains its own accept
+ * queue without contending with the others.  A thread waits for its shard
+ * in epoll, and only once the shard's queue is empty, so bursts are taken
+ * one accept() call per connection.
+ *
+ * The kernel hands connections to every shard whether or not a thread
+ * accepts on it, so the shards no thread has claimed yet are served by all
+ * the accepting threads, at the cost of them contending.  Give the server
+ * as many accept threads as shards (TThreadPoolServer::setAcceptThreads(),
+ * TThreadedServer::setAcceptThreads()); both default to a single one.  More
+ * threads than shards share them.
+ *
+ * interrupt() breaks all threads out of accept() at once, and accept()
+ * keeps throwing INTERRUPTED until the transport is closed.
+ *
+ * Without SO_REUSEPORT all threads share a single listen socket.
+ */
+class TShardedServerSocket : public TServerTransport {
+ public:
+  TShardedServerSocket(int port, int numShards);
+
+  ~TShardedServerSocket();
+
+  void setSendTimeout(int sendTimeout);
+  void setRecvTimeout(int recvTimeout);
+
+  void setTcpSendBuffer(int tcpSendBuffer);
+  void setTcpRecvBuffer(int tcpRecvBuffer);
+
+  int getNumShards() const {
+    return numShards_;
+  }
+
+  void listen();
+  void close();
+
+  void interrupt();
+
+ protected:
+  boost::shared_ptr<TTransport> acceptImpl();
+
+ private:
+  struct Shard {
+    boost::shared_ptr<TServerSocket> socket;
+    int fd;
+    int pollFd;
+  };
+
+  /**
+   * Assigns the calling thread a shard, the next unclaimed one if any.
+   */
+  size_t claimShard();
+
+  /**
+   * Accepts a connection off the socket, or returns -1 if there is none
+   * ready.
+   */
+  int tryAccept(int fd);
+
+  /**
+   * Blocks until the shard's socket, an unclaimed shard's socket or the
+   * interrupt pipe is readable.
+   */
+  void wait(size_t shard);
+
+  /**
+   * Adds the descriptor to the epoll set.
+   */
+  void watch(int pollFd, int fd);
+
+  int port_;
+  int numShards_;
+  int sendTimeout_;
+  int recvTimeout_;
+  int tcpSendBuffer_;
+  int tcpRecvBuffer_;
+
+  std::vector<Shard> shards_;
+
+  // The shard of each accepting thread, plus one
+  pthread_key_t shardKey_;
+
+  // Threads that have claimed a shard; shards from this one on are unclaimed
+  volatile size_t numThreads_;
+  concurrency::Mutex mutex_;
+
+  int intPipe_[2];
+  volatile bool interrupted_;
+};
+
+}}} // apache::thrift::transport
+
+#endif // #ifndef _THRIFT_TRANSPORT_TSHARDEDSERVERSOCKET_H_
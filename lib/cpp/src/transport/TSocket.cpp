@@ -30,11 +30,31 @@
 #include <unistd.h>
 #include <errno.h>
 #include <fcntl.h>
+#include <limits.h>
+#ifdef __linux__
+#include <linux/errqueue.h>
+#endif
+#include <algorithm>
+#include <vector>
 
 #include "concurrency/Monitor.h"
 #include "TSocket.h"
 #include "TTransportException.h"
 
+#ifndef IOV_MAX
+#define IOV_MAX 16
+#endif
+
+#if defined(TCP_CORK)
+#define THRIFT_TCP_CORK TCP_CORK
+#elif defined(TCP_NOPUSH)
+#define THRIFT_TCP_CORK TCP_NOPUSH
+#endif
+
+#if defined(MSG_ZEROCOPY) && defined(SO_ZEROCOPY) && defined(SO_EE_ORIGIN_ZEROCOPY)
+#define THRIFT_HAVE_ZEROCOPY 1
+#endif
+
 namespace apache { namespace thrift { namespace transport {
 
 using namespace std;
@@ -57,6 +77,11 @@ TSocket::TSocket(string host, int port) :
   lingerOn_(1),
   lingerVal_(0),
   noDelay_(1),
+  cork_(false),
+  corked_(false),
+  zeroCopyThreshold_(0),
+  zeroCopySent_(0),
+  zeroCopyDone_(0),
   maxRecvRetries_(5) {
   recvTimeval_.tv_sec = (int)(recvTimeout_/1000);
   recvTimeval_.tv_usec = (int)((recvTimeout_%1000)*1000);
@@ -72,6 +97,11 @@ TSocket::TSocket() :
   lingerOn_(1),
   lingerVal_(0),
   noDelay_(1),
+  cork_(false),
+  corked_(false),
+  zeroCopyThreshold_(0),
+  zeroCopySent_(0),
+  zeroCopyDone_(0),
   maxRecvRetries_(5) {
   recvTimeval_.tv_sec = (int)(recvTimeout_/1000);
   recvTimeval_.tv_usec = (int)((recvTimeout_%1000)*1000);
@@ -87,6 +117,11 @@ TSocket::TSocket(int socket) :
   lingerOn_(1),
   lingerVal_(0),
   noDelay_(1),
+  cork_(false),
+  corked_(false),
+  zeroCopyThreshold_(0),
+  zeroCopySent_(0),
+  zeroCopyDone_(0),
   maxRecvRetries_(5) {
   recvTimeval_.tv_sec = (int)(recvTimeout_/1000);
   recvTimeval_.tv_usec = (int)((recvTimeout_%1000)*1000);
@@ -153,6 +188,11 @@ void TSocket::openConnection(struct addrinfo *res) {
   // No delay
   setNoDelay(noDelay_);
 
+  // Zero-copy sends
+  if (zeroCopyThreshold_ > 0) {
+    setZeroCopyThreshold(zeroCopyThreshold_);
+  }
+
   // Uses a low min RTO if asked to.
 #ifdef TCP_LOW_MIN_RTO
   if (getUseLowMinRto()) {
@@ -290,6 +330,8 @@ void TSocket::close() {
     ::close(socket_);
   }
   socket_ = -1;
+  corked_ = false;
+  zeroCopySent_ = zeroCopyDone_ = 0;
 }
 
 uint32_t TSocket::read(uint8_t* buf, uint32_t len) {
@@ -395,6 +437,19 @@ void TSocket::write(const uint8_t* buf, uint32_t len) {
     throw TTransportException(TTransportException::NOT_OPEN, "Called write on non-open socket");
   }
 
+  // Large writes go through sendmsg() so that they can skip the copy
+  if (zeroCopyThreshold_ > 0 && len >= zeroCopyThreshold_) {
+    struct iovec iov;
+    iov.iov_base = const_cast<uint8_t*>(buf);
+    iov.iov_len = len;
+    writev(&iov, 1);
+    return;
+  }
+
+  if (cork_ && !corked_) {
+    setCorked(true);
+  }
+
   uint32_t sent = 0;
 
   while (sent < len) {
@@ -430,6 +485,179 @@ void TSocket::write(const uint8_t* buf, uint32_t len) {
   }
 }
 
+void TSocket::writev(const struct iovec* iov, int iovcnt) {
+  if (socket_ < 0) {
+    throw TTransportException(TTransportException::NOT_OPEN, "Called writev on non-open socket");
+  }
+
+  if (iovcnt <= 0) {
+    return;
+  }
+
+  if (cork_ && !corked_) {
+    setCorked(true);
+  }
+
+  int zeroCopy = 0;
+#ifdef THRIFT_HAVE_ZEROCOPY
+  if (zeroCopyThreshold_ > 0) {
+    size_t total = 0;
+    for (int i = 0; i < iovcnt; ++i) {
+      total += iov[i].iov_len;
+    }
+    if (total >= zeroCopyThreshold_) {
+      zeroCopy = MSG_ZEROCOPY;
+    }
+  }
+#endif
+
+  // sendmsg() may only take part of the data, so work on a copy of the
+  // vector that we can advance.  Small vectors stay on the stack.
+  struct iovec stackIov[16];
+  std::vector<struct iovec> heapIov;
+  struct iovec* cur = stackIov;
+  if (iovcnt <= 16) {
+    std::copy(iov, iov + iovcnt, stackIov);
+  } else {
+    heapIov.assign(iov, iov + iovcnt);
+    cur = &heapIov[0];
+  }
+  int left = iovcnt;
+
+  while (left > 0) {
+    // Skip over empty (or fully sent) buffers
+    if (cur->iov_len == 0) {
+      ++cur;
+      --left;
+      continue;
+    }
+
+    int flags = 0;
+    #ifdef MSG_NOSIGNAL
+    // Note the use of MSG_NOSIGNAL to suppress SIGPIPE errors, instead we
+    // check for the EPIPE return condition and close the socket in that case
+    flags |= MSG_NOSIGNAL;
+    #endif // ifdef MSG_NOSIGNAL
+    flags |= zeroCopy;
+
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_iov = cur;
+    msg.msg_iovlen = (left < IOV_MAX) ? left : IOV_MAX;
+
+    ssize_t b = sendmsg(socket_, &msg, flags);
+    ++g_socket_syscalls;
+
+    // Out of memory to pin pages with, so copy after all
+    if (b < 0 && zeroCopy != 0 && errno == ENOBUFS) {
+      zeroCopy = 0;
+      continue;
+    }
+
+    // Fail on a send error
+    if (b < 0) {
+      int errno_copy = errno;
+      GlobalOutput.perror("TSocket::writev() sendmsg() " + getSocketInfo(), errno_copy);
+
+      if (errno_copy == EPIPE || errno_copy == ECONNRESET || errno_copy == ENOTCONN) {
+        close();
+        throw TTransportException(TTransportException::NOT_OPEN, "writev() sendmsg()", errno_copy);
+      }
+
+      throw TTransportException(TTransportException::UNKNOWN, "writev() sendmsg()", errno_copy);
+    }
+
+    // Fail on blocked send
+    if (b == 0) {
+      throw TTransportException(TTransportException::NOT_OPEN, "Socket sendmsg returned 0.");
+    }
+    if (zeroCopy != 0) {
+      ++zeroCopySent_;
+    }
+
+    // Advance past whatever was sent
+    size_t done = (size_t)b;
+    while (left > 0 && done >= cur->iov_len) {
+      done -= cur->iov_len;
+      ++cur;
+      --left;
+    }
+    if (left > 0) {
+      cur->iov_base = static_cast<uint8_t*>(cur->iov_base) + done;
+      cur->iov_len -= done;
+    }
+  }
+
+  // The caller may reuse the buffers once we return
+  if (zeroCopySent_ != zeroCopyDone_) {
+    waitForZeroCopy();
+  }
+}
+
+void TSocket::waitForZeroCopy() {
+#ifdef THRIFT_HAVE_ZEROCOPY
+  // The kernel reports finished sends on the socket's error queue, as
+  // ranges of the sends' sequence numbers
+  while (zeroCopyDone_ != zeroCopySent_) {
+    struct pollfd fds[1];
+    fds[0].fd = socket_;
+    fds[0].events = 0;
+    fds[0].revents = 0;
+    int ret = poll(fds, 1, (sendTimeout_ > 0) ? sendTimeout_ : -1);
+    if (ret < 0) {
+      int errno_copy = errno;
+      if (errno_copy == EINTR) {
+        continue;
+      }
+      GlobalOutput.perror("TSocket::waitForZeroCopy() poll() " + getSocketInfo(), errno_copy);
+      throw TTransportException(TTransportException::UNKNOWN, "waitForZeroCopy() poll()", errno_copy);
+    }
+    if (ret == 0) {
+      throw TTransportException(TTransportException::TIMED_OUT, "Timed out waiting for zero-copy sends");
+    }
+
+    char control[128];
+    struct msghdr msg;
+    memset(&msg, 0, sizeof(msg));
+    msg.msg_control = control;
+    msg.msg_controllen = sizeof(control);
+    if (recvmsg(socket_, &msg, MSG_ERRQUEUE) < 0) {
+      int errno_copy = errno;
+      if (errno_copy != EAGAIN && errno_copy != EWOULDBLOCK && errno_copy != EINTR) {
+        GlobalOutput.perror("TSocket::waitForZeroCopy() recvmsg() " + getSocketInfo(), errno_copy);
+        throw TTransportException(TTransportException::UNKNOWN, "waitForZeroCopy() recvmsg()", errno_copy);
+      }
+      // Woken by a plain socket error rather than a notification
+      int error = 0;
+      socklen_t errorLen = sizeof(error);
+      if (getsockopt(socket_, SOL_SOCKET, SO_ERROR, &error, &errorLen) == 0 && error != 0) {
+        close();
+        throw TTransportException(TTransportException::NOT_OPEN, "waitForZeroCopy()", error);
+      }
+      continue;
+    }
+
+    for (struct cmsghdr* cm = CMSG_FIRSTHDR(&msg); cm != NULL; cm = CMSG_NXTHDR(&msg, cm)) {
+      struct sock_extended_err* err = (struct sock_extended_err*)CMSG_DATA(cm);
+      if (err->ee_errno != 0 || err->ee_origin != SO_EE_ORIGIN_ZEROCOPY) {
+        continue;
+      }
+      zeroCopyDone_ += err->ee_data - err->ee_info + 1;
+      // The data was copied anyway, so stop paying for the notifications
+      if (err->ee_code & SO_EE_CODE_ZEROCOPY_COPIED) {
+        zeroCopyThreshold_ = 0;
+      }
+    }
+  }
+#endif
+}
+
+void TSocket::flush() {
+  if (corked_) {
+    setCorked(false);
+  }
+}
+
 std::string TSocket::getHost() {
   return host_;
 }
@@ -476,6 +704,54 @@ void TSocket::setNoDelay(bool noDelay) {
   }
 }
 
+void TSocket::setCork(bool cork) {
+#ifdef THRIFT_TCP_CORK
+  cork_ = cork;
+#endif
+  if (!cork_ && corked_) {
+    setCorked(false);
+  }
+}
+
+void TSocket::setCorked(bool corked) {
+  if (socket_ < 0) {
+    return;
+  }
+
+#ifdef THRIFT_TCP_CORK
+  int v = corked ? 1 : 0;
+  int ret = setsockopt(socket_, IPPROTO_TCP, THRIFT_TCP_CORK, &v, sizeof(v));
+  ++g_socket_syscalls;
+  if (ret == -1) {
+    int errno_copy = errno;  // Copy errno because we're allocating memory.
+    GlobalOutput.perror("TSocket::setCorked() setsockopt() " + getSocketInfo(), errno_copy);
+    // Don't retry on every write
+    cork_ = false;
+    return;
+  }
+  corked_ = corked;
+#endif
+}
+
+void TSocket::setZeroCopyThreshold(uint32_t bytes) {
+  zeroCopyThreshold_ = bytes;
+  if (socket_ < 0 || bytes == 0) {
+    return;
+  }
+
+#ifdef THRIFT_HAVE_ZEROCOPY
+  int one = 1;
+  int ret = setsockopt(socket_, SOL_SOCKET, SO_ZEROCOPY, &one, sizeof(one));
+  if (ret == -1) {
+    int errno_copy = errno;  // Copy errno because we're allocating memory.
+    GlobalOutput.perror("TSocket::setZeroCopyThreshold() setsockopt() " + getSocketInfo(), errno_copy);
+    zeroCopyThreshold_ = 0;
+  }
+#else
+  zeroCopyThreshold_ = 0;
+#endif
+}
+
 void TSocket::setConnTimeout(int ms) {
   connTimeout_ = ms;
 }
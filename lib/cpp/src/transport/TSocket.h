@@ -25,6 +25,7 @@
 #include <netdb.h>
 
 #include "TTransport.h"
+#include "TVirtualTransport.h"
 #include "TServerSocket.h"
 
 namespace apache { namespace thrift { namespace transport {
@@ -33,14 +34,15 @@ namespace apache { namespace thrift { namespace transport {
  * TCP Socket implementation of the TTransport interface.
  *
  */
-class TSocket : public TTransport {
+class TSocket : public TVirtualTransport<TSocket> {
   /**
-   * We allow the TServerSocket acceptImpl() method to access the private
-   * members of a socket so that it can access the TSocket(int socket)
-   * constructor which creates a socket object from the raw UNIX socket
-   * handle.
+   * We allow the TServerSocket and TShardedServerSocket acceptImpl()
+   * methods to access the private members of a socket so that they can
+   * access the TSocket(int socket) constructor which creates a socket object
+   * from the raw UNIX socket handle.
    */
   friend class TServerSocket;
+  friend class TShardedServerSocket;
 
  public:
   /**
@@ -98,6 +100,24 @@ class TSocket : public TTransport {
    */
   void write(const uint8_t* buf, uint32_t len);
 
+  /**
+   * Writes several buffers to the underlying socket with as few sendmsg()
+   * calls as the kernel allows.
+   */
+  void writev(const struct iovec* iov, int iovcnt);
+
+  /**
+   * Sends out anything held back by setCork().
+   */
+  void flush();
+
+  /**
+   * Marks the end of a message; same as flush().
+   */
+  void writeEnd() {
+    flush();
+  }
+
   /**
    * Get the host that the socket is connected to
    *
@@ -142,6 +162,28 @@ class TSocket : public TTransport {
    */
   void setNoDelay(bool noDelay);
 
+  /**
+   * Whether to hold back partial TCP segments until flush() or writeEnd().
+   * With this on, a message written in many pieces (e.g. by a
+   * TBufferedTransport flushing its buffer every wBufSize_ bytes) goes out
+   * in full-sized segments instead of one short segment per send().  Uses
+   * TCP_CORK on Linux and TCP_NOPUSH on BSDs, and does nothing elsewhere.
+   *
+   * @param cork Whether or not to cork the socket between flushes.
+   */
+  void setCork(bool cork);
+
+  /**
+   * Writes of at least this many bytes are sent with MSG_ZEROCOPY, letting
+   * the kernel transmit straight from the caller's pages.  A write returns
+   * once the kernel is done with them, so the caller may reuse the buffer
+   * as usual.  Zero, the default, turns zero-copy off, as does a kernel
+   * that keeps copying anyway (e.g. over loopback).  Linux only.
+   *
+   * @param bytes Smallest write sent without copying, or 0 for none.
+   */
+  void setZeroCopyThreshold(uint32_t bytes);
+
   /**
    * Set the connect timeout
    */
@@ -183,6 +225,13 @@ class TSocket : public TTransport {
    **/
   int getPeerPort();
 
+  /**
+   * Returns the underlying socket descriptor, or -1 if it isn't open
+   */
+  int getSocketFD() {
+    return socket_;
+  }
+
   /**
    * Sets whether to use a low minimum TCP retransmission timeout.
    */
@@ -203,6 +252,12 @@ class TSocket : public TTransport {
   /** connect, called by open */
   void openConnection(struct addrinfo *res);
 
+  /** Sets or clears TCP_CORK (or TCP_NOPUSH) on the socket */
+  void setCorked(bool corked);
+
+  /** Waits until the kernel is done with all MSG_ZEROCOPY sends */
+  void waitForZeroCopy();
+
   /** Host to connect to */
   std::string host_;
 
@@ -239,6 +294,19 @@ class TSocket : public TTransport {
   /** Nodelay */
   bool noDelay_;
 
+  /** Cork between flushes */
+  bool cork_;
+
+  /** Whether the socket is corked right now */
+  bool corked_;
+
+  /** Smallest write sent with MSG_ZEROCOPY, 0 for none */
+  uint32_t zeroCopyThreshold_;
+
+  /** MSG_ZEROCOPY sends made, and how many of them the kernel is done with */
+  uint32_t zeroCopySent_;
+  uint32_t zeroCopyDone_;
+
   /** Recv EGAIN retries */
   int maxRecvRetries_;
 
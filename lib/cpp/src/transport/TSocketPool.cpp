@@ -19,14 +19,18 @@
 
 #include <algorithm>
 #include <iostream>
+#include <poll.h>
 
 #include "TSocketPool.h"
+#include <concurrency/Util.h>
 
 namespace apache { namespace thrift { namespace transport {
 
 using namespace std;
 
 using boost::shared_ptr;
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::Util;
 
 /**
  * TSocketPoolServer implementation
@@ -37,7 +41,13 @@ TSocketPoolServer::TSocketPoolServer()
     port_(0),
     socket_(-1),
     lastFailTime_(0),
-    consecutiveFailures_(0) {}
+    consecutiveFailures_(0),
+    latencyEwma_(0),
+    errorEwma_(0),
+    activeSockets_(0),
+    ejectedUntil_(0),
+    retryBackoff_(0),
+    probing_(false) {}
 
 /**
  * Constructor for TSocketPool server
@@ -47,7 +57,13 @@ TSocketPoolServer::TSocketPoolServer(const string &host, int port)
     port_(port),
     socket_(-1),
     lastFailTime_(0),
-    consecutiveFailures_(0) {}
+    consecutiveFailures_(0),
+    latencyEwma_(0),
+    errorEwma_(0),
+    activeSockets_(0),
+    ejectedUntil_(0),
+    retryBackoff_(0),
+    probing_(false) {}
 
 /**
  * TSocketPool implementation.
@@ -249,4 +265,287 @@ void TSocketPool::close() {
   }
 }
 
+/**
+ * TSocketConnectionPool implementation.
+ *
+ */
+
+struct TSocketConnectionPool::Backend {
+  Backend(shared_ptr<TSocketPoolServer> s) : server(s) {}
+
+  shared_ptr<TSocketPoolServer> server;
+
+  // Idle sockets and when they were checked in, most recent last
+  vector<pair<shared_ptr<TSocket>, int64_t> > idle;
+};
+
+TSocketConnectionPool::TSocketConnectionPool() :
+  maxIdlePerServer_(16),
+  maxIdleTime_(60000),
+  maxConsecutiveFailures_(3),
+  errorThreshold_(0.5),
+  ewmaWeight_(0.1),
+  retryInterval_(1000),
+  maxRetryInterval_(60000),
+  connTimeout_(0),
+  sendTimeout_(0),
+  recvTimeout_(0),
+  numConnects_(0),
+  nextBackend_(0) {
+}
+
+TSocketConnectionPool::TSocketConnectionPool(const vector<pair<string, int> >& servers) :
+  maxIdlePerServer_(16),
+  maxIdleTime_(60000),
+  maxConsecutiveFailures_(3),
+  errorThreshold_(0.5),
+  ewmaWeight_(0.1),
+  retryInterval_(1000),
+  maxRetryInterval_(60000),
+  connTimeout_(0),
+  sendTimeout_(0),
+  recvTimeout_(0),
+  numConnects_(0),
+  nextBackend_(0) {
+  for (unsigned i = 0; i < servers.size(); ++i) {
+    addServer(servers[i].first, servers[i].second);
+  }
+}
+
+TSocketConnectionPool::~TSocketConnectionPool() {
+  for (size_t i = 0; i < backends_.size(); ++i) {
+    closeIdle(backends_[i]);
+    delete backends_[i];
+  }
+}
+
+void TSocketConnectionPool::addServer(const string& host, int port) {
+  addServer(shared_ptr<TSocketPoolServer>(new TSocketPoolServer(host, port)));
+}
+
+void TSocketConnectionPool::addServer(shared_ptr<TSocketPoolServer> server) {
+  if (server) {
+    Guard g(mutex_);
+    backends_.push_back(new Backend(server));
+  }
+}
+
+void TSocketConnectionPool::getServers(vector< shared_ptr<TSocketPoolServer> >& servers) {
+  Guard g(mutex_);
+  servers.clear();
+  for (size_t i = 0; i < backends_.size(); ++i) {
+    servers.push_back(backends_[i]->server);
+  }
+}
+
+/**
+ * An idle connection is only good if the server hasn't closed it or sent
+ * anything on it meanwhile.
+ */
+static bool idleSocketUsable(int fd) {
+  struct pollfd fds;
+  fds.fd = fd;
+  fds.events = POLLIN;
+  fds.revents = 0;
+  return poll(&fds, 1, 0) == 0;
+}
+
+shared_ptr<TSocket> TSocketConnectionPool::checkout() {
+  size_t attempts;
+  {
+    Guard g(mutex_);
+    attempts = backends_.size();
+  }
+
+  for (size_t attempt = 0; attempt < attempts; ++attempt) {
+    Backend* backend;
+    shared_ptr<TSocket> socket;
+    {
+      Guard g(mutex_);
+      int64_t now = Util::currentTime();
+      backend = selectBackend(now);
+      if (backend == NULL) {
+        break;
+      }
+
+      // The most recently used connection is the likeliest to be good
+      while (!backend->idle.empty()) {
+        pair<shared_ptr<TSocket>, int64_t> entry = backend->idle.back();
+        backend->idle.pop_back();
+        if (now - entry.second <= maxIdleTime_ &&
+            idleSocketUsable(entry.first->getSocketFD())) {
+          socket = entry.first;
+          break;
+        }
+        entry.first->close();
+      }
+
+      backend->server->activeSockets_++;
+      if (socket) {
+        Lease lease = { backend, Util::currentTimeUsec() };
+        leases_[socket.get()] = lease;
+        return socket;
+      }
+    }
+
+    // Connect without holding up everyone else
+    socket.reset(new TSocket(backend->server->host_, backend->server->port_));
+    if (connTimeout_ > 0) {
+      socket->setConnTimeout(connTimeout_);
+    }
+    if (sendTimeout_ > 0) {
+      socket->setSendTimeout(sendTimeout_);
+    }
+    if (recvTimeout_ > 0) {
+      socket->setRecvTimeout(recvTimeout_);
+    }
+    try {
+      socket->open();
+    } catch (TTransportException& ttx) {
+      string errStr = "TSocketConnectionPool::checkout failed "+socket->getSocketInfo()+": "+ttx.what();
+      GlobalOutput(errStr.c_str());
+      Guard g(mutex_);
+      backend->server->activeSockets_--;
+      recordFailure(backend, Util::currentTime());
+      continue;
+    }
+
+    Guard g(mutex_);
+    ++numConnects_;
+    Lease lease = { backend, Util::currentTimeUsec() };
+    leases_[socket.get()] = lease;
+    return socket;
+  }
+
+  GlobalOutput("TSocketConnectionPool::checkout: all connections failed");
+  throw TTransportException(TTransportException::NOT_OPEN);
+}
+
+void TSocketConnectionPool::checkin(shared_ptr<TSocket> socket, bool failed) {
+  if (!socket) {
+    return;
+  }
+
+  Guard g(mutex_);
+  map<TSocket*, Lease>::iterator it = leases_.find(socket.get());
+  if (it == leases_.end()) {
+    GlobalOutput("TSocketConnectionPool::checkin: socket not checked out");
+    return;
+  }
+  Backend* backend = it->second.backend;
+  int64_t start = it->second.start;
+  leases_.erase(it);
+
+  TSocketPoolServer* server = backend->server.get();
+  server->activeSockets_--;
+  int64_t nowUsec = Util::currentTimeUsec();
+
+  if (failed) {
+    socket->close();
+    recordFailure(backend, nowUsec / 1000);
+    return;
+  }
+
+  server->latencyEwma_ += ewmaWeight_ * ((double)(nowUsec - start) - server->latencyEwma_);
+  server->errorEwma_ -= ewmaWeight_ * server->errorEwma_;
+  server->consecutiveFailures_ = 0;
+  if (server->probing_) {
+    // The server is back
+    server->probing_ = false;
+    server->ejectedUntil_ = 0;
+    server->retryBackoff_ = 0;
+  }
+
+  if (socket->isOpen() && server->ejectedUntil_ == 0 &&
+      backend->idle.size() < maxIdlePerServer_) {
+    backend->idle.push_back(make_pair(socket, nowUsec / 1000));
+  } else {
+    socket->close();
+  }
+}
+
+TSocketConnectionPool::Backend* TSocketConnectionPool::selectBackend(int64_t now) {
+  size_t numBackends = backends_.size();
+  if (numBackends == 0) {
+    return NULL;
+  }
+
+  Backend* best = NULL;
+  double bestScore = 0;
+  Backend* due = NULL;
+  Backend* soonest = NULL;
+  for (size_t i = 0; i < numBackends; ++i) {
+    Backend* backend = backends_[(nextBackend_ + i) % numBackends];
+    TSocketPoolServer* server = backend->server.get();
+
+    if (server->ejectedUntil_ != 0) {
+      if (!server->probing_) {
+        if (due == NULL && server->ejectedUntil_ <= now) {
+          due = backend;
+        }
+        if (soonest == NULL ||
+            server->ejectedUntil_ < soonest->server->ejectedUntil_) {
+          soonest = backend;
+        }
+      }
+      continue;
+    }
+
+    // Expected wait: the calls already out on the server, and ours
+    double score = (server->activeSockets_ + 1) * (server->latencyEwma_ + 1);
+    if (best == NULL || score < bestScore) {
+      best = backend;
+      bestScore = score;
+    }
+  }
+  ++nextBackend_;
+
+  // Probe a server whose time is up before anything else.  With no
+  // healthy server left, probe the one that is due next rather than fail.
+  if (due == NULL && best == NULL) {
+    due = soonest;
+  }
+  if (due != NULL) {
+    due->server->probing_ = true;
+    return due;
+  }
+  return best;
+}
+
+void TSocketConnectionPool::recordFailure(Backend* backend, int64_t now) {
+  TSocketPoolServer* server = backend->server.get();
+  server->errorEwma_ += ewmaWeight_ * (1 - server->errorEwma_);
+
+  // Calls that were out when the server was ejected don't count again
+  if (server->ejectedUntil_ != 0 && !server->probing_) {
+    return;
+  }
+
+  ++server->consecutiveFailures_;
+  if (server->probing_ ||
+      server->consecutiveFailures_ >= maxConsecutiveFailures_ ||
+      server->errorEwma_ > errorThreshold_) {
+    // Back off for longer each time a probe fails
+    if (server->retryBackoff_ > 0) {
+      server->retryBackoff_ = min(server->retryBackoff_ * 2, (int64_t)maxRetryInterval_);
+    } else {
+      server->retryBackoff_ = retryInterval_;
+    }
+    server->ejectedUntil_ = now + server->retryBackoff_;
+    server->consecutiveFailures_ = 0;
+    server->probing_ = false;
+    closeIdle(backend);
+    GlobalOutput.printf("TSocketConnectionPool: ejecting %s:%d for %d ms",
+                        server->host_.c_str(), server->port_,
+                        (int)server->retryBackoff_);
+  }
+}
+
+void TSocketConnectionPool::closeIdle(Backend* backend) {
+  for (size_t i = 0; i < backend->idle.size(); ++i) {
+    backend->idle[i].first->close();
+  }
+  backend->idle.clear();
+}
+
 }}} // apache::thrift::transport
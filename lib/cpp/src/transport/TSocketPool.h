@@ -20,8 +20,10 @@
 #ifndef _THRIFT_TRANSPORT_TSOCKETPOOL_H_
 #define _THRIFT_TRANSPORT_TSOCKETPOOL_H_ 1
 
+#include <map>
 #include <vector>
 #include "TSocket.h"
+#include <concurrency/Mutex.h>
 
 namespace apache { namespace thrift { namespace transport {
 
@@ -56,6 +58,26 @@ class TSocketPoolServer {
 
   // Number of consecutive times connecting to this server failed
   int consecutiveFailures_;
+
+  // The following are kept by TSocketConnectionPool
+
+  // Moving average of how long sockets are checked out, in microseconds
+  double latencyEwma_;
+
+  // Moving average of the error rate, between 0 and 1
+  double errorEwma_;
+
+  // Sockets checked out
+  int activeSockets_;
+
+  // Time in milliseconds until which the server is left alone, or 0
+  int64_t ejectedUntil_;
+
+  // How long the server was left alone the last time, in milliseconds
+  int64_t retryBackoff_;
+
+  // Set while one socket checks whether an ejected server is back
+  bool probing_;
 };
 
 /**
@@ -190,6 +212,187 @@ class TSocketPool : public TSocket {
    bool alwaysTryLast_;
 };
 
+/**
+ * A thread safe pool of open connections to a set of servers.
+ *
+ * checkout() lends out a socket and checkin() takes it back, so a call
+ * normally reuses a connection made earlier instead of paying for a new
+ * TCP handshake.  Each server keeps moving averages of how long its sockets
+ * are checked out and how often calls on them fail, and checkout() picks
+ * the healthy server with the least expected wait, that is its latency
+ * times the number of sockets it already has out.  Check sockets out for
+ * one call at a time so that the averages measure the calls.
+ *
+ * A server that fails maxConsecutiveFailures times in a row, or whose error
+ * rate passes the threshold, is ejected: it gets no calls for the retry
+ * interval, after which a single probe call is let through.  If the probe
+ * fails too the server is ejected again for twice as long, up to
+ * maxRetryInterval.  When every server is ejected, the one due back first
+ * is probed early rather than failing the call.
+ *
+ * The pool must outlive the sockets checked out of it.
+ */
+class TSocketConnectionPool {
+
+ public:
+
+  TSocketConnectionPool();
+
+  /**
+   * @param servers list of pairs of host name and port
+   */
+  TSocketConnectionPool(const std::vector<std::pair<std::string, int> >& servers);
+
+  virtual ~TSocketConnectionPool();
+
+  /**
+   * Add a server to the pool
+   */
+  void addServer(const std::string& host, int port);
+
+  /**
+   * Add a server to the pool
+   */
+  void addServer(boost::shared_ptr<TSocketPoolServer> server);
+
+  /**
+   * Get list of servers in this pool, with their health
+   */
+  void getServers(std::vector< boost::shared_ptr<TSocketPoolServer> >& servers);
+
+  /**
+   * Lends out an open socket to the least loaded healthy server, reusing an
+   * idle connection if there is one.
+   *
+   * @throws TTransportException NOT_OPEN if no server could be reached
+   */
+  boost::shared_ptr<TSocket> checkout();
+
+  /**
+   * Gives back a socket from checkout().  A socket that is still open is
+   * kept for reuse, unless failed is set, which closes it and counts the
+   * call as an error.
+   */
+  void checkin(boost::shared_ptr<TSocket> socket, bool failed = false);
+
+  /**
+   * Sets how many idle connections to keep per server.
+   */
+  void setMaxIdlePerServer(size_t maxIdle) {
+    maxIdlePerServer_ = maxIdle;
+  }
+
+  /**
+   * Sets how long in milliseconds idle connections are kept.
+   */
+  void setMaxIdleTime(int maxIdleTime) {
+    maxIdleTime_ = maxIdleTime;
+  }
+
+  /**
+   * Sets the failures in a row that eject a server.
+   */
+  void setMaxConsecutiveFailures(int maxConsecutiveFailures) {
+    maxConsecutiveFailures_ = maxConsecutiveFailures;
+  }
+
+  /**
+   * Sets the error rate, between 0 and 1, that ejects a server.
+   */
+  void setErrorThreshold(double errorThreshold) {
+    errorThreshold_ = errorThreshold;
+  }
+
+  /**
+   * Sets the weight of the latest call in the moving averages.
+   */
+  void setEwmaWeight(double weight) {
+    ewmaWeight_ = weight;
+  }
+
+  /**
+   * Sets how long in milliseconds an ejected server is left alone at first.
+   */
+  void setRetryInterval(int retryInterval) {
+    retryInterval_ = retryInterval;
+  }
+
+  /**
+   * Sets the limit in milliseconds the retry interval doubles up to.
+   */
+  void setMaxRetryInterval(int maxRetryInterval) {
+    maxRetryInterval_ = maxRetryInterval;
+  }
+
+  /**
+   * Timeouts in milliseconds for new connections, as for TSocket.
+   */
+  void setConnTimeout(int ms) {
+    connTimeout_ = ms;
+  }
+
+  void setSendTimeout(int ms) {
+    sendTimeout_ = ms;
+  }
+
+  void setRecvTimeout(int ms) {
+    recvTimeout_ = ms;
+  }
+
+  /**
+   * Number of connections the pool has made.
+   */
+  uint64_t getNumConnects() const {
+    return numConnects_;
+  }
+
+ protected:
+
+  struct Backend;
+
+  /**
+   * The server a socket should go to, or NULL if every server is ejected
+   * and already being probed.  Called with mutex_ held.
+   */
+  Backend* selectBackend(int64_t now);
+
+  /**
+   * Counts a failed connect or call against a backend, and ejects it if
+   * that was one too many.  Called with mutex_ held.
+   */
+  void recordFailure(Backend* backend, int64_t now);
+
+  void closeIdle(Backend* backend);
+
+  std::vector<Backend*> backends_;
+
+  struct Lease {
+    Backend* backend;
+    int64_t start;
+  };
+
+  // Sockets checked out, by address
+  std::map<TSocket*, Lease> leases_;
+
+  size_t maxIdlePerServer_;
+  int maxIdleTime_;
+  int maxConsecutiveFailures_;
+  double errorThreshold_;
+  double ewmaWeight_;
+  int retryInterval_;
+  int maxRetryInterval_;
+  int connTimeout_;
+  int sendTimeout_;
+  int recvTimeout_;
+
+  uint64_t numConnects_;
+
+  // Where to start looking, to spread ties between servers
+  size_t nextBackend_;
+
+  apache::thrift::concurrency::Mutex mutex_;
+};
+
 }}} // apache::thrift::transport
 
 #endif // #ifndef _THRIFT_TRANSPORT_TSOCKETPOOL_H_
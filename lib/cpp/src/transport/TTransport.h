@@ -24,13 +24,42 @@
 #include <boost/shared_ptr.hpp>
 #include <transport/TTransportException.h>
 #include <string>
+#include <sys/uio.h>
 
 namespace apache { namespace thrift { namespace transport {
 
+/**
+ * Helper template to hoist readAll implementation out of TTransport
+ */
+template <class Transport_>
+uint32_t readAll(Transport_ &trans, uint8_t* buf, uint32_t len) {
+  uint32_t have = 0;
+  uint32_t get = 0;
+
+  while (have < len) {
+    get = trans.read(buf+have, len-have);
+    if (get <= 0) {
+      throw TTransportException(TTransportException::END_OF_FILE,
+                                "No more data to read.");
+    }
+    have += get;
+  }
+
+  return have;
+}
+
+
 /**
  * Generic interface for a method of transporting data. A TTransport may be
  * capable of either reading or writing, but not necessarily both.
  *
+ * The data transfer methods (read, readAll, write, writeBorrowed, borrow,
+ * consume, readEnd and writeEnd) are non-virtual and simply call a virtual
+ * *_virt() version.
+ * Transport implementations should derive from TVirtualTransport, which
+ * implements the *_virt() methods in terms of the subclass's own non-virtual
+ * methods.  That lets code which knows the concrete transport type (e.g.
+ * TBinaryProtocolT<TMemoryBuffer>) call it directly and have it inlined.
  */
 class TTransport {
  public:
@@ -83,7 +112,10 @@ class TTransport {
    * @return How many bytes were actually read
    * @throws TTransportException If an error occurs
    */
-  virtual uint32_t read(uint8_t* /* buf */, uint32_t /* len */) {
+  uint32_t read(uint8_t* buf, uint32_t len) {
+    return read_virt(buf, len);
+  }
+  virtual uint32_t read_virt(uint8_t* /* buf */, uint32_t /* len */) {
     throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot read.");
   }
 
@@ -95,20 +127,11 @@ class TTransport {
    * @return How many bytes read, which must be equal to size
    * @throws TTransportException If insufficient data was read
    */
-  virtual uint32_t readAll(uint8_t* buf, uint32_t len) {
-    uint32_t have = 0;
-    uint32_t get = 0;
-
-    while (have < len) {
-      get = read(buf+have, len-have);
-      if (get <= 0) {
-        throw TTransportException(TTransportException::END_OF_FILE,
-				  "No more data to read.");
-      }
-      have += get;
-    }
-
-    return have;
+  uint32_t readAll(uint8_t* buf, uint32_t len) {
+    return readAll_virt(buf, len);
+  }
+  virtual uint32_t readAll_virt(uint8_t* buf, uint32_t len) {
+    return apache::thrift::transport::readAll(*this, buf, len);
   }
 
   /**
@@ -117,7 +140,10 @@ class TTransport {
    * e.g. logging the request to a file
    *
    */
-  virtual void readEnd() {
+  void readEnd() {
+    readEnd_virt();
+  }
+  virtual void readEnd_virt() {
     // default behaviour is to do nothing
     return;
   }
@@ -128,17 +154,58 @@ class TTransport {
    * @param buf  The data to write out
    * @throws TTransportException if an error occurs
    */
-  virtual void write(const uint8_t* /* buf */, uint32_t /* len */) {
+  void write(const uint8_t* buf, uint32_t len) {
+    write_virt(buf, len);
+  }
+  virtual void write_virt(const uint8_t* /* buf */, uint32_t /* len */) {
     throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot write.");
   }
 
+  /**
+   * Writes the string in its entirety, like write(), but lets the transport
+   * keep referring to buf instead of copying it.  The caller must leave buf
+   * untouched until the next flush() returns.  By default this just calls
+   * write().
+   *
+   * @param buf  The data to write out
+   * @throws TTransportException if an error occurs
+   */
+  void writeBorrowed(const uint8_t* buf, uint32_t len) {
+    writeBorrowed_virt(buf, len);
+  }
+  virtual void writeBorrowed_virt(const uint8_t* buf, uint32_t len) {
+    write(buf, len);
+  }
+
+  /**
+   * Writes several buffers, in order, in their entirety.  This is the same
+   * as calling write() on each of them, but transports that can hand a list
+   * of buffers straight to the OS (e.g. TSocket) override it so the buffers
+   * never have to be joined first.
+   *
+   * @param iov     The buffers to write out
+   * @param iovcnt  How many entries iov has
+   * @throws TTransportException if an error occurs
+   */
+  void writev(const struct iovec* iov, int iovcnt) {
+    writev_virt(iov, iovcnt);
+  }
+  virtual void writev_virt(const struct iovec* iov, int iovcnt) {
+    for (int i = 0; i < iovcnt; ++i) {
+      write(static_cast<const uint8_t*>(iov[i].iov_base), iov[i].iov_len);
+    }
+  }
+
   /**
    * Called when write is completed.
    * This can be over-ridden to perform a transport-specific action
    * at the end of a request.
    *
    */
-  virtual void writeEnd() {
+  void writeEnd() {
+    writeEnd_virt();
+  }
+  virtual void writeEnd_virt() {
     // default behaviour is to do nothing
     return;
   }
@@ -175,7 +242,10 @@ class TTransport {
    *         the transport's internal buffers.
    * @throws TTransportException if an error occurs
    */
-  virtual const uint8_t* borrow(uint8_t* /* buf */, uint32_t* /* len */) {
+  const uint8_t* borrow(uint8_t* buf, uint32_t* len) {
+    return borrow_virt(buf, len);
+  }
+  virtual const uint8_t* borrow_virt(uint8_t* /* buf */, uint32_t* /* len */) {
     return NULL;
   }
 
@@ -188,7 +258,10 @@ class TTransport {
    * @param len  How many bytes to consume
    * @throws TTransportException If an error occurs
    */
-  virtual void consume(uint32_t /* len */) {
+  void consume(uint32_t len) {
+    consume_virt(len);
+  }
+  virtual void consume_virt(uint32_t /* len */) {
     throw TTransportException(TTransportException::NOT_OPEN, "Base TTransport cannot consume.");
   }
 
@@ -295,5 +295,80 @@ void TZlibTransport::verifyChecksum() {
   // inflating.
 }
 
+TZlibFrameCodec::TZlibFrameCodec(int level) :
+  level_(level),
+  rstream_(NULL),
+  wstream_(NULL) {
+  int rv;
+  try {
+    rstream_ = new z_stream;
+    wstream_ = new z_stream;
+    memset(rstream_, 0, sizeof(z_stream));
+    memset(wstream_, 0, sizeof(z_stream));
+
+    rv = inflateInit(rstream_);
+    if (rv != Z_OK) {
+      throw TZlibTransportException(rv, rstream_->msg);
+    }
+
+    rv = deflateInit(wstream_, level_);
+    if (rv != Z_OK) {
+      inflateEnd(rstream_);
+      throw TZlibTransportException(rv, wstream_->msg);
+    }
+  } catch (...) {
+    delete rstream_;
+    delete wstream_;
+    throw;
+  }
+}
+
+TZlibFrameCodec::~TZlibFrameCodec() {
+  inflateEnd(rstream_);
+  deflateEnd(wstream_);
+  delete rstream_;
+  delete wstream_;
+}
+
+uint32_t TZlibFrameCodec::maxCompressedSize(uint32_t len) {
+  return deflateBound(wstream_, len);
+}
+
+uint32_t TZlibFrameCodec::compress(const uint8_t* in, uint32_t len, uint8_t* out) {
+  int rv = deflateReset(wstream_);
+  if (rv != Z_OK) {
+    throw TZlibTransportException(rv, wstream_->msg);
+  }
+
+  wstream_->next_in = const_cast<uint8_t*>(in);
+  wstream_->avail_in = len;
+  wstream_->next_out = out;
+  wstream_->avail_out = maxCompressedSize(len);
+
+  rv = deflate(wstream_, Z_FINISH);
+  if (rv != Z_STREAM_END) {
+    throw TZlibTransportException(rv, wstream_->msg);
+  }
+  return wstream_->total_out;
+}
+
+void TZlibFrameCodec::decompress(const uint8_t* in, uint32_t len,
+                                 uint8_t* out, uint32_t outLen) {
+  int rv = inflateReset(rstream_);
+  if (rv != Z_OK) {
+    throw TZlibTransportException(rv, rstream_->msg);
+  }
+
+  rstream_->next_in = const_cast<uint8_t*>(in);
+  rstream_->avail_in = len;
+  rstream_->next_out = out;
+  rstream_->avail_out = outLen;
+
+  rv = inflate(rstream_, Z_FINISH);
+  if (rv != Z_STREAM_END || rstream_->total_out != outLen) {
+    throw TTransportException(TTransportException::CORRUPTED_DATA,
+                              "TZlibFrameCodec: corrupted frame");
+  }
+}
 
 }}} // apache::thrift::transport
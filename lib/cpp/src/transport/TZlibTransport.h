@@ -22,6 +22,8 @@
 
 #include <boost/lexical_cast.hpp>
 #include <transport/TTransport.h>
+#include <transport/TVirtualTransport.h>
+#include <transport/TCompressedFramedTransport.h>
 
 struct z_stream_s;
 
@@ -69,7 +71,7 @@ class TZlibTransportException : public TTransportException {
  *               the underlying transport is TBuffered or TMemory.
  *
  */
-class TZlibTransport : public TTransport {
+class TZlibTransport : public TVirtualTransport<TZlibTransport> {
  public:
 
   /**
@@ -214,6 +216,41 @@ class TZlibTransport : public TTransport {
   struct z_stream_s* wstream_;
 };
 
+/**
+ * zlib codec for TCompressedFramedTransport.  Every frame is a complete
+ * zlib stream, with its checksum.  The streams are reset rather than
+ * reinitialized between frames.
+ */
+class TZlibFrameCodec : public TFrameCodec {
+ public:
+  /**
+   * @param level zlib compression level, from 1 (fastest, the default) to 9
+   */
+  TZlibFrameCodec(int level = 1);
+
+  ~TZlibFrameCodec();
+
+  uint8_t getId() const {
+    return ZLIB;
+  }
+
+  uint32_t maxCompressedSize(uint32_t len);
+
+  uint32_t compress(const uint8_t* in, uint32_t len, uint8_t* out);
+
+  void decompress(const uint8_t* in, uint32_t len,
+                  uint8_t* out, uint32_t outLen);
+
+  boost::shared_ptr<TFrameCodec> clone() const {
+    return boost::shared_ptr<TFrameCodec>(new TZlibFrameCodec(level_));
+  }
+
+ private:
+  int level_;
+  struct z_stream_s* rstream_;
+  struct z_stream_s* wstream_;
+};
+
 }}} // apache::thrift::transport
 
 #endif // #ifndef _THRIFT_TRANSPORT_TZLIBTRANSPORT_H_
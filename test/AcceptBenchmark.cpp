@@ -0,0 +1,189 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Measures how many connections a second server transports accept, with
+ * local client threads connecting and disconnecting as fast as they can.
+ *
+ * Usage: AcceptBenchmark [accept threads] [client threads] [seconds]
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <vector>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <concurrency/PosixThreadFactory.h>
+#include <transport/TServerSocket.h>
+#include <transport/TShardedServerSocket.h>
+
+using namespace std;
+using namespace boost;
+using namespace apache::thrift::concurrency;
+using namespace apache::thrift::transport;
+
+static const int PORT = 9390;
+
+static volatile bool done;
+
+static double now() {
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+class Acceptor : public Runnable {
+ public:
+  Acceptor(shared_ptr<TServerTransport> transport) :
+    transport_(transport),
+    accepted_(0) {}
+
+  void run() {
+    while (!done) {
+      try {
+        transport_->accept()->close();
+        accepted_++;
+      } catch (TTransportException& ttx) {
+        if (ttx.getType() != TTransportException::INTERRUPTED) {
+          cerr << "accept: " << ttx.what() << endl;
+        }
+      }
+    }
+    // Wake up the next acceptor
+    transport_->interrupt();
+  }
+
+  shared_ptr<TServerTransport> transport_;
+  uint64_t accepted_;
+};
+
+class Client : public Runnable {
+ public:
+  Client() :
+    connected_(0),
+    failed_(0) {}
+
+  void run() {
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    // Reset instead of closing, so the ports don't pile up in TIME_WAIT
+    struct linger ling = {1, 0};
+
+    while (!done) {
+      int fd = socket(AF_INET, SOCK_STREAM, 0);
+      if (fd < 0) {
+        failed_++;
+        continue;
+      }
+      setsockopt(fd, SOL_SOCKET, SO_LINGER, &ling, sizeof(ling));
+      if (connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0) {
+        connected_++;
+      } else {
+        failed_++;
+      }
+      close(fd);
+    }
+  }
+
+  uint64_t connected_;
+  uint64_t failed_;
+};
+
+static void runBenchmark(const char* name,
+                         shared_ptr<TServerTransport> transport,
+                         int numAcceptors, int numClients, int seconds) {
+  PosixThreadFactory threadFactory(PosixThreadFactory::ROUND_ROBIN,
+                                   PosixThreadFactory::NORMAL, 1, false);
+  transport->listen();
+  done = false;
+
+  vector<shared_ptr<Acceptor> > acceptors;
+  vector<shared_ptr<Client> > clients;
+  vector<shared_ptr<Thread> > threads;
+  for (int i = 0; i < numAcceptors; i++) {
+    acceptors.push_back(shared_ptr<Acceptor>(new Acceptor(transport)));
+    threads.push_back(threadFactory.newThread(acceptors.back()));
+  }
+  for (int i = 0; i < numClients; i++) {
+    clients.push_back(shared_ptr<Client>(new Client()));
+    threads.push_back(threadFactory.newThread(clients.back()));
+  }
+
+  double start = now();
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->start();
+  }
+  usleep(seconds * 1000000);
+  done = true;
+  transport->interrupt();
+  for (size_t i = 0; i < threads.size(); i++) {
+    threads[i]->join();
+  }
+  double elapsed = now() - start;
+  transport->close();
+
+  uint64_t accepted = 0;
+  uint64_t failed = 0;
+  for (int i = 0; i < numAcceptors; i++) {
+    accepted += acceptors[i]->accepted_;
+  }
+  for (int i = 0; i < numClients; i++) {
+    failed += clients[i]->failed_;
+  }
+
+  cout << name << ": " << (uint64_t)(accepted / elapsed) << " accepts/s";
+  if (numAcceptors > 1) {
+    cout << ", per thread";
+    for (int i = 0; i < numAcceptors; i++) {
+      cout << " " << acceptors[i]->accepted_;
+    }
+  }
+  cout << ", " << failed << " failed connects" << endl;
+}
+
+int main(int argc, char** argv) {
+  int numAcceptors = argc > 1 ? atoi(argv[1]) : 4;
+  int numClients = argc > 2 ? atoi(argv[2]) : 4;
+  int seconds = argc > 3 ? atoi(argv[3]) : 2;
+
+  cout << numAcceptors << " accept threads, " << numClients
+       << " client threads, " << seconds << " s per run" << endl;
+
+  runBenchmark("TServerSocket, 1 accept thread",
+               shared_ptr<TServerTransport>(new TServerSocket(PORT)),
+               1, numClients, seconds);
+
+  runBenchmark("TServerSocket, shared by all accept threads",
+               shared_ptr<TServerTransport>(new TServerSocket(PORT)),
+               numAcceptors, numClients, seconds);
+
+  runBenchmark("TShardedServerSocket, a shard per accept thread",
+               shared_ptr<TServerTransport>(new TShardedServerSocket(PORT, numAcceptors)),
+               numAcceptors, numClients, seconds);
+
+  return 0;
+}
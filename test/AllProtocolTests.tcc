@@ -91,6 +91,131 @@ void testField(const Val val) {
   protocol->readStructEnd();
 }
 
+template <typename Val>
+std::vector<Val> integerArray() {
+  // Values of every varint length, with runs of small ones in between
+  std::vector<Val> vals;
+  vals.push_back(std::numeric_limits<Val>::min());
+  vals.push_back(std::numeric_limits<Val>::max());
+  for (int i = 0; i < (int)sizeof(Val) * 8 - 1; i++) {
+    vals.push_back((Val)1 << i);
+    vals.push_back(-((Val)1 << i));
+    for (int j = 0; j < 10; j++) {
+      vals.push_back((Val)(i * j - 100));
+    }
+  }
+  return vals;
+}
+
+inline std::vector<double> doubleArray() {
+  std::vector<double> vals;
+  vals.push_back(0.0);
+  vals.push_back(-0.0);
+  vals.push_back(std::numeric_limits<double>::min());
+  vals.push_back(std::numeric_limits<double>::max());
+  vals.push_back(std::numeric_limits<double>::denorm_min());
+  vals.push_back(std::numeric_limits<double>::infinity());
+  vals.push_back(-std::numeric_limits<double>::infinity());
+  for (int i = 0; i < 1000; i++) {
+    vals.push_back(i * 1.5 - 123.456);
+  }
+  return vals;
+}
+
+template <typename TProto, typename Val>
+void testArray(const std::vector<Val>& vals) {
+  uint32_t size = vals.size();
+
+  // Arrays written in bulk read back one by one, and the other way around.
+  // The tiny buffered transport makes values straddle buffer boundaries.
+  for (int bulkWrite = 0; bulkWrite < 2; bulkWrite++) {
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    shared_ptr<TProtocol> writer(new TProto(buffer));
+    uint32_t wsize = 0;
+    if (bulkWrite) {
+      wsize = GenericIO::writeArray(writer, &vals[0], size);
+    } else {
+      for (uint32_t i = 0; i < size; i++) {
+        wsize += GenericIO::write(writer, vals[i]);
+      }
+    }
+    std::string bytes = buffer->getBufferAsString();
+    if (wsize != bytes.size()) {
+      snprintf(errorMessage, ERR_LEN, "Invalid array write size (type: %s)", ClassNames::getName<Val>());
+      throw TException(errorMessage);
+    }
+
+    for (int buffered = 0; buffered < 2; buffered++) {
+      shared_ptr<TMemoryBuffer> input(new TMemoryBuffer());
+      input->write((const uint8_t*)bytes.data(), bytes.size());
+      shared_ptr<TTransport> transport = input;
+      if (buffered) {
+        transport.reset(new TBufferedTransport(input, 16));
+      }
+      shared_ptr<TProtocol> reader(new TProto(transport));
+      std::vector<Val> out(size);
+      uint32_t rsize = 0;
+      if (bulkWrite) {
+        for (uint32_t i = 0; i < size; i++) {
+          rsize += GenericIO::read(reader, out[i]);
+        }
+      } else {
+        rsize = GenericIO::readArray(reader, &out[0], size);
+      }
+      if (out != vals || rsize != wsize) {
+        snprintf(errorMessage, ERR_LEN, "Invalid array test (type: %s)", ClassNames::getName<Val>());
+        throw TException(errorMessage);
+      }
+    }
+  }
+}
+
+template <typename TProto, TType type, typename Val>
+void testGatheredArray(const std::vector<Val>& vals) {
+  // A framed transport that gathers borrowed writes must still copy the
+  // chunks the array writers build on the stack.  The string is long enough
+  // to be gathered, so the frame mixes copied and borrowed pieces.
+  std::string str(1000, 'x');
+  uint32_t size = vals.size();
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  shared_ptr<TFramedTransport> framed(new TFramedTransport(buffer));
+  framed->setGatherWriteThreshold(64);
+  shared_ptr<TProtocol> writer(new TProto(framed));
+  writer->writeString(str);
+  writer->writeListBegin(type, size);
+  GenericIO::writeArray(writer, &vals[0], size);
+  writer->writeListEnd();
+  writer->writeString(str);
+  framed->flush();
+
+  shared_ptr<TProtocol> reader(new TProto(
+    shared_ptr<TTransport>(new TFramedTransport(buffer))));
+  std::string strOut;
+  TType elemType;
+  uint32_t sizeOut;
+  std::vector<Val> out(size);
+  reader->readString(strOut);
+  reader->readListBegin(elemType, sizeOut);
+  GenericIO::readArray(reader, &out[0], sizeOut);
+  reader->readListEnd();
+  if (strOut != str || elemType != type || sizeOut != size || out != vals) {
+    snprintf(errorMessage, ERR_LEN, "Invalid gathered array test (type: %s)", ClassNames::getName<Val>());
+    throw TException(errorMessage);
+  }
+  reader->readString(strOut);
+  if (strOut != str) {
+    throw TException("Invalid gathered array test (trailing string)");
+  }
+}
+
+inline std::vector<int32_t> longI32Array() {
+  std::vector<int32_t> vals;
+  for (int32_t i = 0; i < 2000; i++) {
+    vals.push_back(i * 7919 - 1000000);
+  }
+  return vals;
+}
+
 template <typename TProto>
 void testMessage() {
   struct TMessage {
@@ -123,6 +248,37 @@ void testMessage() {
         seqid != messages[i].seqid) {
       throw TException("readMessageBegin failed.");
     }
+
+    // Read it again with the name-free API.  Reading from the memory buffer
+    // lends the name out of the transport; reading through a buffered
+    // transport with a tiny buffer makes the protocol copy it.
+    shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    shared_ptr<TProtocol> writer(new TProto(buffer));
+    writer->writeMessageBegin(messages[i].name,
+                              messages[i].type,
+                              messages[i].seqid);
+    writer->writeMessageEnd();
+    writer->writeMessageBegin(messages[i].name,
+                              messages[i].type,
+                              messages[i].seqid);
+    writer->writeMessageEnd();
+
+    shared_ptr<TTransport> readers[2] = {
+      buffer,
+      shared_ptr<TTransport>(new TBufferedTransport(buffer, 4))
+    };
+    for (int j = 0; j < 2; j++) {
+      shared_ptr<TProtocol> reader(new TProto(readers[j]));
+      const char* nameBuf;
+      uint32_t nameLen;
+      reader->readMessageBegin(nameBuf, nameLen, type, seqid);
+      if (std::string(nameBuf, nameLen) != messages[i].name ||
+          type != messages[i].type ||
+          seqid != messages[i].seqid) {
+        throw TException("readMessageBegin (name view) failed.");
+      }
+      reader->readMessageEnd();
+    }
   }
 }
 
@@ -202,6 +358,15 @@ void testProtocol(const char* protoname) {
       testField<TProto, T_I64, int64_t>(-(1L << i));
     }
 
+    testArray<TProto>(integerArray<int8_t>());
+    testArray<TProto>(integerArray<int16_t>());
+    testArray<TProto>(integerArray<int32_t>());
+    testArray<TProto>(integerArray<int64_t>());
+    testArray<TProto>(doubleArray());
+    testGatheredArray<TProto, T_I32>(longI32Array());
+    testGatheredArray<TProto, T_I64>(integerArray<int64_t>());
+    testGatheredArray<TProto, T_DOUBLE>(doubleArray());
+
     testNaked<TProto, double>(123.456);
 
     testNaked<TProto, std::string>("");
@@ -0,0 +1,287 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <cassert>
+#include <iostream>
+#include <TArena.h>
+#include <processor/PeekProcessor.h>
+#include <processor/StatsProcessor.h>
+#include <protocol/TBinaryProtocol.h>
+#include <protocol/TCompactProtocol.h>
+#include <protocol/TJSONProtocol.h>
+#include <transport/TBufferTransports.h>
+#include <transport/TTransportUtils.h>
+#include "gen-cpp/ArenaService.h"
+
+using std::cout;
+using std::endl;
+using namespace thrift::test::arena;
+using namespace apache::thrift;
+using namespace apache::thrift::transport;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::processor;
+
+// Long enough that none of the strings fit in a small string buffer
+static const char* LONG = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+static TArenaString str(const char* prefix, int i) {
+  char buf[32];
+  sprintf(buf, "%d", i);
+  return TArenaString(prefix) + buf + LONG;
+}
+
+static void fill(Nested& n) {
+  n.label = str("label", 0);
+  n.head.name = str("head", 0);
+  n.head.blob = str("blob", 0);
+  n.head.weight = 7;
+  for (int i = 0; i < 10; ++i) {
+    Leaf leaf;
+    leaf.name = str("leaf", i);
+    leaf.blob = str("blob", i);
+    leaf.weight = i;
+    n.leaves.push_back(leaf);
+    n.attrs[str("key", i)] = str("value", i);
+    n.tags.insert(str("tag", i));
+    n.buckets[i].push_back(str("bucket", i));
+    n.buckets[i].push_back(str("bucket", i + 1));
+  }
+  n.layers.resize(2);
+  n.layers[1][str("layer", 1)] = n.head;
+}
+
+static void check_arena(const Nested& n, TArena* arena) {
+  assert(n.label.get_allocator().arena() == arena);
+  assert(n.head.name.get_allocator().arena() == arena);
+  assert(n.leaves.get_allocator().arena() == arena);
+  assert(n.leaves[3].name.get_allocator().arena() == arena);
+  assert(n.leaves[3].blob.get_allocator().arena() == arena);
+  assert(n.attrs.get_allocator().arena() == arena);
+  assert(n.attrs.begin()->first.get_allocator().arena() == arena);
+  assert(n.attrs.begin()->second.get_allocator().arena() == arena);
+  assert(n.tags.begin()->get_allocator().arena() == arena);
+  assert(n.buckets.begin()->second.get_allocator().arena() == arena);
+  assert(n.buckets.begin()->second[1].get_allocator().arena() == arena);
+  assert(n.layers[1].get_allocator().arena() == arena);
+  assert(n.layers[1].begin()->second.name.get_allocator().arena() == arena);
+}
+
+template <class Protocol_, class Transport_>
+static void test_read(boost::shared_ptr<Transport_> transport,
+                      boost::shared_ptr<TMemoryBuffer> buffer,
+                      TArena* arena) {
+  Nested in;
+  fill(in);
+  Protocol_ prot(transport);
+  in.write(&prot);
+  transport->flush();
+  std::string bytes = buffer->getBufferAsString();
+
+  {
+    Nested out(arena);
+    out.read(&prot);
+    assert(out == in);
+    check_arena(out, arena);
+    assert(arena->getAllocated() > 0);
+
+    // Writing from the arena gives the same bytes
+    buffer->resetBuffer();
+    out.write(&prot);
+    transport->flush();
+    assert(buffer->getBufferAsString() == bytes);
+    buffer->resetBuffer();
+  }
+  arena->reset();
+  assert(arena->getAllocated() == 0);
+}
+
+class ArenaServiceHandler : public ArenaServiceIf {
+ public:
+  ArenaServiceHandler() : arena_(NULL) {}
+
+  void echo(Nested& _return, const Nested& request) {
+    assert(request.label.get_allocator().arena() == arena_);
+    check_arena(request, arena_);
+    if (request.label == "fail") {
+      ArenaError err(request.label.get_allocator().arena());
+      err.message = "failed";
+      throw err;
+    }
+    assert(_return.label.get_allocator().arena() == arena_);
+    _return = request;
+  }
+
+  void concat(TArenaString& _return, const std::vector<TArenaString,
+              TArenaAllocator<TArenaString> >& parts) {
+    assert(parts.get_allocator().arena() == arena_);
+    assert(_return.get_allocator().arena() == arena_);
+    for (size_t i = 0; i < parts.size(); ++i) {
+      _return += parts[i];
+    }
+  }
+
+  TArena* arena_;
+};
+
+int main() {
+  cout << "Allocating from an arena." << endl;
+  {
+    TArena arena(64);
+    char* a = (char*)arena.allocate(1);
+    char* b = (char*)arena.allocate(1);
+    assert(b - a == 8);
+    assert(arena.getAllocated() == 16);
+    // Larger than the block size
+    char* big = (char*)arena.allocate(1000);
+    memset(big, 'x', 1000);
+    assert(arena.getAllocated() == 1016);
+    arena.reset();
+    assert(arena.getAllocated() == 0);
+    // The first block is reused
+    assert(arena.allocate(1) == a);
+  }
+
+  cout << "Reading into an arena." << endl;
+  {
+    TArena arena;
+    boost::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    // Borrowed strings
+    test_read<TBinaryProtocol>(buffer, buffer, &arena);
+    test_read<TCompactProtocol>(buffer, buffer, &arena);
+    test_read<TBinaryProtocolT<TMemoryBuffer> >(buffer, buffer, &arena);
+    test_read<TCompactProtocolT<TMemoryBuffer> >(buffer, buffer, &arena);
+    // Strings copied through the protocol's buffer
+    boost::shared_ptr<TTransport> buffered(new TBufferedTransport(buffer, 8));
+    test_read<TBinaryProtocol>(buffered, buffer, &arena);
+    test_read<TCompactProtocol>(buffered, buffer, &arena);
+    // The default string views
+    test_read<TJSONProtocol>(buffer, buffer, &arena);
+  }
+
+  cout << "Reading without an arena." << endl;
+  {
+    Nested in;
+    fill(in);
+    boost::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TBinaryProtocol prot(buffer);
+    in.write(&prot);
+    Nested out;
+    out.read(&prot);
+    assert(out == in);
+    check_arena(out, NULL);
+  }
+
+  cout << "Processing requests with an arena." << endl;
+  {
+    TArena arena;
+    boost::shared_ptr<ArenaServiceHandler> handler(new ArenaServiceHandler);
+    handler->arena_ = &arena;
+    ArenaServiceProcessor processor(handler);
+    boost::shared_ptr<TMemoryBuffer> request(new TMemoryBuffer());
+    boost::shared_ptr<TMemoryBuffer> response(new TMemoryBuffer());
+    boost::shared_ptr<TProtocol> requestProt(new TBinaryProtocol(request));
+    boost::shared_ptr<TProtocol> responseProt(new TBinaryProtocol(response));
+    ArenaServiceClient client(responseProt, requestProt);
+
+    Nested in;
+    fill(in);
+    client.send_echo(in);
+    processor.process(requestProt, responseProt, &arena);
+    assert(arena.getAllocated() > 0);
+    Nested out;
+    client.recv_echo(out);
+    assert(out == in);
+    arena.reset();
+
+    in.label = "fail";
+    client.send_echo(in);
+    processor.process(requestProt, responseProt, &arena);
+    try {
+      client.recv_echo(out);
+      assert(false);
+    } catch (ArenaError& err) {
+      assert(err.message == "failed");
+    }
+    arena.reset();
+
+    std::vector<TArenaString, TArenaAllocator<TArenaString> > parts;
+    parts.push_back(str("a", 1));
+    parts.push_back(str("b", 2));
+    client.send_concat(parts);
+    processor.process(requestProt, responseProt, &arena);
+    TArenaString joined;
+    client.recv_concat(joined);
+    assert(joined == parts[0] + parts[1]);
+    arena.reset();
+
+    // Without an arena everything comes from the heap
+    handler->arena_ = NULL;
+    client.send_echo(in);
+    processor.process(requestProt, responseProt);
+    assert(arena.getAllocated() == 0);
+  }
+
+  cout << "Processing requests through wrapping processors." << endl;
+  {
+    TArena arena;
+    boost::shared_ptr<ArenaServiceHandler> handler(new ArenaServiceHandler);
+    handler->arena_ = &arena;
+    boost::shared_ptr<TMemoryBuffer> request(new TMemoryBuffer());
+    boost::shared_ptr<TMemoryBuffer> response(new TMemoryBuffer());
+    boost::shared_ptr<TProtocol> requestProt(new TBinaryProtocol(request));
+    boost::shared_ptr<TProtocol> responseProt(new TBinaryProtocol(response));
+    ArenaServiceClient client(responseProt, requestProt);
+
+    PeekProcessor peek;
+    peek.initialize(
+      boost::shared_ptr<TProcessor>(new ArenaServiceProcessor(handler)),
+      boost::shared_ptr<TProtocolFactory>(new TBinaryProtocolFactory()),
+      boost::shared_ptr<TPipedTransportFactory>(new TPipedTransportFactory()));
+    boost::shared_ptr<TProtocol> peekProt(
+      new TBinaryProtocol(peek.getPipedTransport(request)));
+
+    // The handler checks that the request was read into the arena
+    Nested in;
+    fill(in);
+    client.send_echo(in);
+    peek.process(peekProt, responseProt, &arena);
+    assert(arena.getAllocated() > 0);
+    Nested out;
+    client.recv_echo(out);
+    assert(out == in);
+    arena.reset();
+
+    handler->arena_ = NULL;
+    client.send_echo(in);
+    peek.process(peekProt, responseProt);
+    assert(arena.getAllocated() == 0);
+    client.recv_echo(out);
+    assert(out == in);
+
+    StatsProcessor stats(false, true);
+    std::vector<TArenaString, TArenaAllocator<TArenaString> > parts;
+    parts.push_back(str("a", 1));
+    client.send_concat(parts);
+    stats.process(requestProt, responseProt, &arena);
+    assert(stats.get_frequency_map().find("concat")->second == 1);
+  }
+
+  cout << "All tests passed." << endl;
+  return 0;
+}
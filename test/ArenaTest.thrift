@@ -0,0 +1,45 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+namespace cpp thrift.test.arena
+
+struct Leaf {
+  1: string name = "leaf";
+  2: binary blob;
+  3: i32 weight;
+}
+
+struct Nested {
+  1: string label;
+  2: list<Leaf> leaves;
+  3: map<string, string> attrs;
+  4: set<string> tags;
+  5: map<i32, list<string>> buckets;
+  6: Leaf head;
+  7: list<map<string, Leaf>> layers;
+}
+
+exception ArenaError {
+  1: string message;
+}
+
+service ArenaService {
+  Nested echo(1: Nested request) throws (1: ArenaError err);
+  string concat(1: list<string> parts);
+}
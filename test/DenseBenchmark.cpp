@@ -0,0 +1,168 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Measures TDenseProtocol writing and reading a flat struct of every type, a
+ * struct of nested containers and a struct of mostly optional small integers,
+ * compared to TBinaryProtocol and TCompactProtocol.
+ *
+ * Usage: DenseBenchmark [iterations]
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <transport/TBufferTransports.h>
+#include <protocol/TBinaryProtocol.h>
+#include <protocol/TCompactProtocol.h>
+#include <protocol/TDenseProtocol.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+#include "gen-cpp/OptionalRequiredTest_types.h"
+#include <sys/time.h>
+
+using namespace std;
+using namespace thrift::test;
+using namespace thrift::test::debug;
+using namespace apache::thrift::transport;
+using namespace apache::thrift::protocol;
+using namespace boost;
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() {
+    gettimeofday(&vStart, 0);
+  }
+  void start() {
+    gettimeofday(&vStart, 0);
+  }
+
+  double frame() {
+    timeval vEnd;
+    gettimeofday(&vEnd, 0);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+
+};
+
+// The dense protocol needs to know what it is reading and writing
+template <typename Protocol, typename Struct>
+static void setTypeSpec(Protocol& prot, const Struct& s) {
+}
+
+template <typename Struct>
+static void setTypeSpec(TDenseProtocol& prot, const Struct& s) {
+  prot.setTypeSpec(Struct::local_reflection);
+}
+
+template <typename Protocol, typename Struct>
+static void run(const char* name, const Struct& s, int num) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol prot(buf);
+  setTypeSpec(prot, s);
+
+  Timer timer;
+  for (int i = 0; i < num; i ++) {
+    buf->resetBuffer();
+    s.write(&prot);
+  }
+  double writeTime = timer.frame();
+  uint32_t size = buf->available_read();
+
+  uint8_t* data;
+  uint32_t datasize;
+  buf->getBuffer(&data, &datasize);
+  string wire((const char*)data, datasize);
+
+  timer.start();
+  for (int i = 0; i < num; i ++) {
+    buf->resetBuffer((uint8_t*)wire.data(), wire.size());
+    Struct s2;
+    s2.read(&prot);
+  }
+  double readTime = timer.frame();
+
+  cout << name << ": " << size << " bytes, write "
+       << num / (1000 * writeTime) << " kHz ("
+       << size * (double)num / writeTime / (1024 * 1024) << " MB/s), read "
+       << num / (1000 * readTime) << " kHz ("
+       << size * (double)num / readTime / (1024 * 1024) << " MB/s)" << endl;
+}
+
+template <typename Struct>
+static void runAll(const char* name, const Struct& s, int num) {
+  string prefix(name);
+  run<TBinaryProtocol>((prefix + ", binary").c_str(), s, num);
+  run<TCompactProtocol>((prefix + ", compact").c_str(), s, num);
+  run<TDenseProtocol>((prefix + ", dense").c_str(), s, num);
+}
+
+int main(int argc, char** argv) {
+  int num = argc > 1 ? atoi(argv[1]) : 100000;
+
+  OneOfEach ooe;
+  ooe.im_true   = true;
+  ooe.im_false  = false;
+  ooe.a_bite    = 0xd6;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1<<24;
+  ooe.integer64 = (uint64_t)6000 * 1000 * 1000;
+  ooe.double_precision = M_PI;
+  ooe.some_characters  = "Debug THIS!";
+  ooe.zomg_unicode     = "\xd7\n\a\t";
+
+  // Lists of structs, sets of lists and maps of lists, a few levels deep
+  HolyMoley hm;
+  for (int i = 0; i < 10; i++) {
+    hm.big.push_back(ooe);
+    hm.big.back().integer32 = i;
+    hm.big.back().double_precision = i / 3.0;
+  }
+  for (int i = 0; i < 10; i++) {
+    vector<string> strings(i, "and a one");
+    hm.contain.insert(strings);
+  }
+  for (int i = 0; i < 10; i++) {
+    vector<Bonk> bonks(i);
+    for (int j = 0; j < i; j++) {
+      bonks[j].type = j;
+      bonks[j].message = "nevermore";
+    }
+    hm.bonks[string(i, 'x')] = bonks;
+  }
+
+  // Small integers, half of them optional and unset
+  ManyOpt mo;
+  mo.opt1 = 1;
+  mo.__isset.opt1 = true;
+  mo.opt3 = 300;
+  mo.__isset.opt3 = true;
+  mo.def4 = 40000;
+  mo.opt5 = 5;
+  mo.opt6 = 6;
+
+  runAll("OneOfEach", ooe, num);
+  runAll("HolyMoley", hm, num / 10);
+  runAll("ManyOpt", mo, num);
+
+  return 0;
+}
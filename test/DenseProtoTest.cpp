@@ -17,20 +17,6 @@
  * under the License.
  */
 
-/*
-../compiler/cpp/thrift --gen cpp:dense DebugProtoTest.thrift
-../compiler/cpp/thrift --gen cpp:dense OptionalRequiredTest.thrift
-g++ -Wall -g -I../lib/cpp/src -I/usr/local/include/boost-1_33_1 \
-  gen-cpp/OptionalRequiredTest_types.cpp \
-  gen-cpp/DebugProtoTest_types.cpp \
-  DenseProtoTest.cpp ../lib/cpp/.libs/libthrift.a -o DenseProtoTest
-./DenseProtoTest
-*/
-
-// I do this to reach into the guts of TDenseProtocol.  Sorry.
-#define private public
-#define inline
-
 #undef NDEBUG
 #include <cstdlib>
 #include <cassert>
@@ -41,7 +27,16 @@ g++ -Wall -g -I../lib/cpp/src -I/usr/local/include/boost-1_33_1 \
 #include "gen-cpp/OptionalRequiredTest_types.h"
 #include <protocol/TDenseProtocol.h>
 #include <transport/TBufferTransports.h>
+#include <transport/TShortReadTransport.h>
 
+// Reaches into the guts of TDenseProtocol to test the variable-length ints.
+class VlqProtocol : public apache::thrift::protocol::TDenseProtocol {
+ public:
+  VlqProtocol(boost::shared_ptr<apache::thrift::transport::TTransport> trans)
+    : apache::thrift::protocol::TDenseProtocol(trans) {}
+  using apache::thrift::protocol::TDenseProtocol::vlqRead;
+  using apache::thrift::protocol::TDenseProtocol::vlqWrite;
+};
 
 // Can't use memcmp here.  GCC is too smart.
 bool my_memeq(const char* str1, const char* str2, int len) {
@@ -60,6 +55,7 @@ int main() {
   using std::endl;
   using boost::shared_ptr;
   using namespace thrift::test::debug;
+  using namespace thrift::test;
   using namespace apache::thrift::transport;
   using namespace apache::thrift::protocol;
 
@@ -137,7 +133,7 @@ int main() {
   //cout << apache::thrift::ThriftDebugString(hm) << endl << endl;
 
   shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
-  shared_ptr<TDenseProtocol> proto(new TDenseProtocol(buffer));
+  shared_ptr<VlqProtocol> proto(new VlqProtocol(buffer));
   proto->setTypeSpec(HolyMoley::local_reflection);
 
   hm.write(proto.get());
@@ -146,6 +142,61 @@ int main() {
 
   assert(hm == hm2);
 
+  // The wire format never changes.
+  {
+    const char expected[] =
+      // fingerprint prefix, im_true, im_false, a_bite
+      "\xdf\x7c\xe7\x83" "\x01" "\x00" "\xd6"
+      // integer16, integer32, integer64
+      "\x81\xd2\x78" "\x88\x80\x80\x00" "\x96\xad\x82\xf8\x00"
+      // double_precision
+      "\x40\x09\x21\xfb\x54\x44\x2d\x18"
+      // some_characters, zomg_unicode, what_who, base64
+      "\x0b" "Debug THIS!" "\x04\xd7\x0a\x07\x09" "\x00" "\x00"
+      // byte_list, i16_list, i64_list
+      "\x03\x01\x02\x03" "\x03\x01\x02\x03" "\x03\x01\x02\x03";
+    buffer->resetBuffer();
+    proto->setTypeSpec(OneOfEach::local_reflection);
+    ooe.write(proto.get());
+    assert(buffer->getBufferAsString() == string(expected, sizeof(expected) - 1));
+    OneOfEach ooe2;
+    ooe2.read(proto.get());
+    assert(ooe == ooe2);
+  }
+
+  // Reading a little at a time takes the slow paths.
+  {
+    buffer->resetBuffer();
+    proto->setTypeSpec(HolyMoley::local_reflection);
+    hm.write(proto.get());
+    shared_ptr<test::TShortReadTransport> short_trans(
+        new test::TShortReadTransport(buffer, 0.5));
+    shared_ptr<TBufferedTransport> small_buff(
+        new TBufferedTransport(short_trans, 8));
+    TDenseProtocol short_proto(small_buff, HolyMoley::local_reflection);
+    HolyMoley hm3;
+    hm3.read(&short_proto);
+    assert(hm == hm3);
+  }
+
+  // Writing with the wrong TypeSpec throws, and leaves the protocol usable.
+  {
+    buffer->resetBuffer();
+    proto->setTypeSpec(Bonk::local_reflection);
+    try {
+      ooe.write(proto.get());
+      assert(false);
+    } catch (TProtocolException& ex) {
+    }
+    buffer->resetBuffer();
+    proto->setTypeSpec(HolyMoley::local_reflection);
+    hm.write(proto.get());
+    HolyMoley hm4;
+    hm4.read(proto.get());
+    assert(hm == hm4);
+  }
+  proto->setTypeSpec(HolyMoley::local_reflection);
+
 
   // Let's test out the variable-length ints, shall we?
   uint64_t vlq;
@@ -188,7 +239,7 @@ int main() {
 
   // Test out the slow path with a TBufferedTransport.
   shared_ptr<TBufferedTransport> buff_trans(new TBufferedTransport(buffer, 3));
-  proto.reset(new TDenseProtocol(buff_trans));
+  proto.reset(new VlqProtocol(buff_trans));
   checkout(0x0000000100000000ull, "\x90\x80\x80\x80\x00");
   checkout(0x0000000200000000ull, "\xA0\x80\x80\x80\x00");
   checkout(0x0000000300000000ull, "\xB0\x80\x80\x80\x00");
@@ -201,7 +252,7 @@ int main() {
   checkout(0xFFFFFFFFFFFFFFFFull, "\x81\xFF\xFF\xFF\xFF\xFF\xFF\xFF\xFF\x7F");
 
   // Test optional stuff.
-  proto.reset(new TDenseProtocol(buffer));
+  proto.reset(new VlqProtocol(buffer));
   proto->setTypeSpec(ManyOpt::local_reflection);
   ManyOpt mo1, mo2, mo3, mo4, mo5, mo6;
   mo1.opt1 = 923759347;
@@ -366,10 +417,11 @@ int main() {
     buffer->resetBuffer();
     // Make sure the fingerprint prefix is right.
     buffer->write(Nesting::binary_fingerprint, 4);
+    std::string junk(1024*1024, '\0');
     for (int j = 0; j < 1024*1024; j++) {
-      uint8_t r = std::rand();
-      buffer->write(&r, 1);
+      junk[j] = std::rand();
     }
+    buffer->write((const uint8_t*)junk.data(), junk.size());
     Nesting n;
     proto->setTypeSpec(OneOfEach::local_reflection);
     try {
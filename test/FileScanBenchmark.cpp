@@ -0,0 +1,144 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Measures how fast TFileTransport and TMappedFileTransport scan a log of
+ * events.  The log is written first, so unless the page cache is dropped in
+ * between (pass an existing file to scan that instead), this measures the
+ * readers rather than the disk.
+ *
+ * Usage: FileScanBenchmark [MB to write] [event size] | FileScanBenchmark -f file
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <transport/TFileTransport.h>
+#include <transport/TMappedFileTransport.h>
+
+using namespace std;
+using namespace apache::thrift::transport;
+
+static double now() {
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+// Writes events the way TFileTransport lays them out, with the default
+// 16MB chunks
+static void writeLog(const string& path, uint64_t bytes, uint32_t eventSize) {
+  const uint64_t chunkSize = 16 * 1024 * 1024;
+  FILE* f = fopen(path.c_str(), "w");
+  if (f == NULL) {
+    perror("fopen");
+    exit(1);
+  }
+  vector<uint8_t> event(eventSize + 4, 'x');
+  memcpy(&event[0], &eventSize, 4);
+  vector<uint8_t> zeros(chunkSize, 0);
+  uint64_t offset = 0;
+  while (offset < bytes) {
+    if (offset / chunkSize != (offset + event.size() - 1) / chunkSize) {
+      uint64_t padding = chunkSize - offset % chunkSize;
+      fwrite(&zeros[0], 1, padding, f);
+      offset += padding;
+    }
+    fwrite(&event[0], 1, event.size(), f);
+    offset += event.size();
+  }
+  fclose(f);
+}
+
+static void report(const char* name, uint64_t bytes, uint64_t events, double elapsed) {
+  char line[256];
+  sprintf(line, "%-40s %10.1f MB/s %10.0f events/s",
+          name, bytes / elapsed / (1024 * 1024), events / elapsed);
+  cout << line << endl;
+}
+
+int main(int argc, char** argv) {
+  string path;
+  bool generated = false;
+  if (argc > 2 && strcmp(argv[1], "-f") == 0) {
+    path = argv[2];
+  } else {
+    uint64_t bytes = (argc > 1 ? atoi(argv[1]) : 512) * 1024ULL * 1024ULL;
+    uint32_t eventSize = argc > 2 ? atoi(argv[2]) : 1024;
+    path = "/tmp/FileScanBenchmark.log";
+    writeLog(path, bytes, eventSize);
+    generated = true;
+  }
+
+  struct stat st;
+  stat(path.c_str(), &st);
+  uint64_t size = st.st_size;
+  vector<uint8_t> buf(16 * 1024 * 1024);
+
+  {
+    TFileTransport trans(path, true);
+    uint64_t events = 0;
+    double start = now();
+    while (trans.read(&buf[0], buf.size()) > 0) {
+      events++;
+    }
+    report("TFileTransport read()", size, events, now() - start);
+  }
+
+  {
+    TMappedFileTransport trans(path);
+    uint64_t events = 0;
+    double start = now();
+    while (trans.read(&buf[0], buf.size()) > 0) {
+      events++;
+    }
+    report("TMappedFileTransport read()", size, events, now() - start);
+  }
+
+  {
+    TMappedFileTransport trans(path);
+    uint64_t events = 0;
+    uint64_t sum = 0;
+    double start = now();
+    uint32_t len = 1;
+    const uint8_t* data;
+    while ((data = trans.borrow(NULL, &len)) != NULL) {
+      // touch the event, as a reader would
+      sum += data[0] + data[len - 1];
+      trans.consume(len);
+      events++;
+      len = 1;
+    }
+    report("TMappedFileTransport borrow()", size, events, now() - start);
+    if (sum == 0) {
+      cout << "empty log" << endl;
+    }
+  }
+
+  if (generated) {
+    unlink(path.c_str());
+  }
+  return 0;
+}
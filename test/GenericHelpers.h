@@ -71,6 +71,26 @@ class GenericIO {
     return proto->writeString(val);
   }
 
+  static uint32_t writeArray(shared_ptr<TProtocol> proto, const int8_t* vals, uint32_t size) {
+    return proto->writeByteArray(vals, size);
+  }
+
+  static uint32_t writeArray(shared_ptr<TProtocol> proto, const int16_t* vals, uint32_t size) {
+    return proto->writeI16Array(vals, size);
+  }
+
+  static uint32_t writeArray(shared_ptr<TProtocol> proto, const int32_t* vals, uint32_t size) {
+    return proto->writeI32Array(vals, size);
+  }
+
+  static uint32_t writeArray(shared_ptr<TProtocol> proto, const int64_t* vals, uint32_t size) {
+    return proto->writeI64Array(vals, size);
+  }
+
+  static uint32_t writeArray(shared_ptr<TProtocol> proto, const double* vals, uint32_t size) {
+    return proto->writeDoubleArray(vals, size);
+  }
+
   /* Read functions */
 
   static uint32_t read(shared_ptr<TProtocol> proto, int8_t& val) {
@@ -97,6 +117,26 @@ class GenericIO {
     return proto->readString(val);
   }
 
+  static uint32_t readArray(shared_ptr<TProtocol> proto, int8_t* vals, uint32_t size) {
+    return proto->readByteArray(vals, size);
+  }
+
+  static uint32_t readArray(shared_ptr<TProtocol> proto, int16_t* vals, uint32_t size) {
+    return proto->readI16Array(vals, size);
+  }
+
+  static uint32_t readArray(shared_ptr<TProtocol> proto, int32_t* vals, uint32_t size) {
+    return proto->readI32Array(vals, size);
+  }
+
+  static uint32_t readArray(shared_ptr<TProtocol> proto, int64_t* vals, uint32_t size) {
+    return proto->readI64Array(vals, size);
+  }
+
+  static uint32_t readArray(shared_ptr<TProtocol> proto, double* vals, uint32_t size) {
+    return proto->readDoubleArray(vals, size);
+  }
+
 };
 
 #endif
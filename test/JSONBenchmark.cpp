@@ -0,0 +1,152 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Measures TJSONProtocol writing and reading a flat struct of every type, a
+ * struct of nested containers and one with large text and binary fields,
+ * compared to TBinaryProtocol.
+ *
+ * Usage: JSONBenchmark [iterations]
+ */
+
+#include <iostream>
+#include <cmath>
+#include <cstdlib>
+#include <transport/TBufferTransports.h>
+#include <protocol/TBinaryProtocol.h>
+#include <protocol/TJSONProtocol.h>
+#include "gen-cpp/DebugProtoTest_types.h"
+#include <sys/time.h>
+
+using namespace std;
+using namespace thrift::test::debug;
+using namespace apache::thrift::transport;
+using namespace apache::thrift::protocol;
+using namespace boost;
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() {
+    gettimeofday(&vStart, 0);
+  }
+  void start() {
+    gettimeofday(&vStart, 0);
+  }
+
+  double frame() {
+    timeval vEnd;
+    gettimeofday(&vEnd, 0);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+
+};
+
+template <typename Protocol, typename Struct>
+static void run(const char* name, const Struct& s, int num) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol prot(buf);
+
+  Timer timer;
+  for (int i = 0; i < num; i ++) {
+    buf->resetBuffer();
+    s.write(&prot);
+  }
+  double writeTime = timer.frame();
+  uint32_t size = buf->available_read();
+
+  uint8_t* data;
+  uint32_t datasize;
+  buf->getBuffer(&data, &datasize);
+  string wire((const char*)data, datasize);
+
+  timer.start();
+  for (int i = 0; i < num; i ++) {
+    buf->resetBuffer((uint8_t*)wire.data(), wire.size());
+    Struct s2;
+    s2.read(&prot);
+  }
+  double readTime = timer.frame();
+
+  cout << name << ": " << size << " bytes, write "
+       << num / (1000 * writeTime) << " kHz ("
+       << size * (double)num / writeTime / (1024 * 1024) << " MB/s), read "
+       << num / (1000 * readTime) << " kHz ("
+       << size * (double)num / readTime / (1024 * 1024) << " MB/s)" << endl;
+}
+
+int main(int argc, char** argv) {
+  int num = argc > 1 ? atoi(argv[1]) : 100000;
+
+  OneOfEach ooe;
+  ooe.im_true   = true;
+  ooe.im_false  = false;
+  ooe.a_bite    = 0xd6;
+  ooe.integer16 = 27000;
+  ooe.integer32 = 1<<24;
+  ooe.integer64 = (uint64_t)6000 * 1000 * 1000;
+  ooe.double_precision = M_PI;
+  ooe.some_characters  = "JSON THIS! \"\1";
+  ooe.zomg_unicode     = "\xd7\n\a\t";
+  ooe.base64 = "\1\2\3\255";
+
+  // Lists of structs, sets of lists and maps of lists, a few levels deep
+  HolyMoley hm;
+  for (int i = 0; i < 10; i++) {
+    hm.big.push_back(ooe);
+    hm.big.back().integer32 = i;
+    hm.big.back().double_precision = i / 3.0;
+  }
+  for (int i = 0; i < 10; i++) {
+    vector<string> strings(i, "and a one");
+    hm.contain.insert(strings);
+  }
+  for (int i = 0; i < 10; i++) {
+    vector<Bonk> bonks(i);
+    for (int j = 0; j < i; j++) {
+      bonks[j].type = j;
+      bonks[j].message = "nevermore";
+    }
+    hm.bonks[string(i, 'x')] = bonks;
+  }
+
+  // A document: mostly text with the odd character to escape, and an
+  // attachment
+  OneOfEach doc = ooe;
+  doc.some_characters.clear();
+  for (int i = 0; i < 1000; i++) {
+    doc.some_characters += "Lorem ipsum dolor sit amet, \"consectetur\"\n";
+  }
+  doc.base64.clear();
+  for (int i = 0; i < 48 * 1024; i++) {
+    doc.base64 += (char)(i * 7);
+  }
+
+  run<TBinaryProtocol>("OneOfEach, binary", ooe, num);
+  run<TJSONProtocol>("OneOfEach, JSON", ooe, num);
+  run<TBinaryProtocol>("HolyMoley, binary", hm, num / 10);
+  run<TJSONProtocol>("HolyMoley, JSON", hm, num / 10);
+  run<TBinaryProtocol>("Document, binary", doc, num / 100);
+  run<TJSONProtocol>("Document, JSON", doc, num / 100);
+
+  return 0;
+}
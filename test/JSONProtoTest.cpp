@@ -19,10 +19,68 @@
 
 #include <iostream>
 #include <cmath>
+#include <clocale>
 #include <transport/TBufferTransports.h>
+#include <transport/TShortReadTransport.h>
 #include <protocol/TJSONProtocol.h>
 #include "gen-cpp/DebugProtoTest_types.h"
 
+// Reads a double off the text of a map key, where anything can be written,
+// returning false if it is rejected
+static bool readJSONDouble(const std::string& key, double& num) {
+  using apache::thrift::transport::TMemoryBuffer;
+  using apache::thrift::protocol::TJSONProtocol;
+  using apache::thrift::protocol::TType;
+  std::string json = "[\"dbl\",\"i32\",1,{\"" + key + "\":1}]";
+  boost::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  buffer->write((const uint8_t*)json.data(), json.size());
+  TJSONProtocol proto(buffer);
+  TType keyType;
+  TType valType;
+  uint32_t size;
+  proto.readMapBegin(keyType, valType, size);
+  try {
+    proto.readDouble(num);
+  } catch (apache::thrift::protocol::TProtocolException&) {
+    return false;
+  }
+  return true;
+}
+
+// Checks that doubles are written with a '.' and read back exactly, and
+// that only decimal numbers are read
+static void testDoubles() {
+  using apache::thrift::transport::TMemoryBuffer;
+  using apache::thrift::protocol::TJSONProtocol;
+  const double values[] = { 10.0/3.0, -1.5, 1E+305, 1E-305, 0.1, 0.0 };
+  for (size_t i = 0; i < sizeof(values) / sizeof(values[0]); ++i) {
+    boost::shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+    TJSONProtocol proto(buffer);
+    proto.writeDouble(values[i]);
+    std::string json = buffer->getBufferAsString();
+    assert(json.find(',') == std::string::npos);
+    // A number at the top level needs something after it to end it
+    buffer->write((const uint8_t*)" ", 1);
+    double num;
+    proto.readDouble(num);
+    assert(num == values[i]);
+  }
+
+  double num;
+  assert(readJSONDouble("1.5", num) && num == 1.5);
+  assert(readJSONDouble("-2e3", num) && num == -2000.0);
+  assert(readJSONDouble("1E-400", num));
+  assert(!readJSONDouble("1e400", num));
+  assert(!readJSONDouble("-1e400", num));
+  assert(!readJSONDouble("0x10", num));
+  assert(!readJSONDouble("1,5", num));
+  assert(!readJSONDouble("1.5e", num));
+  assert(!readJSONDouble(".", num));
+  assert(!readJSONDouble("inf", num));
+  assert(!readJSONDouble("nan", num));
+  assert(!readJSONDouble(" 1", num));
+}
+
 int main() {
   using std::cout;
   using std::endl;
@@ -155,5 +213,96 @@ int main() {
 
   assert(base == base2);
 
+
+  cout << "Testing split buffers" << endl;
+
+  // Read through a buffer of a few bytes, refilled by short reads, so
+  // tokens are split everywhere. The reader must leave the second struct
+  // where it starts.
+  using apache::thrift::transport::TTransport;
+  using apache::thrift::transport::TBufferedTransport;
+  using apache::thrift::transport::test::TShortReadTransport;
+  boost::shared_ptr<TMemoryBuffer> wire(new TMemoryBuffer());
+  TJSONProtocol wireProto(wire);
+  hm.write(&wireProto);
+  ooe.write(&wireProto);
+  boost::shared_ptr<TTransport> shortReads(new TShortReadTransport(wire, 0.5));
+  boost::shared_ptr<TTransport> smallBuffer(new TBufferedTransport(shortReads, 8));
+  {
+    TJSONProtocol splitProto(smallBuffer);
+    HolyMoley hm3;
+    hm3.read(&splitProto);
+    assert(hm == hm3);
+  }
+  {
+    TJSONProtocol splitProto(smallBuffer);
+    OneOfEach ooe3;
+    ooe3.read(&splitProto);
+    assert(ooe == ooe3);
+  }
+
+
+  cout << "Testing doubles" << endl;
+
+  testDoubles();
+  // Whatever the C library's locale, if one with a decimal comma is around
+  const char* commaLocales[] = { "de_DE.UTF-8", "de_DE", "fr_FR.UTF-8", "fr_FR" };
+  for (size_t i = 0; i < sizeof(commaLocales) / sizeof(commaLocales[0]); ++i) {
+    if (setlocale(LC_NUMERIC, commaLocales[i]) != NULL) {
+      testDoubles();
+      setlocale(LC_NUMERIC, "C");
+      break;
+    }
+  }
+
+
+  cout << "Testing reuse after an error" << endl;
+
+  // The field's type is unknown, so the read throws part way into the
+  // struct. Reading again after the buffer is reset and refilled must
+  // start over, and not go on in the buffer borrowed before.
+  {
+    std::string bad = "{\"1\":{\"xyz\":1}}";
+    boost::shared_ptr<TMemoryBuffer> reused(new TMemoryBuffer());
+    reused->write((const uint8_t*)bad.data(), bad.size());
+    TJSONProtocol reusedProto(reused);
+    OneOfEach ooe4;
+    try {
+      ooe4.read(&reusedProto);
+      assert(false);
+    } catch (apache::thrift::protocol::TProtocolException&) {
+    }
+    reused->resetBuffer();
+    TJSONProtocol writer(reused);
+    hm.write(&writer);
+    HolyMoley hm4;
+    hm4.read(&reusedProto);
+    assert(hm == hm4);
+  }
+
+
+  cout << "Testing deep nesting" << endl;
+
+  // Deeper than the contexts kept inline in the protocol
+  apache::thrift::protocol::TType elemType;
+  uint32_t size;
+  int32_t value;
+  for (int i = 0; i < 100; i++) {
+    proto->writeListBegin(apache::thrift::protocol::T_LIST, 2);
+  }
+  for (int i = 0; i < 100; i++) {
+    proto->writeI32(i);
+    proto->writeListEnd();
+  }
+  for (int i = 0; i < 100; i++) {
+    proto->readListBegin(elemType, size);
+    assert(size == 2);
+  }
+  for (int i = 0; i < 100; i++) {
+    proto->readI32(value);
+    assert(value == i);
+    proto->readListEnd();
+  }
+
   return 0;
 }
@@ -0,0 +1,210 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Compares a new connection per call with TSocketConnectionPool, from
+ * several client threads against local TNonblockingServers.  One of the
+ * servers is slow, as a degraded host would be.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+#include <unistd.h>
+#include <sys/time.h>
+#include <concurrency/PosixThreadFactory.h>
+#include <protocol/TBinaryProtocol.h>
+#include <server/TNonblockingServer.h>
+#include <transport/TBufferTransports.h>
+#include <transport/TSocketPool.h>
+#include "gen-cpp/ThriftTest.h"
+
+using namespace std;
+using namespace boost;
+using namespace apache::thrift;
+using namespace apache::thrift::concurrency;
+using namespace apache::thrift::protocol;
+using namespace apache::thrift::server;
+using namespace apache::thrift::transport;
+using namespace thrift::test;
+
+static const int BASE_PORT = 9290;
+static const int NUM_SERVERS = 3;
+static const int NUM_THREADS = 8;
+static const int CALLS_PER_THREAD = 1000;
+
+// How long the slow server takes per call, in microseconds
+static const int SLOW_CALL_USEC = 1000;
+
+static int64_t now() {
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return (int64_t)tv.tv_sec * 1000000 + tv.tv_usec;
+}
+
+class BenchmarkHandler : public ThriftTestNull {
+ public:
+  BenchmarkHandler(int delay) : delay_(delay) {}
+
+  int32_t testI32(const int32_t thing) {
+    if (delay_ > 0) {
+      usleep(delay_);
+    }
+    return thing;
+  }
+
+ private:
+  int delay_;
+};
+
+class ServerRunner : public Runnable {
+ public:
+  ServerRunner(shared_ptr<TNonblockingServer> server) : server_(server) {}
+
+  void run() {
+    server_->serve();
+  }
+
+ private:
+  shared_ptr<TNonblockingServer> server_;
+};
+
+class Worker : public Runnable {
+ public:
+  Worker(TSocketConnectionPool* pool, int id) :
+    pool_(pool),
+    id_(id),
+    errors_(0) {}
+
+  void run() {
+    for (int i = 0; i < CALLS_PER_THREAD; i++) {
+      int64_t start = now();
+      if (pool_ != NULL) {
+        pooledCall(i);
+      } else {
+        connectedCall(i);
+      }
+      latencies_.push_back(now() - start);
+    }
+  }
+
+  // A new connection for every call, to the servers in turn
+  void connectedCall(int i) {
+    shared_ptr<TSocket> socket(new TSocket("localhost",
+                                           BASE_PORT + (id_ + i) % NUM_SERVERS));
+    shared_ptr<TTransport> transport(new TFramedTransport(socket));
+    shared_ptr<TProtocol> protocol(new TBinaryProtocol(transport));
+    ThriftTestClient client(protocol);
+    try {
+      transport->open();
+      client.testI32(i);
+      transport->close();
+    } catch (TException& ex) {
+      errors_++;
+    }
+  }
+
+  void pooledCall(int i) {
+    shared_ptr<TSocket> socket;
+    try {
+      socket = pool_->checkout();
+    } catch (TTransportException& ex) {
+      errors_++;
+      return;
+    }
+    shared_ptr<TTransport> transport(new TFramedTransport(socket));
+    shared_ptr<TProtocol> protocol(new TBinaryProtocol(transport));
+    ThriftTestClient client(protocol);
+    try {
+      client.testI32(i);
+      pool_->checkin(socket);
+    } catch (TException& ex) {
+      errors_++;
+      pool_->checkin(socket, true);
+    }
+  }
+
+  TSocketConnectionPool* pool_;
+  int id_;
+  int errors_;
+  vector<int64_t> latencies_;
+};
+
+static void runBenchmark(const char* name, TSocketConnectionPool* pool) {
+  PosixThreadFactory threadFactory(PosixThreadFactory::ROUND_ROBIN,
+                                   PosixThreadFactory::NORMAL, 1, false);
+  vector<shared_ptr<Worker> > workers;
+  vector<shared_ptr<Thread> > threads;
+  for (int i = 0; i < NUM_THREADS; i++) {
+    workers.push_back(shared_ptr<Worker>(new Worker(pool, i)));
+    threads.push_back(threadFactory.newThread(workers.back()));
+  }
+
+  int64_t start = now();
+  for (int i = 0; i < NUM_THREADS; i++) {
+    threads[i]->start();
+  }
+  for (int i = 0; i < NUM_THREADS; i++) {
+    threads[i]->join();
+  }
+  int64_t elapsed = now() - start;
+
+  vector<int64_t> latencies;
+  int errors = 0;
+  for (int i = 0; i < NUM_THREADS; i++) {
+    latencies.insert(latencies.end(),
+                     workers[i]->latencies_.begin(), workers[i]->latencies_.end());
+    errors += workers[i]->errors_;
+  }
+  sort(latencies.begin(), latencies.end());
+  size_t calls = latencies.size();
+  uint64_t connects = pool != NULL ? pool->getNumConnects() : calls;
+
+  cout << name << ": " << calls << " calls in " << elapsed / 1000 << " ms, "
+       << connects << " connects, " << errors << " errors" << endl;
+  cout << "  latency us: p50 " << latencies[calls / 2]
+       << ", p90 " << latencies[calls * 9 / 10]
+       << ", p99 " << latencies[calls * 99 / 100]
+       << ", max " << latencies[calls - 1] << endl;
+}
+
+int main() {
+  PosixThreadFactory threadFactory;
+  for (int i = 0; i < NUM_SERVERS; i++) {
+    shared_ptr<BenchmarkHandler> handler(new BenchmarkHandler(i == 0 ? SLOW_CALL_USEC : 0));
+    shared_ptr<TProcessor> processor(new ThriftTestProcessor(handler));
+    shared_ptr<TNonblockingServer> server(new TNonblockingServer(processor, BASE_PORT + i));
+    threadFactory.newThread(shared_ptr<Runnable>(new ServerRunner(server)))->start();
+  }
+  // Let the servers start listening
+  usleep(200000);
+
+  runBenchmark("connect per call", NULL);
+
+  vector<pair<string, int> > servers;
+  for (int i = 0; i < NUM_SERVERS; i++) {
+    servers.push_back(make_pair(string("localhost"), BASE_PORT + i));
+  }
+  TSocketConnectionPool pool(servers);
+  runBenchmark("connection pool", &pool);
+
+  // The servers run until the process exits
+  _exit(0);
+}
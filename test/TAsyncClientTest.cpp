@@ -0,0 +1,232 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <string>
+#include <vector>
+#include <async/TAsyncChannel.h>
+#include <async/TAsyncClient.h>
+#include <protocol/TBinaryProtocol.h>
+#include <transport/TBufferTransports.h>
+
+BOOST_AUTO_TEST_SUITE( TAsyncClientTest );
+
+using apache::thrift::async::TAsyncChannel;
+using apache::thrift::async::TAsyncClient;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+using boost::shared_ptr;
+
+/**
+ * Keeps sent messages for the test to answer, and fails when told to,
+ * either right away or on the next send, the way a socket channel does
+ * when send() gets an error.
+ */
+class MemoryChannel : public TAsyncChannel {
+ public:
+  MemoryChannel() : receiver_(NULL), failed_(false), failOnSend_(false) {}
+
+  void setReceiver(Receiver* receiver) {
+    receiver_ = receiver;
+  }
+
+  bool good() const {
+    return !failed_;
+  }
+
+  void sendMessage(const uint8_t* data, uint32_t len) {
+    if (failed_) {
+      throw TTransportException(TTransportException::NOT_OPEN, "failed");
+    }
+    sent_.push_back(std::string((const char*)data, len));
+    if (failOnSend_) {
+      fail();
+    }
+  }
+
+  /// Fail the channel during the next sendMessage().
+  void failOnSend() {
+    failOnSend_ = true;
+  }
+
+  void fail() {
+    failed_ = true;
+    receiver_->channelFailed(
+      TTransportException(TTransportException::END_OF_FILE, "closed"));
+  }
+
+  /// Answer the call with this seqid, with the i32 it carried plus one.
+  void reply(int32_t seqid) {
+    for (size_t i = 0; i < sent_.size(); ++i) {
+      shared_ptr<TMemoryBuffer> in(new TMemoryBuffer(
+        (uint8_t*)sent_[i].data(), sent_[i].size()));
+      TBinaryProtocol iprot(in);
+      std::string name;
+      TMessageType type;
+      int32_t id;
+      int32_t value;
+      iprot.readMessageBegin(name, type, id);
+      iprot.readI32(value);
+      if (id != seqid) {
+        continue;
+      }
+
+      shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+      TBinaryProtocol oprot(out);
+      oprot.writeMessageBegin(name, apache::thrift::protocol::T_REPLY, id);
+      oprot.writeI32(value + 1);
+      oprot.writeMessageEnd();
+      uint8_t* data;
+      uint32_t len;
+      out->getBuffer(&data, &len);
+      receiver_->messageReceived(data, len);
+      return;
+    }
+    BOOST_FAIL("no call to reply to");
+  }
+
+  /// The seqid of the i'th message sent.
+  int32_t seqid(size_t i) {
+    shared_ptr<TMemoryBuffer> in(new TMemoryBuffer(
+      (uint8_t*)sent_[i].data(), sent_[i].size()));
+    TBinaryProtocol iprot(in);
+    std::string name;
+    TMessageType type;
+    int32_t id;
+    iprot.readMessageBegin(name, type, id);
+    return id;
+  }
+
+  size_t numSent() const {
+    return sent_.size();
+  }
+
+ private:
+  Receiver* receiver_;
+  bool failed_;
+  bool failOnSend_;
+  std::vector<std::string> sent_;
+};
+
+/**
+ * A client like the generated ones, for a call that takes an i32 and
+ * returns one.  Records what each completion saw.
+ */
+class EchoClient : public TAsyncClient {
+ public:
+  explicit EchoClient(shared_ptr<TAsyncChannel> channel)
+    : TAsyncClient(channel,
+                   shared_ptr<TBinaryProtocolFactory>(new TBinaryProtocolFactory())) {}
+
+  void call(int32_t value) {
+    int32_t cseqid = beginCall();
+    oprot_->writeMessageBegin("echo", apache::thrift::protocol::T_CALL, cseqid);
+    oprot_->writeI32(value);
+    oprot_->writeMessageEnd();
+    endCall(cseqid, std::tr1::bind(&EchoClient::complete, this));
+  }
+
+  int32_t recv() {
+    checkResponse();
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    int32_t value;
+    iprot_->readMessageBegin(name, type, seqid);
+    iprot_->readI32(value);
+    iprot_->readMessageEnd();
+    return value;
+  }
+
+  /// What each completion got: the returned i32, or -1 for a failure
+  std::vector<int32_t> results;
+
+ private:
+  void complete() {
+    try {
+      results.push_back(recv());
+    } catch (TTransportException&) {
+      results.push_back(-1);
+    }
+  }
+};
+
+BOOST_AUTO_TEST_CASE( test_out_of_order_completion ) {
+  shared_ptr<MemoryChannel> channel(new MemoryChannel());
+  EchoClient client(channel);
+
+  client.call(10);
+  client.call(20);
+  client.call(30);
+  BOOST_CHECK_EQUAL(client.getPendingCount(), 3U);
+
+  // Each response completes the call with its seqid, whatever the order
+  channel->reply(channel->seqid(2));
+  channel->reply(channel->seqid(0));
+  BOOST_CHECK_EQUAL(client.getPendingCount(), 1U);
+  channel->reply(channel->seqid(1));
+  BOOST_CHECK_EQUAL(client.getPendingCount(), 0U);
+
+  BOOST_REQUIRE_EQUAL(client.results.size(), 3U);
+  BOOST_CHECK_EQUAL(client.results[0], 31);
+  BOOST_CHECK_EQUAL(client.results[1], 11);
+  BOOST_CHECK_EQUAL(client.results[2], 21);
+}
+
+BOOST_AUTO_TEST_CASE( test_channel_failure ) {
+  shared_ptr<MemoryChannel> channel(new MemoryChannel());
+  EchoClient client(channel);
+
+  client.call(10);
+  client.call(20);
+  channel->reply(channel->seqid(1));
+
+  // The call still outstanding completes with the failure
+  channel->fail();
+  BOOST_CHECK_EQUAL(client.getPendingCount(), 0U);
+  BOOST_REQUIRE_EQUAL(client.results.size(), 2U);
+  BOOST_CHECK_EQUAL(client.results[0], 21);
+  BOOST_CHECK_EQUAL(client.results[1], -1);
+
+  // And no more calls can be made
+  BOOST_CHECK_THROW(client.call(30), TTransportException);
+  BOOST_CHECK_EQUAL(client.getPendingCount(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE( test_channel_failure_while_sending ) {
+  shared_ptr<MemoryChannel> channel(new MemoryChannel());
+  EchoClient client(channel);
+
+  client.call(10);
+
+  // The call whose send fails the channel completes too, along with the
+  // one before it
+  channel->failOnSend();
+  client.call(20);
+  BOOST_CHECK_EQUAL(channel->numSent(), 2U);
+  BOOST_CHECK_EQUAL(client.getPendingCount(), 0U);
+  BOOST_REQUIRE_EQUAL(client.results.size(), 2U);
+  BOOST_CHECK_EQUAL(client.results[0], -1);
+  BOOST_CHECK_EQUAL(client.results[1], -1);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,121 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <cstdlib>
+#include <string>
+#include <protocol/TBase64Utils.h>
+
+BOOST_AUTO_TEST_SUITE( TBase64UtilsTest );
+
+using apache::thrift::protocol::base64_encode;
+using apache::thrift::protocol::base64_decode;
+using apache::thrift::protocol::base64_encode_block;
+using apache::thrift::protocol::base64_decode_block;
+
+// base64_encode() on each 3 bytes, then the rest
+static std::string encodeSlowly(const std::string& in) {
+  std::string out;
+  uint8_t b[4];
+  const uint8_t* bytes = (const uint8_t*)in.data();
+  uint32_t len = in.size();
+  while (len > 0) {
+    uint32_t n = len < 3 ? len : 3;
+    base64_encode(bytes, n, b);
+    out.append((const char*)b, n + 1);
+    bytes += n;
+    len -= n;
+  }
+  return out;
+}
+
+// base64_decode() on each 4 characters, then the rest if more than one
+static std::string decodeSlowly(std::string in) {
+  std::string out;
+  uint8_t* b = (uint8_t*)&in[0];
+  uint32_t len = in.size();
+  while (len > 1) {
+    uint32_t n = len < 4 ? len : 4;
+    base64_decode(b, n);
+    out.append((const char*)b, n - 1);
+    b += n;
+    len -= n;
+  }
+  return out;
+}
+
+static std::string encode(const std::string& in) {
+  std::string out((in.size() * 4 + 2) / 3, '\0');
+  uint32_t len = base64_encode_block((const uint8_t*)in.data(), in.size(),
+                                     (uint8_t*)&out[0]);
+  BOOST_CHECK_EQUAL(len, out.size());
+  return out;
+}
+
+static std::string decode(std::string in) {
+  if (!in.empty()) {
+    in.resize(base64_decode_block((uint8_t*)&in[0], in.size()));
+  }
+  return in;
+}
+
+static std::string randomBytes(uint32_t len) {
+  std::string bytes;
+  for (uint32_t i = 0; i < len; i++) {
+    bytes += (char)rand();
+  }
+  return bytes;
+}
+
+BOOST_AUTO_TEST_CASE( test_encode_block ) {
+  srand(1);
+  // Every remainder, and lengths around the vector sizes
+  for (uint32_t len = 0; len < 200; len++) {
+    std::string in = randomBytes(len);
+    std::string out = encode(in);
+    BOOST_CHECK_EQUAL(out, encodeSlowly(in));
+    BOOST_CHECK_EQUAL(decode(out), in);
+  }
+  BOOST_CHECK_EQUAL(encode("Man is distinguished"), "TWFuIGlzIGRpc3Rpbmd1aXNoZWQ");
+}
+
+BOOST_AUTO_TEST_CASE( test_decode_block ) {
+  srand(2);
+  for (uint32_t len = 0; len < 200; len++) {
+    std::string in = encode(randomBytes(len));
+    BOOST_CHECK_EQUAL(decode(in), decodeSlowly(in));
+  }
+  BOOST_CHECK_EQUAL(decode("TWFuIGlzIGRpc3Rpbmd1aXNoZWQ"), "Man is distinguished");
+}
+
+BOOST_AUTO_TEST_CASE( test_decode_invalid ) {
+  // Anything at all decodes to the same bytes as it always has
+  srand(3);
+  for (uint32_t len = 0; len < 200; len++) {
+    std::string in = encode(randomBytes(len));
+    if (!in.empty()) {
+      in[rand() % in.size()] = (char)rand();
+    }
+    BOOST_CHECK(decode(in) == decodeSlowly(in));
+    std::string garbage = randomBytes(len);
+    BOOST_CHECK(decode(garbage) == decodeSlowly(garbage));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -18,6 +18,7 @@
  */
 
 #include <algorithm>
+#include <cstring>
 #include <boost/test/auto_unit_test.hpp>
 #include <transport/TBufferTransports.h>
 #include <transport/TShortReadTransport.h>
@@ -522,6 +523,72 @@ BOOST_AUTO_TEST_CASE( test_FramedTransport_Write ) {
   }
 }
 
+BOOST_AUTO_TEST_CASE( test_FramedTransport_Gather_Write ) {
+  init_data();
+
+  int sizes[] = {
+    12, 512, 1<<14,
+  };
+
+  uint32_t thresholds[] = {
+    1, 64, 100, 1000,
+  };
+
+  for (int i = 0; i < sizeof (sizes) / sizeof (sizes[0]); i++) {
+    int size = sizes[i];
+    for (int t = 0; t < sizeof (thresholds) / sizeof (thresholds[0]); t++) {
+      for (int d1 = 0; d1 < 3; d1++) {
+        shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(16));
+        TFramedTransport trans(buffer, size);
+        trans.setGatherWriteThreshold(thresholds[t]);
+        BOOST_CHECK(trans.getGatherWriteThreshold() >=
+                    TFramedTransport::MIN_GATHER_WRITE_THRESHOLD);
+
+        int offset = 0;
+        int index = 0;
+        while (offset < 1<<15) {
+          trans.writeBorrowed(&data[offset], dist[d1][index]);
+          offset += dist[d1][index];
+          index++;
+        }
+        trans.flush();
+
+        int32_t frame_size = -1;
+        buffer->read(reinterpret_cast<uint8_t*>(&frame_size), sizeof(frame_size));
+        frame_size = (int32_t)ntohl((uint32_t)frame_size);
+        BOOST_CHECK_EQUAL(frame_size, 1<<15);
+        string output = buffer->getBufferAsString();
+        BOOST_CHECK_EQUAL(data_str, output);
+      }
+    }
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_FramedTransport_Gather_Write_Copies ) {
+  init_data();
+
+  // Plain write() copies even when gathering is on, so the caller may reuse
+  // its buffer straight away.
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer(16));
+  TFramedTransport trans(buffer);
+  trans.setGatherWriteThreshold(64);
+
+  uint8_t chunk[1<<10];
+  for (int offset = 0; offset < 1<<15; offset += sizeof(chunk)) {
+    memcpy(chunk, &data[offset], sizeof(chunk));
+    trans.write(chunk, sizeof(chunk));
+    memset(chunk, 0, sizeof(chunk));
+  }
+  trans.flush();
+
+  int32_t frame_size = -1;
+  buffer->read(reinterpret_cast<uint8_t*>(&frame_size), sizeof(frame_size));
+  frame_size = (int32_t)ntohl((uint32_t)frame_size);
+  BOOST_CHECK_EQUAL(frame_size, 1<<15);
+  string output = buffer->getBufferAsString();
+  BOOST_CHECK_EQUAL(data_str, output);
+}
+
 BOOST_AUTO_TEST_CASE( test_FramedTransport_Read ) {
   init_data();
 
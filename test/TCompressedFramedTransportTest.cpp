@@ -0,0 +1,195 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <cassert>
+#include <cstdlib>
+#include <cstring>
+#include <arpa/inet.h>
+#include <string>
+#include <vector>
+#include <transport/TCompressedFramedTransport.h>
+#include <protocol/TBinaryProtocol.h>
+#include "gen-cpp/ThriftTest_types.h"
+
+BOOST_AUTO_TEST_SUITE( TCompressedFramedTransportTest );
+
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TFrameCodec;
+using apache::thrift::transport::TLZFrameCodec;
+using apache::thrift::transport::TCompressedFramedTransport;
+using boost::shared_ptr;
+
+// Text-like data that compresses, followed by random bytes that don't.
+static std::vector<uint8_t> testData(uint32_t compressible, uint32_t random) {
+  const char* words[] = { "thrift ", "frame ", "codec ", "buffer ", "\n" };
+  std::vector<uint8_t> data;
+  std::srand(compressible + random);
+  while (data.size() < compressible) {
+    const char* word = words[std::rand() % 5];
+    data.insert(data.end(), word, word + strlen(word));
+  }
+  data.resize(compressible);
+  for (uint32_t i = 0; i < random; i++) {
+    data.push_back((uint8_t)std::rand());
+  }
+  return data;
+}
+
+BOOST_AUTO_TEST_CASE( test_lz_codec ) {
+  TLZFrameCodec codec;
+  uint32_t sizes[][2] = { {0, 0}, {0, 3}, {1, 0}, {100, 0}, {70000, 0},
+                          {0, 5000}, {20000, 20000}, {300000, 10} };
+
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    std::vector<uint8_t> data = testData(sizes[i][0], sizes[i][1]);
+    uint32_t len = data.size();
+    std::vector<uint8_t> compressed(codec.maxCompressedSize(len));
+    uint32_t csz = codec.compress(len ? &data[0] : NULL, len, &compressed[0]);
+    assert(csz <= compressed.size());
+    if (sizes[i][1] == 0 && len > 1000) {
+      assert(csz < len / 2);
+    }
+
+    std::vector<uint8_t> mirror(len + 1);
+    codec.decompress(&compressed[0], csz, &mirror[0], len);
+    mirror.resize(len);
+    assert(mirror == data);
+
+    // Truncated or mislabelled input is rejected, not overrun.
+    if (len > 0) {
+      try {
+        codec.decompress(&compressed[0], csz - 1, &mirror[0], len);
+        assert(false);
+      } catch (TTransportException& ex) {
+        assert(ex.getType() == TTransportException::CORRUPTED_DATA);
+      }
+      try {
+        codec.decompress(&compressed[0], csz, &mirror[0], len - 1);
+        assert(false);
+      } catch (TTransportException& ex) {
+        assert(ex.getType() == TTransportException::CORRUPTED_DATA);
+      }
+    }
+  }
+
+  // Overlapping matches: runs of one byte compress to a few bytes.
+  std::vector<uint8_t> run(10000, 'x');
+  std::vector<uint8_t> compressed(codec.maxCompressedSize(run.size()));
+  uint32_t csz = codec.compress(&run[0], run.size(), &compressed[0]);
+  assert(csz < 100);
+  std::vector<uint8_t> mirror(run.size());
+  codec.decompress(&compressed[0], csz, &mirror[0], mirror.size());
+  assert(mirror == run);
+}
+
+BOOST_AUTO_TEST_CASE( test_roundtrip ) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  TCompressedFramedTransport trans(buffer);
+
+  // A small frame goes out as it is, a large one compressed, and one that
+  // doesn't shrink uncompressed again.
+  std::vector<uint8_t> small = testData(100, 0);
+  std::vector<uint8_t> large = testData(100000, 0);
+  std::vector<uint8_t> noise = testData(0, 5000);
+  uint32_t before = buffer->available_read();
+
+  trans.write(&small[0], small.size());
+  trans.flush();
+  assert(buffer->available_read() - before ==
+         TCompressedFramedTransport::HEADER_SIZE + small.size());
+  before = buffer->available_read();
+
+  trans.write(&large[0], large.size() / 2);
+  trans.write(&large[large.size() / 2], large.size() - large.size() / 2);
+  trans.flush();
+  assert(buffer->available_read() - before < large.size() / 2);
+  before = buffer->available_read();
+
+  trans.write(&noise[0], noise.size());
+  trans.flush();
+  assert(buffer->available_read() - before ==
+         TCompressedFramedTransport::HEADER_SIZE + noise.size());
+
+  std::vector<uint8_t> mirror(small.size());
+  trans.readAll(&mirror[0], mirror.size());
+  assert(mirror == small);
+  assert(trans.getLastReadCodecId() == TFrameCodec::NONE);
+  mirror.resize(large.size());
+  trans.readAll(&mirror[0], mirror.size());
+  assert(mirror == large);
+  assert(trans.getLastReadCodecId() == TFrameCodec::LZ);
+  mirror.resize(noise.size());
+  trans.readAll(&mirror[0], mirror.size());
+  assert(mirror == noise);
+  assert(buffer->available_read() == 0);
+}
+
+BOOST_AUTO_TEST_CASE( test_unframed ) {
+  using apache::thrift::protocol::TBinaryProtocol;
+
+  // As inside TNonblockingServer: the underlying buffer is one frame's
+  // payload, without the frame size.
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  shared_ptr<TCompressedFramedTransport> trans(new TCompressedFramedTransport(buffer));
+  trans->setFramed(false);
+  TBinaryProtocol prot(trans);
+
+  thrift::test::Xtruct a;
+  a.i32_thing = 10;
+  a.i64_thing = 30;
+  a.string_thing = std::string(5000, 'a');
+  a.write(&prot);
+  trans->flush();
+
+  // The same payload inside a frame reads back through a framed transport.
+  std::string payload = buffer->getBufferAsString();
+  uint32_t sz = htonl(payload.size());
+  shared_ptr<TMemoryBuffer> framed(new TMemoryBuffer());
+  framed->write((uint8_t*)&sz, sizeof(sz));
+  framed->write((const uint8_t*)payload.data(), payload.size());
+  shared_ptr<TCompressedFramedTransport> reader(new TCompressedFramedTransport(framed));
+  TBinaryProtocol rprot(reader);
+
+  thrift::test::Xtruct a2;
+  a2.read(&rprot);
+  assert(a == a2);
+  assert(reader->getLastReadCodecId() == TFrameCodec::LZ);
+
+  thrift::test::Xtruct a3;
+  a3.read(&prot);
+  assert(a == a3);
+}
+
+BOOST_AUTO_TEST_CASE( test_unknown_codec ) {
+  shared_ptr<TMemoryBuffer> buffer(new TMemoryBuffer());
+  uint8_t frame[] = { 0, 0, 0, 6, 42, 0, 0, 0, 1, 0 };
+  buffer->write(frame, sizeof(frame));
+  TCompressedFramedTransport trans(buffer);
+  uint8_t b;
+  try {
+    trans.read(&b, 1);
+    assert(false);
+  } catch (TTransportException& ex) {
+    assert(ex.getType() == TTransportException::CORRUPTED_DATA);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,249 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <transport/TFileTransport.h>
+#include <transport/TMappedFileTransport.h>
+
+BOOST_AUTO_TEST_SUITE( TMappedFileTransportTest );
+
+using apache::thrift::transport::TFileTransport;
+using apache::thrift::transport::TFileReaderTransport;
+using apache::thrift::transport::TMappedFileTransport;
+using apache::thrift::transport::TTransportException;
+
+static const uint32_t CHUNK_SIZE = 256;
+
+// Lays events out the way TFileTransport's writer thread does: a host order
+// size, then the event, with zeros up to the next chunk when it won't fit.
+class LogWriter {
+ public:
+  LogWriter() {
+    char path[] = "/tmp/TMappedFileTransportTest.XXXXXX";
+    int fd = mkstemp(path);
+    assert(fd >= 0);
+    close(fd);
+    path_ = path;
+  }
+
+  ~LogWriter() {
+    unlink(path_.c_str());
+  }
+
+  void add(const std::string& event) {
+    uint32_t size = event.size();
+    if (data_.size() / CHUNK_SIZE != (data_.size() + size + 3) / CHUNK_SIZE) {
+      data_.resize((data_.size() / CHUNK_SIZE + 1) * CHUNK_SIZE, 0);
+    }
+    const char* sizeBytes = (const char*)&size;
+    data_.insert(data_.end(), sizeBytes, sizeBytes + 4);
+    data_.insert(data_.end(), event.begin(), event.end());
+  }
+
+  // Overwrites a size field, as a disk error might
+  void corrupt(size_t offset, uint32_t size) {
+    memcpy(&data_[offset], &size, 4);
+  }
+
+  size_t size() {
+    return data_.size();
+  }
+
+  const std::string& save() {
+    FILE* f = fopen(path_.c_str(), "w");
+    assert(f != NULL);
+    fwrite(&data_[0], 1, data_.size(), f);
+    fclose(f);
+    return path_;
+  }
+
+ private:
+  std::string path_;
+  std::vector<char> data_;
+};
+
+static std::string event(int i) {
+  char buf[32];
+  sprintf(buf, "event %d ", i);
+  // vary the sizes so events end up in every position in a chunk
+  return std::string(buf) + std::string(i % 37, 'a' + i % 26);
+}
+
+// Reads events until the end of the file
+static std::vector<std::string> readEvents(TFileReaderTransport& trans) {
+  std::vector<std::string> events;
+  uint8_t buf[CHUNK_SIZE];
+  uint32_t got;
+  // read() never goes past the end of an event
+  while ((got = trans.read(buf, sizeof(buf))) > 0) {
+    events.push_back(std::string((char*)buf, got));
+  }
+  return events;
+}
+
+BOOST_AUTO_TEST_CASE( test_read ) {
+  LogWriter writer;
+  for (int i = 0; i < 200; i++) {
+    writer.add(event(i));
+  }
+  std::string path = writer.save();
+
+  TMappedFileTransport mapped(path);
+  mapped.setChunkSize(CHUNK_SIZE);
+  assert(mapped.getNumChunks() == writer.size() / CHUNK_SIZE + 1);
+  std::vector<std::string> events = readEvents(mapped);
+  assert(events.size() == 200);
+  for (int i = 0; i < 200; i++) {
+    assert(events[i] == event(i));
+  }
+
+  // Same as TFileTransport
+  TFileTransport file(path, true);
+  file.setChunkSize(CHUNK_SIZE);
+  assert(readEvents(file) == events);
+
+  // At the end, readAll() throws
+  uint8_t byte;
+  try {
+    mapped.readAll(&byte, 1);
+    assert(false);
+  } catch (TTransportException& ex) {
+    assert(ex.getType() == TTransportException::END_OF_FILE);
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_borrow ) {
+  LogWriter writer;
+  for (int i = 0; i < 50; i++) {
+    writer.add(event(i));
+  }
+  TMappedFileTransport mapped(writer.save());
+  mapped.setChunkSize(CHUNK_SIZE);
+
+  for (int i = 0; i < 50; i++) {
+    std::string expected = event(i);
+    uint32_t len = 4;
+    const uint8_t* data = mapped.borrow(NULL, &len);
+    assert(data != NULL);
+    // the rest of the event, and no more
+    assert(len == expected.size());
+    assert(std::string((const char*)data, len) == expected);
+    mapped.consume(4);
+    len = 4;
+    data = mapped.borrow(NULL, &len);
+    assert(len == expected.size() - 4);
+    mapped.consume(len);
+  }
+  uint32_t len = 1;
+  assert(mapped.borrow(NULL, &len) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE( test_seek ) {
+  LogWriter writer;
+  for (int i = 0; i < 200; i++) {
+    writer.add(event(i));
+  }
+  std::string path = writer.save();
+
+  TMappedFileTransport mapped(path);
+  mapped.setChunkSize(CHUNK_SIZE);
+  TFileTransport file(path, true);
+  file.setChunkSize(CHUNK_SIZE);
+
+  int32_t chunks[] = { 3, 0, -2, 7 };
+  for (size_t i = 0; i < sizeof(chunks) / sizeof(chunks[0]); i++) {
+    mapped.seekToChunk(chunks[i]);
+    file.seekToChunk(chunks[i]);
+    assert(readEvents(mapped) == readEvents(file));
+  }
+
+  // Seeking to the end leaves nothing to read
+  mapped.seekToEnd();
+  assert(readEvents(mapped).empty());
+}
+
+BOOST_AUTO_TEST_CASE( test_corrupted ) {
+  LogWriter writer;
+  std::vector<size_t> offsets;
+  for (int i = 0; i < 100; i++) {
+    writer.add(event(i));
+    offsets.push_back(writer.size() - event(i).size() - 4);
+  }
+  // Too big for a chunk, and crossing into the next one
+  writer.corrupt(offsets[20], CHUNK_SIZE + 1);
+  writer.corrupt(offsets[60], CHUNK_SIZE - 2);
+  std::string path = writer.save();
+
+  TMappedFileTransport mapped(path);
+  mapped.setChunkSize(CHUNK_SIZE);
+  std::vector<std::string> events = readEvents(mapped);
+
+  // The rest of each bad chunk is skipped
+  std::vector<std::string> expected;
+  for (int i = 0; i < 100; i++) {
+    bool skipped = false;
+    for (int bad = 20; bad <= 60; bad += 40) {
+      if (offsets[i] / CHUNK_SIZE == offsets[bad] / CHUNK_SIZE && i >= bad) {
+        skipped = true;
+      }
+    }
+    if (!skipped) {
+      expected.push_back(event(i));
+    }
+  }
+  assert(expected.size() < 98);
+  assert(events == expected);
+
+  // Seeking back to the bad chunk skips it again
+  mapped.seekToChunk(offsets[20] / CHUNK_SIZE);
+  events = readEvents(mapped);
+  assert(std::find(events.begin(), events.end(), event(20)) == events.end());
+  assert(events.back() == event(99));
+}
+
+BOOST_AUTO_TEST_CASE( test_tail ) {
+  LogWriter writer;
+  for (int i = 0; i < 10; i++) {
+    writer.add(event(i));
+  }
+  std::string path = writer.save();
+
+  TMappedFileTransport mapped(path);
+  mapped.setChunkSize(CHUNK_SIZE);
+  assert(readEvents(mapped).size() == 10);
+
+  // Events appended later are picked up
+  for (int i = 10; i < 30; i++) {
+    writer.add(event(i));
+  }
+  writer.save();
+  std::vector<std::string> events = readEvents(mapped);
+  assert(events.size() == 20);
+  assert(events[0] == event(10));
+}
+
+BOOST_AUTO_TEST_SUITE_END();
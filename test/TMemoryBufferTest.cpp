@@ -104,4 +104,73 @@ BOOST_AUTO_TEST_CASE( test_exceptions )
     }
   }
 
+BOOST_AUTO_TEST_CASE( test_borrow_read_string )
+  {
+    using apache::thrift::transport::TMemoryBuffer;
+    using apache::thrift::protocol::TBinaryProtocol;
+    using boost::shared_ptr;
+    using std::string;
+
+    shared_ptr<TMemoryBuffer> out(new TMemoryBuffer());
+    TBinaryProtocol oprot(out);
+    string big(70000, 'x');
+    oprot.writeString("abc");
+    oprot.writeString(big);
+    oprot.writeString("");
+
+    uint8_t* data;
+    uint32_t size;
+    out->getBuffer(&data, &size);
+
+    // Strings are read straight out of the observed buffer.
+    shared_ptr<TMemoryBuffer> in(new TMemoryBuffer(data, size));
+    TBinaryProtocol iprot(in);
+    string str1, str2, str3 = "junk";
+    iprot.readString(str1);
+    iprot.readString(str2);
+    iprot.readString(str3);
+
+    assert(str1 == "abc");
+    assert(str2 == big);
+    assert(str3.empty());
+    assert(in->available_read() == 0);
+  }
+
+BOOST_AUTO_TEST_CASE( test_borrow_and_consume )
+  {
+    using apache::thrift::transport::TMemoryBuffer;
+    using apache::thrift::transport::TTransport;
+    using apache::thrift::protocol::TBinaryProtocol;
+    using boost::shared_ptr;
+
+    uint8_t data[] = {1, 2, 3, 4, 5};
+    TMemoryBuffer buf(data, sizeof(data));
+
+    const uint8_t* b = buf.borrowAndConsume(4);
+    assert(b == data);
+    assert(buf.available_read() == 1);
+    // Not enough buffered, so nothing is consumed.
+    assert(buf.borrowAndConsume(2) == NULL);
+    assert(buf.available_read() == 1);
+    assert(*buf.borrowAndConsume(1) == 5);
+
+    // Fixed-width values are read the same way through the base class.
+    shared_ptr<TMemoryBuffer> trans(new TMemoryBuffer());
+    TBinaryProtocol oprot(trans);
+    oprot.writeI32(0x12345678);
+    oprot.writeI64(-1);
+    oprot.writeDouble(1.5);
+    TBinaryProtocol iprot(boost::static_pointer_cast<TTransport>(trans));
+    int32_t i32;
+    int64_t i64;
+    double dub;
+    iprot.readI32(i32);
+    iprot.readI64(i64);
+    iprot.readDouble(dub);
+    assert(i32 == 0x12345678);
+    assert(i64 == -1);
+    assert(dub == 1.5);
+    assert(trans->available_read() == 0);
+  }
+
 BOOST_AUTO_TEST_SUITE_END();
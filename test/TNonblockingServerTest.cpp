@@ -0,0 +1,588 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <TProcessor.h>
+#include <async/TAsyncClient.h>
+#include <async/TEventClientChannel.h>
+#include <concurrency/Monitor.h>
+#include <concurrency/Mutex.h>
+#include <concurrency/PosixThreadFactory.h>
+#include <concurrency/ThreadManager.h>
+#include <concurrency/Util.h>
+#include <protocol/TBinaryProtocol.h>
+#include <server/TNonblockingServer.h>
+#include <transport/TBufferTransports.h>
+#include <transport/TSocket.h>
+
+BOOST_AUTO_TEST_SUITE( TNonblockingServerTest );
+
+using apache::thrift::TProcessor;
+using apache::thrift::async::TAsyncClient;
+using apache::thrift::async::TEventClientChannel;
+using apache::thrift::concurrency::Guard;
+using apache::thrift::concurrency::Monitor;
+using apache::thrift::concurrency::Mutex;
+using apache::thrift::concurrency::PosixThreadFactory;
+using apache::thrift::concurrency::Synchronized;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::concurrency::Util;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::server::TNonblockingServer;
+using apache::thrift::server::TServerEventHandler;
+using apache::thrift::transport::TBufferedTransportFactory;
+using apache::thrift::transport::TFramedTransport;
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TTransportException;
+using apache::thrift::transport::TTransportFactory;
+using boost::shared_ptr;
+
+static const int PORT = 19891;
+
+/**
+ * Answers calls carrying a single i32, a delay in milliseconds, by sleeping
+ * that long and sending the i32 back.  Keeps track of how many calls it had
+ * running at once.
+ */
+class DelayProcessor : public TProcessor {
+ public:
+  DelayProcessor() : active_(0), maxActive_(0) {}
+
+  bool process(shared_ptr<TProtocol> in, shared_ptr<TProtocol> out) {
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    int32_t delay;
+    in->readMessageBegin(name, type, seqid);
+    in->readI32(delay);
+    in->readMessageEnd();
+    in->getTransport()->readEnd();
+
+    {
+      Guard g(mutex_);
+      if (++active_ > maxActive_) {
+        maxActive_ = active_;
+      }
+    }
+    usleep(delay * 1000);
+    {
+      Guard g(mutex_);
+      --active_;
+    }
+
+    out->writeMessageBegin(name, apache::thrift::protocol::T_REPLY, seqid);
+    out->writeI32(delay);
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+    return true;
+  }
+
+  /// The most calls that were running at the same time
+  int maxActive() {
+    Guard g(mutex_);
+    return maxActive_;
+  }
+
+ private:
+  Mutex mutex_;
+  int active_;
+  int maxActive_;
+};
+
+/// Runs a server on a thread of its own, from listening until stopped.
+class ServerThread : public TServerEventHandler {
+ public:
+  explicit ServerThread(shared_ptr<TNonblockingServer> server)
+    : server_(server), serving_(false) {
+    server_->setServerEventHandler(
+      shared_ptr<TServerEventHandler>(this, NoDelete()));
+    thread_ = PosixThreadFactory(PosixThreadFactory::ROUND_ROBIN,
+                                 PosixThreadFactory::NORMAL,
+                                 1, false).newThread(server_);
+  }
+
+  /// Start serving, and wait until the server listens.
+  void start() {
+    thread_->start();
+    Synchronized s(monitor_);
+    while (!serving_) {
+      monitor_.wait();
+    }
+  }
+
+  /// Wait for serve() to return.
+  void join() {
+    thread_->join();
+  }
+
+  void preServe() {
+    Synchronized s(monitor_);
+    serving_ = true;
+    monitor_.notifyAll();
+  }
+
+ private:
+  struct NoDelete {
+    void operator()(TServerEventHandler*) {}
+  };
+
+  shared_ptr<TNonblockingServer> server_;
+  shared_ptr<Thread> thread_;
+  Monitor monitor_;
+  bool serving_;
+};
+
+/// A framed binary client that talks to DelayProcessor.
+class Client {
+ public:
+  Client()
+    : socket_(new TSocket("localhost", PORT)),
+      transport_(new TFramedTransport(socket_)),
+      protocol_(transport_) {
+    socket_->open();
+  }
+
+  void send(int32_t seqid, int32_t delay) {
+    protocol_.writeMessageBegin("delay", apache::thrift::protocol::T_CALL, seqid);
+    protocol_.writeI32(delay);
+    protocol_.writeMessageEnd();
+    transport_->flush();
+  }
+
+  /// Read the next response and return its seqid.
+  int32_t receive(int32_t* delay = NULL) {
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    int32_t value;
+    protocol_.readMessageBegin(name, type, seqid);
+    protocol_.readI32(value);
+    protocol_.readMessageEnd();
+    transport_->readEnd();
+    if (delay != NULL) {
+      *delay = value;
+    }
+    return seqid;
+  }
+
+  void close() {
+    socket_->close();
+  }
+
+ private:
+  shared_ptr<TSocket> socket_;
+  shared_ptr<TFramedTransport> transport_;
+  TBinaryProtocol protocol_;
+};
+
+/**
+ * An asynchronous client for DelayProcessor on a TEventClientChannel, like
+ * the generated ones.  Records what each completion saw.
+ */
+class AsyncClient : public TAsyncClient {
+ public:
+  explicit AsyncClient(shared_ptr<TEventClientChannel> channel)
+    : TAsyncClient(channel,
+                   shared_ptr<TBinaryProtocolFactory>(new TBinaryProtocolFactory())) {}
+
+  void call(int32_t delay) {
+    int32_t cseqid = beginCall();
+    oprot_->writeMessageBegin("delay", apache::thrift::protocol::T_CALL, cseqid);
+    oprot_->writeI32(delay);
+    oprot_->writeMessageEnd();
+    endCall(cseqid, std::tr1::bind(&AsyncClient::complete, this));
+  }
+
+  /// A call without its argument, which makes the server drop the client
+  void callBroken() {
+    int32_t cseqid = beginCall();
+    oprot_->writeMessageBegin("delay", apache::thrift::protocol::T_CALL, cseqid);
+    oprot_->writeMessageEnd();
+    endCall(cseqid, std::tr1::bind(&AsyncClient::complete, this));
+  }
+
+  /// What each completion got: the delay sent back, or -1 for a failure
+  std::vector<int32_t> results;
+
+ private:
+  void complete() {
+    try {
+      checkResponse();
+      std::string name;
+      TMessageType type;
+      int32_t seqid;
+      int32_t delay;
+      iprot_->readMessageBegin(name, type, seqid);
+      iprot_->readI32(delay);
+      iprot_->readMessageEnd();
+      results.push_back(delay);
+    } catch (TTransportException&) {
+      results.push_back(-1);
+    }
+  }
+};
+
+/// Run base until the client has this many results, for up to 5 seconds.
+static void runUntil(event_base* base, AsyncClient& client, size_t count) {
+  int64_t end = Util::currentTime() + 5000;
+  while (client.results.size() < count && Util::currentTime() < end) {
+    event_base_loop(base, EVLOOP_ONCE | EVLOOP_NONBLOCK);
+    usleep(1000);
+  }
+}
+
+static shared_ptr<TNonblockingServer> makeServer(
+    shared_ptr<DelayProcessor> processor = shared_ptr<DelayProcessor>(new DelayProcessor()),
+    shared_ptr<ThreadManager> threadManager = shared_ptr<ThreadManager>()) {
+  return shared_ptr<TNonblockingServer>(
+    new TNonblockingServer(processor,
+                           shared_ptr<TBinaryProtocolFactory>(new TBinaryProtocolFactory()),
+                           PORT,
+                           threadManager));
+}
+
+static shared_ptr<ThreadManager> makeThreadManager(size_t workers) {
+  shared_ptr<ThreadManager> threadManager =
+    ThreadManager::newSimpleThreadManager(workers);
+  threadManager->threadFactory(
+    shared_ptr<PosixThreadFactory>(new PosixThreadFactory()));
+  threadManager->start();
+  return threadManager;
+}
+
+BOOST_AUTO_TEST_CASE( test_stop_joins_io_threads ) {
+  shared_ptr<TNonblockingServer> server = makeServer();
+  server->setNumIOThreads(4);
+  ServerThread thread(server);
+  thread.start();
+
+  // Enough connections to give every IO thread some
+  std::vector<shared_ptr<Client> > clients;
+  for (int i = 0; i < 8; ++i) {
+    clients.push_back(shared_ptr<Client>(new Client()));
+    clients.back()->send(i, 0);
+  }
+  for (int i = 0; i < 8; ++i) {
+    BOOST_CHECK_EQUAL(clients[i]->receive(), i);
+  }
+  for (size_t i = 0; i < server->getNumIOThreads(); ++i) {
+    BOOST_CHECK_EQUAL(server->getIOThread(i)->getNumConnections(), 2U);
+  }
+
+  // serve() only returns once every IO thread has finished
+  server->stop();
+  thread.join();
+}
+
+BOOST_AUTO_TEST_CASE( test_stop_before_serve ) {
+  shared_ptr<TNonblockingServer> server = makeServer();
+  server->setNumIOThreads(3);
+  server->stop();
+
+  // Every IO thread stops as soon as it runs
+  ServerThread thread(server);
+  thread.start();
+  thread.join();
+}
+
+BOOST_AUTO_TEST_CASE( test_bypass_input_transport_factory ) {
+  shared_ptr<TBinaryProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+  shared_ptr<TNonblockingServer> server(
+    new TNonblockingServer(shared_ptr<TProcessor>(new DelayProcessor()),
+                           shared_ptr<TTransportFactory>(new TBufferedTransportFactory()),
+                           shared_ptr<TTransportFactory>(new TTransportFactory()),
+                           protocolFactory,
+                           protocolFactory,
+                           PORT));
+  BOOST_CHECK(!server->getBypassInputTransportFactory());
+  server->setBypassInputTransportFactory(true);
+  ServerThread thread(server);
+  thread.start();
+
+  Client client;
+  for (int32_t i = 0; i < 3; ++i) {
+    int32_t delay = -1;
+    client.send(i, i);
+    BOOST_CHECK_EQUAL(client.receive(&delay), i);
+    BOOST_CHECK_EQUAL(delay, i);
+  }
+
+  server->stop();
+  thread.join();
+}
+
+BOOST_AUTO_TEST_CASE( test_requests_in_flight_default_in_order ) {
+  shared_ptr<ThreadManager> threadManager = makeThreadManager(4);
+  shared_ptr<TNonblockingServer> server =
+    makeServer(shared_ptr<DelayProcessor>(new DelayProcessor()), threadManager);
+  BOOST_CHECK_EQUAL(server->getMaxRequestsInFlight(), 1U);
+  ServerThread thread(server);
+  thread.start();
+
+  // One request at a time, so the fast call waits for the slow one
+  Client client;
+  client.send(1, 200);
+  client.send(2, 0);
+  BOOST_CHECK_EQUAL(client.receive(), 1);
+  BOOST_CHECK_EQUAL(client.receive(), 2);
+
+  server->stop();
+  thread.join();
+  threadManager->stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_requests_in_flight_slow_does_not_block_fast ) {
+  shared_ptr<ThreadManager> threadManager = makeThreadManager(4);
+  shared_ptr<TNonblockingServer> server =
+    makeServer(shared_ptr<DelayProcessor>(new DelayProcessor()), threadManager);
+  server->setMaxRequestsInFlight(4);
+  ServerThread thread(server);
+  thread.start();
+
+  Client client;
+  int64_t start = Util::currentTime();
+  client.send(1, 1000);
+  client.send(2, 0);
+  int32_t delay = -1;
+  BOOST_CHECK_EQUAL(client.receive(&delay), 2);
+  BOOST_CHECK_EQUAL(delay, 0);
+  BOOST_CHECK_LT(Util::currentTime() - start, 500);
+  BOOST_CHECK_EQUAL(client.receive(&delay), 1);
+  BOOST_CHECK_EQUAL(delay, 1000);
+
+  server->stop();
+  thread.join();
+  threadManager->stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_requests_in_flight_completion_order ) {
+  shared_ptr<ThreadManager> threadManager = makeThreadManager(4);
+  shared_ptr<TNonblockingServer> server =
+    makeServer(shared_ptr<DelayProcessor>(new DelayProcessor()), threadManager);
+  server->setMaxRequestsInFlight(4);
+  ServerThread thread(server);
+  thread.start();
+
+  // Responses come back as the calls finish, each with its own seqid
+  Client client;
+  client.send(10, 300);
+  client.send(11, 100);
+  client.send(12, 200);
+  int32_t delay = -1;
+  BOOST_CHECK_EQUAL(client.receive(&delay), 11);
+  BOOST_CHECK_EQUAL(delay, 100);
+  BOOST_CHECK_EQUAL(client.receive(&delay), 12);
+  BOOST_CHECK_EQUAL(delay, 200);
+  BOOST_CHECK_EQUAL(client.receive(&delay), 10);
+  BOOST_CHECK_EQUAL(delay, 300);
+
+  // The connection goes on as usual afterwards
+  client.send(13, 0);
+  BOOST_CHECK_EQUAL(client.receive(&delay), 13);
+
+  server->stop();
+  thread.join();
+  threadManager->stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_requests_in_flight_limit_pauses_reads ) {
+  for (int limit = 2; limit <= 3; ++limit) {
+    shared_ptr<ThreadManager> threadManager = makeThreadManager(4);
+    shared_ptr<DelayProcessor> processor(new DelayProcessor());
+    shared_ptr<TNonblockingServer> server = makeServer(processor, threadManager);
+    server->setMaxRequestsInFlight(limit);
+    ServerThread thread(server);
+    thread.start();
+
+    // There are workers to spare, so only the limit keeps more of these
+    // from being read and run at once
+    Client client;
+    for (int32_t i = 0; i < 6; ++i) {
+      client.send(i, 100);
+    }
+    std::vector<bool> seen(6, false);
+    for (int32_t i = 0; i < 6; ++i) {
+      int32_t seqid = client.receive();
+      BOOST_REQUIRE(seqid >= 0 && seqid < 6);
+      BOOST_CHECK(!seen[seqid]);
+      seen[seqid] = true;
+    }
+    BOOST_CHECK_EQUAL(processor->maxActive(), limit);
+
+    server->stop();
+    thread.join();
+    threadManager->stop();
+  }
+}
+
+BOOST_AUTO_TEST_CASE( test_requests_in_flight_close ) {
+  shared_ptr<ThreadManager> threadManager = makeThreadManager(4);
+  shared_ptr<TNonblockingServer> server =
+    makeServer(shared_ptr<DelayProcessor>(new DelayProcessor()), threadManager);
+  server->setMaxRequestsInFlight(4);
+  ServerThread thread(server);
+  thread.start();
+
+  for (int round = 0; round < 3; ++round) {
+    // Hang up while the calls are still on the workers
+    {
+      Client client;
+      client.send(1, 300);
+      client.send(2, 200);
+      client.send(3, 0);
+      usleep(100 * 1000);
+      client.close();
+    }
+
+    // The connection is only recycled once the last call is back
+    usleep(50 * 1000);
+    BOOST_CHECK_EQUAL(server->getIOThread(0)->getNumConnections(), 1U);
+    BOOST_CHECK_EQUAL(server->getNumIdleConnections(), 0U);
+    usleep(400 * 1000);
+    BOOST_CHECK_EQUAL(server->getIOThread(0)->getNumConnections(), 0U);
+    BOOST_CHECK_EQUAL(server->getNumIdleConnections(), 1U);
+
+    // The next client gets the recycled connection
+    Client client;
+    client.send(4, 50);
+    client.send(5, 0);
+    BOOST_CHECK_EQUAL(client.receive(), 5);
+    BOOST_CHECK_EQUAL(client.receive(), 4);
+    client.close();
+    usleep(50 * 1000);
+  }
+
+  server->stop();
+  thread.join();
+  threadManager->stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_requests_in_flight_close_deletes ) {
+  shared_ptr<ThreadManager> threadManager = makeThreadManager(4);
+  shared_ptr<TNonblockingServer> server =
+    makeServer(shared_ptr<DelayProcessor>(new DelayProcessor()), threadManager);
+  server->setMaxRequestsInFlight(8);
+  server->setConnectionStackLimit(1);
+  ServerThread thread(server);
+  thread.start();
+
+  for (int round = 0; round < 10; ++round) {
+    // Fill the connection pool, so the next connection returned is deleted
+    Client idle;
+    Client client;
+    idle.close();
+    usleep(20 * 1000);
+
+    // Calls that finish together are collected together; the connection
+    // must be gone only once nothing is left to tell it about them
+    for (int32_t i = 0; i < 4; ++i) {
+      client.send(i, 50);
+    }
+    usleep(10 * 1000);
+    client.close();
+    usleep(150 * 1000);
+    BOOST_CHECK_EQUAL(server->getIOThread(0)->getNumConnections(), 0U);
+    BOOST_CHECK_EQUAL(server->getNumIdleConnections(), 1U);
+  }
+
+  // The server still answers
+  Client client;
+  client.send(1, 0);
+  BOOST_CHECK_EQUAL(client.receive(), 1);
+
+  server->stop();
+  thread.join();
+  threadManager->stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_async_client_out_of_order ) {
+  shared_ptr<ThreadManager> threadManager = makeThreadManager(4);
+  shared_ptr<TNonblockingServer> server =
+    makeServer(shared_ptr<DelayProcessor>(new DelayProcessor()), threadManager);
+  server->setMaxRequestsInFlight(4);
+  ServerThread thread(server);
+  thread.start();
+
+  event_base* base = event_base_new();
+  {
+    shared_ptr<TSocket> socket(new TSocket("localhost", PORT));
+    socket->open();
+    shared_ptr<TEventClientChannel> channel(new TEventClientChannel(socket, base));
+    AsyncClient client(channel);
+
+    // Calls complete as their responses arrive, not in the order made
+    client.call(300);
+    client.call(100);
+    client.call(0);
+    BOOST_CHECK_EQUAL(client.getPendingCount(), 3U);
+    runUntil(base, client, 3);
+    BOOST_CHECK_EQUAL(client.getPendingCount(), 0U);
+    BOOST_REQUIRE_EQUAL(client.results.size(), 3U);
+    BOOST_CHECK_EQUAL(client.results[0], 0);
+    BOOST_CHECK_EQUAL(client.results[1], 100);
+    BOOST_CHECK_EQUAL(client.results[2], 300);
+  }
+  event_base_free(base);
+
+  server->stop();
+  thread.join();
+  threadManager->stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_async_client_channel_failure ) {
+  shared_ptr<TNonblockingServer> server = makeServer();
+  ServerThread thread(server);
+  thread.start();
+
+  event_base* base = event_base_new();
+  {
+    shared_ptr<TSocket> socket(new TSocket("localhost", PORT));
+    socket->open();
+    shared_ptr<TEventClientChannel> channel(new TEventClientChannel(socket, base));
+    AsyncClient client(channel);
+
+    // The server answers the first call, then closes the connection on
+    // the second, which fails it and the call made after it
+    client.call(0);
+    client.callBroken();
+    client.call(0);
+    runUntil(base, client, 3);
+    BOOST_CHECK_EQUAL(client.getPendingCount(), 0U);
+    BOOST_REQUIRE_EQUAL(client.results.size(), 3U);
+    BOOST_CHECK_EQUAL(client.results[0], 0);
+    BOOST_CHECK_EQUAL(client.results[1], -1);
+    BOOST_CHECK_EQUAL(client.results[2], -1);
+    BOOST_CHECK(!channel->good());
+    BOOST_CHECK_THROW(client.call(0), TTransportException);
+  }
+  event_base_free(base);
+
+  server->stop();
+  thread.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END();
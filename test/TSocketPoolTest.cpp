@@ -0,0 +1,169 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <cassert>
+#include <unistd.h>
+#include <vector>
+#include <transport/TSocketPool.h>
+#include <transport/TServerSocket.h>
+
+BOOST_AUTO_TEST_SUITE( TSocketPoolTest );
+
+using apache::thrift::transport::TSocket;
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TSocketPoolServer;
+using apache::thrift::transport::TSocketConnectionPool;
+using apache::thrift::transport::TTransportException;
+using boost::shared_ptr;
+
+// Listening is enough for connects to succeed; nothing needs to accept.
+static const int GOOD_PORT = 19871;
+static const int DEAD_PORT = 19872;
+
+BOOST_AUTO_TEST_CASE( test_reuse ) {
+  TServerSocket server(GOOD_PORT);
+  server.listen();
+
+  TSocketConnectionPool pool;
+  pool.addServer("localhost", GOOD_PORT);
+
+  shared_ptr<TSocket> a = pool.checkout();
+  assert(a->isOpen());
+  pool.checkin(a);
+  shared_ptr<TSocket> b = pool.checkout();
+  assert(b == a);
+  assert(pool.getNumConnects() == 1);
+
+  // Sockets out at the same time are different connections
+  shared_ptr<TSocket> c = pool.checkout();
+  assert(c != b);
+  assert(pool.getNumConnects() == 2);
+  pool.checkin(b);
+  pool.checkin(c);
+
+  // A failed call doesn't put its socket back
+  shared_ptr<TSocket> d = pool.checkout();
+  pool.checkin(d, true);
+  assert(!d->isOpen());
+  shared_ptr<TSocket> e = pool.checkout();
+  assert(e != d);
+  pool.checkin(e);
+
+  // Neither do connections that have been idle too long
+  pool.setMaxIdleTime(0);
+  usleep(2000);
+  shared_ptr<TSocket> f = pool.checkout();
+  assert(f != e);
+  pool.checkin(f);
+
+  server.close();
+}
+
+BOOST_AUTO_TEST_CASE( test_ejection ) {
+  TServerSocket server(GOOD_PORT);
+  server.listen();
+
+  TSocketConnectionPool pool;
+  pool.addServer("localhost", DEAD_PORT);
+  pool.addServer("localhost", GOOD_PORT);
+  pool.setMaxConsecutiveFailures(1);
+  pool.setRetryInterval(50);
+  pool.setMaxRetryInterval(150);
+
+  std::vector<shared_ptr<TSocketPoolServer> > servers;
+  pool.getServers(servers);
+  shared_ptr<TSocketPoolServer> dead = servers[0];
+
+  // The dead server is tried and ejected, and the call goes to the other
+  for (int i = 0; i < 10; i++) {
+    shared_ptr<TSocket> socket = pool.checkout();
+    assert(socket->getPort() == GOOD_PORT);
+    pool.checkin(socket);
+  }
+  assert(dead->ejectedUntil_ != 0);
+  assert(dead->retryBackoff_ == 50);
+
+  // Each failed probe doubles the backoff, up to the limit
+  usleep(60000);
+  pool.checkin(pool.checkout());
+  assert(dead->retryBackoff_ == 100);
+  usleep(110000);
+  pool.checkin(pool.checkout());
+  assert(dead->retryBackoff_ == 150);
+
+  // A successful probe brings the server back
+  TServerSocket revived(DEAD_PORT);
+  revived.listen();
+  usleep(160000);
+  shared_ptr<TSocket> probe = pool.checkout();
+  assert(probe->getPort() == DEAD_PORT);
+  assert(dead->probing_);
+  pool.checkin(probe);
+  assert(dead->ejectedUntil_ == 0);
+  assert(dead->retryBackoff_ == 0);
+
+  revived.close();
+  server.close();
+}
+
+BOOST_AUTO_TEST_CASE( test_least_loaded ) {
+  TServerSocket server1(GOOD_PORT);
+  server1.listen();
+  TServerSocket server2(DEAD_PORT);
+  server2.listen();
+
+  TSocketConnectionPool pool;
+  pool.addServer("localhost", GOOD_PORT);
+  pool.addServer("localhost", DEAD_PORT);
+
+  // Sockets held at once spread over both servers
+  shared_ptr<TSocket> a = pool.checkout();
+  shared_ptr<TSocket> b = pool.checkout();
+  assert(a->getPort() != b->getPort());
+
+  // The server with the slower calls gets fewer of them
+  pool.checkin(b);
+  usleep(20000);
+  pool.checkin(a);
+  int slowPort = a->getPort();
+  int slow = 0;
+  for (int i = 0; i < 10; i++) {
+    shared_ptr<TSocket> socket = pool.checkout();
+    if (socket->getPort() == slowPort) {
+      slow++;
+    }
+    pool.checkin(socket);
+  }
+  assert(slow == 0);
+
+  // All servers down
+  server1.close();
+  server2.close();
+  try {
+    for (int i = 0; i < 10; i++) {
+      pool.checkout();
+    }
+    assert(false);
+  } catch (TTransportException& ex) {
+    assert(ex.getType() == TTransportException::NOT_OPEN);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END();
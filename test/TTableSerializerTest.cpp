@@ -0,0 +1,235 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <string>
+#include <transport/TBufferTransports.h>
+#include <protocol/TBinaryProtocol.h>
+#include <protocol/TCompactProtocol.h>
+#include <protocol/TDebugProtocol.h>
+#include <protocol/TDenseProtocol.h>
+#include <protocol/TJSONProtocol.h>
+#include "gen-cpp/TableTest_types.h"
+
+BOOST_AUTO_TEST_SUITE( TTableSerializerTest );
+
+using namespace thrift::test::table;
+using apache::thrift::transport::TMemoryBuffer;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::protocol::TProtocolException;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TCompactProtocol;
+using apache::thrift::protocol::TDenseProtocol;
+using apache::thrift::protocol::TJSONProtocol;
+using boost::shared_ptr;
+
+static GeneratedInner makeInner(int32_t id, const std::string& name) {
+  GeneratedInner inner;
+  inner.id = id;
+  inner.name = name;
+  return inner;
+}
+
+static GeneratedEverything makeEverything() {
+  GeneratedEverything ge;
+  ge.req_i32 = 25;
+  ge.req_string = "required";
+  ge.a_bool = true;
+  ge.a_byte = -2;
+  ge.an_i16 = 30000;
+  ge.an_i32 = -(1 << 20);
+  ge.an_i64 = (int64_t)6000 * 1000 * 1000;
+  ge.a_double = 3.25;
+  ge.a_string = "a string";
+  ge.a_binary = std::string("\0\1\2\377", 4);
+  ge.a_color = BLUE;
+  ge.an_inner = makeInner(1, "one");
+  ge.bool_list.push_back(true);
+  ge.bool_list.push_back(false);
+  ge.bool_list.push_back(true);
+  for (int i = 0; i < 20; i++) {
+    ge.i32_list.push_back(i * 1000);
+    ge.double_list.push_back(i / 4.0);
+    ge.i64_set.insert((int64_t)i << 40);
+  }
+  ge.binary_list.push_back(std::string("\377\376", 2));
+  ge.binary_list.push_back("");
+  ge.color_list.push_back(RED);
+  ge.color_list.push_back(GREEN);
+  ge.inner_list.push_back(makeInner(2, "two"));
+  ge.inner_list.push_back(makeInner(3, "three"));
+  ge.string_set.insert("x");
+  ge.string_set.insert("y");
+  ge.names[1] = "uno";
+  ge.names[2] = "dos";
+  ge.groups["odd"] = ge.inner_list;
+  ge.groups["none"];
+  std::map<Color, std::set<int16_t> > nested;
+  nested[RED].insert(1);
+  nested[RED].insert(2);
+  nested[BLUE];
+  ge.nested.push_back(nested);
+  ge.nested.push_back(std::map<Color, std::set<int16_t> >());
+  ge.opt_i32 = 22;
+  ge.__isset.opt_i32 = true;
+  ge.opt_string = "optional";
+  ge.__isset.opt_string = true;
+  ge.opt_inner = makeInner(24, "twenty-four");
+  ge.__isset.opt_inner = true;
+  return ge;
+}
+
+template <class Struct>
+static std::string serialize(TProtocol* prot, const Struct& s) {
+  TMemoryBuffer* buf = static_cast<TMemoryBuffer*>(prot->getTransport().get());
+  buf->resetBuffer();
+  s.write(prot);
+  return buf->getBufferAsString();
+}
+
+template <class Struct>
+static void deserialize(TProtocol* prot, const std::string& bytes, Struct& s) {
+  TMemoryBuffer* buf = static_cast<TMemoryBuffer*>(prot->getTransport().get());
+  buf->resetBuffer((uint8_t*)bytes.data(), bytes.size(), TMemoryBuffer::COPY);
+  s.read(prot);
+  BOOST_CHECK_EQUAL(buf->available_read(), 0U);
+}
+
+// The table-driven Everything reads what the generated code writes, and
+// writes exactly the same bytes back
+static void checkTwins(TProtocol* generated, TProtocol* table,
+                       const GeneratedEverything& ge) {
+  std::string bytes = serialize(generated, ge);
+  Everything e;
+  deserialize(table, bytes, e);
+  BOOST_CHECK(serialize(table, e) == bytes);
+
+  GeneratedEverything ge2;
+  deserialize(generated, serialize(table, e), ge2);
+  BOOST_CHECK(ge2 == ge);
+}
+
+template <class Protocol>
+static void checkTwins(const GeneratedEverything& ge) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol prot(buf);
+  checkTwins(&prot, &prot, ge);
+}
+
+BOOST_AUTO_TEST_CASE( test_binary ) {
+  checkTwins<TBinaryProtocol>(makeEverything());
+}
+
+BOOST_AUTO_TEST_CASE( test_compact ) {
+  checkTwins<TCompactProtocol>(makeEverything());
+}
+
+BOOST_AUTO_TEST_CASE( test_json ) {
+  checkTwins<TJSONProtocol>(makeEverything());
+}
+
+BOOST_AUTO_TEST_CASE( test_dense ) {
+  // The twins have the same fingerprint, but each its own TypeSpec
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TDenseProtocol generated(buf, GeneratedEverything::local_reflection);
+  TDenseProtocol table(buf, Everything::local_reflection);
+  checkTwins(&generated, &table, makeEverything());
+}
+
+BOOST_AUTO_TEST_CASE( test_debug_string ) {
+  // Names come from the table too
+  GeneratedEverything ge = makeEverything();
+  Everything e;
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  deserialize(&prot, serialize(&prot, ge), e);
+
+  std::string expected = apache::thrift::ThriftDebugString(ge);
+  std::string::size_type pos;
+  while ((pos = expected.find("Generated")) != std::string::npos) {
+    expected.erase(pos, 9);
+  }
+  BOOST_CHECK_EQUAL(apache::thrift::ThriftDebugString(e), expected);
+}
+
+BOOST_AUTO_TEST_CASE( test_defaults ) {
+  // Unset optional fields are left out, empty containers are not
+  GeneratedEverything ge;
+  checkTwins<TBinaryProtocol>(ge);
+  checkTwins<TCompactProtocol>(ge);
+
+  Everything e;
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  deserialize(&prot, serialize(&prot, ge), e);
+  BOOST_CHECK(!e.__isset.opt_i32);
+  BOOST_CHECK(!e.__isset.opt_string);
+  BOOST_CHECK(!e.__isset.opt_inner);
+  BOOST_CHECK(e.__isset.a_string);
+  BOOST_CHECK(e.__isset.i32_list);
+}
+
+BOOST_AUTO_TEST_CASE( test_skip ) {
+  // Inner's tags 1 and 2 are a bool and a byte in Everything, and the rest
+  // are unknown, so it all gets skipped
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TCompactProtocol prot(buf);
+  Inner inner;
+  inner.id = 7;
+  deserialize(&prot, serialize(&prot, makeEverything()), inner);
+  BOOST_CHECK_EQUAL(inner.id, 7);
+  BOOST_CHECK(!inner.__isset.id);
+  BOOST_CHECK(!inner.__isset.name);
+}
+
+BOOST_AUTO_TEST_CASE( test_out_of_order ) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  prot.writeStructBegin("Inner");
+  prot.writeFieldBegin("name", apache::thrift::protocol::T_STRING, 2);
+  prot.writeString("two");
+  prot.writeFieldEnd();
+  prot.writeFieldBegin("unknown", apache::thrift::protocol::T_I32, 3);
+  prot.writeI32(3);
+  prot.writeFieldEnd();
+  prot.writeFieldBegin("id", apache::thrift::protocol::T_I32, 1);
+  prot.writeI32(1);
+  prot.writeFieldEnd();
+  prot.writeFieldStop();
+  prot.writeStructEnd();
+
+  Inner inner;
+  inner.read(&prot);
+  BOOST_CHECK_EQUAL(inner.id, 1);
+  BOOST_CHECK_EQUAL(inner.name, "two");
+  BOOST_CHECK(inner.__isset.id);
+  BOOST_CHECK(inner.__isset.name);
+}
+
+BOOST_AUTO_TEST_CASE( test_missing_required ) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  std::string bytes = serialize(&prot, Empty());
+  Everything e;
+  BOOST_CHECK_THROW(deserialize(&prot, bytes, e), TProtocolException);
+  GeneratedEverything ge;
+  BOOST_CHECK_THROW(deserialize(&prot, bytes, ge), TProtocolException);
+}
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,389 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+#include <boost/test/auto_unit_test.hpp>
+#include <unistd.h>
+#include <string>
+#include <vector>
+#include <TProcessor.h>
+#include <concurrency/Monitor.h>
+#include <concurrency/PosixThreadFactory.h>
+#include <concurrency/ThreadManager.h>
+#include <protocol/TBinaryProtocol.h>
+#include <server/TThreadPoolServer.h>
+#include <transport/TBufferTransports.h>
+#include <transport/TServerSocket.h>
+#include <transport/TShardedServerSocket.h>
+#include <transport/TSocket.h>
+
+BOOST_AUTO_TEST_SUITE( TThreadPoolServerTest );
+
+using apache::thrift::TProcessor;
+using apache::thrift::concurrency::Monitor;
+using apache::thrift::concurrency::PosixThreadFactory;
+using apache::thrift::concurrency::Synchronized;
+using apache::thrift::concurrency::Thread;
+using apache::thrift::concurrency::ThreadManager;
+using apache::thrift::concurrency::TimedOutException;
+using apache::thrift::protocol::TBinaryProtocol;
+using apache::thrift::protocol::TBinaryProtocolFactory;
+using apache::thrift::protocol::TMessageType;
+using apache::thrift::protocol::TProtocol;
+using apache::thrift::server::TServerEventHandler;
+using apache::thrift::server::TThreadPoolServer;
+using apache::thrift::transport::TBufferedTransport;
+using apache::thrift::transport::TBufferedTransportFactory;
+using apache::thrift::transport::TServerSocket;
+using apache::thrift::transport::TServerTransport;
+using apache::thrift::transport::TShardedServerSocket;
+using apache::thrift::transport::TSocket;
+using boost::shared_ptr;
+
+static const int PORT = 19892;
+static const size_t WORKERS = 2;
+
+/**
+ * Answers calls carrying a single i32, a delay in milliseconds, by sleeping
+ * that long and sending the i32 back.
+ */
+class DelayProcessor : public TProcessor {
+ public:
+  bool process(shared_ptr<TProtocol> in, shared_ptr<TProtocol> out) {
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    int32_t delay;
+    in->readMessageBegin(name, type, seqid);
+    in->readI32(delay);
+    in->readMessageEnd();
+    in->getTransport()->readEnd();
+
+    usleep(delay * 1000);
+
+    out->writeMessageBegin(name, apache::thrift::protocol::T_REPLY, seqid);
+    out->writeI32(delay);
+    out->writeMessageEnd();
+    out->getTransport()->writeEnd();
+    out->getTransport()->flush();
+    return true;
+  }
+};
+
+/**
+ * Counts a server's clients.  Shared with the server, so it outlives any
+ * callback the server makes.
+ */
+class ClientCounter : public TServerEventHandler {
+ public:
+  ClientCounter() : serving_(false), clients_(0) {}
+
+  /// Wait until the server listens.
+  void waitForServe() {
+    Synchronized s(monitor_);
+    while (!serving_) {
+      monitor_.wait();
+    }
+  }
+
+  /// Wait, for up to a second, until the server has this many clients.
+  int waitForClients(int count) {
+    Synchronized s(monitor_);
+    for (int i = 0; i < 10 && clients_ != count; ++i) {
+      try {
+        monitor_.wait(100);
+      } catch (TimedOutException&) {
+      }
+    }
+    return clients_;
+  }
+
+  int clients() {
+    Synchronized s(monitor_);
+    return clients_;
+  }
+
+  void preServe() {
+    Synchronized s(monitor_);
+    serving_ = true;
+    monitor_.notifyAll();
+  }
+
+  void clientBegin(shared_ptr<TProtocol>, shared_ptr<TProtocol>) {
+    Synchronized s(monitor_);
+    ++clients_;
+    monitor_.notifyAll();
+  }
+
+  void clientEnd(shared_ptr<TProtocol>, shared_ptr<TProtocol>) {
+    Synchronized s(monitor_);
+    --clients_;
+    monitor_.notifyAll();
+  }
+
+ private:
+  Monitor monitor_;
+  bool serving_;
+  int clients_;
+};
+
+/// Runs a server on a thread of its own, and counts its clients.
+class ServerThread {
+ public:
+  explicit ServerThread(shared_ptr<TThreadPoolServer> server)
+    : server_(server), counter_(new ClientCounter()) {
+    server_->setServerEventHandler(counter_);
+    thread_ = PosixThreadFactory(PosixThreadFactory::ROUND_ROBIN,
+                                 PosixThreadFactory::NORMAL,
+                                 1, false).newThread(server_);
+  }
+
+  /// Start serving, and wait until the server listens.
+  void start() {
+    thread_->start();
+    counter_->waitForServe();
+  }
+
+  /// Stop the server and wait for serve() to return.
+  void stop() {
+    server_->stop();
+    thread_->join();
+  }
+
+  int waitForClients(int count) {
+    return counter_->waitForClients(count);
+  }
+
+  int clients() {
+    return counter_->clients();
+  }
+
+ private:
+  shared_ptr<TThreadPoolServer> server_;
+  shared_ptr<ClientCounter> counter_;
+  shared_ptr<Thread> thread_;
+};
+
+/**
+ * A buffered binary client that talks to DelayProcessor.  Receives time out
+ * rather than hang if the server never gets to a request.
+ */
+class Client {
+ public:
+  Client()
+    : socket_(new TSocket("localhost", PORT)),
+      transport_(new TBufferedTransport(socket_)),
+      protocol_(transport_) {
+    socket_->setRecvTimeout(5000);
+    socket_->open();
+  }
+
+  /// Queue a call; it goes out on the next flush().
+  void write(int32_t seqid, int32_t delay) {
+    protocol_.writeMessageBegin("delay", apache::thrift::protocol::T_CALL, seqid);
+    protocol_.writeI32(delay);
+    protocol_.writeMessageEnd();
+  }
+
+  void flush() {
+    transport_->flush();
+  }
+
+  void send(int32_t seqid, int32_t delay) {
+    write(seqid, delay);
+    flush();
+  }
+
+  /// Read the next response and return its seqid.
+  int32_t receive() {
+    std::string name;
+    TMessageType type;
+    int32_t seqid;
+    int32_t value;
+    protocol_.readMessageBegin(name, type, seqid);
+    protocol_.readI32(value);
+    protocol_.readMessageEnd();
+    transport_->readEnd();
+    return seqid;
+  }
+
+  void close() {
+    socket_->close();
+  }
+
+ private:
+  shared_ptr<TSocket> socket_;
+  shared_ptr<TBufferedTransport> transport_;
+  TBinaryProtocol protocol_;
+};
+
+static shared_ptr<TThreadPoolServer> makeServer(
+    shared_ptr<TServerTransport> serverTransport =
+      shared_ptr<TServerTransport>(new TServerSocket(PORT))) {
+  shared_ptr<ThreadManager> threadManager =
+    ThreadManager::newSimpleThreadManager(WORKERS);
+  threadManager->threadFactory(
+    shared_ptr<PosixThreadFactory>(new PosixThreadFactory()));
+  threadManager->start();
+
+  shared_ptr<TBinaryProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+  shared_ptr<TThreadPoolServer> server(
+    new TThreadPoolServer(shared_ptr<TProcessor>(new DelayProcessor()),
+                          serverTransport,
+                          shared_ptr<TBufferedTransportFactory>(new TBufferedTransportFactory()),
+                          protocolFactory,
+                          threadManager));
+  return server;
+}
+
+BOOST_AUTO_TEST_CASE( test_per_request_setting ) {
+  shared_ptr<TThreadPoolServer> server = makeServer();
+  BOOST_CHECK(!server->getPerRequest());
+  server->setPerRequest(true);
+  BOOST_CHECK(server->getPerRequest());
+}
+
+BOOST_AUTO_TEST_CASE( test_sharded_fewer_accept_threads_than_shards ) {
+  // One accept thread, the default, for four shards
+  shared_ptr<TThreadPoolServer> server =
+    makeServer(shared_ptr<TServerTransport>(new TShardedServerSocket(PORT, 4)));
+  ServerThread thread(server);
+  thread.start();
+
+  // The kernel spreads the clients over all the shards, and each of them
+  // must be accepted
+  for (int i = 0; i < 16; ++i) {
+    Client client;
+    client.send(i, 0);
+    BOOST_CHECK_EQUAL(client.receive(), i);
+    client.close();
+  }
+
+  thread.stop();
+}
+
+#ifdef HAVE_SYS_EPOLL_H
+
+BOOST_AUTO_TEST_CASE( test_per_request_more_clients_than_workers ) {
+  shared_ptr<TThreadPoolServer> server = makeServer();
+  server->setPerRequest(true);
+  ServerThread thread(server);
+  thread.start();
+
+  // With a task per connection the first WORKERS clients would hold every
+  // worker, and the rest would never be answered.
+  const int numClients = WORKERS * 4;
+  std::vector<shared_ptr<Client> > clients;
+  for (int i = 0; i < numClients; ++i) {
+    clients.push_back(shared_ptr<Client>(new Client()));
+  }
+  BOOST_CHECK_EQUAL(thread.waitForClients(numClients), numClients);
+
+  // Answer the newest clients first, while the oldest still stay connected
+  for (int i = numClients - 1; i >= 0; --i) {
+    clients[i]->send(i, 0);
+    BOOST_CHECK_EQUAL(clients[i]->receive(), i);
+  }
+
+  // Every client goes idle, then sends again, all at the same time
+  usleep(200 * 1000);
+  for (int round = 0; round < 3; ++round) {
+    for (int i = 0; i < numClients; ++i) {
+      clients[i]->send(round * numClients + i, 1);
+    }
+    for (int i = 0; i < numClients; ++i) {
+      BOOST_CHECK_EQUAL(clients[i]->receive(), round * numClients + i);
+    }
+    usleep(50 * 1000);
+  }
+
+  thread.stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_per_request_read_ahead ) {
+  shared_ptr<TThreadPoolServer> server = makeServer();
+  server->setPerRequest(true);
+  ServerThread thread(server);
+  thread.start();
+
+  // Calls that arrive together are read ahead into the server's buffer,
+  // where epoll can't see them; they must still all be answered.
+  Client client;
+  for (int32_t i = 0; i < 5; ++i) {
+    client.write(i, 0);
+  }
+  client.flush();
+  for (int32_t i = 0; i < 5; ++i) {
+    BOOST_CHECK_EQUAL(client.receive(), i);
+  }
+
+  thread.stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_per_request_client_close ) {
+  shared_ptr<TThreadPoolServer> server = makeServer();
+  server->setPerRequest(true);
+  ServerThread thread(server);
+  thread.start();
+
+  std::vector<shared_ptr<Client> > clients;
+  for (int i = 0; i < 4; ++i) {
+    clients.push_back(shared_ptr<Client>(new Client()));
+    clients.back()->send(i, 0);
+    BOOST_CHECK_EQUAL(clients.back()->receive(), i);
+  }
+  BOOST_CHECK_EQUAL(thread.waitForClients(4), 4);
+
+  // Idle clients that hang up leave the poller, and the rest go on
+  clients[0]->close();
+  clients[2]->close();
+  BOOST_CHECK_EQUAL(thread.waitForClients(2), 2);
+  clients[1]->send(1, 0);
+  clients[3]->send(3, 0);
+  BOOST_CHECK_EQUAL(clients[1]->receive(), 1);
+  BOOST_CHECK_EQUAL(clients[3]->receive(), 3);
+
+  thread.stop();
+}
+
+BOOST_AUTO_TEST_CASE( test_per_request_stop_closes_clients ) {
+  shared_ptr<TThreadPoolServer> server = makeServer();
+  server->setPerRequest(true);
+  ServerThread thread(server);
+  thread.start();
+
+  std::vector<shared_ptr<Client> > clients;
+  for (int i = 0; i < 3; ++i) {
+    clients.push_back(shared_ptr<Client>(new Client()));
+  }
+  BOOST_CHECK_EQUAL(thread.waitForClients(3), 3);
+
+  // One client is on a worker when the server stops, the others are parked
+  clients[0]->send(0, 300);
+  usleep(100 * 1000);
+  thread.stop();
+
+  // serve() returned only after every client was closed, and the call that
+  // was running still got its answer
+  BOOST_CHECK_EQUAL(thread.clients(), 0);
+  BOOST_CHECK_EQUAL(clients[0]->receive(), 0);
+}
+
+#endif // #ifdef HAVE_SYS_EPOLL_H
+
+BOOST_AUTO_TEST_SUITE_END();
@@ -0,0 +1,158 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Measures structs read and written by the table-driven serializer against
+ * their twins that use generated code, with TBinaryProtocol and
+ * TCompactProtocol.
+ *
+ * Usage: TableBenchmark [iterations]
+ */
+
+#include <iostream>
+#include <cstdlib>
+#include <transport/TBufferTransports.h>
+#include <protocol/TBinaryProtocol.h>
+#include <protocol/TCompactProtocol.h>
+#include "gen-cpp/TableTest_types.h"
+#include <sys/time.h>
+
+using namespace std;
+using namespace thrift::test::table;
+using namespace apache::thrift::transport;
+using namespace apache::thrift::protocol;
+using namespace boost;
+
+class Timer {
+public:
+  timeval vStart;
+
+  Timer() {
+    gettimeofday(&vStart, 0);
+  }
+  void start() {
+    gettimeofday(&vStart, 0);
+  }
+
+  double frame() {
+    timeval vEnd;
+    gettimeofday(&vEnd, 0);
+    double dstart = vStart.tv_sec + ((double)vStart.tv_usec / 1000000.0);
+    double dend = vEnd.tv_sec + ((double)vEnd.tv_usec / 1000000.0);
+    return dend - dstart;
+  }
+
+};
+
+template <typename Protocol, typename Struct>
+static void run(const char* name, const Struct& s, int num) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  Protocol prot(buf);
+
+  Timer timer;
+  for (int i = 0; i < num; i ++) {
+    buf->resetBuffer();
+    s.write(&prot);
+  }
+  double writeTime = timer.frame();
+  uint32_t size = buf->available_read();
+
+  uint8_t* data;
+  uint32_t datasize;
+  buf->getBuffer(&data, &datasize);
+  string wire((const char*)data, datasize);
+
+  timer.start();
+  for (int i = 0; i < num; i ++) {
+    buf->resetBuffer((uint8_t*)wire.data(), wire.size());
+    Struct s2;
+    s2.read(&prot);
+  }
+  double readTime = timer.frame();
+
+  cout << name << ": " << size << " bytes, write "
+       << num / (1000 * writeTime) << " kHz ("
+       << size * (double)num / writeTime / (1024 * 1024) << " MB/s), read "
+       << num / (1000 * readTime) << " kHz ("
+       << size * (double)num / readTime / (1024 * 1024) << " MB/s)" << endl;
+}
+
+// Copies a struct into its twin, by way of the wire
+template <typename From, typename To>
+static void copy(const From& from, To& to) {
+  shared_ptr<TMemoryBuffer> buf(new TMemoryBuffer());
+  TBinaryProtocol prot(buf);
+  from.write(&prot);
+  to.read(&prot);
+}
+
+template <typename Table, typename Generated>
+static void runAll(const char* name, const Generated& s, int num) {
+  Table t;
+  copy(s, t);
+  string prefix(name);
+  run<TBinaryProtocol>((prefix + ", binary, generated").c_str(), s, num);
+  run<TBinaryProtocol>((prefix + ", binary, table").c_str(), t, num);
+  run<TCompactProtocol>((prefix + ", compact, generated").c_str(), s, num);
+  run<TCompactProtocol>((prefix + ", compact, table").c_str(), t, num);
+}
+
+int main(int argc, char** argv) {
+  int num = argc > 1 ? atoi(argv[1]) : 100000;
+
+  GeneratedInner inner;
+  inner.id = 42;
+  inner.name = "forty-two";
+
+  // Every kind of field, with short containers
+  GeneratedEverything ge;
+  ge.req_i32 = 25;
+  ge.req_string = "required";
+  ge.a_bool = true;
+  ge.a_byte = 2;
+  ge.an_i16 = 30000;
+  ge.an_i32 = 1 << 24;
+  ge.an_i64 = (int64_t)6000 * 1000 * 1000;
+  ge.a_double = 3.25;
+  ge.a_string = "a string";
+  ge.a_binary = "\1\2\3\255";
+  ge.a_color = BLUE;
+  ge.an_inner = inner;
+  for (int i = 0; i < 10; i++) {
+    ge.bool_list.push_back(i % 3 == 0);
+    ge.i32_list.push_back(i * 1000);
+    ge.double_list.push_back(i / 4.0);
+    ge.color_list.push_back(GREEN);
+    ge.inner_list.push_back(inner);
+    ge.i64_set.insert((int64_t)i << 40);
+  }
+  ge.binary_list.push_back("\377\376");
+  ge.string_set.insert("x");
+  ge.names[1] = "uno";
+  ge.groups["all"] = ge.inner_list;
+  ge.nested.resize(2);
+  ge.nested[0][RED].insert(1);
+  ge.opt_i32 = 22;
+  ge.__isset.opt_i32 = true;
+
+  runAll<Inner>("Inner", inner, num * 10);
+  runAll<Everything>("Everything", ge, num);
+
+  return 0;
+}
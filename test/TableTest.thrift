@@ -0,0 +1,104 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/*
+ * Structs for TTableSerializerTest and TableBenchmark, generated with the
+ * "table" option.  Each one read and written by the table-driven serializer
+ * has a twin that keeps the generated code, to check the two against.
+ */
+
+namespace cpp thrift.test.table
+
+enum Color {
+  RED = 1,
+  GREEN = 2,
+  BLUE = 3,
+}
+
+struct Inner {
+  1: i32 id,
+  2: string name,
+}
+
+struct Everything {
+  // Declared out of order, written in order
+  25: required i32 req_i32,
+  26: required string req_string,
+  1: bool a_bool,
+  2: byte a_byte,
+  3: i16 an_i16,
+  4: i32 an_i32,
+  5: i64 an_i64,
+  6: double a_double,
+  7: string a_string,
+  8: binary a_binary,
+  9: Color a_color,
+  10: Inner an_inner,
+  11: list<bool> bool_list,
+  12: list<i32> i32_list,
+  13: list<double> double_list,
+  14: list<binary> binary_list,
+  15: list<Color> color_list,
+  16: list<Inner> inner_list,
+  17: set<i64> i64_set,
+  18: set<string> string_set,
+  19: map<i32,string> names,
+  20: map<string,list<Inner>> groups,
+  21: list<map<Color,set<i16>>> nested,
+  22: optional i32 opt_i32,
+  23: optional string opt_string,
+  24: optional Inner opt_inner,
+}
+
+struct GeneratedInner {
+  1: i32 id,
+  2: string name,
+} (cpp.serializer = "generated")
+
+struct GeneratedEverything {
+  25: required i32 req_i32,
+  26: required string req_string,
+  1: bool a_bool,
+  2: byte a_byte,
+  3: i16 an_i16,
+  4: i32 an_i32,
+  5: i64 an_i64,
+  6: double a_double,
+  7: string a_string,
+  8: binary a_binary,
+  9: Color a_color,
+  10: GeneratedInner an_inner,
+  11: list<bool> bool_list,
+  12: list<i32> i32_list,
+  13: list<double> double_list,
+  14: list<binary> binary_list,
+  15: list<Color> color_list,
+  16: list<GeneratedInner> inner_list,
+  17: set<i64> i64_set,
+  18: set<string> string_set,
+  19: map<i32,string> names,
+  20: map<string,list<GeneratedInner>> groups,
+  21: list<map<Color,set<i16>>> nested,
+  22: optional i32 opt_i32,
+  23: optional string opt_string,
+  24: optional GeneratedInner opt_inner,
+} (cpp.serializer = "generated")
+
+struct Empty {
+}
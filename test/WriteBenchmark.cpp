@@ -0,0 +1,205 @@
+/*
+ * Licensed to the Apache Software Foundation (ASF) under one
+ * or more contributor license agreements. See the NOTICE file
+ * distributed with this work for additional information
+ * regarding copyright ownership. The ASF licenses this file
+ * to you under the Apache License, Version 2.0 (the
+ * "License"); you may not use this file except in compliance
+ * with the License. You may obtain a copy of the License at
+ *
+ *   http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing,
+ * software distributed under the License is distributed on an
+ * "AS IS" BASIS, WITHOUT WARRANTIES OR CONDITIONS OF ANY
+ * KIND, either express or implied. See the License for the
+ * specific language governing permissions and limitations
+ * under the License.
+ */
+
+/**
+ * Measures how TSocket write modes send messages of 1KB to 10MB over
+ * loopback.  Each message is answered with a one byte ack, like a response
+ * the client waits for.  Reported are the socket syscalls made by both ends
+ * and the TCP segments the host sent (from /proc/net/snmp, so run it on a
+ * quiet box), per message.
+ *
+ * Usage: WriteBenchmark [MB per run]
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sys/time.h>
+#include <concurrency/PosixThreadFactory.h>
+#include <transport/TServerSocket.h>
+#include <transport/TSocket.h>
+#include <transport/TBufferTransports.h>
+
+namespace apache { namespace thrift { namespace transport {
+extern uint32_t g_socket_syscalls;
+}}}
+
+using namespace std;
+using namespace boost;
+using namespace apache::thrift::concurrency;
+using namespace apache::thrift::transport;
+
+static const int PORT = 9391;
+
+static double now() {
+  timeval tv;
+  gettimeofday(&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+/**
+ * TCP segments sent by this host so far, or 0 if unknown.
+ */
+static uint64_t outSegs() {
+  FILE* f = fopen("/proc/net/snmp", "r");
+  if (f == NULL) {
+    return 0;
+  }
+  // The Tcp: header line names the columns, the next one has the values
+  char names[1024];
+  char values[1024];
+  uint64_t result = 0;
+  while (fgets(names, sizeof(names), f) != NULL) {
+    if (strncmp(names, "Tcp:", 4) != 0 || fgets(values, sizeof(values), f) == NULL) {
+      continue;
+    }
+    char* nameSave;
+    char* valueSave;
+    char* name = strtok_r(names, " \n", &nameSave);
+    char* value = strtok_r(values, " \n", &valueSave);
+    while (name != NULL && value != NULL) {
+      if (strcmp(name, "OutSegs") == 0) {
+        result = strtoull(value, NULL, 10);
+      }
+      name = strtok_r(NULL, " \n", &nameSave);
+      value = strtok_r(NULL, " \n", &valueSave);
+    }
+    break;
+  }
+  fclose(f);
+  return result;
+}
+
+/**
+ * Reads messages of a given size and acks each one.
+ */
+class Receiver : public Runnable {
+ public:
+  Receiver(shared_ptr<TServerSocket> serverSocket, uint32_t size, int count) :
+    serverSocket_(serverSocket),
+    size_(size),
+    count_(count) {}
+
+  void run() {
+    shared_ptr<TTransport> client = serverSocket_->accept();
+    uint8_t* buf = new uint8_t[size_];
+    uint8_t ack = 1;
+    for (int i = 0; i < count_; i++) {
+      client->readAll(buf, size_);
+      client->write(&ack, 1);
+    }
+    delete[] buf;
+    client->close();
+  }
+
+ private:
+  shared_ptr<TServerSocket> serverSocket_;
+  uint32_t size_;
+  int count_;
+};
+
+enum Mode {
+  PIECES,
+  PIECES_CORKED,
+  WHOLE,
+  WHOLE_ZEROCOPY
+};
+
+static const char* modeNames[] = {
+  "64B pieces, buffered",
+  "64B pieces, buffered, corked",
+  "one write",
+  "one write, zero-copy"
+};
+
+static void runBenchmark(Mode mode, uint32_t size, int count) {
+  shared_ptr<TServerSocket> serverSocket(new TServerSocket(PORT));
+  serverSocket->listen();
+  shared_ptr<Thread> receiver = PosixThreadFactory(PosixThreadFactory::ROUND_ROBIN,
+                                                   PosixThreadFactory::NORMAL, 1, false)
+    .newThread(shared_ptr<Runnable>(new Receiver(serverSocket, size, count)));
+  receiver->start();
+
+  shared_ptr<TSocket> socket(new TSocket("127.0.0.1", PORT));
+  socket->setCork(mode == PIECES_CORKED);
+  if (mode == WHOLE_ZEROCOPY) {
+    socket->setZeroCopyThreshold(64 * 1024);
+  }
+  socket->open();
+  TBufferedTransport transport(socket);
+
+  uint8_t* message = new uint8_t[size];
+  memset(message, 'x', size);
+  uint8_t ack;
+
+  uint32_t syscalls = g_socket_syscalls;
+  uint64_t segs = outSegs();
+  double start = now();
+  for (int i = 0; i < count; i++) {
+    if (mode == PIECES || mode == PIECES_CORKED) {
+      for (uint32_t off = 0; off < size; off += 64) {
+        transport.write(message + off, (size - off < 64) ? size - off : 64);
+      }
+    } else {
+      transport.write(message, size);
+    }
+    transport.flush();
+    transport.writeEnd();
+    transport.readAll(&ack, 1);
+  }
+  double elapsed = now() - start;
+  // Includes the acks, which are one segment each
+  segs = outSegs() - segs - count;
+  syscalls = g_socket_syscalls - syscalls;
+
+  receiver->join();
+  transport.close();
+  serverSocket->close();
+  delete[] message;
+
+  char line[256];
+  sprintf(line, "%8u B  %-30s %8.1f MB/s %8.1f segs %8.1f syscalls",
+          size, modeNames[mode],
+          (double)size * count / elapsed / (1024 * 1024),
+          (double)segs / count, (double)syscalls / count);
+  cout << line << endl;
+}
+
+int main(int argc, char** argv) {
+  uint64_t bytesPerRun = (argc > 1 ? atoi(argv[1]) : 64) * 1024ULL * 1024ULL;
+
+  static const uint32_t sizes[] = {
+    1024, 16 * 1024, 256 * 1024, 1024 * 1024, 10 * 1024 * 1024
+  };
+  for (size_t i = 0; i < sizeof(sizes) / sizeof(sizes[0]); i++) {
+    int count = (int)(bytesPerRun / sizes[i]);
+    if (count < 10) {
+      count = 10;
+    }
+    if (count > 20000) {
+      count = 20000;
+    }
+    for (int mode = PIECES; mode <= WHOLE_ZEROCOPY; mode++) {
+      runBenchmark((Mode)mode, sizes[i], count);
+    }
+  }
+
+  return 0;
+}
@@ -304,6 +304,41 @@ int main() {
         assert(ex.getType() == TTransportException::INTERNAL_ERROR);
       }
     }
+
+    // Frames compressed with the zlib frame codec, read back by a transport
+    // that also has to know the codec.
+    {
+      mirror.clear();
+      shared_ptr<TMemoryBuffer> membuf(new TMemoryBuffer());
+      shared_ptr<TFrameCodec> codec(new TZlibFrameCodec());
+      TCompressedFramedTransport writer(membuf, codec);
+      TCompressedFramedTransport reader(membuf);
+      reader.addCodec(codec->clone());
+      for (int i = 0; i < 3; i++) {
+        writer.write(&content[0], content.size());
+        writer.flush();
+        mirror.resize(content.size());
+        reader.readAll(&mirror[0], mirror.size());
+        assert(mirror == content);
+      }
+
+      // Flip a bit in a compressed frame.
+      writer.write(&content[0], content.size());
+      writer.flush();
+      string tmp_buf;
+      membuf->appendBufferToString(tmp_buf);
+      if (tmp_buf[4] == TFrameCodec::ZLIB) {
+        tmp_buf[tmp_buf.length() / 2] ^= 1;
+        membuf->resetBuffer((uint8_t*)tmp_buf.data(), tmp_buf.length(),
+                            TMemoryBuffer::COPY);
+        try {
+          reader.readAll(&mirror[0], mirror.size());
+          assert(false);
+        } catch (TTransportException& ex) {
+          assert(ex.getType() == TTransportException::CORRUPTED_DATA);
+        }
+      }
+    }
   }
 
   return 0;
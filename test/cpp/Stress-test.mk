@@ -67,5 +67,15 @@ stress-test-debug: stubs
 stress-test: stubs
 	g++ -o stress-test $(CFL) src/main.cpp ./gen-cpp/Service.cpp gen-cpp/StressTest_types.cpp
 
+# Requests/sec of the nonblocking server as the IO thread count grows, one
+# line per IO thread count, for both server types
+bench-nb-io-threads: stress-test-nb
+	@for type in simple thread-pool; do \
+	  for n in 1 2 4 8 16; do \
+	    echo -n "$$type: "; \
+	    ./stress-test-nb --server-type=$$type --workers=16 --clients=64 --call=echoI32 --loop=10000 --io-threads=$$n 2>/dev/null | grep rate; \
+	  done; \
+	done
+
 clean:
 	rm -fr stress-test stress-test-nb gen-cpp
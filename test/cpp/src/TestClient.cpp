@@ -22,7 +22,9 @@
 #include <sys/time.h>
 #include <protocol/TBinaryProtocol.h>
 #include <transport/TTransportUtils.h>
+#include <transport/TCompressedFramedTransport.h>
 #include <transport/TSocket.h>
+#include <async/TEventClientChannel.h>
 
 #include <boost/shared_ptr.hpp>
 #include "ThriftTest.h"
@@ -35,6 +37,7 @@ using namespace std;
 using namespace apache::thrift;
 using namespace apache::thrift::protocol;
 using namespace apache::thrift::transport;
+using namespace apache::thrift::async;
 using namespace thrift::test;
 
 //extern uint32_t g_socket_syscalls;
@@ -51,11 +54,122 @@ uint64_t now()
   return ret;
 }
 
+/**
+ * Pipelined calls over one connection, with their responses checked as
+ * they come back.
+ */
+struct AsyncTest {
+  struct event_base* base;
+  int outstanding;
+  int failures;
+
+  void done(bool ok) {
+    if (!ok) {
+      failures++;
+    }
+    if (--outstanding == 0) {
+      event_base_loopbreak(base);
+    }
+  }
+
+  void i32Returned(ThriftTestAsyncClient* client, int32_t expected) {
+    bool ok = false;
+    try {
+      ok = (client->recv_testI32() == expected);
+    } catch (TException& e) {
+      printf("testI32 failed: %s\n", e.what());
+    }
+    done(ok);
+  }
+
+  void stringReturned(ThriftTestAsyncClient* client, string expected) {
+    bool ok = false;
+    try {
+      string s;
+      client->recv_testString(s);
+      ok = (s == expected);
+    } catch (TException& e) {
+      printf("testString failed: %s\n", e.what());
+    }
+    done(ok);
+  }
+
+  void exceptionReturned(ThriftTestAsyncClient* client) {
+    bool ok = false;
+    try {
+      Xtruct result;
+      client->recv_testMultiException(result);
+    } catch (Xception2& e) {
+      ok = (e.errorCode == 2002);
+    } catch (TException& e) {
+      printf("testMultiException failed: %s\n", e.what());
+    }
+    done(ok);
+  }
+};
+
+static bool runAsyncTest(const string& host, int port, int calls) {
+  using std::tr1::bind;
+  using namespace std::tr1::placeholders;
+
+  shared_ptr<TSocket> socket(new TSocket(host, port));
+  try {
+    socket->open();
+  } catch (TTransportException& ttx) {
+    printf("Connect failed: %s\n", ttx.what());
+    return false;
+  }
+
+  AsyncTest test;
+  test.base = event_base_new();
+  test.outstanding = 0;
+  test.failures = 0;
+  {
+    shared_ptr<TEventClientChannel> channel(new TEventClientChannel(socket, test.base));
+    shared_ptr<TProtocolFactory> protocolFactory(new TBinaryProtocolFactory());
+    ThriftTestAsyncClient client(channel, protocolFactory);
+
+    printf("Async test, %d pipelined calls to %s:%d\n", calls, host.c_str(), port);
+    uint64_t start = now();
+    for (int i = 0; i < calls; i++) {
+      switch (i % 3) {
+      case 0:
+        client.testI32(bind(&AsyncTest::i32Returned, &test, _1, i), i);
+        break;
+      case 1: {
+        char buf[32];
+        sprintf(buf, "call %d", i);
+        client.testString(bind(&AsyncTest::stringReturned, &test, _1, string(buf)), buf);
+        break;
+      }
+      default:
+        client.testMultiException(bind(&AsyncTest::exceptionReturned, &test, _1),
+                                  "Xception2", "pipelined");
+        break;
+      }
+      test.outstanding++;
+    }
+    event_base_dispatch(test.base);
+    uint64_t stop = now();
+
+    if (test.outstanding != 0) {
+      printf("%d calls unanswered\n", test.outstanding);
+      test.failures++;
+    }
+    printf("%d calls, %d failed, took %"PRIu64" us\n",
+           calls, test.failures, stop - start);
+  }
+  event_base_free(test.base);
+  return test.failures == 0;
+}
+
 int main(int argc, char** argv) {
   string host = "localhost";
   int port = 9090;
   int numTests = 1;
   bool framed = false;
+  bool compressed = false;
+  int asyncCalls = 0;
 
   for (int i = 0; i < argc; ++i) {
     if (strcmp(argv[i], "-h") == 0) {
@@ -71,15 +185,26 @@ int main(int argc, char** argv) {
       numTests = atoi(argv[++i]);
     } else if (strcmp(argv[i], "-f") == 0) {
       framed = true;
+    } else if (strcmp(argv[i], "-c") == 0) {
+      compressed = true;
+    } else if (strcmp(argv[i], "-a") == 0) {
+      asyncCalls = atoi(argv[++i]);
     }
   }
 
+  // The async client always frames its messages
+  if (asyncCalls > 0) {
+    return runAsyncTest(host, port, asyncCalls) ? 0 : 1;
+  }
+
 
   shared_ptr<TTransport> transport;
 
   shared_ptr<TSocket> socket(new TSocket(host, port));
 
-  if (framed) {
+  if (compressed) {
+    transport.reset(new TCompressedFramedTransport(socket));
+  } else if (framed) {
     shared_ptr<TFramedTransport> framedSocket(new TFramedTransport(socket));
     transport = framedSocket;
   } else {
@@ -25,7 +25,9 @@
 #include <server/TThreadPoolServer.h>
 #include <server/TNonblockingServer.h>
 #include <transport/TServerSocket.h>
+#include <transport/TShardedServerSocket.h>
 #include <transport/TTransportUtils.h>
+#include <transport/TCompressedFramedTransport.h>
 #include "ThriftTest.h"
 
 #include <iostream>
@@ -293,17 +295,29 @@ int main(int argc, char **argv) {
   string serverType = "simple";
   string protocolType = "binary";
   size_t workerCount = 4;
+  bool perRequest = false;
+  bool compressed = false;
+  size_t requestsInFlight = 0;
+  int acceptThreads = 1;
 
   ostringstream usage;
 
   usage <<
-    argv[0] << " [--port=<port number>] [--server-type=<server-type>] [--protocol-type=<protocol-type>] [--workers=<worker-count>]" << endl <<
+    argv[0] << " [--port=<port number>] [--server-type=<server-type>] [--protocol-type=<protocol-type>] [--workers=<worker-count>] [--per-request] [--compressed] [--requests-in-flight=<count>] [--accept-threads=<count>]" << endl <<
 
     "\t\tserver-type\t\ttype of server, \"simple\", \"thread-pool\", \"threaded\", or \"nonblocking\".  Default is " << serverType << endl <<
 
     "\t\tprotocol-type\t\ttype of protocol, \"binary\", \"ascii\", or \"xml\".  Default is " << protocolType << endl <<
 
-    "\t\tworkers\t\tNumber of thread pools workers.  Only valid for thread-pool server type.  Default is " << workerCount << endl;
+    "\t\tworkers\t\tNumber of thread pools workers.  Only valid for thread-pool server type, or nonblocking with requests-in-flight.  Default is " << workerCount << endl <<
+
+    "\t\tper-request\t\tGive connections a worker per request rather than per connection.  Only valid for thread-pool server type." << endl <<
+
+    "\t\tcompressed\t\tUse compressed framed transports, for clients run with -c." << endl <<
+
+    "\t\trequests-in-flight\t\tRequests a connection may have on workers at once, answered out of order.  Only valid for nonblocking server type." << endl <<
+
+    "\t\taccept-threads\t\tThreads accepting connections, each on its own SO_REUSEPORT socket.  Only valid for thread-pool and threaded server types." << endl;
 
   map<string, string>  args;
 
@@ -353,6 +367,18 @@ int main(int argc, char **argv) {
     if (!args["workers"].empty()) {
       workerCount = atoi(args["workers"].c_str());
     }
+
+    perRequest = !args["per-request"].empty();
+
+    compressed = !args["compressed"].empty();
+
+    if (!args["requests-in-flight"].empty()) {
+      requestsInFlight = atoi(args["requests-in-flight"].c_str());
+    }
+
+    if (!args["accept-threads"].empty()) {
+      acceptThreads = atoi(args["accept-threads"].c_str());
+    }
   } catch (exception& e) {
     cerr << e.what() << endl;
     cerr << usage;
@@ -366,11 +392,18 @@ int main(int argc, char **argv) {
   shared_ptr<ThriftTestProcessor> testProcessor(new ThriftTestProcessor(testHandler));
 
   // Transport
-  shared_ptr<TServerSocket> serverSocket(new TServerSocket(port));
+  shared_ptr<TServerTransport> serverSocket(new TServerSocket(port));
+  if (acceptThreads > 1) {
+    serverSocket.reset(new TShardedServerSocket(port, acceptThreads));
+  }
 
   // Factory
   shared_ptr<TTransportFactory> transportFactory(new TBufferedTransportFactory());
 
+  if (compressed) {
+    transportFactory.reset(new TCompressedFramedTransportFactory());
+  }
+
   if (serverType == "simple") {
 
     // Server
@@ -399,6 +432,8 @@ int main(int argc, char **argv) {
                                        transportFactory,
                                        protocolFactory,
 				       threadManager);
+    threadPoolServer.setPerRequest(perRequest);
+    threadPoolServer.setAcceptThreads(acceptThreads);
 
     printf("Starting the server on port %d...\n", port);
     threadPoolServer.serve();
@@ -409,12 +444,26 @@ int main(int argc, char **argv) {
                                    serverSocket,
                                    transportFactory,
                                    protocolFactory);
+    threadedServer.setAcceptThreads(acceptThreads);
 
     printf("Starting the server on port %d...\n", port);
     threadedServer.serve();
 
   } else if (serverType == "nonblocking") {
     TNonblockingServer nonblockingServer(testProcessor, port);
+    if (requestsInFlight > 0) {
+      shared_ptr<ThreadManager> threadManager =
+        ThreadManager::newSimpleThreadManager(workerCount);
+      threadManager->threadFactory(
+        shared_ptr<PosixThreadFactory>(new PosixThreadFactory()));
+      threadManager->start();
+      nonblockingServer.setThreadManager(threadManager);
+      nonblockingServer.setMaxRequestsInFlight(requestsInFlight);
+    }
+    if (compressed) {
+      nonblockingServer.setInputTransportFactory(transportFactory);
+      nonblockingServer.setOutputTransportFactory(transportFactory);
+    }
     printf("Starting the nonblocking server on port %d...\n", port);
     nonblockingServer.serve();
   }
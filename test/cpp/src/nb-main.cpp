@@ -229,6 +229,7 @@ int main(int argc, char **argv) {
   string serverType = "simple";
   string protocolType = "binary";
   size_t workerCount = 4;
+  size_t ioThreadCount = 1;
   size_t clientCount = 20;
   size_t loopCount = 50000;
   TType loopType  = T_VOID;
@@ -241,7 +242,7 @@ int main(int argc, char **argv) {
   ostringstream usage;
 
   usage <<
-    argv[0] << " [--port=<port number>] [--server] [--server-type=<server-type>] [--protocol-type=<protocol-type>] [--workers=<worker-count>] [--clients=<client-count>] [--loop=<loop-count>]" << endl <<
+    argv[0] << " [--port=<port number>] [--server] [--server-type=<server-type>] [--protocol-type=<protocol-type>] [--workers=<worker-count>] [--io-threads=<io-thread-count>] [--clients=<client-count>] [--loop=<loop-count>]" << endl <<
     "\tclients        Number of client threads to create - 0 implies no clients, i.e. server only.  Default is " << clientCount << endl <<
     "\thelp           Prints this help text." << endl <<
     "\tcall           Service method to call.  Default is " << callName << endl <<
@@ -252,7 +253,8 @@ int main(int argc, char **argv) {
     "\tprotocol-type  Type of protocol, \"binary\", \"ascii\", or \"xml\".  Default is " << protocolType << endl <<
     "\tlog-request    Log all request to ./requestlog.tlog. Default is " << logRequests << endl <<
     "\treplay-request Replay requests from log file (./requestlog.tlog) Default is " << replayRequests << endl <<
-    "\tworkers        Number of thread pools workers.  Only valid for thread-pool server type.  Default is " << workerCount << endl;
+    "\tworkers        Number of thread pools workers.  Only valid for thread-pool server type.  Default is " << workerCount << endl <<
+    "\tio-threads     Number of IO threads per nonblocking server.  Default is " << ioThreadCount << endl;
 
 
   map<string, string>  args;
@@ -320,6 +322,10 @@ int main(int argc, char **argv) {
       workerCount = atoi(args["workers"].c_str());
     }
 
+    if (!args["io-threads"].empty()) {
+      ioThreadCount = atoi(args["io-threads"].c_str());
+    }
+
   } catch(exception& e) {
     cerr << e.what() << endl;
     cerr << usage;
@@ -374,11 +380,13 @@ int main(int argc, char **argv) {
 
     shared_ptr<Thread> serverThread;
     shared_ptr<Thread> serverThread2;
+    shared_ptr<TNonblockingServer> server;
+    shared_ptr<TNonblockingServer> server2;
 
     if (serverType == "simple") {
 
-      serverThread = threadFactory->newThread(shared_ptr<TServer>(new TNonblockingServer(serviceProcessor, protocolFactory, port)));
-      serverThread2 = threadFactory->newThread(shared_ptr<TServer>(new TNonblockingServer(serviceProcessor, protocolFactory, port+1)));
+      server = shared_ptr<TNonblockingServer>(new TNonblockingServer(serviceProcessor, protocolFactory, port));
+      server2 = shared_ptr<TNonblockingServer>(new TNonblockingServer(serviceProcessor, protocolFactory, port+1));
 
     } else if (serverType == "thread-pool") {
 
@@ -386,10 +394,15 @@ int main(int argc, char **argv) {
 
       threadManager->threadFactory(threadFactory);
       threadManager->start();
-      serverThread = threadFactory->newThread(shared_ptr<TServer>(new TNonblockingServer(serviceProcessor, protocolFactory, port, threadManager)));
-      serverThread2 = threadFactory->newThread(shared_ptr<TServer>(new TNonblockingServer(serviceProcessor, protocolFactory, port+1, threadManager)));
+      server = shared_ptr<TNonblockingServer>(new TNonblockingServer(serviceProcessor, protocolFactory, port, threadManager));
+      server2 = shared_ptr<TNonblockingServer>(new TNonblockingServer(serviceProcessor, protocolFactory, port+1, threadManager));
     }
 
+    server->setNumIOThreads(ioThreadCount);
+    server2->setNumIOThreads(ioThreadCount);
+    serverThread = threadFactory->newThread(server);
+    serverThread2 = threadFactory->newThread(server2);
+
     cerr << "Starting the server on port " << port << " and " << (port + 1) << endl;
     serverThread->start();
     serverThread2->start();
@@ -488,7 +501,7 @@ int main(int argc, char **argv) {
     averageTime /= clientCount;
 
 
-    cout <<  "workers :" << workerCount << ", client : " << clientCount << ", loops : " << loopCount << ", rate : " << (clientCount * loopCount * 1000) / ((double)(time01 - time00)) << endl;
+    cout <<  "workers :" << workerCount << ", io threads : " << ioThreadCount << ", client : " << clientCount << ", loops : " << loopCount << ", rate : " << (clientCount * loopCount * 1000) / ((double)(time01 - time00)) << endl;
 
     count_map count = serviceHandler->getCount();
     count_map::iterator iter;